@@ -0,0 +1,68 @@
+#ifndef CADENCE_FUSION_H
+#define CADENCE_FUSION_H
+
+#include <stdint.h>
+#include "gear_estimator.h"
+
+// Cadence fusion tuning
+#define FUSION_RATIO_SHIFT 8       // Extra fraction bits of the tracked ratio
+#define FUSION_GAIN_SHIFT 2        // Each crank edge corrects 1/4 of the ratio error
+#define FUSION_TOLERANCE 8         // Max disagreement (%) of a crank edge with the wheel
+#define FUSION_CONFIRM_EDGES 2     // Agreeing crank edges before the fused value is used
+#define FUSION_OVERDUE_PERCENT 150 // Crank edge later than this % of its predicted interval = freewheeling
+
+// Cadence of one bike inferred from its wheel. While pedalling in a known
+// gear the crank turns at wheel RPM / gear ratio, and the wheel reports
+// many edges per revolution where the crank reports one, so the wheel
+// gives a cadence that follows changes within a fraction of a pedal
+// stroke. Each crank edge checks that cadence, averaged over the same
+// revolution so the crank's lag while accelerating is not mistaken for
+// disagreement. An agreeing edge nudges the tracked ratio towards the
+// measured one (a complementary filter - the wheel carries the fast
+// changes, the crank the long-term level), a disagreeing one drops the
+// lock until the crank agrees again. No lock is held while the gear is
+// unknown or a shift is pending, and it lapses when a crank edge is
+// overdue (freewheeling); callers then fall back to the crank's own
+// reading.
+class CadenceFusion {
+public:
+    CadenceFusion();
+
+    // Forget the lock and the tracked ratio
+    void clear();
+
+    // Called on every pass after gear estimation: wheel RPM, the crank's
+    // reading and its last accepted edge (time and interval, micros)
+    void update(const GearEstimator& gear, uint32_t wheelMilliRPM, uint32_t cadenceMilliRPM,
+                uint32_t crankEdgeTime, uint32_t crankInterval);
+
+    // True while the wheel-derived cadence is trusted
+    bool isLocked() const;
+
+    // Wheel-derived cadence (milli-RPM), 0 when not locked. Once the next
+    // crank edge is due it is also capped by the time since the last one,
+    // like SensorEngine::getDecayedMilliRPM.
+    uint32_t getCadenceMilliRPM() const;
+
+    // Crank edges that agreed with and contradicted the wheel while locked
+    unsigned long getAgreeingEdges() const { return agreeingEdges; }
+    unsigned long getDisagreeingEdges() const { return disagreeingEdges; }
+
+private:
+    uint16_t gearRatio;          // Locked gear from the estimator (x GEAR_RATIO_SCALE), 0 if none
+    uint32_t trackedRatio;       // Corrected ratio (x GEAR_RATIO_SCALE << FUSION_RATIO_SHIFT)
+    uint32_t predictedMilliRPM;  // Cadence from the last wheel reading
+    uint64_t predictedSum;       // Predicted cadence x micros since the last crank edge
+    uint32_t predictedTime;      // Micros covered by predictedSum
+    uint32_t lastUpdateTime;
+    uint32_t lastCrankEdge;      // Crank edge already checked
+    uint32_t crankInterval;      // Its interval (micros)
+    uint32_t crankMilliRPM;      // The crank's reading at that edge
+    uint8_t confirmations;       // Agreeing crank edges since the lock was lost
+    unsigned long agreeingEdges;
+    unsigned long disagreeingEdges;
+
+    void checkCrankEdge(uint32_t cadenceMilliRPM);
+};
+
+#endif // CADENCE_FUSION_H
@@ -0,0 +1,12 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+// Time base for code that must also build off-target. The firmware maps
+// these onto the Arduino clock (src/clock.cpp); host builds provide their
+// own definitions, e.g. a virtual clock that can run faster than real time.
+uint32_t clockMillis();
+uint32_t clockMicros();
+
+#endif // CLOCK_H
@@ -13,22 +13,105 @@
 
 // Serial configuration
 #define SERIAL_BAUD_RATE 115200
+#define SERIAL_TX_BUFFER_SIZE 1024  // Room for queued binary frames
+
+// Serial output mode and the single-character commands that switch it
+#define SERIAL_DEFAULT_MODE SERIAL_MODE_TEXT
+#define SERIAL_TEXT_COMMAND 't'     // Human-readable status lines
+#define SERIAL_SAMPLES_COMMAND 'b'  // Framed binary samples (see tools/serial_reader)
+#define SERIAL_EDGES_COMMAND 'e'    // Framed binary samples plus every raw edge
+#define SERIAL_STREAM_INTERVAL 20   // ms between binary samples (50 Hz)
 
 // Timing configuration
 #define OUTPUT_INTERVAL 3000    // Output interval in milliseconds
 #define MEASUREMENT_INTERVAL 1000  // Interval for RPM calculations in milliseconds
 #define LOGGING_INTERVAL 1000      // Interval for data logging in milliseconds
+#define TELEMETRY_SAMPLE_INTERVAL 100  // Interval for ESP-NOW telemetry samples in milliseconds
+#define TELEMETRY_MAX_LATENCY 500      // Max ms a sample waits in a partly filled ESP-NOW frame
+#define TELEMETRY_RETRY_DEADLINE 1000  // Max ms a frame is retried before it is dropped
+
+// Event-driven loop (see event_loop.h): loop() runs on sensor interrupts
+// and deadlines only. Wi-Fi startup, ESP-NOW retries, capture syncs and
+// serial commands are polled at the housekeeping interval.
+#define EVENT_LOOP_HOUSEKEEPING_INTERVAL 10  // ms
+// 1 = let the CPU light-sleep between events (needs a framework built
+// with power management). Off by default: the sensor interrupts and the
+// pulse counter stop in light sleep, so edges while asleep are missed.
+#define EVENT_LOOP_LIGHT_SLEEP 0
+
+// Averaging windows in milliseconds (max 5000) for each output
+#define SERIAL_AVERAGE_WINDOW 3000
+#define LOG_AVERAGE_WINDOW 1000
+#define ESPNOW_AVERAGE_WINDOW 1000
 
 // Magnets configuration
 #define WHEEL_MAGNETS 14  // Number of magnets on the wheel
 #define CRANK_MAGNETS 1  // Number of magnets on the crank
 
+// 1 = magnets and gears are checked and tabulated at compile time
+// (FixedRPMCalculator), 0 = runtime-configured RPMCalculator
+#define FIXED_SENSOR_CONFIG 1
+
 // Sensor configuration
 #define INTERRUPT_MODE FALLING  // Interrupt trigger mode (RISING, FALLING, CHANGE)
 
+// Sensor acquisition backend (see sensor_input.h); override per build
+// environment with -DSENSOR_BACKEND=SENSOR_BACKEND_PCNT
+#define SENSOR_BACKEND_GPIO 0  // One GPIO interrupt per edge
+#define SENSOR_BACKEND_PCNT 1  // Pulse counter hardware, one interrupt per edgeDivider edges
+#ifndef SENSOR_BACKEND
+#define SENSOR_BACKEND SENSOR_BACKEND_GPIO
+#endif
+
+// Edges counted in hardware per interrupt with the PCNT backend: one
+// interrupt per wheel revolution, every crank edge
+#if SENSOR_BACKEND == SENSOR_BACKEND_PCNT
+#define WHEEL_EDGE_DIVIDER WHEEL_MAGNETS
+#define CADENCE_EDGE_DIVIDER 1
+#else
+#define WHEEL_EDGE_DIVIDER 1
+#define CADENCE_EDGE_DIVIDER 1
+#endif
+#define PCNT_FILTER_CYCLES 1023  // Pulse counter glitch filter (APB cycles, 1023 = 12.8 us)
+
+// Debounce configuration - edges closer than this percentage of the
+// currently tracked period are treated as sensor bounce
+#define WHEEL_GLITCH_PERCENT 30
+#define CADENCE_GLITCH_PERCENT 50
+
+// Sensor channels, one {pin, magnets, max RPM, glitch %, edge divider}
+// entry per Hall sensor (up to MAX_SENSOR_CHANNELS), and the {wheel, crank}
+// channel pairs that form a bike for gear estimation. The first bike feeds
+// the log, telemetry and serial outputs.
+#define SENSOR_CHANNELS { \
+  {WHEEL_SENSOR_PIN, WHEEL_MAGNETS, MAX_WHEEL_RPM, WHEEL_GLITCH_PERCENT, WHEEL_EDGE_DIVIDER}, \
+  {CADENCE_SENSOR_PIN, CRANK_MAGNETS, MAX_CADENCE_RPM, CADENCE_GLITCH_PERCENT, CADENCE_EDGE_DIVIDER} \
+}
+#define SENSOR_BIKES { {0, 1} }
+
+// Magnet spacing calibration (see spacing_calibrator.h): learn each
+// magnet's real angle during steady riding and correct the intervals with
+// it; the tables are kept in NVS across reboots. Only channels with
+// several timestamps per revolution are calibrated - not the wheel with
+// the PCNT backend, which already times whole revolutions.
+#define SPACING_CALIBRATION true
+#define SPACING_FORGET_COMMAND 'm'  // Serial command to drop the tables (after moving magnets)
+
 // Logging configuration
 #define LOG_FILE_PREFIX "/session_"  // Prefix for log files
-#define LOG_FILE_EXTENSION ".csv"    // File extension for log files
+#define LOG_FILE_EXTENSION ".bin"    // File extension for binary log files (see tools/log2csv)
+#define LOG_SYNC_INTERVAL 10000      // Max ms of logged rows that may be lost on power failure
+#define LOG_QUEUE_LENGTH 32          // Rows buffered for the SD writer task during card stalls
+#define LOG_PREALLOCATE_SIZE (1024UL * 1024)  // Contiguous space reserved per log (~14 h of rows)
+
+// Raw edge capture alongside the session log (see tools/capture2csv)
+#define EDGE_CAPTURE_ENABLED true
+#define EDGE_CAPTURE_REJECTED true         // Also keep edges the debounce filter discarded
+#define CAPTURE_FILE_EXTENSION ".edg"
+
+// Instrumentation (only with -DENABLE_INSTRUMENTATION, see platformio.ini)
+#define STATS_INTERVAL 10000  // ms between #STATS packets on serial
+#define STATS_COMMAND 's'     // Serial command for a full stats dump
 
 // SD configuration
 #define SD_CONFIG SdSpiConfig(SD_CS_PIN, SHARED_SPI, SD_SCK_MHZ(1))
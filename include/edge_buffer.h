@@ -0,0 +1,59 @@
+#ifndef EDGE_BUFFER_H
+#define EDGE_BUFFER_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring of edge timestamps.
+// The sensor ISR is the only producer (push) and the main loop the only
+// consumer (pop), so head and tail each have exactly one writer.
+// SIZE must be a power of two so the free-running indices wrap cleanly.
+template <uint16_t SIZE>
+class EdgeBuffer {
+  static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "EdgeBuffer SIZE must be a power of two");
+
+public:
+  EdgeBuffer() : head(0), tail(0), overflowCount(0) {}
+
+  // Producer side (ISR). Returns false and counts an overflow if full.
+  bool push(uint32_t timestamp) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= SIZE) {
+      overflowCount = overflowCount + 1;
+      return false;
+    }
+    slots[h & (SIZE - 1)] = timestamp;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side (loop). Returns false when there is nothing to read.
+  bool pop(uint32_t& timestamp) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    timestamp = slots[t & (SIZE - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: discard everything currently queued
+  void clear() {
+    tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  uint32_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+  uint32_t getOverflowCount() const { return overflowCount; }
+
+private:
+  uint32_t slots[SIZE];
+  std::atomic<uint32_t> head;  // Next slot to write (producer only)
+  std::atomic<uint32_t> tail;  // Next slot to read (consumer only)
+  volatile uint32_t overflowCount;
+};
+
+#endif // EDGE_BUFFER_H
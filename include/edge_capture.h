@@ -0,0 +1,82 @@
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "edge_capture_format.h"
+#include "log_writer.h"
+#include "rpm_calculator.h"
+
+// Sector buffers shared with the writer task. At MAX_WHEEL_RPM with 14
+// magnets the wheel produces ~230 edges/s, ~1.4 sectors/s, so eight
+// buffers ride out several seconds of SD card stall.
+#define EDGE_CAPTURE_BUFFERS 8
+
+// Records every sensor edge (micros timestamp, channel and the debounce
+// filter's verdict) to a capture file for offline analysis with
+// tools/capture2csv. Edges are packed into sector buffers from loop()
+// and handed to the LogWriter task whole, so capturing never waits on
+// the card; when every buffer is still in flight or the writer queue is
+// full, edges are dropped and the count is stored in the next sector.
+class EdgeCapture {
+public:
+    EdgeCapture();
+
+    // Write capture files through this writer; partial sectors are handed
+    // over after syncInterval ms, like the session log
+    void begin(LogWriter* writer, unsigned long syncInterval);
+
+    // Open a capture file and queue its header sector
+    bool start(const char* fileName, uint32_t startTimestamp, uint32_t startMillis, uint32_t bootTimestamp,
+               uint8_t wheelMagnets, uint8_t crankMagnets, bool includeRejected);
+
+    // Add one edge (loop context - matches RPMCalculator's EdgeObserver)
+    void record(SensorChannel channel, uint32_t edgeTime, bool accepted);
+
+    // Hand over a partial sector once it has waited syncInterval ms
+    void update(unsigned long currentTime);
+
+    // Hand over the last sector and close the file
+    void stop();
+
+    bool isActive() const { return active; }
+    unsigned long getCapturedCount() const { return capturedCount; }
+    unsigned long getDroppedCount() const { return droppedCount; }
+
+private:
+    // Find a buffer the writer task has finished with; -1 if all are in flight
+    int8_t claimBuffer();
+
+    // Claim a buffer for the next data sector; false if none is free
+    bool startSector();
+
+    // Queue the current sector for writing
+    void submitSector();
+
+    LogWriter* writer;
+    unsigned long syncInterval;
+    bool active;
+    bool includeRejected;
+
+    uint8_t buffers[EDGE_CAPTURE_BUFFERS][SESSION_LOG_SECTOR_SIZE];
+    std::atomic<bool> busy[EDGE_CAPTURE_BUFFERS];
+    int8_t current;              // Buffer being filled, -1 if none
+    uint8_t nextBuffer;
+    size_t sectorLength;
+    uint16_t sectorEdges;
+    uint32_t sectorSequence;
+    unsigned long sectorStartTime;
+    uint32_t captureId;          // Random per capture, in every sector header
+
+    // Last edge per channel - deltas are taken against these
+    uint32_t lastEdgeTime[2];
+    uint32_t pendingDrops;       // Dropped since the last sector started
+
+    unsigned long capturedCount;
+    unsigned long droppedCount;
+};
+
+// Declare global instance
+extern EdgeCapture edgeCapture;
+
+#endif // EDGE_CAPTURE_H
@@ -0,0 +1,95 @@
+#ifndef EDGE_CAPTURE_FORMAT_H
+#define EDGE_CAPTURE_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "session_log_format.h"
+
+// Raw edge capture layout, shared by the firmware and the tools/ readers.
+// Like the session log it is written in whole 512-byte sectors: sector 0
+// holds the file header, every following sector a small header and a
+// stream of varint-encoded edges. Each edge is stored as
+//   varint((delta << 2) | (rejected << 1) | channel)
+// where delta is the micros since the previous edge on the same channel.
+// Every sector carries both channels' base times, so a torn or missing
+// sector only loses its own edges, and the count of edges dropped while
+// the SD card was too slow to take them.
+//
+// From version 2 sector headers also carry the capture's random id, so a
+// reader can tell the capture's own sectors from zeroed holes (sectors
+// the card failed to take) and from anything else in the file.
+
+#define EDGE_CAPTURE_MAGIC "TTEC"
+#define EDGE_CAPTURE_VERSION 2
+#define EDGE_CAPTURE_SECTOR_MAGIC 0x4345  // "EC"
+#define EDGE_CAPTURE_MAX_RECORD 5         // Longest varint (34-bit value)
+
+struct __attribute__((packed)) EdgeCaptureHeader {
+  char magic[4];              // EDGE_CAPTURE_MAGIC
+  uint16_t version;           // EDGE_CAPTURE_VERSION
+  uint8_t wheelMagnets;
+  uint8_t crankMagnets;
+  uint8_t includesRejected;   // 1 if edges rejected by the debounce filter are present
+  uint8_t reserved[3];
+  uint32_t startTimestamp;    // Same as the session log this capture belongs to
+  uint32_t startMillis;
+  uint32_t bootTimestamp;     // Unix time (s) at millis() == 0, 0 if not synced at start
+  uint32_t startMicros;       // micros() when capture started
+  uint32_t captureId;         // Random, repeated in every sector header (version 2)
+};
+
+struct __attribute__((packed)) EdgeCaptureSectorHeader {
+  uint16_t magic;             // EDGE_CAPTURE_SECTOR_MAGIC
+  uint16_t length;            // Bytes of edge data in this sector
+  uint32_t sequence;          // Data sector number, starting at 0
+  uint32_t wheelBase;         // Last wheel edge (micros) before this sector
+  uint32_t cadenceBase;       // Last cadence edge (micros) before this sector
+  uint32_t droppedEdges;      // Edges lost just before this sector (no free buffer or full queue)
+  uint32_t captureId;         // EdgeCaptureHeader::captureId (version 2)
+};
+
+// Version 1 had no capture id in the sector header
+#define EDGE_CAPTURE_V1_SECTOR_HEADER_SIZE 20
+
+#define EDGE_CAPTURE_SECTOR_DATA (SESSION_LOG_SECTOR_SIZE - sizeof(EdgeCaptureSectorHeader))
+
+// Offset of the edge data in a data sector
+inline size_t edgeCaptureDataOffset(const EdgeCaptureHeader& header) {
+  return header.version < 2 ? EDGE_CAPTURE_V1_SECTOR_HEADER_SIZE : sizeof(EdgeCaptureSectorHeader);
+}
+
+static_assert(sizeof(EdgeCaptureHeader) <= SESSION_LOG_SECTOR_SIZE, "Edge capture header exceeds a sector");
+
+// Encode one edge; returns the bytes written (at most EDGE_CAPTURE_MAX_RECORD)
+inline size_t edgeCaptureEncode(uint8_t* out, uint32_t delta, uint8_t channel, bool rejected) {
+  uint64_t value = ((uint64_t)delta << 2) | (rejected ? 2 : 0) | (channel & 1);
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+// Decode one edge at pos; returns false if the data ends mid-record
+inline bool edgeCaptureDecode(const uint8_t* data, size_t length, size_t& pos,
+                              uint32_t& delta, uint8_t& channel, bool& rejected) {
+  uint64_t value = 0;
+  for (uint8_t shift = 0; shift < 7 * EDGE_CAPTURE_MAX_RECORD; shift += 7) {
+    if (pos >= length) {
+      return false;
+    }
+    uint8_t byte = data[pos++];
+    value |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      delta = (uint32_t)(value >> 2);
+      rejected = (value & 2) != 0;
+      channel = value & 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif // EDGE_CAPTURE_FORMAT_H
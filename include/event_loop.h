@@ -0,0 +1,77 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include "config.h"
+#include "clock.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Event-driven scheduling for loop(). Each pass registers the deadlines
+// of its timed work, then wait() blocks the loop task until the earliest
+// of them or until a sensor interrupt notifies it, so the CPU sits in the
+// idle task (or light sleep) between events instead of spinning.
+//
+// A pass does exactly what a polling pass did; the loop only skips the
+// passes in which nothing could have changed. Anything that changes with
+// time alone must therefore register its deadline here - tools/replay
+// --event checks the logged output against a loop polling every
+// microsecond.
+class EventLoop {
+public:
+    EventLoop();
+
+#ifdef ARDUINO
+    // Take over the calling (loop) task; with EVENT_LOOP_LIGHT_SLEEP also
+    // enables automatic light sleep. Returns false if that is unavailable.
+    bool begin();
+
+    // Block until notified or the earliest deadline passes, then start
+    // collecting deadlines for the next pass
+    void wait();
+
+    // Wake the loop task - called from the sensor ISRs
+    void notifyFromISR();
+#endif
+
+    // Run the next pass within timeout micros at the latest
+    void wakeIn(uint32_t timeout);
+
+    // Run the next pass once the millisecond clock reaches dueTime
+    void wakeAt(uint32_t dueTime);
+
+    // Run the next pass once interval ms have passed since lastTime (the
+    // usual "currentTime - lastTime >= interval" check)
+    void wakeAfter(uint32_t lastTime, uint32_t interval) { wakeAt(lastTime + interval); }
+
+    // Micros until the earliest deadline registered since the last wait
+    // (UINT32_MAX if none)
+    uint32_t getDelay() const { return wakeDelay; }
+    void clearDeadlines() { wakeDelay = UINT32_MAX; }
+
+    // Wakes by cause, and time the loop task spent running passes versus
+    // waiting (micros)
+    uint32_t getWakeCount() const { return notifiedWakes + timerWakes; }
+    uint32_t getNotifiedWakes() const { return notifiedWakes; }
+    uint32_t getTimerWakes() const { return timerWakes; }
+    uint64_t getBusyTime() const { return busyTime; }
+    uint64_t getIdleTime() const { return idleTime; }
+
+private:
+    uint32_t wakeDelay;
+    uint32_t notifiedWakes;
+    uint32_t timerWakes;
+    uint64_t busyTime;
+    uint64_t idleTime;
+    uint32_t passStart;
+#ifdef ARDUINO
+    TaskHandle_t task;
+#endif
+};
+
+// Declare global instance
+extern EventLoop eventLoop;
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,167 @@
+#ifndef FIXED_RPM_CALCULATOR_H
+#define FIXED_RPM_CALCULATOR_H
+
+#include "rpm_calculator.h"
+
+// RPMCalculator for a sensor and gear layout known at compile time. The
+// layout is a traits struct:
+//
+//   struct Config {
+//     static constexpr const SensorChannelConfig* channels = CHANNELS;  // constexpr array
+//     static constexpr uint8_t channelCount = 2;
+//     static constexpr const BikeConfig* bikes = BIKES;                 // constexpr array
+//     static constexpr uint8_t bikeCount = 1;
+//     static constexpr uint8_t chainringCount = 2;
+//     static constexpr const uint8_t* chainrings = CHAINRINGS;
+//     static constexpr uint8_t sprocketCount = 9;
+//     static constexpr const uint8_t* sprockets = SPROCKETS;
+//   };
+//
+// Invalid layouts fail to compile, and the sorted gear table is built by
+// the compiler and kept in flash, so begin() only copies it in. Each
+// channel's magnets and plausibility limit reach the per-edge maths as
+// constants. Needs C++17 (the firmware builds as C++17).
+
+// Compile-time checks over a channel table, the same ones
+// SensorEngine::addChannel() makes at runtime
+constexpr bool fixedChannelsValid(const SensorChannelConfig* channels, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    const SensorChannelConfig& channel = channels[i];
+    if (channel.magnets == 0 || channel.maxRPM == 0 || channel.edgeDivider == 0 ||
+        channel.magnets % channel.edgeDivider != 0) return false;
+  }
+  return true;
+}
+
+// Every channel keeps a non-zero glitch filter floor (see
+// SensorEngine::configureGlitchFilter())
+constexpr bool fixedGlitchFloorsValid(const SensorChannelConfig* channels, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    const SensorChannelConfig& channel = channels[i];
+    if (channel.magnets == 0 || channel.maxRPM == 0) continue;  // Reported by fixedChannelsValid()
+    if (60000000UL * channel.edgeDivider / ((uint32_t)channel.maxRPM * channel.magnets) / 2 == 0) return false;
+  }
+  return true;
+}
+
+constexpr bool fixedBikesValid(const BikeConfig* bikes, uint8_t bikeCount, uint8_t channelCount) {
+  for (uint8_t i = 0; i < bikeCount; i++) {
+    if (bikes[i].wheelChannel >= channelCount || bikes[i].crankChannel >= channelCount) return false;
+  }
+  return true;
+}
+
+// Compile-time checks over a tooth count table
+constexpr bool fixedGearTeethValid(const uint8_t* teeth, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (teeth[i] == 0) return false;
+  }
+  return true;
+}
+
+constexpr uint8_t fixedGearTeethExtreme(const uint8_t* teeth, uint8_t count, bool largest) {
+  uint8_t extreme = teeth[0];
+  for (uint8_t i = 1; i < count; i++) {
+    if (largest ? teeth[i] > extreme : teeth[i] < extreme) extreme = teeth[i];
+  }
+  return extreme;
+}
+
+// Gear table built during compilation
+template <class Config>
+struct FixedGearTable {
+  GearEntry entries[MAX_GEARS];
+  uint8_t count;
+
+  constexpr FixedGearTable() : entries{}, count(0) {
+    count = buildGearTable(Config::chainrings, Config::chainringCount,
+                           Config::sprockets, Config::sprocketCount, entries);
+  }
+};
+
+// Rates for SensorEngine::process() from a compile-time channel table:
+// the channel index selects a branch with that channel's numerator and
+// limit as constants, so each divide is sized for its channel by the
+// compiler
+template <class Config, uint8_t CH = 0>
+struct FixedChannelRates {
+  static constexpr uint64_t NUMERATOR =
+      MILLI_RPM_MINUTE * Config::channels[CH].edgeDivider / Config::channels[CH].magnets;
+  static constexpr uint32_t MAX_MILLI_RPM = (uint32_t)Config::channels[CH].maxRPM * MILLI_RPM_PER_RPM;
+  static constexpr bool LAST = CH + 1 >= Config::channelCount;
+
+  static uint32_t edgeMilliRPM(uint8_t channel, uint32_t interval) {
+    if constexpr (!LAST) {
+      if (channel != CH) return FixedChannelRates<Config, CH + 1>::edgeMilliRPM(channel, interval);
+    }
+    return edgeMilliRPMFor(NUMERATOR, interval);
+  }
+
+  static uint32_t batchMilliRPM(uint8_t channel, uint32_t edges, uint64_t time) {
+    if constexpr (!LAST) {
+      if (channel != CH) return FixedChannelRates<Config, CH + 1>::batchMilliRPM(channel, edges, time);
+    }
+    return batchMilliRPMFor(NUMERATOR, edges, time);
+  }
+
+  static uint32_t maxMilliRPM(uint8_t channel) {
+    if constexpr (!LAST) {
+      if (channel != CH) return FixedChannelRates<Config, CH + 1>::maxMilliRPM(channel);
+    }
+    return MAX_MILLI_RPM;
+  }
+};
+
+template <class Config>
+class FixedRPMCalculator : public RPMCalculator {
+public:
+  static_assert(Config::channelCount > 0 && Config::channelCount <= MAX_SENSOR_CHANNELS,
+                "Channel count must be 1..MAX_SENSOR_CHANNELS");
+  static_assert(fixedChannelsValid(Config::channels, Config::channelCount),
+                "Channels need magnets, a maximum RPM and an edge divider that divides the magnets");
+  static_assert(fixedGlitchFloorsValid(Config::channels, Config::channelCount),
+                "Too many magnets for the glitch filter floor");
+  static_assert(Config::bikeCount > 0 && Config::bikeCount <= MAX_BIKES, "Bike count must be 1..MAX_BIKES");
+  static_assert(fixedBikesValid(Config::bikes, Config::bikeCount, Config::channelCount),
+                "Bikes must pair channels from the table");
+  static_assert(Config::chainringCount > 0 && Config::chainringCount <= MAX_CHAINRINGS,
+                "Chainring count must be 1..MAX_CHAINRINGS");
+  static_assert(Config::sprocketCount > 0 && Config::sprocketCount <= MAX_SPROCKETS,
+                "Sprocket count must be 1..MAX_SPROCKETS");
+  static_assert(fixedGearTeethValid(Config::chainrings, Config::chainringCount) &&
+                fixedGearTeethValid(Config::sprockets, Config::sprocketCount),
+                "Tooth counts must be non-zero");
+  static_assert((uint32_t)fixedGearTeethExtreme(Config::chainrings, Config::chainringCount, true) * GEAR_RATIO_SCALE /
+                fixedGearTeethExtreme(Config::sprockets, Config::sprocketCount, false) <= 0xFFFF,
+                "Largest gear ratio does not fit the fixed-point ratio");
+
+  static constexpr FixedGearTable<Config> GEARS = FixedGearTable<Config>();
+  static_assert(GEARS.count > 0, "Gear table is empty");
+
+  using Rates = FixedChannelRates<Config>;
+
+  // Initialize with the compile-time channels, bikes and gears
+  void begin() {
+    loadGears(Config::chainringCount, Config::chainrings, Config::sprocketCount, Config::sprockets,
+              GEARS.entries, GEARS.count);
+    RPMCalculator::begin(Config::channels, Config::channelCount, Config::bikes, Config::bikeCount);
+  }
+
+  // Edge processing with the compile-time rates; these hide the
+  // RPMCalculator versions, so call them on the FixedRPMCalculator itself
+  bool processWheelTrigger(uint32_t edgeTime) { return getEngine().processEdge(getWheelChannel(), edgeTime, Rates()); }
+  bool processCadenceTrigger(uint32_t edgeTime) { return getEngine().processEdge(getCadenceChannel(), edgeTime, Rates()); }
+  void calculateRPMs() {
+    getEngine().process(Rates());
+    updateBikes();
+  }
+
+  // The layout is fixed - hide the runtime configuration
+  void begin(uint8_t wheelMagnets, uint8_t crankMagnets) = delete;
+  bool begin(const SensorChannelConfig* channels, uint8_t channelCount,
+             const BikeConfig* bikes, uint8_t bikeCount) = delete;
+  void configureGears(uint8_t chainringCount, const uint8_t* chainringTeeth,
+                      uint8_t sprocketCount, const uint8_t* sprocketTeeth) = delete;
+};
+
+#endif // FIXED_RPM_CALCULATOR_H
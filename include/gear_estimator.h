@@ -0,0 +1,66 @@
+#ifndef GEAR_ESTIMATOR_H
+#define GEAR_ESTIMATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gear_table.h"
+
+// Gear estimation tuning (the gear table itself is built in gear_table.h)
+#define GEAR_MATCH_TOLERANCE 20    // Max relative error (%) to accept a gear match
+#define GEAR_HYSTERESIS 25         // A new gear must be this much (%) closer than the current one
+#define GEAR_MIN_MILLI_RPM 10000   // Both channels must be above 10 RPM to estimate a gear
+#define GEAR_SHIFT_DWELL 400       // ms a new gear must persist before it is reported
+
+// Tracks the gear of one bike from its wheel and crank RPM
+class GearEstimator {
+public:
+    GearEstimator();
+
+    // Build the ratio table from tooth counts
+    void configure(uint8_t chainringCount, const uint8_t* chainringTeeth,
+                   uint8_t sprocketCount, const uint8_t* sprocketTeeth);
+
+    // Install a table already built by buildGearTable()
+    void load(uint8_t chainringCount, const uint8_t* chainringTeeth,
+              uint8_t sprocketCount, const uint8_t* sprocketTeeth,
+              const GearEntry* table, uint8_t count);
+
+    bool isConfigured() const { return gearsConfigured; }
+
+    // Match the measured ratio against the table (milli-RPM inputs)
+    void estimate(uint32_t wheelMilliRPM, uint32_t cadenceMilliRPM);
+
+    // Forget the current gear
+    void clear();
+
+    // ms until a pending shift has waited out its dwell and the next
+    // estimate() reports it (UINT32_MAX when no shift is pending)
+    uint32_t getTimeUntilShift() const;
+
+    uint8_t getCurrentChainring() const { return currentChainring; }
+    uint8_t getCurrentSprocket() const { return currentSprocket; }
+    float getCurrentGearRatio() const { return (float)currentGearRatio / GEAR_RATIO_SCALE; }
+    uint16_t getCurrentGearRatioFixed() const { return currentGearRatio; }  // x GEAR_RATIO_SCALE
+    void getGearDescription(char* buffer, size_t size) const;
+
+private:
+    uint8_t chainringCount;
+    uint8_t chainringTeeth[MAX_CHAINRINGS];
+    uint8_t sprocketCount;
+    uint8_t sprocketTeeth[MAX_SPROCKETS];
+    uint8_t currentChainring;  // 1-based index (1 = first chainring)
+    uint8_t currentSprocket;   // 1-based index (1 = first sprocket)
+    uint16_t currentGearRatio;  // x GEAR_RATIO_SCALE
+    bool gearsConfigured;
+
+    // Sorted, deduplicated ratio table
+    GearEntry gearTable[MAX_GEARS];
+    uint8_t gearCount;
+    int8_t currentGearIndex;   // Index into gearTable, -1 when unknown
+    int8_t pendingGearIndex;   // Candidate waiting out the shift dwell time
+    unsigned long pendingGearSince;
+
+    uint8_t findClosestGear(uint16_t ratio) const;
+};
+
+#endif // GEAR_ESTIMATOR_H
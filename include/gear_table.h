@@ -0,0 +1,97 @@
+#ifndef GEAR_TABLE_H
+#define GEAR_TABLE_H
+
+#include <stdint.h>
+
+// Gear ratio table shared by RPMCalculator, which builds it when gears
+// are configured at runtime, and FixedRPMCalculator, which builds the
+// same table at compile time. The builder is constexpr from C++14 on
+// (the firmware builds as C++17); older host builds get a plain inline.
+
+#if __cplusplus >= 201402L
+#define GEAR_TABLE_CONSTEXPR constexpr
+#else
+#define GEAR_TABLE_CONSTEXPR inline
+#endif
+
+#define GEAR_RATIO_SCALE 1000
+
+// Maximum number of gears supported (triple chainset, 13-speed cassette)
+#define MAX_CHAINRINGS 3
+#define MAX_SPROCKETS 13
+#define MAX_GEARS (MAX_CHAINRINGS * MAX_SPROCKETS)
+
+#define GEAR_RATIO_TOLERANCE 15    // Ratios closer than 1.5% (per mille) are treated as the same gear
+
+// One entry of the precomputed gear table, sorted by ratio
+struct GearEntry {
+  uint16_t ratio;     // Chainring/sprocket teeth x GEAR_RATIO_SCALE
+  uint8_t chainring;  // 1-based index into the configured chainrings
+  uint8_t sprocket;   // 1-based index into the configured sprockets
+  uint8_t crossChain; // 0 = straight chainline, 100 = fully crossed
+};
+
+// Fill table (MAX_GEARS entries) with every chainring/sprocket pair sorted
+// by ratio, near-identical ratios merged in favour of the straighter
+// chainline; returns the number of entries. Sprockets with zero teeth
+// are skipped.
+GEAR_TABLE_CONSTEXPR uint8_t buildGearTable(const uint8_t* chainringTeeth, uint8_t chainringCount,
+                                            const uint8_t* sprocketTeeth, uint8_t sprocketCount,
+                                            GearEntry* table) {
+  // Rank chainrings (smallest = 0) and sprockets (largest = 0) so the
+  // cross-chain score is the distance between the two chainline positions
+  uint8_t chainringRank[MAX_CHAINRINGS] = {};
+  uint8_t sprocketRank[MAX_SPROCKETS] = {};
+  for (uint8_t i = 0; i < chainringCount; i++) {
+    for (uint8_t j = 0; j < chainringCount; j++) {
+      if (chainringTeeth[j] < chainringTeeth[i]) chainringRank[i]++;
+    }
+  }
+  for (uint8_t i = 0; i < sprocketCount; i++) {
+    for (uint8_t j = 0; j < sprocketCount; j++) {
+      if (sprocketTeeth[j] > sprocketTeeth[i]) sprocketRank[i]++;
+    }
+  }
+
+  // Build the table with an insertion sort on ratio
+  uint8_t count = 0;
+  for (uint8_t c = 0; c < chainringCount; c++) {
+    for (uint8_t s = 0; s < sprocketCount; s++) {
+      if (sprocketTeeth[s] == 0) {
+        continue;
+      }
+
+      int front = chainringCount > 1 ? chainringRank[c] * 100 / (chainringCount - 1) : 50;
+      int rear = sprocketCount > 1 ? sprocketRank[s] * 100 / (sprocketCount - 1) : 50;
+      GearEntry entry = {
+        (uint16_t)((chainringTeeth[c] * GEAR_RATIO_SCALE + sprocketTeeth[s] / 2) / sprocketTeeth[s]),
+        (uint8_t)(c + 1),  // 1-based index
+        (uint8_t)(s + 1),  // 1-based index
+        (uint8_t)(front > rear ? front - rear : rear - front)
+      };
+
+      uint8_t i = count++;
+      while (i > 0 && table[i - 1].ratio > entry.ratio) {
+        table[i] = table[i - 1];
+        i--;
+      }
+      table[i] = entry;
+    }
+  }
+
+  // Merge near-identical ratios, keeping the combination with the
+  // straighter chainline
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (kept > 0 && (uint32_t)(table[i].ratio - table[kept - 1].ratio) * 1000 <= (uint32_t)table[kept - 1].ratio * GEAR_RATIO_TOLERANCE) {
+      if (table[i].crossChain < table[kept - 1].crossChain) {
+        table[kept - 1] = table[i];
+      }
+      continue;
+    }
+    table[kept++] = table[i];
+  }
+  return kept;
+}
+
+#endif // GEAR_TABLE_H
@@ -0,0 +1,74 @@
+#ifndef GLITCH_FILTER_H
+#define GLITCH_FILTER_H
+
+#include <stdint.h>
+
+// Number of back-to-back rejections after which the tracked period is
+// considered stale (e.g. after a hard acceleration) and is re-learned
+#define GLITCH_REACQUIRE_REJECTIONS 3
+
+// Period-relative debounce for one sensor channel. An interval (micros)
+// is rejected if it is shorter than the absolute floor or shorter than a
+// percentage of the recently tracked period, so the filter tightens at
+// low speed and relaxes at high speed instead of using a fixed cut-off.
+class GlitchFilter {
+public:
+  GlitchFilter() :
+    minInterval(0),
+    periodPercent(0),
+    trackedPeriod(0),
+    consecutiveRejections(0),
+    rejectedCount(0)
+  {
+  }
+
+  // Set the absolute floor and the period-relative threshold
+  void configure(uint32_t minInterval, uint8_t periodPercent) {
+    this->minInterval = minInterval;
+    this->periodPercent = periodPercent;
+    reset();
+  }
+
+  // Forget the tracked period (call after a reset or timeout)
+  void reset() {
+    trackedPeriod = 0;
+    consecutiveRejections = 0;
+  }
+
+  // Returns true if the interval since the last accepted edge is genuine
+  bool accept(uint32_t interval) {
+    uint32_t threshold = minInterval;
+    if (trackedPeriod > 0) {
+      uint32_t relative = (uint32_t)(((uint64_t)trackedPeriod * periodPercent) / 100);
+      if (relative > threshold) {
+        threshold = relative;
+      }
+    }
+
+    if (interval < threshold) {
+      rejectedCount++;
+      if (++consecutiveRejections >= GLITCH_REACQUIRE_REJECTIONS) {
+        trackedPeriod = 0;
+        consecutiveRejections = 0;
+      }
+      return false;
+    }
+
+    // Track the period with a 1/4 weight smoothing
+    trackedPeriod = trackedPeriod == 0 ? interval : (trackedPeriod * 3 + interval) / 4;
+    consecutiveRejections = 0;
+    return true;
+  }
+
+  uint32_t getTrackedPeriod() const { return trackedPeriod; }
+  unsigned long getRejectedCount() const { return rejectedCount; }
+
+private:
+  uint32_t minInterval;
+  uint8_t periodPercent;
+  uint32_t trackedPeriod;
+  uint8_t consecutiveRejections;
+  unsigned long rejectedCount;
+};
+
+#endif // GLITCH_FILTER_H
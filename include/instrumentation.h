@@ -0,0 +1,139 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <stdint.h>
+
+// Hot-path counters and latency histograms. Everything is reached through
+// the STAT_* macros below, which expand to nothing unless the build
+// defines ENABLE_INSTRUMENTATION (see the esp32dev-instrumented
+// environment in platformio.ini), so production builds carry no code or
+// RAM for it.
+
+#ifdef ENABLE_INSTRUMENTATION
+
+#include <atomic>
+#include "clock.h"
+
+#define STAT_HISTOGRAM_BUCKETS 20  // log2 buckets of micros; the last one also holds anything longer
+
+// Event counters - incremented from ISRs and tasks alike
+enum StatCounter : uint8_t {
+  STAT_LOOP_PASSES,
+  STAT_TELEMETRY_SAMPLES,
+  STAT_COUNTER_COUNT
+};
+
+// Latency histograms - each has a single writer
+enum StatHistogram : uint8_t {
+  HIST_LOOP_PERIOD,   // Time between loop() passes
+  HIST_LOG_DATA,      // logData() duration
+  HIST_SD_SECTOR,     // One sector write on the writer task
+  HIST_SD_FLUSH,      // Partial sector write plus sync
+  HIST_EDGE_DELAY,    // ISR timestamp to processing in calculateRPMs()
+  STAT_HISTOGRAM_COUNT
+};
+
+// Fixed log2-bucket histogram: bucket i counts values in [2^i, 2^(i+1))
+// micros (bucket 0 also holds 0). Recording is one increment and a max
+// update, so it is cheap enough for every loop pass.
+class LatencyHistogram {
+public:
+  LatencyHistogram() { reset(); }
+
+  void reset() {
+    for (uint8_t i = 0; i < STAT_HISTOGRAM_BUCKETS; i++) {
+      buckets[i].store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+  }
+
+  void record(uint32_t micros) {
+    uint8_t bucket = micros > 1 ? 31 - __builtin_clz(micros) : 0;
+    if (bucket >= STAT_HISTOGRAM_BUCKETS) bucket = STAT_HISTOGRAM_BUCKETS - 1;
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    if (micros > maximum.load(std::memory_order_relaxed)) {
+      maximum.store(micros, std::memory_order_relaxed);  // Single writer, no CAS needed
+    }
+  }
+
+  uint32_t getCount() const { return count.load(std::memory_order_relaxed); }
+  uint32_t getMax() const { return maximum.load(std::memory_order_relaxed); }
+  uint32_t getBucket(uint8_t i) const { return buckets[i].load(std::memory_order_relaxed); }
+
+  // Upper bound (micros) of the bucket holding the given percentile
+  uint32_t percentile(uint8_t percent) const {
+    uint32_t total = getCount();
+    if (total == 0) return 0;
+    uint32_t target = (uint32_t)(((uint64_t)total * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < STAT_HISTOGRAM_BUCKETS; i++) {
+      seen += getBucket(i);
+      if (seen >= target) {
+        uint32_t upper = 2UL << i;
+        return i + 1 < STAT_HISTOGRAM_BUCKETS && upper < getMax() ? upper : getMax();
+      }
+    }
+    return getMax();
+  }
+
+private:
+  std::atomic<uint32_t> buckets[STAT_HISTOGRAM_BUCKETS];
+  std::atomic<uint32_t> count;
+  std::atomic<uint32_t> maximum;
+};
+
+class Instrumentation {
+public:
+  void count(StatCounter counter) { counters[counter].fetch_add(1, std::memory_order_relaxed); }
+  void record(StatHistogram histogram, uint32_t micros) { histograms[histogram].record(micros); }
+
+  uint32_t getCounter(StatCounter counter) const { return counters[counter].load(std::memory_order_relaxed); }
+  const LatencyHistogram& getHistogram(StatHistogram histogram) const { return histograms[histogram]; }
+
+  static const char* getCounterName(StatCounter counter);
+  static const char* getHistogramName(StatHistogram histogram);
+
+private:
+  std::atomic<uint32_t> counters[STAT_COUNTER_COUNT] = {};
+  LatencyHistogram histograms[STAT_HISTOGRAM_COUNT];
+};
+
+// Declare global instance
+extern Instrumentation instrumentation;
+
+#ifdef ARDUINO
+class Print;
+
+// Full counter and histogram dump (serial command)
+void printStatsReport(Print& out);
+
+// One-line "#STATS,..." packet for periodic logging
+void printStatsPacket(Print& out);
+#endif
+
+#define STAT_COUNT(counter) instrumentation.count(counter)
+#define STAT_RECORD(histogram, micros) instrumentation.record(histogram, micros)
+#define STAT_TIMER_START(name) uint32_t name = clockMicros()
+#define STAT_TIMER_STOP(histogram, name) instrumentation.record(histogram, clockMicros() - (name))
+
+// Record the time since the previous call at this site
+#define STAT_INTERVAL(histogram) do { \
+    static uint32_t statLast = 0; \
+    uint32_t statNow = clockMicros(); \
+    if (statLast != 0) instrumentation.record(histogram, statNow - statLast); \
+    statLast = statNow; \
+  } while (0)
+
+#else
+
+#define STAT_COUNT(counter) do {} while (0)
+#define STAT_RECORD(histogram, micros) do {} while (0)
+#define STAT_TIMER_START(name) do {} while (0)
+#define STAT_TIMER_STOP(histogram, name) do {} while (0)
+#define STAT_INTERVAL(histogram) do {} while (0)
+
+#endif // ENABLE_INSTRUMENTATION
+
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,85 @@
+#ifndef LOG_QUEUE_H
+#define LOG_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+// Writer task configuration (firmware)
+#define LOG_WRITER_CORE 0          // loop() runs on core 1
+#define LOG_WRITER_STACK_SIZE 4096
+#define LOG_WRITER_PRIORITY 1
+
+// Bounded queue of fixed-size messages between the measurement loop and
+// the LogWriter task. The firmware uses a FreeRTOS queue
+// (src/log_queue_freertos.cpp); host builds use a mutex and condition
+// variable (src/log_queue_thread.cpp), so the writer and its sinks can be
+// exercised off-target (see tools/log_writer_stress).
+class LogQueue {
+public:
+    LogQueue();
+    ~LogQueue();
+
+    // Allocate room for length messages of messageSize bytes
+    bool begin(uint8_t length, size_t messageSize);
+
+    bool isReady() const;
+
+    // Copy a message in; waits up to timeoutMs for room (0 = never waits).
+    // Returns false if the queue stayed full.
+    bool send(const void* message, unsigned long timeoutMs);
+
+    // Copy the oldest message out; waits up to timeoutMs for one
+    bool receive(void* message, unsigned long timeoutMs);
+
+private:
+#ifdef ARDUINO
+    QueueHandle_t handle;
+#else
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::vector<uint8_t> storage;
+    size_t messageSize;
+    uint8_t length;
+    uint8_t first;   // Oldest message
+    uint8_t count;
+#endif
+};
+
+// The thread a LogWriter runs on: a FreeRTOS task pinned to the core
+// loop() does not use, or a std::thread on the host
+class LogTask {
+public:
+    typedef void (*Entry)(void* param);
+
+    LogTask();
+
+    // Run entry(param) in the background
+    bool start(const char* name, Entry entry, void* param);
+
+    // Wait until entry has returned (after it was asked to stop)
+    void join();
+
+private:
+#ifdef ARDUINO
+    TaskHandle_t handle;
+    SemaphoreHandle_t done;
+    Entry entry;
+    void* param;
+
+    static void taskEntry(void* task);
+#else
+    std::thread thread;
+#endif
+};
+
+#endif // LOG_QUEUE_H
@@ -0,0 +1,57 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include <stdint.h>
+#include "session_log_format.h"
+
+#define LOG_FILE_NAME_LENGTH 32  // Longest file name a sink is given, including the terminator
+
+// What a new session log starts with
+struct LogSessionInfo {
+    const char* fileName;
+    uint32_t startTimestamp;
+    uint32_t startMillis;
+    uint32_t bootTimestamp;
+    uint8_t wheelMagnets;
+    uint8_t crankMagnets;
+};
+
+// Storage behind a LogWriter: the session log and the raw edge capture
+// file. Every call comes from the writer task, one at a time, so a sink
+// may block for as long as its medium takes; the measurement loop never
+// waits on it. The firmware writes to the SD card (SdLogSink); host
+// programs substitute their own (see tools/log_writer_stress).
+class LogSink {
+public:
+    virtual ~LogSink() {}
+
+    // Bring up the medium; called first, so slow card initialisation runs
+    // on the writer task instead of holding up boot. Returns false if the
+    // medium cannot be used.
+    virtual bool mount() = 0;
+
+    // Close sessions left open by a reset or power cut; called once after
+    // mount(). Returns the number that could not be recovered.
+    virtual unsigned long recoverSessions() = 0;
+
+    // Session log; a new session closes any open one
+    virtual bool openSession(const LogSessionInfo& info) = 0;
+    virtual bool isSessionOpen() const = 0;
+    virtual bool appendRecord(const SessionLogRecord& record, unsigned long currentTime) = 0;
+    virtual void closeSession() = 0;
+
+    // Record the boot time in the open session and capture headers
+    virtual bool setBootTimestamp(uint32_t bootTimestamp) = 0;
+
+    // Put everything written so far on the medium (partial sectors
+    // included); called when no work arrived for a durability window
+    virtual bool flush() = 0;
+
+    // Raw edge capture file, written one sector at a time by index
+    virtual bool openCapture(const char* fileName) = 0;
+    virtual bool writeCaptureSector(uint32_t index, const uint8_t* data) = 0;
+    virtual bool syncCapture() = 0;
+    virtual void closeCapture() = 0;
+};
+
+#endif // LOG_SINK_H
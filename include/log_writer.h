@@ -0,0 +1,129 @@
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <stdint.h>
+#include <atomic>
+#include "log_queue.h"
+#include "log_sink.h"
+
+#define LOG_CONTROL_TIMEOUT 20  // Max ms the caller waits for queue room to open or close a file
+
+// Performs all log storage access from a dedicated writer task, so storage
+// stalls never block the measurement loop. The loop hands over work
+// through a bounded queue and never waits on it for data: if the sink
+// falls behind and the queue is full, rows are dropped and counted
+// instead, as are rows that arrive while no session file is open (its
+// open failed). Opening and closing files and setting the clock wait up
+// to LOG_CONTROL_TIMEOUT ms for room, so a burst of rows cannot silently
+// lose them. Before taking any work the task brings up the sink's medium
+// (for the SD card, the slow 1 MHz initialisation) and has it close
+// sessions left open by a reset or power cut. The queue, task and sink
+// are portable: the firmware runs a FreeRTOS task writing to the SD card
+// (SdLogSink), host programs a std::thread and a sink of their own.
+class LogWriter {
+public:
+    // Progress of the medium's bring-up on the writer task
+    enum StorageState : uint8_t {
+        STORAGE_STARTING,
+        STORAGE_READY,
+        STORAGE_FAILED
+    };
+
+    LogWriter();
+
+    // Create the queue and start the writer task; partial sectors are
+    // flushed after syncInterval ms without work
+    bool begin(LogSink* sink, uint8_t queueLength, unsigned long syncInterval);
+
+    // Close the open files and stop the writer task; waits for the work
+    // already queued
+    void end();
+
+    // Ask the writer task to create a new session file
+    bool openSession(const char* fileName, uint32_t startTimestamp, uint32_t startMillis,
+                     uint32_t bootTimestamp, uint8_t wheelMagnets, uint8_t crankMagnets);
+
+    // Store the boot time in the open file once the clock has synced
+    bool setBootTimestamp(uint32_t bootTimestamp);
+
+    // Queue a row for writing (non-blocking); returns false if dropped
+    bool enqueue(const SessionLogRecord& record);
+
+    // Ask the writer task to flush and close the current file
+    bool closeSession();
+
+    // Raw edge capture file (see edge_capture.h). Sectors are written
+    // straight from the caller's buffer, which the writer task hands back
+    // by clearing the release flag once the sector is on the card.
+    bool openCapture(const char* fileName);
+    bool writeCaptureSector(const uint8_t* data, uint32_t index, std::atomic<bool>* release);
+    bool closeCapture();
+
+    // Overflow and progress accounting
+    unsigned long getDroppedCount() const { return droppedCount.load(std::memory_order_relaxed); }
+    unsigned long getWrittenCount() const { return writtenCount; }
+    unsigned long getWriteErrorCount() const { return writeErrorCount; }
+    bool isSessionOpen() const { return sessionOpen; }
+    StorageState getStorageState() const { return storageState; }
+
+private:
+    enum MessageType : uint8_t {
+        MSG_OPEN,
+        MSG_RECORD,
+        MSG_SET_CLOCK,
+        MSG_CLOSE,
+        MSG_CAPTURE_OPEN,
+        MSG_CAPTURE_SECTOR,
+        MSG_CAPTURE_CLOSE,
+        MSG_STOP
+    };
+
+    struct Message {
+        MessageType type;
+        union {
+            SessionLogRecord record;
+            uint32_t bootTimestamp;
+            struct {
+                char fileName[LOG_FILE_NAME_LENGTH];
+                uint32_t startTimestamp;
+                uint32_t startMillis;
+                uint32_t bootTimestamp;
+                uint8_t wheelMagnets;
+                uint8_t crankMagnets;
+            } open;
+            struct {
+                char fileName[LOG_FILE_NAME_LENGTH];
+            } captureOpen;
+            struct {
+                const uint8_t* data;
+                uint32_t index;          // Sector number in the file
+                std::atomic<bool>* release;
+            } captureSector;
+        };
+    };
+
+    static void taskEntry(void* param);
+    void run();
+    void handleMessage(const Message& message);
+    void handleCaptureMessage(const Message& message);
+    bool sendControl(const Message& message);
+    void countError(bool ok);
+
+    LogSink* sink;
+    LogQueue queue;
+    LogTask task;
+    bool running;
+    unsigned long syncInterval;
+    unsigned long lastCaptureSync;
+
+    volatile StorageState storageState;
+    volatile bool sessionOpen;
+    std::atomic<unsigned long> droppedCount;  // Counted by both the caller and the writer task
+    volatile unsigned long writtenCount;
+    volatile unsigned long writeErrorCount;
+};
+
+// Declare global instance
+extern LogWriter logWriter;
+
+#endif // LOG_WRITER_H
@@ -1,122 +1,210 @@
 #ifndef RPM_CALCULATOR_H
 #define RPM_CALCULATOR_H
 
-#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "clock.h"
+#include "sensor_engine.h"
+#include "gear_estimator.h"
+#include "cadence_fusion.h"
+#include "event_loop.h"
 
 // Constants for RPM calculations
 #define MAX_WHEEL_RPM 1000  // Maximum realistic wheel RPM
 #define MAX_CADENCE_RPM 200 // Maximum realistic cadence RPM
-#define MIN_TRIGGER_TIME 10 // Minimum ms between triggers (debounce)
+#define DEFAULT_GLITCH_PERCENT 30 // Reject edges shorter than this % of the tracked period
 
-// Maximum number of gears supported
-#define MAX_CHAINRINGS 3
-#define MAX_SPROCKETS 12
+#define MAX_BIKES (MAX_SENSOR_CHANNELS / 2)
 
+// Sensor roles within a bike, as stored in edge captures
+enum SensorChannel : uint8_t {
+  CHANNEL_WHEEL,
+  CHANNEL_CADENCE
+};
+
+// Two engine channels paired into a bike for gear estimation
+struct BikeConfig {
+  uint8_t wheelChannel;
+  uint8_t crankChannel;
+};
+
+// Consumers that each read RPM averaged over their own window length
+enum AverageOutput : uint8_t {
+  AVERAGE_SERIAL,
+  AVERAGE_LOG,
+  AVERAGE_ESPNOW,
+  AVERAGE_OUTPUT_COUNT
+};
+
+// Wheel and cadence RPM plus gear estimation on top of a SensorEngine.
+// The engine may carry several bikes; the wheel/cadence getters report
+// the first (primary) one, the others are reached through getEngine()
+// and getGearEstimator().
 class RPMCalculator {
 public:
     RPMCalculator();
     
-    // Initialize the calculator
+    // Initialize a single bike on channels 0 (wheel) and 1 (crank); gears
+    // default to a 2x9 road setup unless they were configured beforehand
     void begin(uint8_t wheelMagnets, uint8_t crankMagnets);
     
+    // Initialize from a channel table and the channel pairs that form
+    // bikes; returns false if a channel or a pairing is invalid
+    bool begin(const SensorChannelConfig* channels, uint8_t channelCount,
+               const BikeConfig* bikes, uint8_t bikeCount);
+    
     // Reset all stored values
     void reset();
     
-    // Process a wheel sensor trigger
-    void processWheelTrigger();
+    // Configure the period-relative debounce of the primary bike's channels
+    void configureGlitchFilters(uint8_t wheelPercent, uint8_t cadencePercent);
+    
+    // Queue an edge timestamp (micros) - called from the sensor ISRs
+    void recordEdge(uint8_t channel, uint32_t timestamp) { engine.recordEdge(channel, timestamp); }
+    void recordWheelEdge(uint32_t timestamp) { engine.recordEdge(bikes[0].wheelChannel, timestamp); }
+    void recordCadenceEdge(uint32_t timestamp) { engine.recordEdge(bikes[0].crankChannel, timestamp); }
     
-    // Process a cadence sensor trigger
-    void processCadenceTrigger();
+    // Process a single wheel sensor edge (timestamp in micros); returns
+    // false if the debounce filter rejected it
+    bool processWheelTrigger(uint32_t edgeTime) { return engine.processEdge(bikes[0].wheelChannel, edgeTime); }
     
-    // Calculate RPMs based on current data
+    // Process a single cadence sensor edge (timestamp in micros)
+    bool processCadenceTrigger(uint32_t edgeTime) { return engine.processEdge(bikes[0].crankChannel, edgeTime); }
+    
+    // Drain queued edges and calculate RPMs based on current data
     void calculateRPMs();
     
+    // Receive every raw edge with the filter's verdict (nullptr to remove)
+    void setEdgeObserver(EdgeObserver observer, void* context) { engine.setEdgeObserver(observer, context); }
+    
     // Check for timeouts (no recent triggers)
     void checkTimeouts();
     
+    // Register when the readings next change without a new edge (a sensor
+    // timeout, the end of a gear shift's dwell, stabilization), so an
+    // event-driven loop runs a pass then
+    void scheduleDeadlines(EventLoop& events) const;
+    
     // Called to update averages at the reporting interval
-    void updateAverages();
+    void updateAverages() { engine.updateAverages(); }
     
-    // Reset the 3-second averaging counters
-    void resetIntervalCounters();
+    // Reset the interval averaging counters
+    void resetIntervalCounters() { engine.resetIntervalCounters(); }
     
     // Start a new session and reset session averages
-    void startNewSession();
+    void startNewSession() { engine.startNewSession(); }
+    
+    // Channel layout
+    SensorEngine& getEngine() { return engine; }
+    const SensorEngine& getEngine() const { return engine; }
+    uint8_t getBikeCount() const { return bikeCount; }
+    const BikeConfig& getBike(uint8_t bike) const { return bikes[bike]; }
+    uint8_t getWheelChannel() const { return bikes[0].wheelChannel; }
+    uint8_t getCadenceChannel() const { return bikes[0].crankChannel; }
     
     // Getters for current values
-    float getInstantWheelRPM() const { return instantWheelRPM; }
-    float getInstantCadenceRPM() const { return instantCadenceRPM; }
-    float getCurrentWheelRPM() const;
-    float getCurrentCadenceRPM() const;
-    float getSessionAvgWheelRPM() const { return sessionAvgWheelRPM; }
-    float getSessionAvgCadenceRPM() const { return sessionAvgCadenceRPM; }
-    
-    // Activity detection
-    bool hasActivity() const;
+    float getInstantWheelRPM() const { return (float)getInstantWheelMilliRPM() / MILLI_RPM_PER_RPM; }
+    float getInstantCadenceRPM() const { return (float)getInstantCadenceMilliRPM() / MILLI_RPM_PER_RPM; }
+    float getCurrentWheelRPM() const { return (float)engine.getIntervalMilliRPM(bikes[0].wheelChannel) / MILLI_RPM_PER_RPM; }
+    float getCurrentCadenceRPM() const { return (float)engine.getIntervalMilliRPM(bikes[0].crankChannel) / MILLI_RPM_PER_RPM; }
+    float getSessionAvgWheelRPM() const { return (float)engine.getSessionAvgMilliRPM(bikes[0].wheelChannel) / MILLI_RPM_PER_RPM; }
+    float getSessionAvgCadenceRPM() const { return (float)engine.getSessionAvgMilliRPM(bikes[0].crankChannel) / MILLI_RPM_PER_RPM; }
+    
+    // Averaging window length (ms) used for each output
+    void configureAverageWindow(AverageOutput output, uint16_t windowLength);
+    
+    // Spike-filtered RPM averaged over the output's window
+    float getAverageWheelRPM(AverageOutput output) const;
+    float getAverageCadenceRPM(AverageOutput output) const;
+    
+    // Exponentially smoothed live RPM
+    float getSmoothedWheelRPM() const { return (float)getSmoothedWheelMilliRPM() / MILLI_RPM_PER_RPM; }
+    float getSmoothedCadenceRPM() const { return (float)getSmoothedCadenceMilliRPM() / MILLI_RPM_PER_RPM; }
+    
+    // Min/max/mean/variance over the most recent edges (milli-RPM)
+    const SlidingWindow<uint32_t, RECENT_EDGE_WINDOW>& getWheelEdgeStats() const { return engine.getEdgeStats(bikes[0].wheelChannel); }
+    const SlidingWindow<uint32_t, RECENT_EDGE_WINDOW>& getCadenceEdgeStats() const { return engine.getEdgeStats(bikes[0].crankChannel); }
+    
+    // Fixed-point getters (milli-RPM)
+    uint32_t getInstantWheelMilliRPM() const { return engine.getInstantMilliRPM(bikes[0].wheelChannel); }
+    uint32_t getInstantCadenceMilliRPM() const { return engine.getInstantMilliRPM(bikes[0].crankChannel); }
+    uint32_t getSmoothedWheelMilliRPM() const { return engine.getSmoothedMilliRPM(bikes[0].wheelChannel); }
+    uint32_t getSmoothedCadenceMilliRPM() const { return engine.getSmoothedMilliRPM(bikes[0].crankChannel); }
+    
+    // Live readouts that decay between edges (see SensorEngine::getDecayedMilliRPM)
+    uint32_t getDecayedWheelMilliRPM() const { return engine.getDecayedMilliRPM(bikes[0].wheelChannel); }
+    uint32_t getDecayedCadenceMilliRPM() const { return engine.getDecayedMilliRPM(bikes[0].crankChannel); }
+    uint32_t getDecayedSmoothedWheelMilliRPM() const { return engine.getDecayedSmoothedMilliRPM(bikes[0].wheelChannel); }
+    uint32_t getDecayedSmoothedCadenceMilliRPM() const { return engine.getDecayedSmoothedMilliRPM(bikes[0].crankChannel); }
+    
+    // Live cadence: derived from the wheel while pedalling in a locked gear,
+    // otherwise the decayed crank reading (see CadenceFusion)
+    uint32_t getFusedCadenceMilliRPM() const;
+    bool isCadenceFused() const { return fusion[0].isLocked(); }
+    
+    // Activity detection (any channel)
+    bool hasActivity() const { return engine.hasActivity(); }
     bool areReadingsStabilized(unsigned long currentTime);
     
     // Other timing utilities
-    void markActivity();
-    unsigned long getLastActivityTime() const { return lastActivityTime; }
+    void markActivity() { engine.markActivity(); }
+    unsigned long getLastActivityTime() const { return engine.getLastActivityTime(); }
+    
+    // Edges lost because a queue was full when the ISR fired
+    uint32_t getWheelEdgeOverflows() const { return engine.getEdgeOverflows(bikes[0].wheelChannel); }
+    uint32_t getCadenceEdgeOverflows() const { return engine.getEdgeOverflows(bikes[0].crankChannel); }
+    
+    // Edges discarded by the debounce filters
+    unsigned long getWheelRejectedEdges() const { return engine.getRejectedEdges(bikes[0].wheelChannel); }
+    unsigned long getCadenceRejectedEdges() const { return engine.getRejectedEdges(bikes[0].crankChannel); }
 
-    // Gear estimation functions
+    // Gear estimation - configureGears() sets the same gears on every
+    // bike, getGearEstimator() reaches a single one
     void configureGears(uint8_t chainringCount, const uint8_t* chainringTeeth, 
                         uint8_t sprocketCount, const uint8_t* sprocketTeeth);
-    void estimateCurrentGear();
-    uint8_t getCurrentChainring() const { return currentChainring; }
-    uint8_t getCurrentSprocket() const { return currentSprocket; }
-    float getCurrentGearRatio() const { return currentGearRatio; }
-    String getGearDescription() const;
+    GearEstimator& getGearEstimator(uint8_t bike) { return gears[bike]; }
+    const GearEstimator& getGearEstimator(uint8_t bike) const { return gears[bike]; }
+    uint8_t getCurrentChainring() const { return gears[0].getCurrentChainring(); }
+    uint8_t getCurrentSprocket() const { return gears[0].getCurrentSprocket(); }
+    float getCurrentGearRatio() const { return gears[0].getCurrentGearRatio(); }
+    uint16_t getCurrentGearRatioFixed() const { return gears[0].getCurrentGearRatioFixed(); }  // x GEAR_RATIO_SCALE
+    void getGearDescription(char* buffer, size_t size) const { gears[0].getGearDescription(buffer, size); }
+    
+    // Wheel-derived cadence of a single bike
+    const CadenceFusion& getCadenceFusion(uint8_t bike) const { return fusion[bike]; }
+
+protected:
+    // Install gears on every bike with a table already built by buildGearTable()
+    void loadGears(uint8_t chainringCount, const uint8_t* chainringTeeth,
+                   uint8_t sprocketCount, const uint8_t* sprocketTeeth,
+                   const GearEntry* table, uint8_t count);
+
+    // Gear estimation and cadence fusion on the readings of the last
+    // engine pass - the second half of calculateRPMs()
+    void updateBikes();
 
 private:
-    // Wheel variables
-    volatile unsigned long wheelPulseCount;
-    unsigned long wheelLastTriggerTime;
-    unsigned long wheelTimeBetweenTriggers;
-    float instantWheelRPM;
-    float wheelTotalRPM;
-    unsigned long wheelReadingCount;
-    uint8_t wheelMagnets;
-    
-    // Cadence variables
-    volatile unsigned long cadencePulseCount;
-    unsigned long cadenceLastTriggerTime;
-    unsigned long cadenceTimeBetweenTriggers;
-    float instantCadenceRPM;
-    float cadenceTotalRPM;
-    unsigned long cadenceReadingCount;
-    uint8_t crankMagnets;
-    
-    // Session average variables
-    float sessionWheelTotalRPM;
-    unsigned long sessionWheelReadings;
-    float sessionAvgWheelRPM;
-    float sessionCadenceTotalRPM;
-    unsigned long sessionCadenceReadings;
-    float sessionAvgCadenceRPM;
+    SensorEngine engine;
+    
+    // Channel pairs, one gear estimator and cadence fusion each
+    BikeConfig bikes[MAX_BIKES];
+    uint8_t bikeCount;
+    GearEstimator gears[MAX_BIKES];
+    CadenceFusion fusion[MAX_BIKES];
+    
+    // Averaging window length per output (ms)
+    uint16_t averageWindows[AVERAGE_OUTPUT_COUNT];
     
     // Activity variables
-    unsigned long lastActivityTime;
     bool readingsStabilized;
     unsigned long firstValidReadingTime;
     
-    // Gear variables
-    uint8_t chainringCount;
-    uint8_t chainringTeeth[MAX_CHAINRINGS];
-    uint8_t sprocketCount;
-    uint8_t sprocketTeeth[MAX_SPROCKETS];
-    uint8_t currentChainring;  // 1-based index (1 = first chainring)
-    uint8_t currentSprocket;   // 1-based index (1 = first sprocket)
-    float currentGearRatio;
-    bool gearsConfigured;
-    
     // Constants
-    const unsigned long TIMEOUT_PERIOD = 3000; // 3 seconds for timeout
     const unsigned long STABILIZATION_PERIOD = 2000; // 2 seconds for stabilization
-    const unsigned long MAX_TIME_BETWEEN_TRIGGERS = 60000; // 60 seconds max between triggers
 };
 
-// Declare global instance
-extern RPMCalculator rpmCalculator;
+// Declare global instance (defined by the firmware, which picks the
+// runtime-configured or a FixedRPMCalculator variant)
+extern RPMCalculator& rpmCalculator;
 
 #endif // RPM_CALCULATOR_H 
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef SD_LOG_SINK_H
+#define SD_LOG_SINK_H
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include "log_sink.h"
+#include "session_log.h"
+
+// Session logs and edge captures on the SD card. Each session file gets
+// preallocateSize bytes of contiguous space up front so its sectors can be
+// written straight to the card, and is synced every syncInterval ms (see
+// SessionLogWriter).
+class SdLogSink : public LogSink {
+public:
+    SdLogSink();
+
+    // Nothing touches the card until mount(), which runs SdFat::begin()
+    // with config
+    void begin(SdFat* sd, SdSpiConfig config, uint32_t preallocateSize, unsigned long syncInterval);
+
+    bool mount() override;
+    unsigned long recoverSessions() override;
+    bool openSession(const LogSessionInfo& info) override;
+    bool isSessionOpen() const override { return sessionLog.isOpen(); }
+    bool appendRecord(const SessionLogRecord& record, unsigned long currentTime) override;
+    void closeSession() override;
+    bool setBootTimestamp(uint32_t bootTimestamp) override;
+    bool flush() override;
+    bool openCapture(const char* fileName) override;
+    bool writeCaptureSector(uint32_t index, const uint8_t* data) override;
+    bool syncCapture() override;
+    void closeCapture() override;
+
+private:
+    SdFat* sd;
+    SdSpiConfig config;
+    uint32_t preallocateSize;
+    unsigned long syncInterval;
+    FsFile file;
+    SessionLogWriter sessionLog;
+    FsFile captureFile;
+};
+
+// Declare global instance
+extern SdLogSink sdLogSink;
+
+#endif // SD_LOG_SINK_H
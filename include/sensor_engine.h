@@ -0,0 +1,351 @@
+#ifndef SENSOR_ENGINE_H
+#define SENSOR_ENGINE_H
+
+#include <stdint.h>
+#include "clock.h"
+#include "edge_buffer.h"
+#include "instrumentation.h"
+#include "glitch_filter.h"
+#include "spacing_calibrator.h"
+#include "streaming_stats.h"
+
+// Fixed-point representation - RPMs are carried as integer milli-RPM;
+// floats only appear in the getters
+#define MILLI_RPM_PER_RPM 1000
+#define MILLI_RPM_MINUTE 60000000000ULL // micros per minute x MILLI_RPM_PER_RPM
+
+// Per-edge milli-RPM from a channel's precomputed numerator (MILLI_RPM_MINUTE
+// x edgeDivider / magnets). A 32-bit divide when the numerator fits (any
+// channel with 14+ magnets): on the ESP32 a 64-bit divide is a library
+// call, a 32-bit one a single instruction.
+inline uint32_t edgeMilliRPMFor(uint64_t numerator, uint32_t interval) {
+  if (numerator <= UINT32_MAX) {
+    return (uint32_t)numerator / interval;
+  }
+  return (uint32_t)(numerator / interval);
+}
+
+// Milli-RPM over a batch of edges spanning time micros
+inline uint32_t batchMilliRPMFor(uint64_t numerator, uint32_t edges, uint64_t time) {
+  return (uint32_t)((numerator * edges) / time);
+}
+
+#define MAX_SENSOR_CHANNELS 8
+#define SENSOR_EDGE_BUFFER_SIZE 64  // Edge timestamp queue depth per channel (power of two)
+#define SENSOR_PIN_NONE 0xFF        // Channel fed by something other than a GPIO
+
+// Streaming statistics
+#define RECENT_EDGE_WINDOW 16  // Per-edge samples kept for min/max/variance
+#define SPIKE_MEDIAN_SIZE 3    // Median-of-N spike rejection on per-edge RPM
+#define SMOOTHING_SHIFT 3      // EWMA weight of 1/8 per edge for the live value
+#define AVERAGE_BUCKET_MS 100  // Resolution of the averaging windows
+#define AVERAGE_BUCKETS 50     // Longest averaging window (5 s)
+
+// Decayed readouts drop to zero once the time since the last edge reaches
+// this many of the last edge intervals (one whole period missed)
+#define DECAY_STOP_PERIODS 2
+
+// One Hall sensor input
+struct SensorChannelConfig {
+  uint8_t pin;            // GPIO the sensor is wired to (SENSOR_PIN_NONE if fed otherwise)
+  uint8_t magnets;        // Magnets passing the sensor per revolution
+  uint16_t maxRPM;        // Readings above this are discarded as implausible
+  uint8_t glitchPercent;  // Reject edges shorter than this % of the tracked period
+  uint8_t edgeDivider;    // Sensor edges per queued timestamp (1 unless counted in hardware)
+};
+
+// Called for every raw edge as it is drained from the ISR queue (loop
+// context); accepted is false if the debounce filter discarded the edge
+typedef void (*EdgeObserver)(uint8_t channel, uint32_t edgeTime, bool accepted, void* context);
+
+// Edge processing for any number of sensor channels. Per-channel state is
+// kept as structure-of-arrays, one array per field indexed by channel, so
+// each processing pass is a tight loop over the channels touching only the
+// fields it needs. Channels know nothing about each other; pairing them
+// into a bike for gear estimation is up to the caller (see RPMCalculator).
+class SensorEngine {
+public:
+    SensorEngine();
+
+    // Remove every channel
+    void clearChannels();
+
+    // Append a channel; returns its index, or -1 if the table is full or
+    // the configuration is invalid. The edge divider must divide the
+    // magnet count, so every queued timestamp covers the same angle.
+    int8_t addChannel(const SensorChannelConfig& config);
+
+    uint8_t getChannelCount() const { return channelCount; }
+    uint8_t getPin(uint8_t channel) const { return pins[channel]; }
+    uint8_t getMagnets(uint8_t channel) const { return magnets[channel]; }
+    uint8_t getEdgeDivider(uint8_t channel) const { return edgeDividers[channel]; }
+
+    // Change a channel's period-relative debounce
+    void configureGlitchFilter(uint8_t channel, uint8_t percent);
+
+    // Turn a channel's magnet spacing calibration on or off (on by default
+    // for channels with several timestamps per revolution)
+    void configureSpacing(uint8_t channel, bool enabled);
+
+    // Reset all stored values (configuration is kept)
+    void reset();
+
+    // Queue an edge timestamp (micros) - called from the sensor ISRs
+    void recordEdge(uint8_t channel, uint32_t timestamp) { edges[channel].push(timestamp); }
+
+    // How edge intervals become milli-RPM and which readings are
+    // implausible, as read from the channel table. process() and
+    // processEdge() also take any type with the same three members, so a
+    // caller with a compile-time layout can supply constants instead (see
+    // FixedRPMCalculator).
+    class TableRates {
+    public:
+        explicit TableRates(const SensorEngine& engine) : engine(engine) {}
+        uint32_t edgeMilliRPM(uint8_t channel, uint32_t interval) const {
+            return edgeMilliRPMFor(engine.rpmNumerator[channel], interval);
+        }
+        uint32_t batchMilliRPM(uint8_t channel, uint32_t edges, uint64_t time) const {
+            return batchMilliRPMFor(engine.rpmNumerator[channel], edges, time);
+        }
+        uint32_t maxMilliRPM(uint8_t channel) const { return engine.maxMilliRPM[channel]; }
+
+    private:
+        const SensorEngine& engine;
+    };
+
+    // Process a single edge (timestamp in micros); returns false if the
+    // debounce filter rejected it
+    bool processEdge(uint8_t channel, uint32_t edgeTime) { return processEdge(channel, edgeTime, TableRates(*this)); }
+    template <class Rates>
+    bool processEdge(uint8_t channel, uint32_t edgeTime, const Rates& rates);
+
+    // Drain queued edges and update every channel
+    void process() { process(TableRates(*this)); }
+    template <class Rates>
+    void process(const Rates& rates);
+
+    // Receive every raw edge with the filter's verdict (nullptr to remove)
+    void setEdgeObserver(EdgeObserver observer, void* context);
+
+    // Zero channels without a recent edge
+    void checkTimeouts();
+
+    // Micros until checkTimeouts() zeroes the next channel unless another
+    // edge arrives (UINT32_MAX when every channel is stopped)
+    uint32_t getTimeUntilTimeout() const;
+
+    // Fold the interval sums into the session averages
+    void updateAverages();
+
+    // Reset the interval averaging counters
+    void resetIntervalCounters();
+
+    // Reset session averages
+    void startNewSession();
+
+    // Per-channel readings (milli-RPM)
+    uint32_t getInstantMilliRPM(uint8_t channel) const { return instantMilliRPM[channel]; }
+    uint32_t getSmoothedMilliRPM(uint8_t channel) const { return instantMilliRPM[channel] > 0 ? smoothed[channel].value() : 0; }
+    uint32_t getIntervalMilliRPM(uint8_t channel) const;
+    uint32_t getAverageMilliRPM(uint8_t channel, uint16_t windowLength) const { return averages[channel].mean(windowLength); }
+    uint32_t getSessionAvgMilliRPM(uint8_t channel) const { return sessionAvgMilliRPM[channel]; }
+
+    // Instant and smoothed readings bounded by the time since the last
+    // edge: the next edge cannot come sooner than now, so the speed is at
+    // most one edge spacing over the elapsed time. Between edges the
+    // readout decays as 1/t and is zero once DECAY_STOP_PERIODS intervals
+    // pass without an edge, instead of holding until checkTimeouts().
+    uint32_t getDecayedMilliRPM(uint8_t channel) const { return decay(channel, getInstantMilliRPM(channel)); }
+    uint32_t getDecayedSmoothedMilliRPM(uint8_t channel) const { return decay(channel, getSmoothedMilliRPM(channel)); }
+
+    // Last accepted edge (micros) and its interval; 0 while stopped
+    uint32_t getLastEdgeTime(uint8_t channel) const { return lastTriggerTime[channel]; }
+    uint32_t getLastInterval(uint8_t channel) const { return lastInterval[channel]; }
+
+    // Min/max/mean/variance over the most recent edges (milli-RPM)
+    const SlidingWindow<uint32_t, RECENT_EDGE_WINDOW>& getEdgeStats(uint8_t channel) const { return recent[channel]; }
+
+    // Accepted edges since the interval counters were last reset
+    unsigned long getReadingCount(uint8_t channel) const { return readingCount[channel]; }
+
+    // Edges lost because a queue was full when the ISR fired
+    uint32_t getEdgeOverflows(uint8_t channel) const { return edges[channel].getOverflowCount(); }
+
+    // Edges discarded by the debounce filter
+    unsigned long getRejectedEdges(uint8_t channel) const { return filters[channel].getRejectedCount(); }
+
+    // Learned magnet spacing (to save and restore the table)
+    SpacingCalibrator& getSpacing(uint8_t channel) { return spacing[channel]; }
+    const SpacingCalibrator& getSpacing(uint8_t channel) const { return spacing[channel]; }
+
+    // True if any channel is turning
+    bool hasActivity() const;
+
+    // Time (ms) of the last accepted edge on any channel
+    void markActivity() { lastActivityTime = clockMillis(); }
+    unsigned long getLastActivityTime() const { return lastActivityTime; }
+
+private:
+    uint8_t channelCount;
+
+    // Per-edge state (trigger times in micros)
+    uint32_t lastTriggerTime[MAX_SENSOR_CHANNELS];
+    uint32_t batchTime[MAX_SENSOR_CHANNELS];
+    uint16_t batchEdges[MAX_SENSOR_CHANNELS];
+    uint32_t instantMilliRPM[MAX_SENSOR_CHANNELS];
+    uint64_t weightedMilliRPM[MAX_SENSOR_CHANNELS];  // Sum of milli-RPM x micros this interval
+    uint64_t intervalTime[MAX_SENSOR_CHANNELS];      // Micros covered this interval
+    unsigned long readingCount[MAX_SENSOR_CHANNELS];
+    uint32_t idleSince[MAX_SENSOR_CHANNELS];         // Idle time is accounted up to here while stopped
+    uint32_t lastInterval[MAX_SENSOR_CHANNELS];      // Last accepted edge interval (micros), 0 if none
+    uint32_t plausibleMilliRPM[MAX_SENSOR_CHANNELS]; // Last per-edge reading within maxRPM, 0 if none
+
+    // Configuration
+    uint64_t rpmNumerator[MAX_SENSOR_CHANNELS];  // MILLI_RPM_MINUTE x edgeDivider / magnets
+    uint32_t maxMilliRPM[MAX_SENSOR_CHANNELS];
+    uint8_t magnets[MAX_SENSOR_CHANNELS];
+    uint8_t edgeDividers[MAX_SENSOR_CHANNELS];
+    uint8_t pins[MAX_SENSOR_CHANNELS];
+
+    // Queues, filters and statistics
+    EdgeBuffer<SENSOR_EDGE_BUFFER_SIZE> edges[MAX_SENSOR_CHANNELS];
+    GlitchFilter filters[MAX_SENSOR_CHANNELS];
+    SpacingCalibrator spacing[MAX_SENSOR_CHANNELS];
+    MedianFilter<uint32_t, SPIKE_MEDIAN_SIZE> spikeFilters[MAX_SENSOR_CHANNELS];
+    Ewma<SMOOTHING_SHIFT> smoothed[MAX_SENSOR_CHANNELS];
+    SlidingWindow<uint32_t, RECENT_EDGE_WINDOW> recent[MAX_SENSOR_CHANNELS];
+    BucketWindow<AVERAGE_BUCKETS> averages[MAX_SENSOR_CHANNELS];
+
+    // Session averages
+    uint64_t sessionWeightedMilliRPM[MAX_SENSOR_CHANNELS];
+    uint64_t sessionTime[MAX_SENSOR_CHANNELS];
+    uint32_t sessionAvgMilliRPM[MAX_SENSOR_CHANNELS];
+
+    // Raw edge observer
+    EdgeObserver edgeObserver;
+    void* edgeObserverContext;
+
+    unsigned long lastActivityTime;
+
+    // Time-weighted accumulation of a value held for a duration (micros)
+    // up to the given edge time (micros)
+    void accumulate(uint8_t channel, uint32_t milliRPM, uint32_t duration, uint32_t until);
+
+    // The clockMillis() reading at a past clockMicros() time
+    static uint32_t millisAt(uint32_t time);
+
+    // Zero RPM from idleSince up to the given time (micros), spread over
+    // the average buckets it spans
+    void accumulateIdle(uint8_t channel, uint32_t until);
+
+    // A reading capped by the time since the channel's last edge
+    uint32_t decay(uint8_t channel, uint32_t milliRPM) const;
+
+    // Constants
+    const uint32_t TIMEOUT_PERIOD = 3000000; // 3 seconds for timeout (micros)
+    const uint32_t MAX_TIME_BETWEEN_TRIGGERS = 60000000; // 60 seconds max between triggers (micros)
+};
+
+// The edge processing is defined here so each caller's rates inline into it
+
+template <class Rates>
+bool SensorEngine::processEdge(uint8_t channel, uint32_t edgeTime, const Rates& rates) {
+    // First edge after a reset or timeout only establishes the reference time;
+    // the time spent stopped until now counts as zero RPM
+    if (lastTriggerTime[channel] == 0) {
+        if ((int32_t)(edgeTime - idleSince[channel]) > 0) {
+            accumulateIdle(channel, edgeTime);
+        }
+        lastTriggerTime[channel] = edgeTime;
+        lastActivityTime = clockMillis();
+        return true;
+    }
+
+    // Too long since the last edge to be a valid interval - restart from here
+    uint32_t interval = edgeTime - lastTriggerTime[channel];
+    if (interval >= MAX_TIME_BETWEEN_TRIGGERS) {
+        lastTriggerTime[channel] = edgeTime;
+        lastInterval[channel] = 0;
+        spacing[channel].lostPhase();
+        return true;
+    }
+
+    // Ignore triggers that are too close together (debounce)
+    if (!filters[channel].accept(interval)) {
+        return false;
+    }
+
+    // Readings use the interval as if the magnets were evenly spaced; the
+    // averages still weight each reading by the time it really covered
+    uint32_t evenInterval = spacing[channel].correct(interval);
+
+    // Accumulate the interval into the current batch
+    batchTime[channel] += evenInterval;
+    batchEdges[channel]++;
+    lastTriggerTime[channel] = edgeTime;
+    lastInterval[channel] = interval;
+    lastActivityTime = clockMillis();
+
+    // A burst of implausible edges gets past the median, so the same
+    // limit as the batch applies per edge: the edge's time still counts
+    // in the averages, at the last plausible reading, but its own value
+    // reaches none of the statistics
+    uint32_t rawMilliRPM = rates.edgeMilliRPM(channel, evenInterval);
+    if (rawMilliRPM > rates.maxMilliRPM(channel)) {
+        accumulate(channel, plausibleMilliRPM[channel], interval, edgeTime);
+        return true;
+    }
+
+    // Per-edge statistics - the median rejects single-edge spikes
+    uint32_t edgeMilliRPM = spikeFilters[channel].add(rawMilliRPM);
+    plausibleMilliRPM[channel] = edgeMilliRPM;
+    smoothed[channel].add(edgeMilliRPM);
+    recent[channel].add(edgeMilliRPM);
+
+    // Averages are weighted by the time each value was held, once per edge
+    accumulate(channel, edgeMilliRPM, interval, edgeTime);
+    readingCount[channel]++;
+    return true;
+}
+
+template <class Rates>
+void SensorEngine::process(const Rates& rates) {
+    uint32_t edgeTime;
+
+    // Drain every edge the ISRs queued since the last pass
+    for (uint8_t ch = 0; ch < channelCount; ch++) {
+        while (edges[ch].pop(edgeTime)) {
+            STAT_RECORD(HIST_EDGE_DELAY, clockMicros() - edgeTime);
+            bool accepted = processEdge(ch, edgeTime, rates);
+            if (edgeObserver) edgeObserver(ch, edgeTime, accepted, edgeObserverContext);
+        }
+    }
+
+    uint32_t currentTime = clockMicros();
+    uint32_t currentMillis = clockMillis();
+    for (uint8_t ch = 0; ch < channelCount; ch++) {
+        // A stopped channel contributes zero RPM for the time it stays stopped
+        if (lastTriggerTime[ch] == 0 && (int32_t)(currentTime - idleSince[ch]) > 0) {
+            accumulateIdle(ch, currentTime);
+            idleSince[ch] = currentTime;
+        }
+
+        // Let the averaging window slide even when no edges arrive
+        averages[ch].advance(currentMillis);
+
+        // Milli-RPM over the whole batch so no edge is discarded:
+        // edges * (60e9 x edgeDivider / magnets) / elapsed micros
+        if (batchEdges[ch] > 0) {
+            uint32_t calculatedMilliRPM = rates.batchMilliRPM(ch, batchEdges[ch], batchTime[ch]);
+
+            // Sanity check - only accept reasonable values
+            if (calculatedMilliRPM <= rates.maxMilliRPM(ch)) {
+                instantMilliRPM[ch] = calculatedMilliRPM;
+            }
+            batchTime[ch] = 0;
+            batchEdges[ch] = 0;
+        }
+    }
+}
+
+#endif // SENSOR_ENGINE_H
@@ -0,0 +1,81 @@
+#ifndef SENSOR_INPUT_H
+#define SENSOR_INPUT_H
+
+#include <stdint.h>
+#include "config.h"
+#include "sensor_engine.h"
+#include "seqlock.h"
+
+// What a channel's interrupt handler has done so far, published as one
+// consistent snapshot
+struct SensorChannelState {
+    uint32_t interrupts;         // Interrupts taken since begin()
+    uint32_t lastInterruptTime;  // micros of the latest one
+    uint64_t handlerCycles;      // CPU cycles in the handler (instrumented builds only)
+};
+
+// Sensor acquisition: turns Hall sensor edges into timestamps queued on a
+// SensorEngine and wakes the event loop for each interrupt. The backend
+// is picked at build time by SENSOR_BACKEND:
+//
+//   GPIO - attachInterruptArg() on every sensor pin, one interrupt per edge
+//          (src/sensor_input_gpio.cpp)
+//   PCNT - one pulse counter unit per channel counts edges behind its
+//          hardware glitch filter and interrupts only every edgeDivider
+//          edges (src/sensor_input_pcnt.cpp)
+//
+// Host builds get a simulated backend (src/sensor_input_sim.cpp) fed by
+// inject(), which takes interrupts exactly where the hardware would for
+// each channel's edge divider, so both firmware backends can be compared
+// off-target.
+class SensorInput {
+public:
+    SensorInput();
+
+    // Start acquisition on every engine channel that has a pin; returns
+    // false if a channel could not be set up
+    bool begin(SensorEngine* engine);
+
+    // Stop acquisition
+    void end();
+
+#ifndef ARDUINO
+    // Simulated sensor edge at the given time (micros)
+    void inject(uint8_t channel, uint32_t timestamp);
+#endif
+
+    static const char* getBackendName();
+
+    // Consistent snapshot of a channel's handler state; safe from any task
+    // while the interrupts keep running
+    SensorChannelState getState(uint8_t channel) const { return published[channel].read(); }
+
+    // Interrupts taken and sensor edges seen since begin()
+    uint32_t getInterruptCount(uint8_t channel) const { return getState(channel).interrupts; }
+    uint32_t getEdgeCount(uint8_t channel) const;
+    uint32_t getInterruptCount() const;
+    uint32_t getEdgeCount() const;
+
+    // CPU cycles spent in the interrupt handlers (instrumented builds only,
+    // otherwise 0); excludes the interrupt entry and exit
+    uint64_t getHandlerCycles() const;
+
+private:
+    SensorEngine* engine;
+    uint8_t channelCount;
+    SensorChannelState states[MAX_SENSOR_CHANNELS];              // Each written by its channel's ISR only
+    SeqLock<SensorChannelState> published[MAX_SENSOR_CHANNELS];  // Copy of states[] for readers
+#ifndef ARDUINO
+    uint8_t pendingEdges[MAX_SENSOR_CHANNELS];  // Simulated counter value
+#endif
+
+    // Start every channel from zero (before the interrupts are enabled)
+    void resetStates();
+
+    static void onInterrupt(void* channel);
+};
+
+// Declare global instance
+extern SensorInput sensorInput;
+
+#endif // SENSOR_INPUT_H
@@ -0,0 +1,93 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+// Single-writer sequence lock: publishes a small struct from an ISR (or a
+// single task) so readers get a consistent copy without disabling
+// interrupts and without ever blocking the writer. The writer makes the
+// sequence odd, stores the words, then makes it even again; a reader
+// retries whenever the sequence was odd or changed while it copied.
+//
+// T must be trivially copyable and a whole number of 32-bit words, which
+// are stored as relaxed atomics so a copy racing a write is well defined.
+// Readers must not preempt the writer on its core (an ISR reading a value
+// its own task writes would spin forever).
+template <typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+  static_assert(sizeof(T) % sizeof(uint32_t) == 0, "SeqLock type must be a whole number of 32-bit words");
+
+public:
+  SeqLock() : sequence(0) {
+    for (size_t i = 0; i < WORDS; i++) {
+      words[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Writer side (one writer only)
+  void write(const T& value) {
+    uint32_t source[WORDS];
+    memcpy(source, &value, sizeof(T));
+
+    uint32_t s = sequence.load(std::memory_order_relaxed);
+    sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) {
+      words[i].store(source[i], std::memory_order_relaxed);
+    }
+    sequence.store(s + 2, std::memory_order_release);
+  }
+
+  // Reader side: a consistent copy
+  T read() const {
+    T value;
+    uint32_t version;
+    do {
+      version = readBegin();
+      value = load();
+    } while (readRetry(version));
+    return value;
+  }
+
+  // Reader side in steps, for readers that pair the snapshot with other
+  // state (e.g. a hardware counter): readBegin(), load() and any other
+  // reads, then start over while readRetry() returns true
+  uint32_t readBegin() const {
+    uint32_t s;
+    while ((s = sequence.load(std::memory_order_acquire)) & 1) {
+      // A write is in progress on another core
+    }
+    return s;
+  }
+
+  T load() const {
+    uint32_t copy[WORDS];
+    for (size_t i = 0; i < WORDS; i++) {
+      copy[i] = words[i].load(std::memory_order_relaxed);
+    }
+    T value;
+    memcpy(&value, copy, sizeof(T));
+    return value;
+  }
+
+  bool readRetry(uint32_t version) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return sequence.load(std::memory_order_relaxed) != version;
+  }
+
+  // Writes published so far
+  uint32_t getWriteCount() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+  static const size_t WORDS = sizeof(T) / sizeof(uint32_t);
+
+  std::atomic<uint32_t> sequence;  // Odd while a write is in progress
+  std::atomic<uint32_t> words[WORDS];
+};
+
+#endif // SEQLOCK_H
@@ -0,0 +1,82 @@
+#ifndef SERIAL_FRAME_H
+#define SERIAL_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary records streamed over the USB serial port. Each frame is
+//   type (1) | sequence (1) | payload | CRC-16/CCITT (2, little-endian)
+// COBS-encoded and terminated by a zero byte, so a reader can join the
+// stream at any point and stray text (boot messages, errors) just fails
+// the CRC. The sequence increments per frame, including frames the
+// firmware had to drop, so gaps show up on the host. Shared with the host
+// reader in tools/.
+
+#define SERIAL_FRAME_MAX_PAYLOAD 32
+#define SERIAL_FRAME_MAX_RAW (SERIAL_FRAME_MAX_PAYLOAD + 4)          // type, sequence, CRC
+#define SERIAL_FRAME_MAX_ENCODED (SERIAL_FRAME_MAX_RAW + 2)          // COBS overhead + delimiter
+
+enum SerialRecordType : uint8_t {
+  SERIAL_RECORD_SAMPLE = 1,
+  SERIAL_RECORD_EDGE = 2
+};
+
+// Periodic sample (SERIAL_STREAM_INTERVAL)
+struct __attribute__((packed)) SerialSampleRecord {
+  uint32_t time;                   // ms since boot
+  uint32_t wheelMilliRPM;          // Instant, decayed between edges
+  uint32_t cadenceMilliRPM;        // Wheel-derived in a locked gear, else as the wheel
+  uint32_t smoothedWheelMilliRPM;  // EWMA, decayed between edges
+  uint32_t smoothedCadenceMilliRPM;
+  uint8_t chainring;               // 1-based, 0 = unknown
+  uint8_t sprocket;
+  uint16_t gearRatio;              // x 1000
+};
+
+// One raw sensor edge, as queued by the ISR
+struct __attribute__((packed)) SerialEdgeRecord {
+  uint8_t channel;  // 0 = wheel, 1 = cadence
+  uint32_t time;    // micros
+};
+
+static_assert(sizeof(SerialSampleRecord) <= SERIAL_FRAME_MAX_PAYLOAD, "Sample record too large");
+
+uint16_t serialFrameCrc(const uint8_t* data, size_t length);
+
+// Encode one record into out (at least SERIAL_FRAME_MAX_ENCODED bytes),
+// including the trailing delimiter; returns the encoded length
+size_t serialFrameEncode(uint8_t type, uint8_t sequence, const void* payload, size_t length, uint8_t* out);
+
+// Byte-at-a-time decoder for the host side
+class SerialFrameDecoder {
+public:
+  SerialFrameDecoder();
+
+  // Feed one byte; returns true when it completed a valid frame
+  bool push(uint8_t byte);
+
+  uint8_t getType() const { return frame[0]; }
+  uint8_t getSequence() const { return frame[1]; }
+  const uint8_t* getPayload() const { return frame + 2; }
+  size_t getPayloadLength() const { return frameLength - 4; }
+
+  unsigned long getFrameCount() const { return frameCount; }
+  unsigned long getBadFrames() const { return badFrames; }
+  unsigned long getLostFrames() const { return lostFrames; }
+
+private:
+  uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+  size_t encodedLength;
+  bool overflow;
+  uint8_t frame[SERIAL_FRAME_MAX_RAW];
+  size_t frameLength;
+  uint8_t lastSequence;
+  bool hasSequence;
+  unsigned long frameCount;
+  unsigned long badFrames;
+  unsigned long lostFrames;
+
+  bool decodeFrame();
+};
+
+#endif // SERIAL_FRAME_H
@@ -0,0 +1,47 @@
+#ifndef SERIAL_STREAM_H
+#define SERIAL_STREAM_H
+
+#include <Arduino.h>
+#include "serial_frame.h"
+
+// What goes out on the serial port
+enum SerialStreamMode : uint8_t {
+    SERIAL_MODE_TEXT,     // Human-readable status lines (default)
+    SERIAL_MODE_SAMPLES,  // Binary sample records only
+    SERIAL_MODE_EDGES     // Binary sample records plus every raw edge
+};
+
+// Writes framed binary records (see serial_frame.h) to a serial port
+// without ever blocking the loop: a frame is only written if it fits in
+// the UART transmit buffer, otherwise it is dropped and counted.
+class SerialStream {
+public:
+    SerialStream();
+
+    void begin(HardwareSerial* port, SerialStreamMode mode);
+
+    void setMode(SerialStreamMode mode) { this->mode = mode; }
+    SerialStreamMode getMode() const { return mode; }
+    bool isBinary() const { return mode != SERIAL_MODE_TEXT; }
+
+    // Record senders - ignored when the mode does not include them
+    void sendSample(const SerialSampleRecord& sample);
+    void sendEdge(uint8_t channel, uint32_t edgeTime);
+
+    unsigned long getSentCount() const { return sentCount; }
+    unsigned long getDroppedCount() const { return droppedCount; }
+
+private:
+    bool sendFrame(uint8_t type, const void* payload, size_t length);
+
+    HardwareSerial* port;
+    SerialStreamMode mode;
+    uint8_t sequence;
+    unsigned long sentCount;
+    unsigned long droppedCount;
+};
+
+// Declare global instance
+extern SerialStream serialStream;
+
+#endif // SERIAL_STREAM_H
@@ -0,0 +1,85 @@
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include "session_log_format.h"
+
+// Outcome of checking one file for an interrupted session on boot
+enum SessionLogRecovery : uint8_t {
+    SESSION_RECOVERY_CLEAN,     // Closed normally or not a version 3 log - untouched
+    SESSION_RECOVERY_SALVAGED,  // Truncated after its last valid sector and closed
+    SESSION_RECOVERY_FAILED     // The file could not be read or rewritten
+};
+
+// Buffers packed log rows in RAM and writes them to the SD card one whole
+// sector at a time. A partially filled sector is only written (and the
+// file synced) once the durability window expires, and is rewritten in
+// place as more rows arrive. Each sync also commits the row count to the
+// file header.
+//
+// When the file is one contiguous extent (see FsFile::preAllocate()) and
+// a card is given, sectors are written straight to the card, bypassing
+// FAT cluster allocation and the volume cache.
+class SessionLogWriter {
+public:
+    SessionLogWriter();
+
+    // Write the file header and start buffering rows into the given file;
+    // card may be nullptr to always write through the file
+    bool begin(FsFile* file, SdCard* card, uint32_t startTimestamp, uint32_t startMillis, uint32_t bootTimestamp,
+               uint8_t wheelMagnets, uint8_t crankMagnets, unsigned long syncInterval);
+
+    // Close a session left open by a reset or power cut: keep every valid
+    // sector, truncate the pre-allocated space after it and mark the file
+    // closed. Only used while no session is open.
+    SessionLogRecovery recover(FsFile* file, SdCard* card);
+
+    // Record the boot time once the clock syncs by rewriting the file header
+    bool setBootTimestamp(uint32_t bootTimestamp);
+
+    // Add a row; writes a sector when full or when the sync window expires
+    bool append(const SessionLogRecord& record, unsigned long currentTime);
+
+    // Write any buffered rows and sync the file
+    bool flush();
+
+    // Flush, trim the unused pre-allocated space and detach from the file
+    void end();
+
+    bool isOpen() const { return file != nullptr; }
+    uint32_t getRecordCount() const { return totalRecords; }
+    uint32_t getCommittedCount() const { return header.committedRecords; }
+
+private:
+    // Write the current sector buffer at its position in the file
+    bool writeSector();
+
+    // Write the file header into sector 0
+    bool writeHeader();
+
+    // Sector-sized access by index within the file, raw when contiguous
+    bool writeFileSector(uint32_t index, const uint8_t* data);
+    bool readFileSector(uint32_t index, uint8_t* data);
+
+    // Use raw sector access if the file is a single extent
+    void mapExtent(SdCard* card);
+
+    // Cut the file after the header and the given number of data sectors
+    bool truncateSectors(uint32_t dataSectors);
+
+    FsFile* file;
+    SdCard* card;
+    uint32_t firstSector;        // Card sectors of the file's extent
+    uint32_t lastSector;
+    SessionLogHeader header;
+    uint8_t sector[SESSION_LOG_SECTOR_SIZE];
+    uint16_t sectorRecords;
+    uint32_t sectorSequence;
+    uint32_t totalRecords;
+    bool sectorDirty;
+    unsigned long syncInterval;
+    unsigned long lastSyncTime;
+};
+
+#endif // SESSION_LOG_H
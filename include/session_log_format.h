@@ -0,0 +1,95 @@
+#ifndef SESSION_LOG_FORMAT_H
+#define SESSION_LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary session log layout, shared by the firmware writer and the host
+// converter in tools/. Everything is little-endian and written in whole
+// 512-byte sectors: sector 0 holds the file header, every following
+// sector holds a small sector header and up to 25 fixed-size rows.
+//
+// From version 3 the file is pre-allocated, so everything past the last
+// written sector is whatever the card held before. Sector headers carry
+// the session's random id to tell its own sectors from that leftover
+// data, and the file header records how many rows had been committed
+// (written and synced) and whether the session was closed cleanly.
+
+#define SESSION_LOG_SECTOR_SIZE 512
+#define SESSION_LOG_MAGIC "TTLG"
+#define SESSION_LOG_VERSION 3
+#define SESSION_LOG_SECTOR_MAGIC 0x5354  // "TS"
+
+// Column layout of the CSV files the binary log converts back to
+#define SESSION_LOG_CSV_HEADER "Timestamp,ElapsedTime(ms),WheelRPM,CadenceRPM,SessionAvgWheelRPM,SessionAvgCadenceRPM,Chainring,Sprocket,GearRatio"
+
+// Fixed-point scales used in the packed rows
+#define SESSION_LOG_RPM_SCALE 10     // RPM stored in tenths
+#define SESSION_LOG_RATIO_SCALE 100  // Gear ratio stored in hundredths
+
+struct __attribute__((packed)) SessionLogHeader {
+  char magic[4];              // SESSION_LOG_MAGIC
+  uint16_t version;           // SESSION_LOG_VERSION
+  uint16_t recordSize;        // sizeof(SessionLogRecord)
+  uint16_t recordsPerSector;  // SESSION_LOG_RECORDS_PER_SECTOR
+  uint8_t wheelMagnets;
+  uint8_t crankMagnets;
+  uint32_t startTimestamp;    // Unix time (s), or millis() if time was not synced
+  uint32_t startMillis;       // millis() when the session started (version 2)
+  uint32_t bootTimestamp;     // Unix time (s) at millis() == 0, 0 if never synced (version 2)
+  uint32_t sessionId;         // Random, repeated in every sector header (version 3)
+  uint32_t committedRecords;  // Rows known to be on the card (version 3)
+  uint8_t closed;             // 1 once the file was ended and truncated (version 3)
+};
+
+struct __attribute__((packed)) SessionLogSectorHeader {
+  uint16_t magic;             // SESSION_LOG_SECTOR_MAGIC
+  uint16_t recordCount;       // Valid rows in this sector
+  uint32_t sequence;          // Data sector number, starting at 0
+  uint32_t sessionId;         // SessionLogHeader::sessionId (version 3)
+};
+
+// Versions 1 and 2 had no session id in the sector header
+#define SESSION_LOG_V2_SECTOR_HEADER_SIZE 8
+
+struct __attribute__((packed)) SessionLogRecord {
+  uint32_t timestamp;         // Unix time (s), or millis() if time was not synced
+  uint32_t elapsedTime;       // ms since session start
+  uint16_t wheelRPM;          // x SESSION_LOG_RPM_SCALE
+  uint16_t cadenceRPM;
+  uint16_t sessionAvgWheelRPM;
+  uint16_t sessionAvgCadenceRPM;
+  uint8_t chainring;          // 1-based, 0 = unknown
+  uint8_t sprocket;           // 1-based, 0 = unknown
+  uint16_t gearRatio;         // x SESSION_LOG_RATIO_SCALE
+};
+
+#define SESSION_LOG_RECORDS_PER_SECTOR \
+  ((SESSION_LOG_SECTOR_SIZE - sizeof(SessionLogSectorHeader)) / sizeof(SessionLogRecord))
+
+static_assert(sizeof(SessionLogHeader) <= SESSION_LOG_SECTOR_SIZE, "Session log header exceeds a sector");
+static_assert(sizeof(SessionLogRecord) == 20, "Session log record layout changed - bump SESSION_LOG_VERSION");
+
+// Offset of the first row in a data sector
+inline size_t sessionLogRowOffset(const SessionLogHeader& header) {
+  return header.version < 3 ? SESSION_LOG_V2_SECTOR_HEADER_SIZE : sizeof(SessionLogSectorHeader);
+}
+
+// Wall-clock time of a row. The clock may sync after the session started,
+// so once the header knows the boot time every row is re-dated from it.
+inline uint32_t sessionLogRowTime(const SessionLogHeader& header, const SessionLogRecord& record) {
+  if (header.version < 2 || header.bootTimestamp == 0) {
+    return record.timestamp;
+  }
+  return header.bootTimestamp + (header.startMillis + record.elapsedTime) / 1000;
+}
+
+// Convert a non-negative value to its packed fixed-point representation
+inline uint16_t sessionLogFixed(float value, uint16_t scale) {
+  float scaled = value * scale + 0.5f;
+  if (scaled <= 0) return 0;
+  if (scaled >= 65535.0f) return 65535;
+  return (uint16_t)scaled;
+}
+
+#endif // SESSION_LOG_FORMAT_H
@@ -0,0 +1,24 @@
+#ifndef SESSION_RECORD_H
+#define SESSION_RECORD_H
+
+#include "rpm_calculator.h"
+#include "session_log_format.h"
+
+// Pack one session log row from the calculator state. Shared by logData()
+// and the host replay tool so both produce identical rows.
+inline SessionLogRecord makeSessionLogRecord(const RPMCalculator& calculator, uint32_t timestamp,
+                                             uint32_t elapsedTime, float wheelRPM, float cadenceRPM) {
+  SessionLogRecord record;
+  record.timestamp = timestamp;
+  record.elapsedTime = elapsedTime;
+  record.wheelRPM = sessionLogFixed(wheelRPM, SESSION_LOG_RPM_SCALE);
+  record.cadenceRPM = sessionLogFixed(cadenceRPM, SESSION_LOG_RPM_SCALE);
+  record.sessionAvgWheelRPM = sessionLogFixed(calculator.getSessionAvgWheelRPM(), SESSION_LOG_RPM_SCALE);
+  record.sessionAvgCadenceRPM = sessionLogFixed(calculator.getSessionAvgCadenceRPM(), SESSION_LOG_RPM_SCALE);
+  record.chainring = calculator.getCurrentChainring();
+  record.sprocket = calculator.getCurrentSprocket();
+  record.gearRatio = sessionLogFixed(calculator.getCurrentGearRatio(), SESSION_LOG_RATIO_SCALE);
+  return record;
+}
+
+#endif // SESSION_RECORD_H
@@ -0,0 +1,289 @@
+#ifndef SPACING_CALIBRATOR_H
+#define SPACING_CALIBRATOR_H
+
+#include <stdint.h>
+
+// Magnet spacing calibration tuning
+#define SPACING_MAX_SLOTS 16         // Most edges per revolution a channel can calibrate
+#define SPACING_ONE 65536            // Nominal spacing (one edge interval of an even ring)
+#define SPACING_LEARN_SHIFT 4        // Past the first revolutions, each one moves the table 1/16 of the way
+#define SPACING_STEADY_PERCENT 1     // Max change (%) from the previous revolution to learn from one
+#define SPACING_MIN_REVOLUTIONS 16   // Steady revolutions learned before intervals are corrected
+#define SPACING_SLIP_PERCENT 30      // An interval this far (%) from its expected length = missed or extra edge
+
+// A learned spacing table, as saved and restored
+struct SpacingTable {
+  uint8_t slots;
+  uint16_t revolutions;               // Steady revolutions learned (saturates)
+  uint32_t spacing[SPACING_MAX_SLOTS];  // Angle to each edge from the one before, x SPACING_ONE
+};
+
+// Per-magnet spacing calibration for one sensor channel. Hand-placed
+// magnets are never evenly spaced, so consecutive intervals jitter by the
+// placement error even at a steady speed. Counting edges gives each
+// interval a slot (the magnet that ended it); over steady revolutions the
+// calibrator learns the angle each slot really spans as a share of the
+// revolution, then scales every interval to what it would have been with
+// even spacing. The table has no fixed origin: after the phase is lost (a
+// stop, a missed or an extra edge) one revolution of intervals is matched
+// against the table to find the slots again, and nothing is corrected
+// until it matches unambiguously. SpacingStore keeps the tables across
+// reboots.
+//
+// Channels with one timestamp per revolution (a single magnet, or the
+// pulse counter grouping a whole ring) have nothing to calibrate.
+class SpacingCalibrator {
+public:
+  SpacingCalibrator() : slots(0) { forget(); }
+
+  // Timestamps per revolution; 0, 1 or more than SPACING_MAX_SLOTS
+  // disables calibration
+  void configure(uint8_t slots) {
+    this->slots = slots > 1 && slots <= SPACING_MAX_SLOTS ? slots : 0;
+    forget();
+  }
+
+  bool isEnabled() const { return slots > 0; }
+  uint8_t getSlots() const { return slots; }
+
+  // Drop the learned table
+  void forget() {
+    for (uint8_t i = 0; i < SPACING_MAX_SLOTS; i++) {
+      spacing[i] = SPACING_ONE;
+      inverse[i] = SPACING_ONE;
+    }
+    revolutions = 0;
+    learnedRevolutions = 0;
+    resyncs = 0;
+    lostPhase();
+  }
+
+  // The edge count no longer tells the slot (after a reset, timeout or
+  // restart). A table still being learned is dropped; a calibrated one is
+  // matched again once a revolution has been collected.
+  void lostPhase() {
+    if (revolutions > 0 && revolutions < SPACING_MIN_REVOLUTIONS) {
+      for (uint8_t i = 0; i < SPACING_MAX_SLOTS; i++) {
+        spacing[i] = SPACING_ONE;
+        inverse[i] = SPACING_ONE;
+      }
+      revolutions = 0;
+    }
+    synced = revolutions == 0;
+    slot = 0;
+    collected = 0;
+    previousRevolution = 0;
+    meanInterval = 0;
+  }
+
+  // Account one accepted interval (micros) and return it corrected to
+  // even spacing (unchanged until calibrated and in phase). Per edge this
+  // only multiplies; the divides happen once per revolution.
+  uint32_t correct(uint32_t interval) {
+    if (slots == 0) {
+      return interval;
+    }
+
+    uint8_t next = (uint8_t)((slot + 1) % slots);
+
+    // A missed or extra edge shifts every later slot - start over
+    if (synced && meanInterval > 0) {
+      uint32_t expected = (uint32_t)(((uint64_t)meanInterval * spacing[next]) / SPACING_ONE);
+      uint32_t difference = interval > expected ? interval - expected : expected - interval;
+      if ((uint64_t)difference * 100 > (uint64_t)expected * SPACING_SLIP_PERCENT) {
+        lostPhase();
+        next = 1 % slots;
+      }
+    }
+
+    slot = next;
+    intervals[slot] = interval;
+    if (collected < slots) {
+      collected++;
+    }
+
+    uint32_t corrected = interval;
+    if (synced && revolutions >= SPACING_MIN_REVOLUTIONS) {
+      corrected = (uint32_t)(((uint64_t)interval * inverse[slot] + SPACING_ONE / 2) / SPACING_ONE);
+    }
+
+    // A whole revolution ends at the last slot
+    if (collected == slots && slot == slots - 1) {
+      if (synced) {
+        learn();
+      } else {
+        match();
+      }
+    }
+    return corrected;
+  }
+
+  // Corrections are applied
+  bool isCalibrated() const { return revolutions >= SPACING_MIN_REVOLUTIONS; }
+  bool isSynced() const { return synced; }
+
+  uint16_t getRevolutions() const { return revolutions; }
+  unsigned long getLearnedRevolutions() const { return learnedRevolutions; }  // Since boot
+  unsigned long getResyncCount() const { return resyncs; }
+
+  // Spacing of one slot relative to even spacing (x SPACING_ONE)
+  uint32_t getSpacing(uint8_t slot) const { return spacing[slot]; }
+
+  void getTable(SpacingTable& table) const {
+    table.slots = slots;
+    table.revolutions = revolutions;
+    for (uint8_t i = 0; i < SPACING_MAX_SLOTS; i++) {
+      table.spacing[i] = spacing[i];
+    }
+  }
+
+  // Install a saved table; refused if it was learned for another layout
+  bool loadTable(const SpacingTable& table) {
+    if (slots == 0 || table.slots != slots) {
+      return false;
+    }
+    uint64_t total = 0;
+    for (uint8_t i = 0; i < slots; i++) {
+      total += table.spacing[i];
+    }
+    if (total != (uint64_t)slots * SPACING_ONE) {
+      return false;  // Corrupt
+    }
+    for (uint8_t i = 0; i < slots; i++) {
+      spacing[i] = table.spacing[i];
+    }
+    revolutions = table.revolutions;
+    updateInverse();
+    lostPhase();
+    return true;
+  }
+
+private:
+  uint8_t slots;                        // 0 when disabled
+  uint8_t slot;                         // Slot of the last interval
+  uint8_t collected;                    // Intervals of the current revolution so far
+  bool synced;                          // Slots line up with the table
+  uint16_t revolutions;
+  unsigned long learnedRevolutions;
+  unsigned long resyncs;
+  uint32_t previousRevolution;          // Micros
+  uint32_t meanInterval;                // Of the previous revolution, 0 if unknown
+  uint32_t intervals[SPACING_MAX_SLOTS];  // Raw intervals of the current revolution
+  uint32_t spacing[SPACING_MAX_SLOTS];
+  uint32_t inverse[SPACING_MAX_SLOTS];  // SPACING_ONE^2 / spacing, to correct without dividing
+
+  void updateInverse() {
+    for (uint8_t i = 0; i < slots; i++) {
+      inverse[i] = (uint32_t)(((uint64_t)SPACING_ONE * SPACING_ONE + spacing[i] / 2) / spacing[i]);
+    }
+  }
+
+  // Fold a completed revolution into the table if it was ridden steadily
+  void learn() {
+    uint64_t revolution = 0;
+    for (uint8_t i = 0; i < slots; i++) {
+      revolution += intervals[i];
+    }
+
+    uint32_t previous = meanInterval > 0 ? previousRevolution : 0;
+    previousRevolution = (uint32_t)revolution;
+    meanInterval = (uint32_t)(revolution / slots);
+    if (previous == 0) {
+      return;
+    }
+    uint32_t change = revolution > previous ? (uint32_t)revolution - previous : previous - (uint32_t)revolution;
+    if ((uint64_t)change * 100 > (uint64_t)previous * SPACING_STEADY_PERCENT) {
+      return;  // Accelerating - the intervals mix speed and spacing
+    }
+
+    // Even a gentle speed change stretches the intervals steadily over the
+    // revolution; take that trend out so it is not learned as spacing.
+    // Interval i sits (2i + 1 - slots) / 2 slots of a revolution from the
+    // middle.
+    int64_t trend = ((int64_t)revolution - previous) * SPACING_ONE / previous;
+    uint32_t steady[SPACING_MAX_SLOTS];
+    uint64_t steadyRevolution = 0;
+    for (uint8_t i = 0; i < slots; i++) {
+      int64_t factor = SPACING_ONE + trend * (2 * i + 1 - slots) / (2 * slots);
+      steady[i] = (uint32_t)((uint64_t)intervals[i] * SPACING_ONE / (uint64_t)factor);
+      steadyRevolution += steady[i];
+    }
+
+    // A plain mean over the first revolutions, then an exponential one
+    uint32_t weight = revolutions < (1u << SPACING_LEARN_SHIFT) ? revolutions + 1u : (1u << SPACING_LEARN_SHIFT);
+    int64_t total = 0;
+    for (uint8_t i = 0; i < slots; i++) {
+      int64_t share = (int64_t)(((uint64_t)steady[i] * slots * SPACING_ONE) / steadyRevolution);
+      spacing[i] = (uint32_t)((int64_t)spacing[i] + (share - (int64_t)spacing[i]) / (int64_t)weight);
+      total += spacing[i];
+    }
+
+    // Keep the shares summing to one revolution despite the rounding
+    int64_t excess = total - (int64_t)slots * SPACING_ONE;
+    for (uint8_t i = 0; excess != 0; i = (uint8_t)((i + 1) % slots)) {
+      int64_t step = excess > 0 ? 1 : -1;
+      spacing[i] = (uint32_t)((int64_t)spacing[i] - step);
+      excess -= step;
+    }
+    updateInverse();
+
+    if (revolutions < UINT16_MAX) {
+      revolutions++;
+    }
+    learnedRevolutions++;
+  }
+
+  // Find the rotation of the table that fits the revolution just collected
+  void match() {
+    uint64_t revolution = 0;
+    for (uint8_t i = 0; i < slots; i++) {
+      revolution += intervals[i];
+    }
+    uint32_t shares[SPACING_MAX_SLOTS];
+    for (uint8_t i = 0; i < slots; i++) {
+      shares[i] = (uint32_t)(((uint64_t)intervals[i] * slots * SPACING_ONE) / revolution);
+    }
+
+    uint64_t best = UINT64_MAX;
+    uint64_t secondBest = UINT64_MAX;
+    uint8_t bestShift = 0;
+    for (uint8_t shift = 0; shift < slots; shift++) {
+      uint64_t cost = 0;
+      for (uint8_t i = 0; i < slots; i++) {
+        uint32_t expected = spacing[(i + shift) % slots];
+        cost += shares[i] > expected ? shares[i] - expected : expected - shares[i];
+      }
+      if (cost < best) {
+        secondBest = best;
+        best = cost;
+        bestShift = shift;
+      } else if (cost < secondBest) {
+        secondBest = cost;
+      }
+    }
+
+    // Ambiguous (an evenly spaced ring, or a speed change in the middle of
+    // the revolution) - try the next one
+    collected = 0;
+    if (best * 2 > secondBest) {
+      return;
+    }
+
+    // Renumber the collected intervals into table slots
+    uint32_t aligned[SPACING_MAX_SLOTS];
+    for (uint8_t i = 0; i < slots; i++) {
+      aligned[(i + bestShift) % slots] = intervals[i];
+    }
+    for (uint8_t i = 0; i < slots; i++) {
+      intervals[i] = aligned[i];
+    }
+    slot = (uint8_t)((slot + bestShift) % slots);
+    collected = slots;
+    previousRevolution = (uint32_t)revolution;
+    meanInterval = (uint32_t)(revolution / slots);
+    synced = true;
+    resyncs++;
+  }
+};
+
+#endif // SPACING_CALIBRATOR_H
@@ -0,0 +1,39 @@
+#ifndef SPACING_STORE_H
+#define SPACING_STORE_H
+
+#include <Arduino.h>
+#include "sensor_engine.h"
+
+#define SPACING_STORE_NAMESPACE "spacing"  // NVS namespace of the saved tables
+#define SPACING_SAVE_REVOLUTIONS 500       // Steady revolutions learned before a saved table is refreshed
+
+// Keeps each channel's learned magnet spacing (see SpacingCalibrator) in
+// NVS flash, so corrections apply from the first revolution after boot
+// instead of after SPACING_MIN_REVOLUTIONS steady ones. A table is saved
+// when it first becomes calibrated and again after it has learned
+// SPACING_SAVE_REVOLUTIONS more. Flash writes stall the CPU for several
+// ms, so the caller only saves while every sensor is stopped.
+class SpacingStore {
+public:
+    SpacingStore();
+
+    // Restore the saved tables into the engine's channels; tables saved
+    // for a different magnet count are ignored. Returns the number restored.
+    uint8_t load(SensorEngine& engine);
+
+    // Save the tables that are new or have learned enough since their last
+    // save; returns the number written
+    uint8_t update(const SensorEngine& engine);
+
+    // Erase every saved table
+    void clear();
+
+private:
+    bool saved[MAX_SENSOR_CHANNELS];
+    unsigned long savedRevolutions[MAX_SENSOR_CHANNELS];  // Learned revolutions at the last save
+};
+
+// Declare global instance
+extern SpacingStore spacingStore;
+
+#endif // SPACING_STORE_H
@@ -0,0 +1,234 @@
+#ifndef STREAMING_STATS_H
+#define STREAMING_STATS_H
+
+#include <stdint.h>
+
+// Constant-memory streaming statistics for integer sensor samples. All
+// updates are O(1) (amortized for min/max); nothing allocates.
+
+// Fixed-capacity sliding window over the last N samples with mean, min,
+// max and variance. Min and max use monotonic queues of sample sequence
+// numbers so they never rescan the window. Intended for integral T; the
+// 64-bit sums hold up to 4096 samples of up to 2^26 without overflow.
+template <typename T, uint16_t N>
+class SlidingWindow {
+public:
+  SlidingWindow() { reset(); }
+
+  void reset() {
+    count = 0;
+    sequence = 0;
+    sum = 0;
+    sumSquares = 0;
+    minHead = minTail = 0;
+    maxHead = maxTail = 0;
+  }
+
+  void add(T sample) {
+    uint16_t slot = sequence % N;
+    if (count == N) {
+      sum -= samples[slot];
+      sumSquares -= (uint64_t)samples[slot] * samples[slot];
+    } else {
+      count++;
+    }
+    samples[slot] = sample;
+    sum += sample;
+    sumSquares += (uint64_t)sample * sample;
+
+    // Drop queue entries that left the window or can no longer be extremes
+    while (minHead != minTail && sequence - minQueue[minHead % N] >= N) minHead++;
+    while (minHead != minTail && samples[minQueue[(minTail - 1) % N] % N] >= sample) minTail--;
+    minQueue[minTail++ % N] = sequence;
+
+    while (maxHead != maxTail && sequence - maxQueue[maxHead % N] >= N) maxHead++;
+    while (maxHead != maxTail && samples[maxQueue[(maxTail - 1) % N] % N] <= sample) maxTail--;
+    maxQueue[maxTail++ % N] = sequence;
+
+    sequence++;
+  }
+
+  uint16_t size() const { return count; }
+  T mean() const { return count > 0 ? (T)(sum / count) : 0; }
+  T min() const { return count > 0 ? samples[minQueue[minHead % N] % N] : 0; }
+  T max() const { return count > 0 ? samples[maxQueue[maxHead % N] % N] : 0; }
+
+  // Population variance in squared sample units
+  uint64_t variance() const {
+    if (count == 0) return 0;
+    // sum^2 / count without squaring the sum, which overflows 64 bits
+    uint64_t meanSquare = (sum / count) * sum + ((sum % count) * sum) / count;
+    return sumSquares > meanSquare ? (sumSquares - meanSquare) / count : 0;
+  }
+
+private:
+  T samples[N];
+  uint32_t minQueue[N];  // Sequence numbers, increasing sample values
+  uint32_t maxQueue[N];  // Sequence numbers, decreasing sample values
+  uint32_t minHead, minTail;
+  uint32_t maxHead, maxTail;
+  uint32_t sequence;
+  uint16_t count;
+  uint64_t sum;
+  uint64_t sumSquares;
+};
+
+// Running median of the last N samples (N small and odd, e.g. 3 or 5) for
+// rejecting single-sample spikes. Keeps a sorted copy updated by one
+// removal and one insertion per sample.
+template <typename T, uint8_t N>
+class MedianFilter {
+  static_assert(N % 2 == 1, "MedianFilter size must be odd");
+
+public:
+  MedianFilter() { reset(); }
+
+  void reset() {
+    count = 0;
+    next = 0;
+  }
+
+  // Add a sample and return the median of the samples seen so far
+  T add(T sample) {
+    if (count == N) {
+      // Remove the oldest sample from the sorted copy
+      T oldest = history[next];
+      uint8_t i = 0;
+      while (sorted[i] != oldest) i++;
+      for (; i + 1 < count; i++) sorted[i] = sorted[i + 1];
+      count--;
+    }
+    history[next] = sample;
+    next = (next + 1) % N;
+
+    uint8_t i = count++;
+    while (i > 0 && sorted[i - 1] > sample) {
+      sorted[i] = sorted[i - 1];
+      i--;
+    }
+    sorted[i] = sample;
+
+    return sorted[count / 2];
+  }
+
+private:
+  T history[N];
+  T sorted[N];
+  uint8_t count;
+  uint8_t next;
+};
+
+// Exponentially weighted moving average with alpha = 1 / 2^SHIFT, kept
+// with 8 fractional bits so small steps are not lost to truncation.
+template <uint8_t SHIFT>
+class Ewma {
+public:
+  Ewma() : state(0), primed(false) {}
+
+  void reset() {
+    state = 0;
+    primed = false;
+  }
+
+  void add(uint32_t sample) {
+    int64_t scaled = (int64_t)sample << 8;
+    if (!primed) {
+      state = scaled;
+      primed = true;
+    } else {
+      state += (scaled - state) >> SHIFT;
+    }
+  }
+
+  uint32_t value() const { return (uint32_t)(state >> 8); }
+
+private:
+  int64_t state;
+  bool primed;
+};
+
+// Sliding time window made of N fixed-length buckets, each holding a
+// weighted sum. Adding a sample is O(1); a query sums at most N buckets,
+// so windows of different lengths can be read from the same history.
+template <uint16_t N>
+class BucketWindow {
+public:
+  explicit BucketWindow(uint32_t bucketPeriod = 1) : bucketPeriod(bucketPeriod) { reset(); }
+
+  // Change the bucket length (clears the history)
+  void setBucketPeriod(uint32_t bucketPeriod) {
+    this->bucketPeriod = bucketPeriod;
+    reset();
+  }
+
+  void reset() {
+    for (uint16_t i = 0; i < N; i++) {
+      buckets[i].sum = 0;
+      buckets[i].weight = 0;
+    }
+    currentBucket = 0;
+    currentIndex = 0;
+  }
+
+  // Move the window forward to the given time, clearing expired buckets
+  void advance(uint32_t currentTime) {
+    uint32_t bucket = currentTime / bucketPeriod;
+    uint32_t steps = bucket - currentBucket;
+    if (steps == 0) return;
+    if (currentBucket - bucket <= N) return;  // An earlier time leaves the window where it is
+    if (steps > N) steps = N;
+    for (uint32_t i = 0; i < steps; i++) {
+      currentIndex = (currentIndex + 1) % N;
+      buckets[currentIndex].sum = 0;
+      buckets[currentIndex].weight = 0;
+    }
+    currentBucket = bucket;
+  }
+
+  // A sample older than the current bucket goes into the bucket of its
+  // time, or nowhere once that bucket has left the window
+  void add(uint32_t value, uint32_t weight, uint32_t time) {
+    uint32_t age = currentBucket - time / bucketPeriod;
+    if ((int32_t)age <= 0) {
+      advance(time);
+      age = 0;
+    } else if (age >= N) {
+      return;
+    }
+    Bucket& bucket = buckets[(currentIndex + N - age) % N];
+    bucket.sum += (uint64_t)value * weight;
+    bucket.weight += weight;
+  }
+
+  // Weighted mean over the most recent windowLength time units
+  uint32_t mean(uint32_t windowLength) const {
+    uint32_t span = (windowLength + bucketPeriod - 1) / bucketPeriod;
+    if (span > N) span = N;
+    if (span == 0) span = 1;
+
+    uint64_t sum = 0;
+    uint64_t weight = 0;
+    for (uint32_t i = 0; i < span; i++) {
+      const Bucket& b = buckets[(currentIndex + N - i) % N];
+      sum += b.sum;
+      weight += b.weight;
+    }
+    return weight > 0 ? (uint32_t)(sum / weight) : 0;
+  }
+
+  uint32_t getBucketPeriod() const { return bucketPeriod; }
+  uint32_t getCapacity() const { return bucketPeriod * N; }
+
+private:
+  struct Bucket {
+    uint64_t sum;
+    uint64_t weight;
+  };
+
+  Bucket buckets[N];
+  uint32_t bucketPeriod;
+  uint32_t currentBucket;  // Absolute bucket number of currentIndex
+  uint16_t currentIndex;
+};
+
+#endif // STREAMING_STATS_H
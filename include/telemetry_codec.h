@@ -0,0 +1,123 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Batched telemetry frames for ESP-NOW. Each frame packs as many samples
+// as fit in one 250-byte ESP-NOW payload: the first sample is a keyframe
+// with absolute values, every following sample stores zigzag/varint
+// deltas against the one before it. Frames carry a sequence number so the
+// receiver can count lost frames. Plain C++ so the controller (or a host
+// tool) can link the same encoder/decoder, with a loopback send function
+// standing in for esp_now_send().
+
+#define TELEMETRY_MAX_FRAME_SIZE 250  // ESP_NOW_MAX_DATA_LEN
+#define TELEMETRY_MAGIC 0xA5
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_HEADER_SIZE 9
+#define TELEMETRY_MAX_SAMPLE_SIZE 18  // Worst case encoded sample (delta form)
+
+// Date a finished frame built before the clock synced (boot time 0) with
+// the boot time now known; frames that already carry one are left alone
+void telemetryStampBootTime(uint8_t* frame, size_t length, uint32_t bootTime);
+
+struct TelemetrySample {
+  uint32_t time;        // ms since boot
+  uint16_t wheelRPM;    // RPM x 10
+  uint16_t cadenceRPM;  // RPM x 10
+  uint8_t chainring;    // 1-based, 0 = unknown
+  uint8_t sprocket;     // 1-based, 0 = unknown
+  uint16_t gearRatio;   // Ratio x 100
+};
+
+// Builds one frame at a time
+class TelemetryEncoder {
+public:
+  TelemetryEncoder();
+
+  // Start a new, empty frame
+  void begin(uint16_t sequence, uint32_t bootTime);
+
+  // Append a sample; returns false (and leaves the frame untouched) if it does not fit
+  bool add(const TelemetrySample& sample);
+
+  // Date the frame if it was begun without a boot time
+  void stampBootTime(uint32_t bootTime) { telemetryStampBootTime(frame, length, bootTime); }
+
+  const uint8_t* data() const { return frame; }
+  size_t size() const { return length; }
+  uint8_t getSampleCount() const { return frame[8]; }
+  bool isEmpty() const { return frame[8] == 0; }
+  uint32_t getFirstSampleTime() const { return firstSampleTime; }
+
+private:
+  uint8_t frame[TELEMETRY_MAX_FRAME_SIZE];
+  size_t length;
+  TelemetrySample previous;
+  uint32_t firstSampleTime;
+};
+
+// Unpacks frames and tracks the sequence for loss detection
+class TelemetryDecoder {
+public:
+  TelemetryDecoder();
+
+  // Decode a frame into samples; returns the number decoded, 0 for a
+  // repeated frame, or -1 if malformed
+  int decode(const uint8_t* data, size_t length, TelemetrySample* samples, size_t maxSamples);
+
+  uint16_t getLastSequence() const { return lastSequence; }
+  uint32_t getLastBootTime() const { return lastBootTime; }
+  unsigned long getFrameCount() const { return frameCount; }
+  unsigned long getLostFrames() const { return lostFrames; }
+  unsigned long getDuplicateFrames() const { return duplicateFrames; }
+
+private:
+  uint16_t lastSequence;
+  uint32_t lastBootTime;
+  bool hasSequence;
+  unsigned long frameCount;
+  unsigned long lostFrames;
+  unsigned long duplicateFrames;
+};
+
+// Sends a finished frame; returns false if the frame could not be queued
+typedef bool (*TelemetrySendFn)(const uint8_t* data, size_t length, void* context);
+
+// Collects samples into frames and hands each frame to the send function
+// when it is full or its oldest sample has waited maxLatency ms
+class TelemetryBatcher {
+public:
+  TelemetryBatcher();
+
+  void begin(uint32_t maxLatency, TelemetrySendFn send, void* context);
+
+  // Queue a sample (time in ms since boot); bootTime (Unix time at ms 0,
+  // 0 while unknown) stamps the frame so the receiver can date samples
+  void add(const TelemetrySample& sample, uint32_t bootTime);
+
+  // Send the pending frame if it has been held too long
+  void update(uint32_t currentTime);
+
+  // Send the pending frame now
+  bool flush();
+
+  unsigned long getFramesSent() const { return framesSent; }
+  unsigned long getSendFailures() const { return sendFailures; }
+  unsigned long getSamplesSent() const { return samplesSent; }
+  unsigned long getBytesSent() const { return bytesSent; }
+
+private:
+  TelemetryEncoder encoder;
+  TelemetrySendFn send;
+  void* context;
+  uint32_t maxLatency;
+  uint16_t sequence;
+  unsigned long framesSent;
+  unsigned long sendFailures;
+  unsigned long samplesSent;
+  unsigned long bytesSent;
+};
+
+#endif // TELEMETRY_CODEC_H
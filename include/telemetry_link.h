@@ -0,0 +1,93 @@
+#ifndef TELEMETRY_LINK_H
+#define TELEMETRY_LINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "edge_buffer.h"
+#include "telemetry_codec.h"
+
+// Reliable-ish delivery of telemetry frames over a transport that reports
+// each send through a completion callback (ESP-NOW's send callback says
+// whether the peer acknowledged the frame). At most TELEMETRY_SEND_WINDOW
+// frames are with the radio at a time; failed frames are retried until
+// their deadline, and when the queue backs up the oldest waiting frame
+// is dropped in favour of fresher data.
+
+#define TELEMETRY_SEND_WINDOW 1         // Frames handed to the radio awaiting their callback
+#define TELEMETRY_QUEUE_FRAMES 4        // Frames buffered while the link is backlogged
+#define TELEMETRY_COMPLETION_QUEUE 8    // Pending send results (must be a power of two)
+
+static_assert(TELEMETRY_SEND_WINDOW < TELEMETRY_QUEUE_FRAMES, "Send window must leave room to queue");
+
+// Something that can put a frame on the air
+class TelemetryTransport {
+public:
+  virtual ~TelemetryTransport() {}
+
+  // Start sending a frame; returns false if the radio did not accept it.
+  // The outcome must later be reported through TelemetryLink::onSendComplete().
+  virtual bool send(const uint8_t* data, size_t length) = 0;
+};
+
+class TelemetryLink {
+public:
+  TelemetryLink();
+
+  void begin(TelemetryTransport* transport, uint32_t retryDeadline);
+
+  // Queue a frame for sending (currentTime in ms starts its retry
+  // deadline); a full queue drops its oldest waiting frame
+  void submit(const uint8_t* data, size_t length, uint32_t currentTime);
+
+  // Give every queued frame a full retry deadline from now, and date the
+  // frames built before the clock synced with bootTime (0 if still
+  // unknown). Call when the transport comes up, so frames queued while it
+  // could not send are not expired before their first attempt.
+  void restartDeadlines(uint32_t currentTime, uint32_t bootTime);
+
+  // Send callback - may run on the radio task, so it only queues the result
+  void onSendComplete(bool delivered) { completions.push(delivered ? 1 : 0); }
+
+  // Apply send results, expire old frames and start new sends (loop only)
+  void update(uint32_t currentTime);
+
+  unsigned long getSentCount() const { return sentCount; }
+  unsigned long getAckedCount() const { return ackedCount; }
+  unsigned long getRetriedCount() const { return retriedCount; }
+  unsigned long getDroppedCount() const { return droppedCount; }
+  unsigned long getCoalescedCount() const { return coalescedCount; }
+  uint8_t getQueuedFrames() const { return count; }
+
+private:
+  enum FrameState : uint8_t {
+    FRAME_WAITING,
+    FRAME_IN_FLIGHT
+  };
+
+  struct Frame {
+    uint8_t data[TELEMETRY_MAX_FRAME_SIZE];
+    uint8_t length;
+    FrameState state;
+    uint8_t attempts;
+    uint32_t queuedAt;  // ms, for the retry deadline
+  };
+
+  Frame frames[TELEMETRY_QUEUE_FRAMES];
+  uint8_t order[TELEMETRY_QUEUE_FRAMES];  // Slot indices, oldest first
+  uint8_t count;
+  uint8_t inFlight;
+  EdgeBuffer<TELEMETRY_COMPLETION_QUEUE> completions;  // 1 = acked, 0 = failed
+
+  TelemetryTransport* transport;
+  uint32_t retryDeadline;
+
+  unsigned long sentCount;
+  unsigned long ackedCount;
+  unsigned long retriedCount;
+  unsigned long droppedCount;
+  unsigned long coalescedCount;
+
+  void remove(uint8_t position);
+};
+
+#endif // TELEMETRY_LINK_H
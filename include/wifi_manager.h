@@ -6,6 +6,8 @@
 #include <esp_now.h>
 #include <time.h>
 #include "secret.h"
+#include "telemetry_codec.h"
+#include "telemetry_link.h"
 
 // NTP settings
 #define NTP_SERVER "pool.ntp.org"
@@ -17,35 +19,59 @@
 #define ESPNOW_PMK "pmk1234567890123"
 #define ESPNOW_LMK "lmk1234567890123"
 
-// Message structure for ESP-NOW communication
-struct SensorData {
-    float wheelRPM;
-    float cadenceRPM;
-    uint8_t currentChainring;
-    uint8_t currentSprocket;
-    float currentGearRatio;
-    uint32_t timestamp;
+// Startup timeouts (ms) - measurement runs regardless of the outcome
+#define WIFI_CONNECT_TIMEOUT 10000
+#define NTP_SYNC_TIMEOUT 10000
+
+// Background startup steps, advanced by WiFiManager::update()
+enum WiFiState : uint8_t {
+    WIFI_STATE_IDLE,        // start() not called yet
+    WIFI_STATE_CONNECTING,  // Waiting for the access point
+    WIFI_STATE_SYNCING,     // Waiting for NTP
+    WIFI_STATE_READY,       // ESP-NOW running (time may or may not be valid)
+    WIFI_STATE_FAILED       // ESP-NOW could not be started
+};
+
+// ESP-NOW transport for telemetry frames
+class EspNowTransport : public TelemetryTransport {
+public:
+    void setPeer(const uint8_t* address) { memcpy(peerAddress, address, 6); }
+    bool send(const uint8_t* data, size_t length) override;
+
+private:
+    uint8_t peerAddress[6];
 };
 
 class WiFiManager {
 public:
     WiFiManager();
     
-    // Initialize Wi-Fi and time sync
-    bool begin();
+    // Start connecting in the background; returns immediately
+    void start();
+    
+    // Advance the startup state machine - call every loop() pass
+    void update(unsigned long currentTime);
     
-    // Sync time with NTP server
-    bool syncTime();
+    WiFiState getState() const { return state; }
     
     // Initialize ESP-NOW
     bool initESPNow();
     
-    // Send data via ESP-NOW
-    bool sendData(const SensorData& data);
+    // Queue a sample for the next batched telemetry frame
+    void sendSample(const TelemetrySample& sample);
+    
+    // Close stale frames, apply send results and start pending sends
+    void updateTelemetry(uint32_t currentTime);
+    
+    // Telemetry delivery statistics (sent/acked/retried/dropped)
+    const TelemetryLink& getTelemetryLink() const { return telemetryLink; }
     
     // Get current timestamp
     uint32_t getCurrentTimestamp() const;
     
+    // Unix time (s) at millis() == 0, or 0 until the clock has synced
+    uint32_t getBootTimestamp() const { return bootTimestamp; }
+    
     // Disconnect from Wi-Fi
     void disconnectWiFi();
     
@@ -56,12 +82,28 @@ private:
     // ESP-NOW callback
     static void onDataSent(const uint8_t* mac_addr, esp_now_send_status_t status);
     
+    // Batcher send function - queues one frame on the link
+    static bool queueFrame(const uint8_t* data, size_t length, void* context);
+    
+    // Batched telemetry frames and their delivery
+    TelemetryBatcher telemetry;
+    EspNowTransport espNowTransport;
+    TelemetryLink telemetryLink;
+    
     // ESP-NOW peer info
     esp_now_peer_info_t peerInfo;
     uint8_t controllerAddress[6];
     
+    // Move to a new startup step
+    void enterState(WiFiState newState, unsigned long currentTime);
+    
+    // Startup state
+    WiFiState state;
+    unsigned long stateSince;
+    
     // Time sync status
     bool timeValid;
+    uint32_t bootTimestamp;
     time_t lastSyncTime;
     
     // ESP-NOW interface
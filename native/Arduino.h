@@ -0,0 +1,116 @@
+#ifndef ARDUINO_SHIM_H
+#define ARDUINO_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// Minimal stand-in for the Arduino core, for the host build of the
+// portable sources ([env:native] in platformio.ini). Only what that code
+// and the native benchmark need is here: a clock the program controls,
+// String, a repeatable esp_random(), and a Serial that collects what is
+// printed instead of driving a UART. Nothing in it touches hardware, so it never defines ARDUINO;
+// code built against it sees ARDUINO_SHIM instead.
+
+#ifndef ARDUINO_SHIM
+#define ARDUINO_SHIM
+#endif
+
+// Clock - stands still until the program moves it
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);                // Advances the clock, returns at once
+void delayMicroseconds(unsigned int us);
+
+void shimSetMicros(uint64_t micros);
+void shimAdvanceMicros(uint64_t micros);
+
+// ESP32 hardware random number - a seeded sequence, the same every run
+uint32_t esp_random();
+void shimSeedRandom(uint32_t seed);
+
+// Arduino String on top of std::string
+class String {
+public:
+  String() {}
+  String(const char* text) : text(text != nullptr ? text : "") {}
+  String(const std::string& text) : text(text) {}
+  String(char c) : text(1, c) {}
+  String(int value) : text(std::to_string(value)) {}
+  String(unsigned int value) : text(std::to_string(value)) {}
+  String(long value) : text(std::to_string(value)) {}
+  String(unsigned long value) : text(std::to_string(value)) {}
+  String(float value, unsigned char decimals = 2);
+  String(double value, unsigned char decimals = 2);
+
+  const char* c_str() const { return text.c_str(); }
+  unsigned int length() const { return (unsigned int)text.size(); }
+  char operator[](unsigned int index) const { return index < text.size() ? text[index] : '\0'; }
+
+  String& operator+=(const String& other) { text += other.text; return *this; }
+  bool concat(const String& other) { text += other.text; return true; }
+  friend String operator+(String left, const String& right) { left += right; return left; }
+  bool operator==(const String& other) const { return text == other.text; }
+  bool operator!=(const String& other) const { return text != other.text; }
+
+  int indexOf(char c) const;
+  String substring(unsigned int from) const { return substring(from, length()); }
+  String substring(unsigned int from, unsigned int to) const;
+  long toInt() const { return strtol(text.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(text.c_str(), nullptr); }
+
+private:
+  std::string text;
+};
+
+// Serial - everything printed is appended to a buffer the program can
+// inspect and clear, and echoed to stdout unless that is turned off
+class HardwareSerial {
+public:
+  HardwareSerial() : echo(true), writeRoom(4096) {}
+
+  void begin(unsigned long baud) { (void)baud; }
+  operator bool() const { return true; }
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* data, size_t length);
+  int availableForWrite() { return writeRoom; }
+  void flush() {}
+
+  size_t print(const char* text);
+  size_t print(const String& text) { return print(text.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value) { return print(String(value)); }
+  size_t print(unsigned int value) { return print(String(value)); }
+  size_t print(long value) { return print(String(value)); }
+  size_t print(unsigned long value) { return print(String(value)); }
+  size_t print(double value, int decimals = 2) { return print(String(value, (unsigned char)decimals)); }
+
+  template <typename T>
+  size_t println(const T& value) { return print(value) + print("\r\n"); }
+  size_t println(double value, int decimals) { return print(value, decimals) + print("\r\n"); }
+  size_t println() { return print("\r\n"); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  // Sink control
+  const std::string& output() const { return captured; }
+  void clearOutput() { captured.clear(); }
+  void setEcho(bool echo) { this->echo = echo; }
+  void setAvailableForWrite(int room) { writeRoom = room; }  // Simulate a full transmit buffer
+
+private:
+  std::string captured;
+  bool echo;
+  int writeRoom;
+};
+
+typedef HardwareSerial Print;
+typedef HardwareSerial Stream;
+
+extern HardwareSerial Serial;
+
+#endif // ARDUINO_SHIM_H
@@ -0,0 +1,95 @@
+#ifndef SDFAT_SHIM_H
+#define SDFAT_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// Stand-in for the parts of SdFat the log sink uses, for host tests of
+// session log recovery. One simulated card holds every file in the root
+// directory; sectors are handed out lowest-free first, as FAT reuses freed
+// clusters, so a file re-created under the same name gets the sectors of
+// the old one back with their old contents. Writes go straight to the
+// card (no volume cache). A simulated power cut erases the sector being
+// written and fails every write and sync after it.
+
+#ifndef O_RDONLY
+#define O_RDONLY 0x00
+#define O_WRONLY 0x01
+#define O_RDWR 0x02
+#define O_CREAT 0x40
+#define O_TRUNC 0x200
+#endif
+#define FILE_WRITE (O_RDWR | O_CREAT)
+
+#define SHARED_SPI 0
+#define SD_SCK_MHZ(mhz) (1000000UL * (mhz))
+
+// Bus settings for SdFat::begin(); the simulated card ignores them
+struct SdSpiConfig {
+  SdSpiConfig(uint8_t csPin, uint8_t options, uint32_t maxSck) : csPin(csPin), options(options), maxSck(maxSck) {}
+  uint8_t csPin;
+  uint8_t options;
+  uint32_t maxSck;
+};
+
+#define SHIM_SD_SECTORS 16384  // 8 MB card
+#define SHIM_SD_NEVER 0xFFFFFFFFUL
+
+class SdCard {
+public:
+  bool readSector(uint32_t sector, uint8_t* dst);
+  bool writeSector(uint32_t sector, const uint8_t* src);
+};
+
+class FsFile {
+public:
+  FsFile() : entry(-1), position(0), directory(false), nextEntry(0) {}
+
+  explicit operator bool() const { return entry >= 0 || directory; }
+  bool isDir() const { return directory; }
+  size_t getName(char* name, size_t size) const;
+  bool openNext(FsFile* dir, int flags);
+  void close();
+
+  uint64_t fileSize() const;
+  bool seekSet(uint64_t position);
+  int read(void* data, size_t length);
+  size_t write(const void* data, size_t length);
+  bool sync();
+  bool truncate(uint64_t length);
+  bool preAllocate(uint64_t length);
+  bool contiguousRange(uint32_t* firstSector, uint32_t* lastSector);
+
+private:
+  friend class SdFat;
+  int entry;           // Index into the shim's file table, -1 if closed
+  uint64_t position;
+  bool directory;      // The root directory, for openNext()
+  int nextEntry;
+};
+
+class SdFat {
+public:
+  bool begin(SdSpiConfig config) { (void)config; return true; }
+  FsFile open(const char* path, int flags = O_RDONLY);
+  SdCard* card() { return &sdCard; }
+  uint8_t sdErrorCode() const { return 0; }
+  uint32_t sdErrorData() const { return 0; }
+
+private:
+  SdCard sdCard;
+};
+
+// Blank the card and forget every file
+void shimSdFormat();
+
+// Power cut during the given card write from now (1 = the next one, 0 =
+// right away): that sector is left erased, every later write and sync
+// fails. SHIM_SD_NEVER restores power.
+void shimSdPowerCutAfter(unsigned long writes);
+
+// Whole file contents, for comparing before and after (empty if missing)
+std::string shimSdFileContents(const char* name);
+
+#endif // SDFAT_SHIM_H
@@ -0,0 +1,51 @@
+#ifndef WIFI_SHIM_H
+#define WIFI_SHIM_H
+
+#include <Arduino.h>
+#include <time.h>
+
+// Stand-in for the ESP32 WiFi library and the SNTP calls of the Arduino
+// core, for host tests of WiFiManager. The access point and the time
+// server answer after delays the program scripts (SHIM_NEVER: not at
+// all), counted on the shim clock from WiFi.begin() and configTime().
+// The synced time itself is the host's time().
+
+#define SHIM_NEVER 0xFFFFFFFFUL
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1
+} wifi_mode_t;
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_CONNECTED = 3,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+class WiFiClass {
+public:
+  WiFiClass() : currentMode(WIFI_OFF), connecting(false), connectStart(0) {}
+
+  void mode(wifi_mode_t mode) { currentMode = mode; }
+  wifi_mode_t getMode() const { return currentMode; }
+  void begin(const char* ssid, const char* password);
+  wl_status_t status() const;
+  bool disconnect(bool wifiOff = false);
+
+private:
+  wifi_mode_t currentMode;
+  bool connecting;
+  unsigned long connectStart;
+};
+
+extern WiFiClass WiFi;
+
+void configTime(long gmtOffset, int daylightOffset, const char* server);
+bool getLocalTime(struct tm* info, uint32_t waitMs = 5000);  // Never waits
+
+// Script the next startup (ms after WiFi.begin() / configTime()) and
+// forget the previous one, including the ESP-NOW state
+void shimScriptWiFi(unsigned long connectAfter, unsigned long syncAfter);
+
+#endif // WIFI_SHIM_H
@@ -0,0 +1,96 @@
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Create the global instance
+HardwareSerial Serial;
+
+static uint64_t shimMicros = 0;
+static uint32_t shimRandom = 1;
+
+unsigned long millis() {
+  return (unsigned long)(uint32_t)(shimMicros / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)(uint32_t)shimMicros;
+}
+
+void delay(unsigned long ms) {
+  shimMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+  shimMicros += us;
+}
+
+void shimSetMicros(uint64_t micros) {
+  shimMicros = micros;
+}
+
+void shimAdvanceMicros(uint64_t micros) {
+  shimMicros += micros;
+}
+
+uint32_t esp_random() {
+  // xorshift32
+  shimRandom ^= shimRandom << 13;
+  shimRandom ^= shimRandom >> 17;
+  shimRandom ^= shimRandom << 5;
+  return shimRandom;
+}
+
+void shimSeedRandom(uint32_t seed) {
+  shimRandom = seed != 0 ? seed : 1;
+}
+
+String::String(float value, unsigned char decimals) : String((double)value, decimals) {
+}
+
+String::String(double value, unsigned char decimals) {
+  char buffer[48];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+  text = buffer;
+}
+
+int String::indexOf(char c) const {
+  size_t position = text.find(c);
+  return position == std::string::npos ? -1 : (int)position;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    unsigned int swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from >= text.size()) {
+    return String();
+  }
+  return String(text.substr(from, to - from));
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t length) {
+  captured.append((const char*)data, length);
+  if (echo) {
+    fwrite(data, 1, length, stdout);
+  }
+  return length;
+}
+
+size_t HardwareSerial::print(const char* text) {
+  return write((const uint8_t*)text, strlen(text));
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0) {
+    return 0;
+  }
+  return write((const uint8_t*)buffer, (size_t)length < sizeof(buffer) ? (size_t)length : sizeof(buffer) - 1);
+}
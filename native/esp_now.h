@@ -0,0 +1,47 @@
+#ifndef ESP_NOW_SHIM_H
+#define ESP_NOW_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Stand-in for ESP-NOW, for host tests of WiFiManager. esp_now_init()
+// fails unless WiFi is in station mode (or when the test says so), and
+// sent frames wait until the program delivers them, which fires the
+// registered send callback with the outcome it chooses.
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+#define ESP_NOW_MAX_DATA_LEN 250
+
+typedef enum {
+  ESP_NOW_SEND_SUCCESS = 0,
+  ESP_NOW_SEND_FAIL
+} esp_now_send_status_t;
+
+typedef struct {
+  uint8_t peer_addr[6];
+  uint8_t channel;
+  bool encrypt;
+} esp_now_peer_info_t;
+
+typedef int esp_now_handle_t;
+typedef void (*esp_now_send_cb_t)(const uint8_t* mac_addr, esp_now_send_status_t status);
+
+esp_err_t esp_now_init();
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t callback);
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer);
+esp_err_t esp_now_send(const uint8_t* peer_addr, const uint8_t* data, size_t length);
+
+// Make esp_now_init() fail until the next shimScriptWiFi()
+void shimFailEspNowInit();
+
+// Frames sent and not yet delivered
+size_t shimEspNowPending();
+
+// Take the oldest pending frame (data must hold ESP_NOW_MAX_DATA_LEN) and
+// report it as acked or not; false if nothing is pending
+bool shimEspNowDeliver(bool acked, uint8_t* data, size_t* length);
+
+#endif // ESP_NOW_SHIM_H
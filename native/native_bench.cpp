@@ -0,0 +1,179 @@
+// Host benchmark of the per-pass measurement calls, built by [env:native]
+// against the Arduino.h shim:
+//
+//   pio run -e native -t exec
+//
+// A steady simulated ride (14 wheel magnets around 280 RPM, one crank
+// magnet around 90 RPM) runs on the shim clock, and each call is timed
+// with the host's steady clock. Results go to Serial (stdout) as CSV, one
+// row per call, in ns/call; the timer row is the cost of reading the
+// clock twice, included in the rows timed one call at a time.
+//   processWheelTrigger   One wheel edge through the debounce and RPM maths
+//   calculateRPMs         One loop pass: drain the edge queues, estimate
+//                         the gear and update the fused cadence
+//   estimateCurrentGear   GearEstimator::estimate() on its own
+//   updateAverages        One reporting-interval average update
+//
+// Usage (built binary): program [--seconds <n>] [--loop-us <n>]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "rpm_calculator.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define WHEEL_PERIOD 15306         // 14 magnets at 280 RPM
+#define CRANK_PERIOD 666667        // 90 RPM
+#define AVERAGE_INTERVAL 1000      // ms between updateAverages() calls
+
+struct Timing {
+  unsigned long calls;
+  double nanoseconds;
+};
+
+static void report(const char* name, const Timing& timing) {
+  Serial.printf("%s,%lu,%.1f\n", name, timing.calls,
+                timing.calls > 0 ? timing.nanoseconds / timing.calls : 0.0);
+}
+
+static double since(Clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+static Timing benchTimer(unsigned long calls) {
+  Timing timing = {calls, 0.0};
+  for (unsigned long i = 0; i < calls; i++) {
+    Clock::time_point start = Clock::now();
+    timing.nanoseconds += since(start);
+  }
+  return timing;
+}
+
+// Edges straight into the engine, back to back
+static Timing benchWheelTrigger(unsigned long calls) {
+  static RPMCalculator calculator;
+  shimSetMicros(1000000);
+  calculator.begin(14, 1);
+
+  uint32_t edgeTime = micros();
+  Timing timing = {calls, 0.0};
+  Clock::time_point start = Clock::now();
+  for (unsigned long i = 0; i < calls; i++) {
+    edgeTime += WHEEL_PERIOD;
+    shimSetMicros(edgeTime);
+    calculator.processWheelTrigger(edgeTime);
+  }
+  timing.nanoseconds = since(start);
+
+  // RPM is published by the next pass; every edge must have been accepted
+  if (calculator.getWheelRejectedEdges() > 0 ||
+      calculator.getEngine().getLastInterval(calculator.getWheelChannel()) != WHEEL_PERIOD) {
+    Serial.println("Warning: wheel edges rejected");
+  }
+  return timing;
+}
+
+// A loop() pass every loopMicros: queue what the ISRs would have seen
+// (not timed), then calculateRPMs(), and updateAverages() once per
+// reporting interval
+static void benchLoop(uint32_t seconds, uint32_t loopMicros, Timing* passes, Timing* averages) {
+  static RPMCalculator calculator;
+  shimSetMicros(1000000);
+  calculator.begin(14, 1);
+  calculator.startNewSession();
+
+  uint64_t now = 1000000;
+  uint64_t end = now + (uint64_t)seconds * 1000000;
+  uint64_t nextWheel = now + WHEEL_PERIOD;
+  uint64_t nextCrank = now + CRANK_PERIOD / 3;
+  uint64_t nextAverage = now + AVERAGE_INTERVAL * 1000;
+  while (now < end) {
+    now += loopMicros;
+    shimSetMicros(now);
+    while (nextWheel <= now) {
+      calculator.recordWheelEdge((uint32_t)nextWheel);
+      nextWheel += WHEEL_PERIOD;
+    }
+    while (nextCrank <= now) {
+      calculator.recordCadenceEdge((uint32_t)nextCrank);
+      nextCrank += CRANK_PERIOD;
+    }
+
+    Clock::time_point start = Clock::now();
+    calculator.calculateRPMs();
+    passes->nanoseconds += since(start);
+    passes->calls++;
+
+    if (now >= nextAverage) {
+      start = Clock::now();
+      calculator.updateAverages();
+      averages->nanoseconds += since(start);
+      averages->calls++;
+      calculator.resetIntervalCounters();
+      nextAverage += AVERAGE_INTERVAL * 1000;
+    }
+  }
+
+  if (calculator.getCurrentChainring() == 0) {
+    Serial.println("Warning: no gear estimated");
+  }
+}
+
+// Measured ratios spread over the default 2x9 gears, some between two
+// cogs and some outside every gear
+static Timing benchGearEstimate(unsigned long calls) {
+  static RPMCalculator calculator;
+  shimSetMicros(1000000);
+  calculator.begin(14, 1);
+  GearEstimator& estimator = calculator.getGearEstimator(0);
+
+  const uint32_t cadenceMilliRPM = 90000;
+  uint32_t wheelMilliRPM[64];
+  for (uint8_t i = 0; i < 64; i++) {
+    wheelMilliRPM[i] = cadenceMilliRPM + i * 5000;  // Ratios 1.0 to 4.5
+  }
+
+  volatile uint32_t sink = 0;
+  Timing timing = {calls, 0.0};
+  Clock::time_point start = Clock::now();
+  for (unsigned long i = 0; i < calls; i++) {
+    estimator.estimate(wheelMilliRPM[i % 64], cadenceMilliRPM);
+    sink = sink + estimator.getCurrentGearRatioFixed();
+  }
+  timing.nanoseconds = since(start);
+  return timing;
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds = 600;
+  uint32_t loopMicros = 1000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+      loopMicros = strtoul(argv[++i], nullptr, 10);
+    } else {
+      Serial.printf("Usage: %s [--seconds <n>] [--loop-us <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (seconds == 0 || loopMicros == 0) {
+    Serial.println("Error: --seconds and --loop-us must be non-zero");
+    return 2;
+  }
+
+  Timing passes = {0, 0.0};
+  Timing averages = {0, 0.0};
+  benchLoop(seconds, loopMicros, &passes, &averages);
+
+  Serial.println("Function,Calls,ns/call");
+  report("timer", benchTimer(1000000));
+  report("processWheelTrigger", benchWheelTrigger(1000000));
+  report("calculateRPMs", passes);
+  report("estimateCurrentGear", benchGearEstimate(1000000));
+  report("updateAverages", averages);
+  return 0;
+}
@@ -0,0 +1,264 @@
+#include <SdFat.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define SHIM_SD_SECTOR_SIZE 512
+
+struct ShimFile {
+  std::string name;
+  std::vector<uint32_t> sectors;  // Card sector of each 512-byte block of the file
+  uint64_t size;
+};
+
+static std::vector<uint8_t> cardData(SHIM_SD_SECTORS * SHIM_SD_SECTOR_SIZE, 0xFF);
+static std::vector<bool> sectorUsed(SHIM_SD_SECTORS, false);
+static std::vector<ShimFile> files;
+static unsigned long writesUntilCut = SHIM_SD_NEVER;
+static bool powerLost = false;
+
+void shimSdFormat() {
+  std::fill(cardData.begin(), cardData.end(), 0xFF);
+  std::fill(sectorUsed.begin(), sectorUsed.end(), false);
+  files.clear();
+  shimSdPowerCutAfter(SHIM_SD_NEVER);
+}
+
+void shimSdPowerCutAfter(unsigned long writes) {
+  writesUntilCut = writes;
+  powerLost = writes == 0;
+}
+
+std::string shimSdFileContents(const char* name) {
+  for (size_t i = 0; i < files.size(); i++) {
+    if (files[i].name == name) {
+      std::string contents;
+      for (uint64_t offset = 0; offset < files[i].size; offset += SHIM_SD_SECTOR_SIZE) {
+        size_t length = files[i].size - offset < SHIM_SD_SECTOR_SIZE ? (size_t)(files[i].size - offset) : SHIM_SD_SECTOR_SIZE;
+        contents.append((const char*)&cardData[(size_t)files[i].sectors[offset / SHIM_SD_SECTOR_SIZE] * SHIM_SD_SECTOR_SIZE],
+                        length);
+      }
+      return contents;
+    }
+  }
+  return std::string();
+}
+
+bool SdCard::readSector(uint32_t sector, uint8_t* dst) {
+  if (sector >= SHIM_SD_SECTORS) {
+    return false;
+  }
+  memcpy(dst, &cardData[(size_t)sector * SHIM_SD_SECTOR_SIZE], SHIM_SD_SECTOR_SIZE);
+  return true;
+}
+
+bool SdCard::writeSector(uint32_t sector, const uint8_t* src) {
+  if (sector >= SHIM_SD_SECTORS || powerLost) {
+    return false;
+  }
+  uint8_t* target = &cardData[(size_t)sector * SHIM_SD_SECTOR_SIZE];
+  if (writesUntilCut != SHIM_SD_NEVER && --writesUntilCut == 0) {
+    // Power went while the card was programming this sector
+    memset(target, 0xFF, SHIM_SD_SECTOR_SIZE);
+    powerLost = true;
+    return false;
+  }
+  memcpy(target, src, SHIM_SD_SECTOR_SIZE);
+  return true;
+}
+
+// Lowest free sector, or -1 when the card is full
+static int64_t allocateSector() {
+  for (uint32_t i = 0; i < SHIM_SD_SECTORS; i++) {
+    if (!sectorUsed[i]) {
+      sectorUsed[i] = true;
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void releaseSectors(ShimFile& file, size_t keep) {
+  for (size_t i = keep; i < file.sectors.size(); i++) {
+    sectorUsed[file.sectors[i]] = false;
+  }
+  file.sectors.resize(keep);
+}
+
+FsFile SdFat::open(const char* path, int flags) {
+  FsFile file;
+  if (path[0] == '/') {
+    path++;
+  }
+  if (path[0] == '\0') {
+    file.directory = true;
+    return file;
+  }
+
+  for (size_t i = 0; i < files.size(); i++) {
+    if (files[i].name == path) {
+      if (flags & O_TRUNC) {
+        releaseSectors(files[i], 0);
+        files[i].size = 0;
+      }
+      file.entry = (int)i;
+      return file;
+    }
+  }
+  if (flags & O_CREAT) {
+    ShimFile created;
+    created.name = path;
+    created.size = 0;
+    files.push_back(created);
+    file.entry = (int)files.size() - 1;
+  }
+  return file;
+}
+
+size_t FsFile::getName(char* name, size_t size) const {
+  if (entry < 0 || size == 0) {
+    return 0;
+  }
+  size_t length = files[entry].name.copy(name, size - 1);
+  name[length] = '\0';
+  return length;
+}
+
+bool FsFile::openNext(FsFile* dir, int flags) {
+  (void)flags;
+  if (!dir->directory || dir->nextEntry >= (int)files.size()) {
+    return false;
+  }
+  *this = FsFile();
+  entry = dir->nextEntry++;
+  return true;
+}
+
+void FsFile::close() {
+  entry = -1;
+  directory = false;
+  position = 0;
+}
+
+uint64_t FsFile::fileSize() const {
+  return entry >= 0 ? files[entry].size : 0;
+}
+
+bool FsFile::seekSet(uint64_t position) {
+  // Like SdFat, not past the end of the file
+  if (entry < 0 || position > files[entry].size) {
+    return false;
+  }
+  this->position = position;
+  return true;
+}
+
+int FsFile::read(void* data, size_t length) {
+  if (entry < 0) {
+    return -1;
+  }
+  const ShimFile& file = files[entry];
+  size_t done = 0;
+  while (done < length && position < file.size) {
+    size_t offset = (size_t)(position % SHIM_SD_SECTOR_SIZE);
+    size_t chunk = SHIM_SD_SECTOR_SIZE - offset;
+    if (chunk > length - done) chunk = length - done;
+    if (chunk > file.size - position) chunk = (size_t)(file.size - position);
+    memcpy((uint8_t*)data + done,
+           &cardData[(size_t)file.sectors[position / SHIM_SD_SECTOR_SIZE] * SHIM_SD_SECTOR_SIZE + offset], chunk);
+    done += chunk;
+    position += chunk;
+  }
+  return (int)done;
+}
+
+size_t FsFile::write(const void* data, size_t length) {
+  if (entry < 0) {
+    return 0;
+  }
+  ShimFile& file = files[entry];
+  size_t done = 0;
+  while (done < length) {
+    size_t block = (size_t)(position / SHIM_SD_SECTOR_SIZE);
+    while (file.sectors.size() <= block) {
+      int64_t sector = allocateSector();
+      if (sector < 0) {
+        return done;
+      }
+      file.sectors.push_back((uint32_t)sector);
+    }
+
+    // Read-modify-write of one card sector
+    uint8_t buffer[SHIM_SD_SECTOR_SIZE];
+    SdCard card;
+    size_t offset = (size_t)(position % SHIM_SD_SECTOR_SIZE);
+    size_t chunk = SHIM_SD_SECTOR_SIZE - offset;
+    if (chunk > length - done) chunk = length - done;
+    card.readSector(file.sectors[block], buffer);
+    memcpy(buffer + offset, (const uint8_t*)data + done, chunk);
+    if (!card.writeSector(file.sectors[block], buffer)) {
+      return done;
+    }
+    done += chunk;
+    position += chunk;
+    if (position > file.size) {
+      file.size = position;
+    }
+  }
+  return done;
+}
+
+bool FsFile::sync() {
+  return entry >= 0 && !powerLost;
+}
+
+bool FsFile::truncate(uint64_t length) {
+  if (entry < 0 || length > files[entry].size || powerLost) {
+    return false;
+  }
+  ShimFile& file = files[entry];
+  releaseSectors(file, (size_t)((length + SHIM_SD_SECTOR_SIZE - 1) / SHIM_SD_SECTOR_SIZE));
+  file.size = length;
+  if (position > length) {
+    position = length;
+  }
+  return true;
+}
+
+bool FsFile::preAllocate(uint64_t length) {
+  if (entry < 0 || files[entry].size != 0 || !files[entry].sectors.empty()) {
+    return false;
+  }
+
+  // First run of free sectors long enough; the data is whatever was there
+  uint32_t count = (uint32_t)((length + SHIM_SD_SECTOR_SIZE - 1) / SHIM_SD_SECTOR_SIZE);
+  uint32_t run = 0;
+  for (uint32_t i = 0; i < SHIM_SD_SECTORS; i++) {
+    run = sectorUsed[i] ? 0 : run + 1;
+    if (run == count) {
+      for (uint32_t s = i + 1 - count; s <= i; s++) {
+        sectorUsed[s] = true;
+        files[entry].sectors.push_back(s);
+      }
+      files[entry].size = length;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FsFile::contiguousRange(uint32_t* firstSector, uint32_t* lastSector) {
+  if (entry < 0 || files[entry].sectors.empty()) {
+    return false;
+  }
+  const std::vector<uint32_t>& sectors = files[entry].sectors;
+  for (size_t i = 1; i < sectors.size(); i++) {
+    if (sectors[i] != sectors[0] + i) {
+      return false;
+    }
+  }
+  *firstSector = sectors.front();
+  *lastSector = sectors.back();
+  return true;
+}
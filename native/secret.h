@@ -0,0 +1,8 @@
+#ifndef SECRET_H
+#define SECRET_H
+
+// Placeholder credentials for the host build - the Wi-Fi shim ignores them
+#define WIFI_SSID "native"
+#define WIFI_PASSWORD "native"
+
+#endif // SECRET_H
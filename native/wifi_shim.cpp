@@ -0,0 +1,125 @@
+#include <WiFi.h>
+#include <esp_now.h>
+#include <string.h>
+#include <deque>
+#include <string>
+
+// Create the global instance
+WiFiClass WiFi;
+
+static unsigned long connectAfter = SHIM_NEVER;
+static unsigned long syncAfter = SHIM_NEVER;
+static bool syncStarted = false;
+static unsigned long syncStart = 0;
+
+static bool espNowFailInit = false;
+static bool espNowRunning = false;
+static esp_now_send_cb_t espNowCallback = nullptr;
+static std::deque<std::string> espNowPending;
+
+static bool elapsed(unsigned long start, unsigned long after) {
+  return after != SHIM_NEVER && millis() - start >= after;
+}
+
+void WiFiClass::begin(const char* ssid, const char* password) {
+  (void)ssid;
+  (void)password;
+  connecting = true;
+  connectStart = millis();
+}
+
+wl_status_t WiFiClass::status() const {
+  if (!connecting) {
+    return WL_DISCONNECTED;
+  }
+  return elapsed(connectStart, connectAfter) ? WL_CONNECTED : WL_IDLE_STATUS;
+}
+
+bool WiFiClass::disconnect(bool wifiOff) {
+  connecting = false;
+  if (wifiOff) {
+    currentMode = WIFI_OFF;
+    espNowRunning = false;  // ESP-NOW goes down with the radio
+  }
+  return true;
+}
+
+void configTime(long gmtOffset, int daylightOffset, const char* server) {
+  (void)gmtOffset;
+  (void)daylightOffset;
+  (void)server;
+  syncStarted = true;
+  syncStart = millis();
+}
+
+bool getLocalTime(struct tm* info, uint32_t waitMs) {
+  (void)waitMs;
+  if (!syncStarted || !elapsed(syncStart, syncAfter)) {
+    return false;
+  }
+  time_t now = time(nullptr);
+  localtime_r(&now, info);
+  return true;
+}
+
+void shimScriptWiFi(unsigned long connectAfterMs, unsigned long syncAfterMs) {
+  WiFi = WiFiClass();
+  connectAfter = connectAfterMs;
+  syncAfter = syncAfterMs;
+  syncStarted = false;
+  espNowFailInit = false;
+  espNowRunning = false;
+  espNowCallback = nullptr;
+  espNowPending.clear();
+}
+
+esp_err_t esp_now_init() {
+  if (espNowFailInit || WiFi.getMode() != WIFI_STA) {
+    return ESP_FAIL;
+  }
+  espNowRunning = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t callback) {
+  espNowCallback = callback;
+  return espNowRunning ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer) {
+  (void)peer;
+  return espNowRunning ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_now_send(const uint8_t* peer_addr, const uint8_t* data, size_t length) {
+  (void)peer_addr;
+  if (!espNowRunning || length > ESP_NOW_MAX_DATA_LEN) {
+    return ESP_FAIL;
+  }
+  espNowPending.push_back(std::string((const char*)data, length));
+  return ESP_OK;
+}
+
+void shimFailEspNowInit() {
+  espNowFailInit = true;
+}
+
+size_t shimEspNowPending() {
+  return espNowPending.size();
+}
+
+bool shimEspNowDeliver(bool acked, uint8_t* data, size_t* length) {
+  if (espNowPending.empty()) {
+    return false;
+  }
+  const std::string& frame = espNowPending.front();
+  memcpy(data, frame.data(), frame.size());
+  *length = frame.size();
+  espNowPending.pop_front();
+
+  static const uint8_t peer[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  if (espNowCallback) {
+    espNowCallback(peer, acked ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+  }
+  return true;
+}
@@ -0,0 +1,132 @@
+#include "cadence_fusion.h"
+#include "clock.h"
+
+CadenceFusion::CadenceFusion() :
+  gearRatio(0),
+  trackedRatio(0),
+  predictedMilliRPM(0),
+  predictedSum(0),
+  predictedTime(0),
+  lastUpdateTime(0),
+  lastCrankEdge(0),
+  crankInterval(0),
+  crankMilliRPM(0),
+  confirmations(0),
+  agreeingEdges(0),
+  disagreeingEdges(0)
+{
+}
+
+void CadenceFusion::clear() {
+  gearRatio = 0;
+  trackedRatio = 0;
+  predictedMilliRPM = 0;
+  predictedSum = 0;
+  predictedTime = 0;
+  confirmations = 0;
+}
+
+void CadenceFusion::update(const GearEstimator& gear, uint32_t wheelMilliRPM, uint32_t cadenceMilliRPM,
+                           uint32_t crankEdgeTime, uint32_t crankInterval) {
+  // Every crank edge is checked once; edges seen while there is nothing
+  // to check them against are skipped
+  bool newCrankEdge = crankEdgeTime != lastCrankEdge;
+  lastCrankEdge = crankEdgeTime;
+
+  uint16_t ratio = gear.getCurrentGearRatioFixed();
+  if (ratio == 0 || wheelMilliRPM == 0 || cadenceMilliRPM == 0 || crankInterval == 0) {
+    clear();
+    return;
+  }
+
+  // A lock starts from a gear the estimator has settled on, at its nominal
+  // ratio. Once locked the crank edges decide: the estimator compares the
+  // current wheel with a crank reading a revolution old, so it sees
+  // passing shifts while the rider accelerates hard.
+  if (confirmations < FUSION_CONFIRM_EDGES) {
+    if (gear.getTimeUntilShift() != UINT32_MAX) {
+      clear();
+      return;
+    }
+    if (ratio != gearRatio) {
+      clear();
+      gearRatio = ratio;
+      trackedRatio = (uint32_t)ratio << FUSION_RATIO_SHIFT;
+    }
+  }
+
+  // The previous prediction held until now; the current wheel reading
+  // already covers part of this pass, so it is counted from here on
+  uint32_t currentTime = clockMicros();
+  if (predictedMilliRPM > 0) {
+    predictedSum += (uint64_t)predictedMilliRPM * (currentTime - lastUpdateTime);
+    predictedTime += currentTime - lastUpdateTime;
+  }
+  lastUpdateTime = currentTime;
+
+  if (newCrankEdge) {
+    this->crankInterval = crankInterval;
+    crankMilliRPM = cadenceMilliRPM;
+    checkCrankEdge(cadenceMilliRPM);
+  }
+
+  predictedMilliRPM = (uint32_t)((((uint64_t)wheelMilliRPM * GEAR_RATIO_SCALE) << FUSION_RATIO_SHIFT) / trackedRatio);
+}
+
+void CadenceFusion::checkCrankEdge(uint32_t cadenceMilliRPM) {
+  // The crank reading covers its last revolution, so compare it with the
+  // wheel-derived cadence over that revolution
+  uint32_t expected = predictedTime > 0 ? (uint32_t)(predictedSum / predictedTime) : predictedMilliRPM;
+  predictedSum = 0;
+  predictedTime = 0;
+  if (expected == 0) {
+    return;  // Nothing predicted yet in this gear
+  }
+
+  // A crank edge far from the wheel-derived cadence means the rider
+  // shifted or stopped pedalling - stop trusting the wheel until the
+  // crank agrees again
+  uint32_t difference = cadenceMilliRPM > expected ? cadenceMilliRPM - expected : expected - cadenceMilliRPM;
+  if ((uint64_t)difference * 100 > (uint64_t)expected * FUSION_TOLERANCE) {
+    if (confirmations >= FUSION_CONFIRM_EDGES) {
+      disagreeingEdges++;
+    }
+    confirmations = 0;
+    return;
+  }
+
+  // Move the tracked ratio part of the way towards the ratio this edge
+  // measured, which absorbs tooth count rounding and any steady offset
+  // between the sensors
+  uint32_t measured = (uint32_t)(((uint64_t)trackedRatio * expected) / cadenceMilliRPM);
+  trackedRatio += (int32_t)(measured - trackedRatio) / (1 << FUSION_GAIN_SHIFT);
+
+  if (confirmations < FUSION_CONFIRM_EDGES) {
+    confirmations++;
+  } else {
+    agreeingEdges++;
+  }
+}
+
+bool CadenceFusion::isLocked() const {
+  if (gearRatio == 0 || confirmations < FUSION_CONFIRM_EDGES) {
+    return false;
+  }
+
+  // Freewheeling: the wheel still turns but the next crank edge is overdue
+  // at the cadence the wheel implies (interval x RPM is constant per edge)
+  uint32_t elapsed = clockMicros() - lastCrankEdge;
+  return (uint64_t)elapsed * predictedMilliRPM * 100 <=
+         (uint64_t)crankInterval * crankMilliRPM * FUSION_OVERDUE_PERCENT;
+}
+
+uint32_t CadenceFusion::getCadenceMilliRPM() const {
+  if (!isLocked()) {
+    return 0;
+  }
+
+  // Interval x RPM is the same for every crank edge
+  uint32_t elapsed = clockMicros() - lastCrankEdge;
+  uint64_t bound = elapsed > 0 ? (uint64_t)crankInterval * crankMilliRPM / elapsed : UINT32_MAX;
+  return bound < predictedMilliRPM ? (uint32_t)bound : predictedMilliRPM;
+}
@@ -0,0 +1,15 @@
+// On the board, or on the host against the Arduino.h shim (native/)
+#if defined(ARDUINO) || defined(ARDUINO_SHIM)
+
+#include <Arduino.h>
+#include "clock.h"
+
+uint32_t clockMillis() {
+  return millis();
+}
+
+uint32_t clockMicros() {
+  return micros();
+}
+
+#endif // ARDUINO || ARDUINO_SHIM
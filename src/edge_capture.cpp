@@ -0,0 +1,195 @@
+#include "edge_capture.h"
+#include <stddef.h>
+
+// Create the global instance
+EdgeCapture edgeCapture;
+
+EdgeCapture::EdgeCapture() :
+    writer(nullptr),
+    syncInterval(0),
+    active(false),
+    includeRejected(false),
+    current(-1),
+    nextBuffer(0),
+    sectorLength(0),
+    sectorEdges(0),
+    sectorSequence(0),
+    sectorStartTime(0),
+    captureId(0),
+    pendingDrops(0),
+    capturedCount(0),
+    droppedCount(0)
+{
+    for (uint8_t i = 0; i < EDGE_CAPTURE_BUFFERS; i++) {
+        busy[i].store(false, std::memory_order_relaxed);
+    }
+    lastEdgeTime[CHANNEL_WHEEL] = 0;
+    lastEdgeTime[CHANNEL_CADENCE] = 0;
+}
+
+void EdgeCapture::begin(LogWriter* writer, unsigned long syncInterval) {
+    this->writer = writer;
+    this->syncInterval = syncInterval;
+}
+
+bool EdgeCapture::start(const char* fileName, uint32_t startTimestamp, uint32_t startMillis, uint32_t bootTimestamp,
+                        uint8_t wheelMagnets, uint8_t crankMagnets, bool includeRejected) {
+    if (writer == nullptr || active) {
+        return false;
+    }
+
+    this->includeRejected = includeRejected;
+    captureId = esp_random();
+    sectorSequence = 0;
+    pendingDrops = 0;
+    capturedCount = 0;
+    droppedCount = 0;
+    uint32_t startMicros = micros();
+    lastEdgeTime[CHANNEL_WHEEL] = startMicros;
+    lastEdgeTime[CHANNEL_CADENCE] = startMicros;
+
+    // The header goes out through the same buffers as the edge sectors
+    int8_t index = claimBuffer();
+    if (index < 0 || !writer->openCapture(fileName)) {
+        if (index >= 0) {
+            busy[index].store(false, std::memory_order_relaxed);
+        }
+        return false;
+    }
+
+    EdgeCaptureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EDGE_CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = EDGE_CAPTURE_VERSION;
+    header.wheelMagnets = wheelMagnets;
+    header.crankMagnets = crankMagnets;
+    header.includesRejected = includeRejected ? 1 : 0;
+    header.startTimestamp = startTimestamp;
+    header.startMillis = startMillis;
+    header.bootTimestamp = bootTimestamp;
+    header.startMicros = startMicros;
+    header.captureId = captureId;
+
+    uint8_t* sector = buffers[index];
+    memset(sector, 0, SESSION_LOG_SECTOR_SIZE);
+    memcpy(sector, &header, sizeof(header));
+    if (!writer->writeCaptureSector(sector, 0, &busy[index])) {
+        busy[index].store(false, std::memory_order_relaxed);
+        writer->closeCapture();
+        return false;
+    }
+
+    current = -1;
+    active = true;
+    return true;
+}
+
+void EdgeCapture::record(SensorChannel channel, uint32_t edgeTime, bool accepted) {
+    if (!active || (!accepted && !includeRejected)) {
+        return;
+    }
+
+    uint8_t encoded[EDGE_CAPTURE_MAX_RECORD];
+    size_t length = edgeCaptureEncode(encoded, edgeTime - lastEdgeTime[channel], channel, !accepted);
+
+    // Full sector - send it and continue in a fresh one
+    if (current >= 0 && sectorLength + length > EDGE_CAPTURE_SECTOR_DATA) {
+        submitSector();
+    }
+
+    if (current < 0 && !startSector()) {
+        // The next sector's base times skip over the lost edges
+        lastEdgeTime[channel] = edgeTime;
+        pendingDrops++;
+        droppedCount++;
+        return;
+    }
+
+    memcpy(buffers[current] + sizeof(EdgeCaptureSectorHeader) + sectorLength, encoded, length);
+    sectorLength += length;
+    sectorEdges++;
+    lastEdgeTime[channel] = edgeTime;
+    capturedCount++;
+}
+
+void EdgeCapture::update(unsigned long currentTime) {
+    if (active && current >= 0 && sectorLength > 0 && currentTime - sectorStartTime >= syncInterval) {
+        submitSector();
+    }
+}
+
+void EdgeCapture::stop() {
+    if (!active) {
+        return;
+    }
+
+    if (current >= 0) {
+        if (sectorLength > 0) {
+            submitSector();
+        } else {
+            busy[current].store(false, std::memory_order_relaxed);
+            current = -1;
+        }
+    }
+    writer->closeCapture();
+    active = false;
+}
+
+int8_t EdgeCapture::claimBuffer() {
+    for (uint8_t i = 0; i < EDGE_CAPTURE_BUFFERS; i++) {
+        uint8_t index = (nextBuffer + i) % EDGE_CAPTURE_BUFFERS;
+        if (!busy[index].load(std::memory_order_acquire)) {
+            busy[index].store(true, std::memory_order_relaxed);
+            nextBuffer = (index + 1) % EDGE_CAPTURE_BUFFERS;
+            return index;
+        }
+    }
+    return -1;
+}
+
+bool EdgeCapture::startSector() {
+    current = claimBuffer();
+    if (current < 0) {
+        return false;
+    }
+
+    // Bases are the edges before this sector, so it decodes on its own
+    EdgeCaptureSectorHeader header;
+    header.magic = EDGE_CAPTURE_SECTOR_MAGIC;
+    header.length = 0;
+    header.sequence = sectorSequence;
+    header.wheelBase = lastEdgeTime[CHANNEL_WHEEL];
+    header.cadenceBase = lastEdgeTime[CHANNEL_CADENCE];
+    header.droppedEdges = pendingDrops;
+    header.captureId = captureId;
+    memset(buffers[current], 0, SESSION_LOG_SECTOR_SIZE);
+    memcpy(buffers[current], &header, sizeof(header));
+
+    pendingDrops = 0;
+    sectorLength = 0;
+    sectorEdges = 0;
+    sectorStartTime = millis();
+    return true;
+}
+
+void EdgeCapture::submitSector() {
+    uint8_t* sector = buffers[current];
+    uint16_t length = (uint16_t)sectorLength;
+    memcpy(sector + offsetof(EdgeCaptureSectorHeader, length), &length, sizeof(length));
+
+    // Data sectors follow the header sector. A full queue loses the whole
+    // sector, but not its place in the file: its edges (and the drops it
+    // reported) go into the next sector's drop count, so the file stays
+    // contiguous and the base times keep later edges exact.
+    if (writer->writeCaptureSector(sector, sectorSequence + 1, &busy[current])) {
+        sectorSequence++;
+    } else {
+        uint32_t reportedDrops;
+        memcpy(&reportedDrops, sector + offsetof(EdgeCaptureSectorHeader, droppedEdges), sizeof(reportedDrops));
+        busy[current].store(false, std::memory_order_relaxed);
+        pendingDrops += reportedDrops + sectorEdges;
+        capturedCount -= sectorEdges;
+        droppedCount += sectorEdges;
+    }
+    current = -1;
+}
@@ -0,0 +1,97 @@
+#include "event_loop.h"
+
+// Create the global instance
+EventLoop eventLoop;
+
+EventLoop::EventLoop() :
+  wakeDelay(UINT32_MAX),
+  notifiedWakes(0),
+  timerWakes(0),
+  busyTime(0),
+  idleTime(0),
+  passStart(0)
+#ifdef ARDUINO
+  , task(nullptr)
+#endif
+{
+}
+
+void EventLoop::wakeIn(uint32_t timeout) {
+  if (timeout < wakeDelay) {
+    wakeDelay = timeout;
+  }
+}
+
+void EventLoop::wakeAt(uint32_t dueTime) {
+  uint32_t currentTime = clockMicros();
+  uint32_t currentMillis = clockMillis();
+  if ((int32_t)(dueTime - currentMillis) <= 0) {
+    wakeIn(0);
+    return;
+  }
+
+  // Micros until the millisecond clock reads dueTime (both clocks wrap
+  // consistently modulo 2^32)
+  uint32_t subMillis = currentTime - currentMillis * 1000;
+  if (subMillis >= 1000) {
+    subMillis = 0;  // The millisecond ticked between the two reads
+  }
+  wakeIn((dueTime - currentMillis) * 1000 - subMillis);
+}
+
+#ifdef ARDUINO
+
+#if EVENT_LOOP_LIGHT_SLEEP
+#include <esp_pm.h>
+#endif
+
+bool EventLoop::begin() {
+  task = xTaskGetCurrentTaskHandle();
+  passStart = clockMicros();
+
+#if EVENT_LOOP_LIGHT_SLEEP
+#if CONFIG_PM_ENABLE
+  // Keep the CPU clock; the idle task light-sleeps whenever nothing is
+  // due before the next tick
+  esp_pm_config_esp32_t config = {};
+  config.max_freq_mhz = getCpuFrequencyMhz();
+  config.min_freq_mhz = getCpuFrequencyMhz();
+  config.light_sleep_enable = true;
+  return esp_pm_configure(&config) == ESP_OK;
+#else
+  return false;  // Framework built without CONFIG_PM_ENABLE
+#endif
+#else
+  return true;
+#endif
+}
+
+void EventLoop::wait() {
+  uint32_t waitStart = clockMicros();
+  busyTime += waitStart - passStart;
+
+  // Rounded up to whole ticks; a wake a little early just runs an idle pass
+  const uint32_t tickMicros = portTICK_PERIOD_MS * 1000UL;
+  TickType_t ticks = wakeDelay == UINT32_MAX ? portMAX_DELAY : (wakeDelay + tickMicros - 1) / tickMicros;
+  bool notified = ulTaskNotifyTake(pdTRUE, ticks) > 0;
+
+  passStart = clockMicros();
+  idleTime += passStart - waitStart;
+  if (notified) {
+    notifiedWakes++;
+  } else {
+    timerWakes++;
+  }
+  clearDeadlines();
+}
+
+void IRAM_ATTR EventLoop::notifyFromISR() {
+  if (task == nullptr) {
+    return;
+  }
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(task, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+#endif // ARDUINO
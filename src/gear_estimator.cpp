@@ -0,0 +1,157 @@
+#include "gear_estimator.h"
+#include "clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+GearEstimator::GearEstimator() :
+  chainringCount(0),
+  sprocketCount(0),
+  currentChainring(0),
+  currentSprocket(0),
+  currentGearRatio(0),
+  gearsConfigured(false),
+  gearCount(0),
+  currentGearIndex(-1),
+  pendingGearIndex(-1),
+  pendingGearSince(0)
+{
+}
+
+void GearEstimator::configure(uint8_t chainringCount, const uint8_t* chainringTeeth,
+                              uint8_t sprocketCount, const uint8_t* sprocketTeeth) {
+  // Safety checks
+  if (chainringCount > MAX_CHAINRINGS || sprocketCount > MAX_SPROCKETS) {
+    return;
+  }
+
+  // Precompute the ratio table once so estimation needs no divides
+  GearEntry table[MAX_GEARS];
+  uint8_t count = buildGearTable(chainringTeeth, chainringCount, sprocketTeeth, sprocketCount, table);
+  load(chainringCount, chainringTeeth, sprocketCount, sprocketTeeth, table, count);
+}
+
+void GearEstimator::load(uint8_t chainringCount, const uint8_t* chainringTeeth,
+                         uint8_t sprocketCount, const uint8_t* sprocketTeeth,
+                         const GearEntry* table, uint8_t count) {
+  // Copy chainring teeth counts
+  this->chainringCount = chainringCount;
+  for (uint8_t i = 0; i < chainringCount; i++) {
+    this->chainringTeeth[i] = chainringTeeth[i];
+  }
+
+  // Copy sprocket teeth counts
+  this->sprocketCount = sprocketCount;
+  for (uint8_t i = 0; i < sprocketCount; i++) {
+    this->sprocketTeeth[i] = sprocketTeeth[i];
+  }
+
+  gearCount = count;
+  for (uint8_t i = 0; i < count; i++) {
+    gearTable[i] = table[i];
+  }
+
+  // Mark as configured
+  gearsConfigured = gearCount > 0;
+
+  // Reset current gear estimates
+  clear();
+}
+
+uint8_t GearEstimator::findClosestGear(uint16_t ratio) const {
+  // Binary search for the first entry with a ratio >= the measured one
+  uint8_t low = 0;
+  uint8_t high = gearCount;
+  while (low < high) {
+    uint8_t mid = (low + high) / 2;
+    if (gearTable[mid].ratio < ratio) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  // The closest entry is either that one or its lower neighbour
+  if (low == gearCount) {
+    return gearCount - 1;
+  }
+  if (low > 0 && ratio - gearTable[low - 1].ratio < gearTable[low].ratio - ratio) {
+    return low - 1;
+  }
+  return low;
+}
+
+void GearEstimator::clear() {
+  currentChainring = 0;
+  currentSprocket = 0;
+  currentGearRatio = 0;
+  currentGearIndex = -1;
+  pendingGearIndex = -1;
+}
+
+void GearEstimator::estimate(uint32_t wheelMilliRPM, uint32_t cadenceMilliRPM) {
+  // Only estimate if wheels and cranks are moving
+  if (!gearsConfigured || wheelMilliRPM < GEAR_MIN_MILLI_RPM || cadenceMilliRPM < GEAR_MIN_MILLI_RPM) {
+    clear();
+    return;
+  }
+
+  // Calculate the current gear ratio from RPM values
+  uint32_t measured = (uint32_t)(((uint64_t)wheelMilliRPM * GEAR_RATIO_SCALE) / cadenceMilliRPM);
+  uint16_t measuredRatio = measured > 0xFFFF ? 0xFFFF : (uint16_t)measured;
+
+  // Find the closest matching theoretical gear ratio
+  uint8_t candidate = findClosestGear(measuredRatio);
+  uint32_t candidateError = abs((int32_t)gearTable[candidate].ratio - measuredRatio);
+
+  // Only consider it if confident (within 20% error)
+  if (candidateError * 100 >= (uint32_t)measuredRatio * GEAR_MATCH_TOLERANCE || candidate == currentGearIndex) {
+    pendingGearIndex = -1;
+    return;
+  }
+
+  // Hysteresis - a different gear must be clearly closer than the current one
+  if (currentGearIndex >= 0) {
+    uint32_t currentError = abs((int32_t)gearTable[currentGearIndex].ratio - measuredRatio);
+    if (candidateError * 100 > currentError * (100 - GEAR_HYSTERESIS)) {
+      pendingGearIndex = -1;
+      return;
+    }
+  }
+
+  // Dwell time - the new gear must persist before it is reported
+  unsigned long currentTime = clockMillis();
+  if (pendingGearIndex != candidate) {
+    pendingGearIndex = candidate;
+    pendingGearSince = currentTime;
+  }
+  if (currentGearIndex >= 0 && currentTime - pendingGearSince < GEAR_SHIFT_DWELL) {
+    return;
+  }
+
+  currentGearIndex = candidate;
+  pendingGearIndex = -1;
+  currentChainring = gearTable[candidate].chainring;
+  currentSprocket = gearTable[candidate].sprocket;
+  currentGearRatio = gearTable[candidate].ratio;
+}
+
+uint32_t GearEstimator::getTimeUntilShift() const {
+  if (pendingGearIndex < 0 || currentGearIndex < 0) {
+    return UINT32_MAX;
+  }
+  unsigned long elapsed = clockMillis() - pendingGearSince;
+  return elapsed >= GEAR_SHIFT_DWELL ? 0 : GEAR_SHIFT_DWELL - elapsed;
+}
+
+void GearEstimator::getGearDescription(char* buffer, size_t size) const {
+  if (!gearsConfigured || currentChainring == 0 || currentSprocket == 0) {
+    snprintf(buffer, size, "Unknown Gear");
+    return;
+  }
+
+  uint8_t frontTeeth = chainringTeeth[currentChainring - 1];
+  uint8_t rearTeeth = sprocketTeeth[currentSprocket - 1];
+
+  snprintf(buffer, size, "%d/%d (%.1f:1)",
+           frontTeeth, rearTeeth, getCurrentGearRatio());
+}
@@ -0,0 +1,105 @@
+#include "instrumentation.h"
+
+#ifdef ENABLE_INSTRUMENTATION
+
+// Create the global instance
+Instrumentation instrumentation;
+
+const char* Instrumentation::getCounterName(StatCounter counter) {
+  switch (counter) {
+    case STAT_LOOP_PASSES: return "loop_passes";
+    case STAT_TELEMETRY_SAMPLES: return "telemetry_samples";
+    default: return "?";
+  }
+}
+
+const char* Instrumentation::getHistogramName(StatHistogram histogram) {
+  switch (histogram) {
+    case HIST_LOOP_PERIOD: return "loop_period";
+    case HIST_LOG_DATA: return "log_data";
+    case HIST_SD_SECTOR: return "sd_sector";
+    case HIST_SD_FLUSH: return "sd_flush";
+    case HIST_EDGE_DELAY: return "edge_delay";
+    default: return "?";
+  }
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "rpm_calculator.h"
+#include "log_writer.h"
+#include "wifi_manager.h"
+#include "sensor_input.h"
+#include "event_loop.h"
+
+void printStatsReport(Print& out) {
+  out.printf("Stats after %lu ms\n", (unsigned long)millis());
+
+  for (uint8_t i = 0; i < STAT_COUNTER_COUNT; i++) {
+    out.printf("  %-18s %lu\n", Instrumentation::getCounterName((StatCounter)i),
+               (unsigned long)instrumentation.getCounter((StatCounter)i));
+  }
+
+  // Counters the modules keep themselves
+  uint64_t isrMicros = sensorInput.getHandlerCycles() / getCpuFrequencyMhz();
+  out.printf("  %-18s %lu interrupts, %lu edges (%s), %.3f%% CPU in handlers\n", "sensor_input",
+             (unsigned long)sensorInput.getInterruptCount(), (unsigned long)sensorInput.getEdgeCount(),
+             SensorInput::getBackendName(), millis() > 0 ? isrMicros * 0.1 / millis() : 0.0);
+  uint64_t loopTime = eventLoop.getBusyTime() + eventLoop.getIdleTime();
+  out.printf("  %-18s %lu wakes (%lu sensor, %lu timer), %.2f%% busy\n", "event_loop",
+             (unsigned long)eventLoop.getWakeCount(), (unsigned long)eventLoop.getNotifiedWakes(),
+             (unsigned long)eventLoop.getTimerWakes(),
+             loopTime > 0 ? eventLoop.getBusyTime() * 100.0 / loopTime : 0.0);
+  out.printf("  %-18s %lu / %lu\n", "edge_overflows",
+             (unsigned long)rpmCalculator.getWheelEdgeOverflows(),
+             (unsigned long)rpmCalculator.getCadenceEdgeOverflows());
+  out.printf("  %-18s %lu / %lu\n", "edges_rejected",
+             rpmCalculator.getWheelRejectedEdges(), rpmCalculator.getCadenceRejectedEdges());
+  out.printf("  %-18s %lu written, %lu dropped, %lu errors\n", "log_rows",
+             logWriter.getWrittenCount(), logWriter.getDroppedCount(), logWriter.getWriteErrorCount());
+  const TelemetryLink& link = wifiManager.getTelemetryLink();
+  out.printf("  %-18s %lu sent, %lu acked, %lu retried, %lu dropped\n", "espnow_frames",
+             link.getSentCount(), link.getAckedCount(), link.getRetriedCount(), link.getDroppedCount());
+
+  // Histograms: count, p50/p99/max, then the non-empty buckets
+  for (uint8_t h = 0; h < STAT_HISTOGRAM_COUNT; h++) {
+    const LatencyHistogram& histogram = instrumentation.getHistogram((StatHistogram)h);
+    out.printf("  %-18s n=%lu p50<%luus p99<%luus max=%luus\n",
+               Instrumentation::getHistogramName((StatHistogram)h),
+               (unsigned long)histogram.getCount(), (unsigned long)histogram.percentile(50),
+               (unsigned long)histogram.percentile(99), (unsigned long)histogram.getMax());
+    for (uint8_t i = 0; i < STAT_HISTOGRAM_BUCKETS; i++) {
+      if (histogram.getBucket(i) > 0) {
+        out.printf("    <%-8lu %lu\n", 2UL << i, (unsigned long)histogram.getBucket(i));
+      }
+    }
+  }
+}
+
+void printStatsPacket(Print& out) {
+  // #STATS,millis,<counters...>,<overflows>,<rejected>,<log drops>,<espnow drops>,
+  // <sensor interrupts>,<sensor edges>,<sensor handler us>,<sensor wakes>,<timer wakes>,
+  // <loop busy ms>, then p50,p99,max per histogram
+  out.printf("#STATS,%lu", (unsigned long)millis());
+  for (uint8_t i = 0; i < STAT_COUNTER_COUNT; i++) {
+    out.printf(",%lu", (unsigned long)instrumentation.getCounter((StatCounter)i));
+  }
+  out.printf(",%lu,%lu,%lu,%lu",
+             (unsigned long)(rpmCalculator.getWheelEdgeOverflows() + rpmCalculator.getCadenceEdgeOverflows()),
+             rpmCalculator.getWheelRejectedEdges() + rpmCalculator.getCadenceRejectedEdges(),
+             logWriter.getDroppedCount(), wifiManager.getTelemetryLink().getDroppedCount());
+  out.printf(",%lu,%lu,%lu", (unsigned long)sensorInput.getInterruptCount(),
+             (unsigned long)sensorInput.getEdgeCount(),
+             (unsigned long)(sensorInput.getHandlerCycles() / getCpuFrequencyMhz()));
+  out.printf(",%lu,%lu,%lu", (unsigned long)eventLoop.getNotifiedWakes(),
+             (unsigned long)eventLoop.getTimerWakes(), (unsigned long)(eventLoop.getBusyTime() / 1000));
+  for (uint8_t h = 0; h < STAT_HISTOGRAM_COUNT; h++) {
+    const LatencyHistogram& histogram = instrumentation.getHistogram((StatHistogram)h);
+    out.printf(",%lu,%lu,%lu", (unsigned long)histogram.percentile(50),
+               (unsigned long)histogram.percentile(99), (unsigned long)histogram.getMax());
+  }
+  out.print("\n");
+}
+#endif // ARDUINO
+
+#endif // ENABLE_INSTRUMENTATION
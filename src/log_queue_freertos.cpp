@@ -0,0 +1,76 @@
+#include "log_queue.h"
+
+#ifdef ARDUINO
+
+LogQueue::LogQueue() :
+    handle(nullptr)
+{
+}
+
+LogQueue::~LogQueue() {
+    if (handle != nullptr) {
+        vQueueDelete(handle);
+    }
+}
+
+bool LogQueue::begin(uint8_t length, size_t messageSize) {
+    handle = xQueueCreate(length, messageSize);
+    return handle != nullptr;
+}
+
+bool LogQueue::isReady() const {
+    return handle != nullptr;
+}
+
+bool LogQueue::send(const void* message, unsigned long timeoutMs) {
+    return xQueueSend(handle, message, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+bool LogQueue::receive(void* message, unsigned long timeoutMs) {
+    return xQueueReceive(handle, message, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+LogTask::LogTask() :
+    handle(nullptr),
+    done(nullptr),
+    entry(nullptr),
+    param(nullptr)
+{
+}
+
+bool LogTask::start(const char* name, Entry entry, void* param) {
+    this->entry = entry;
+    this->param = param;
+    done = xSemaphoreCreateBinary();
+    if (done == nullptr) {
+        return false;
+    }
+    if (xTaskCreatePinnedToCore(taskEntry, name, LOG_WRITER_STACK_SIZE, this,
+                                LOG_WRITER_PRIORITY, &handle, LOG_WRITER_CORE) != pdPASS) {
+        vSemaphoreDelete(done);
+        done = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void LogTask::join() {
+    if (done == nullptr) {
+        return;
+    }
+    xSemaphoreTake(done, portMAX_DELAY);
+    vSemaphoreDelete(done);
+    done = nullptr;
+    handle = nullptr;
+}
+
+void LogTask::taskEntry(void* task) {
+    LogTask* self = static_cast<LogTask*>(task);
+    self->entry(self->param);
+
+    // A FreeRTOS task must not return
+    xSemaphoreGive(self->done);
+    vTaskDelete(nullptr);
+}
+
+#endif // ARDUINO
@@ -0,0 +1,77 @@
+#include "log_queue.h"
+
+#ifndef ARDUINO
+
+#include <chrono>
+#include <string.h>
+
+LogQueue::LogQueue() :
+    messageSize(0),
+    length(0),
+    first(0),
+    count(0)
+{
+}
+
+LogQueue::~LogQueue() {
+}
+
+bool LogQueue::begin(uint8_t length, size_t messageSize) {
+    if (length == 0 || messageSize == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    storage.assign((size_t)length * messageSize, 0);
+    this->length = length;
+    this->messageSize = messageSize;
+    first = 0;
+    count = 0;
+    return true;
+}
+
+bool LogQueue::isReady() const {
+    return length > 0;
+}
+
+bool LogQueue::send(const void* message, unsigned long timeoutMs) {
+    std::unique_lock<std::mutex> guard(lock);
+    if (count == length &&
+        !notFull.wait_for(guard, std::chrono::milliseconds(timeoutMs), [this] { return count < length; })) {
+        return false;
+    }
+    memcpy(&storage[((first + count) % length) * messageSize], message, messageSize);
+    count++;
+    guard.unlock();
+    notEmpty.notify_one();
+    return true;
+}
+
+bool LogQueue::receive(void* message, unsigned long timeoutMs) {
+    std::unique_lock<std::mutex> guard(lock);
+    if (!notEmpty.wait_for(guard, std::chrono::milliseconds(timeoutMs), [this] { return count > 0; })) {
+        return false;
+    }
+    memcpy(message, &storage[first * messageSize], messageSize);
+    first = (uint8_t)((first + 1) % length);
+    count--;
+    guard.unlock();
+    notFull.notify_one();
+    return true;
+}
+
+LogTask::LogTask() {
+}
+
+bool LogTask::start(const char* name, Entry entry, void* param) {
+    (void)name;
+    thread = std::thread(entry, param);
+    return true;
+}
+
+void LogTask::join() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+#endif // ARDUINO
@@ -0,0 +1,258 @@
+#include "log_writer.h"
+#include "clock.h"
+#include <string.h>
+
+// Create the global instance
+LogWriter logWriter;
+
+LogWriter::LogWriter() :
+    sink(nullptr),
+    running(false),
+    syncInterval(0),
+    lastCaptureSync(0),
+    storageState(STORAGE_STARTING),
+    sessionOpen(false),
+    droppedCount(0),
+    writtenCount(0),
+    writeErrorCount(0)
+{
+}
+
+bool LogWriter::begin(LogSink* sink, uint8_t queueLength, unsigned long syncInterval) {
+    this->sink = sink;
+    this->syncInterval = syncInterval;
+    storageState = STORAGE_STARTING;
+
+    if (!queue.begin(queueLength, sizeof(Message))) {
+        return false;
+    }
+    running = task.start("logWriter", taskEntry, this);
+    return running;
+}
+
+void LogWriter::end() {
+    if (!running) {
+        return;
+    }
+
+    // The only message that waits for room - everything before it is handled
+    Message message;
+    message.type = MSG_STOP;
+    while (!queue.send(&message, 1000)) {
+    }
+    task.join();
+    running = false;
+}
+
+bool LogWriter::openSession(const char* fileName, uint32_t startTimestamp, uint32_t startMillis,
+                            uint32_t bootTimestamp, uint8_t wheelMagnets, uint8_t crankMagnets) {
+    if (!running) {
+        return false;
+    }
+
+    Message message;
+    message.type = MSG_OPEN;
+    strncpy(message.open.fileName, fileName, LOG_FILE_NAME_LENGTH - 1);
+    message.open.fileName[LOG_FILE_NAME_LENGTH - 1] = '\0';
+    message.open.startTimestamp = startTimestamp;
+    message.open.startMillis = startMillis;
+    message.open.bootTimestamp = bootTimestamp;
+    message.open.wheelMagnets = wheelMagnets;
+    message.open.crankMagnets = crankMagnets;
+
+    return sendControl(message);
+}
+
+bool LogWriter::enqueue(const SessionLogRecord& record) {
+    if (!running) {
+        return false;
+    }
+
+    Message message;
+    message.type = MSG_RECORD;
+    message.record = record;
+
+    // Never wait - a full queue means the card is stalled, so drop the row
+    if (!queue.send(&message, 0)) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool LogWriter::setBootTimestamp(uint32_t bootTimestamp) {
+    if (!running) {
+        return false;
+    }
+
+    Message message;
+    message.type = MSG_SET_CLOCK;
+    message.bootTimestamp = bootTimestamp;
+    return sendControl(message);
+}
+
+bool LogWriter::closeSession() {
+    if (!running) {
+        return false;
+    }
+
+    Message message;
+    message.type = MSG_CLOSE;
+    return sendControl(message);
+}
+
+bool LogWriter::openCapture(const char* fileName) {
+    if (!running) {
+        return false;
+    }
+
+    Message message;
+    message.type = MSG_CAPTURE_OPEN;
+    strncpy(message.captureOpen.fileName, fileName, LOG_FILE_NAME_LENGTH - 1);
+    message.captureOpen.fileName[LOG_FILE_NAME_LENGTH - 1] = '\0';
+    return sendControl(message);
+}
+
+bool LogWriter::writeCaptureSector(const uint8_t* data, uint32_t index, std::atomic<bool>* release) {
+    if (!running) {
+        return false;
+    }
+
+    Message message;
+    message.type = MSG_CAPTURE_SECTOR;
+    message.captureSector.data = data;
+    message.captureSector.index = index;
+    message.captureSector.release = release;
+
+    // Same policy as rows - the caller keeps (and counts) what cannot be queued
+    return queue.send(&message, 0);
+}
+
+bool LogWriter::closeCapture() {
+    if (!running) {
+        return false;
+    }
+
+    Message message;
+    message.type = MSG_CAPTURE_CLOSE;
+    return sendControl(message);
+}
+
+bool LogWriter::sendControl(const Message& message) {
+    // Worth a short wait: losing an open or close would misfile every row after it
+    return queue.send(&message, LOG_CONTROL_TIMEOUT);
+}
+
+void LogWriter::taskEntry(void* param) {
+    static_cast<LogWriter*>(param)->run();
+}
+
+void LogWriter::run() {
+    Message message;
+
+    // Sessions opened meanwhile wait in the queue
+    if (sink->mount()) {
+        writeErrorCount = writeErrorCount + sink->recoverSessions();
+        storageState = STORAGE_READY;
+    } else {
+        storageState = STORAGE_FAILED;
+    }
+
+    for (;;) {
+        if (queue.receive(&message, syncInterval)) {
+            if (message.type == MSG_STOP) {
+                break;
+            }
+            handleMessage(message);
+        } else {
+            // No rows for a whole durability window - push out the partial sector
+            countError(sink->flush());
+        }
+    }
+
+    sink->closeCapture();
+    sink->closeSession();
+    sessionOpen = false;
+}
+
+void LogWriter::countError(bool ok) {
+    if (!ok) {
+        writeErrorCount = writeErrorCount + 1;
+    }
+}
+
+void LogWriter::handleMessage(const Message& message) {
+    switch (message.type) {
+        case MSG_OPEN: {
+            LogSessionInfo info = {
+                message.open.fileName,
+                message.open.startTimestamp,
+                message.open.startMillis,
+                message.open.bootTimestamp,
+                message.open.wheelMagnets,
+                message.open.crankMagnets
+            };
+            bool opened = sink->openSession(info);
+            countError(opened);
+            sessionOpen = opened;
+            break;
+        }
+
+        case MSG_RECORD:
+            if (!sink->isSessionOpen()) {
+                droppedCount.fetch_add(1, std::memory_order_relaxed);  // The open failed
+                break;
+            }
+            if (sink->appendRecord(message.record, clockMillis())) {
+                writtenCount = writtenCount + 1;
+            } else {
+                writeErrorCount = writeErrorCount + 1;
+            }
+            break;
+
+        case MSG_SET_CLOCK:
+            countError(sink->setBootTimestamp(message.bootTimestamp));
+            break;
+
+        case MSG_CLOSE:
+            sink->closeSession();
+            sessionOpen = false;
+            break;
+
+        default:
+            handleCaptureMessage(message);
+            break;
+    }
+}
+
+void LogWriter::handleCaptureMessage(const Message& message) {
+    switch (message.type) {
+        case MSG_CAPTURE_OPEN:
+            countError(sink->openCapture(message.captureOpen.fileName));
+            lastCaptureSync = clockMillis();
+            break;
+
+        case MSG_CAPTURE_SECTOR: {
+            // Sectors may arrive after a failed open - always hand the buffer back
+            bool written = sink->writeCaptureSector(message.captureSector.index, message.captureSector.data);
+            message.captureSector.release->store(false, std::memory_order_release);
+            if (!written) {
+                writeErrorCount = writeErrorCount + 1;
+                break;
+            }
+
+            if (clockMillis() - lastCaptureSync >= syncInterval) {
+                countError(sink->syncCapture());
+                lastCaptureSync = clockMillis();
+            }
+            break;
+        }
+
+        case MSG_CAPTURE_CLOSE:
+            sink->closeCapture();
+            break;
+
+        default:
+            break;
+    }
+}
@@ -3,16 +3,39 @@
 #include <SPI.h>
 #include <SdFat.h>
 #include "rpm_calculator.h"
+#include "fixed_rpm_calculator.h"
 #include "wifi_manager.h"
+#include "log_writer.h"
+#include "sd_log_sink.h"
+#include "session_record.h"
+#include "instrumentation.h"
+#include "serial_stream.h"
+#include "edge_capture.h"
+#include "sensor_input.h"
+#include "event_loop.h"
+#include "spacing_store.h"
 
 // Time tracking
 unsigned long lastOutputTime = 0;
 unsigned long lastLoggingTime = 0;
+unsigned long lastTelemetryTime = 0;
+unsigned long lastStreamTime = 0;
+
+// Startup metrics (ms since boot)
+unsigned long sensorsAttachedTime = 0;
+unsigned long firstSampleTime = 0;
+
+#ifdef ENABLE_INSTRUMENTATION
+unsigned long lastStatsTime = 0;
+#endif
 unsigned long sessionStartTime = 0;
 
 // Session state
 bool isSessionActive = false;
+bool sessionLogging = false;  // The writer task took the request to open a log file
 bool sdCardAvailable = false;
+bool sdCardReported = false;  // Outcome of the background SD bring-up printed
+bool sessionClockKnown = false;  // Log header has the boot time
 
 // Activity detection thresholds
 #define ACTIVITY_TIMEOUT 5000  // 5 seconds without activity before stopping logging
@@ -20,27 +43,40 @@ bool sdCardAvailable = false;
 
 // Gear configuration for this specific bike (2 chainrings, 9 sprockets)
 // These values should be updated with actual tooth counts
-const uint8_t CHAINRING_COUNT = 2;
-const uint8_t CHAINRINGS[CHAINRING_COUNT] = {50, 34}; // Common road bike chainrings (front)
+constexpr uint8_t CHAINRING_COUNT = 2;
+constexpr uint8_t CHAINRINGS[CHAINRING_COUNT] = {50, 34}; // Common road bike chainrings (front)
+
+constexpr uint8_t SPROCKET_COUNT = 9;
+constexpr uint8_t SPROCKETS[SPROCKET_COUNT] = {11, 12, 13, 15, 17, 19, 21, 24, 28}; // Common 9-speed cassette (rear)
+
+// Sensor channels and the bikes they form
+constexpr SensorChannelConfig SENSOR_CHANNEL_CONFIG[] = SENSOR_CHANNELS;
+constexpr uint8_t SENSOR_CHANNEL_COUNT = sizeof(SENSOR_CHANNEL_CONFIG) / sizeof(SENSOR_CHANNEL_CONFIG[0]);
+constexpr BikeConfig SENSOR_BIKE_CONFIG[] = SENSOR_BIKES;
+constexpr uint8_t SENSOR_BIKE_COUNT = sizeof(SENSOR_BIKE_CONFIG) / sizeof(SENSOR_BIKE_CONFIG[0]);
 
-const uint8_t SPROCKET_COUNT = 9;
-const uint8_t SPROCKETS[SPROCKET_COUNT] = {11, 12, 13, 15, 17, 19, 21, 24, 28}; // Common 9-speed cassette (rear)
+// Compile-time layout of this bike for FixedRPMCalculator
+struct TrainerConfig {
+  static constexpr const SensorChannelConfig* channels = SENSOR_CHANNEL_CONFIG;
+  static constexpr uint8_t channelCount = SENSOR_CHANNEL_COUNT;
+  static constexpr const BikeConfig* bikes = SENSOR_BIKE_CONFIG;
+  static constexpr uint8_t bikeCount = SENSOR_BIKE_COUNT;
+  static constexpr uint8_t chainringCount = CHAINRING_COUNT;
+  static constexpr const uint8_t* chainrings = CHAINRINGS;
+  static constexpr uint8_t sprocketCount = SPROCKET_COUNT;
+  static constexpr const uint8_t* sprockets = SPROCKETS;
+};
 
 // Create the objects
+#if FIXED_SENSOR_CONFIG
+FixedRPMCalculator<TrainerConfig> calculator;
+#else
+RPMCalculator calculator;
+#endif
+RPMCalculator& rpmCalculator = calculator;
 SdFat SD;
-FsFile logFile;
 String logFileName = "";
 
-// ISR for wheel sensor - keep as simple as possible
-void IRAM_ATTR wheelPulseCounter() {
-  rpmCalculator.processWheelTrigger();
-}
-
-// ISR for cadence sensor - keep as simple as possible
-void IRAM_ATTR cadencePulseCounter() {
-  rpmCalculator.processCadenceTrigger();
-}
-
 // Create a new log file
 bool createLogFile() {
   if (!sdCardAvailable) {
@@ -56,20 +92,28 @@ bool createLogFile() {
   }
   logFileName = String(LOG_FILE_PREFIX) + String(currentTime) + String(LOG_FILE_EXTENSION);
   
-  // Open the file for writing
-  logFile = SD.open(logFileName.c_str(), FILE_WRITE);
-  
-  if (!logFile) {
+  // The writer task opens the file and writes the header in the background
+  if (!logWriter.openSession(logFileName.c_str(), currentTime, millis(), wifiManager.getBootTimestamp(),
+                             WHEEL_MAGNETS, CRANK_MAGNETS)) {
     Serial.println("Error: Could not create log file!");
     return false;
   }
   
-  // Write header row with session averages and gear info
-  logFile.println("Timestamp,ElapsedTime(ms),WheelRPM,CadenceRPM,SessionAvgWheelRPM,SessionAvgCadenceRPM,Chainring,Sprocket,GearRatio");
-  logFile.flush();
-  
   Serial.print("Log file created: ");
   Serial.println(logFileName);
+  
+  // Raw edges go to a companion file with the same name
+  if (EDGE_CAPTURE_ENABLED) {
+    String captureFileName = String(LOG_FILE_PREFIX) + String(currentTime) + String(CAPTURE_FILE_EXTENSION);
+    if (edgeCapture.start(captureFileName.c_str(), currentTime, millis(), wifiManager.getBootTimestamp(),
+                          WHEEL_MAGNETS / WHEEL_EDGE_DIVIDER, CRANK_MAGNETS / CADENCE_EDGE_DIVIDER,
+                          EDGE_CAPTURE_REJECTED)) {
+      Serial.print("Capture file created: ");
+      Serial.println(captureFileName);
+    } else {
+      Serial.println("Error: Could not create capture file!");
+    }
+  }
   return true;
 }
 
@@ -81,11 +125,13 @@ void startSession() {
   
   // Reset session averages in the calculator
   rpmCalculator.startNewSession();
+  sessionClockKnown = wifiManager.isTimeValid();
   
   // If SD card is available, create a log file
   if (sdCardAvailable) {
     if (createLogFile()) {
       isSessionActive = true;
+      sessionLogging = true;
       sessionStartTime = millis();
       Serial.println("Session automatically started with logging!");
     } else {
@@ -105,73 +151,252 @@ void startSession() {
 // Log data to the file
 void logData(float wheelRPM, float cadenceRPM) {
   if (!isSessionActive || !sdCardAvailable) return;
+  STAT_TIMER_START(logStart);
   
   unsigned long currentTime = millis();
   unsigned long elapsedTime = currentTime - sessionStartTime;
   
-  // Try to write data if possible
-  if (logFile) {
-    // Get current timestamp
-    uint32_t timestamp = wifiManager.getCurrentTimestamp();
-    if (timestamp == 0) {
-      timestamp = currentTime; // Fallback to millis() if time sync failed
-    }
-    
-    // Write data to log file with session averages and gear info
-    logFile.print(timestamp);
-    logFile.print(",");
-    logFile.print(elapsedTime);
-    logFile.print(",");
-    logFile.print(wheelRPM, 1);
-    logFile.print(",");
-    logFile.print(cadenceRPM, 1);
-    logFile.print(",");
-    logFile.print(rpmCalculator.getSessionAvgWheelRPM(), 1);
-    logFile.print(",");
-    logFile.print(rpmCalculator.getSessionAvgCadenceRPM(), 1);
-    logFile.print(",");
-    logFile.print(rpmCalculator.getCurrentChainring());
-    logFile.print(",");
-    logFile.print(rpmCalculator.getCurrentSprocket());
-    logFile.print(",");
-    logFile.println(rpmCalculator.getCurrentGearRatio(), 2);
-    
-    // Flush data to SD card frequently to minimize data loss on power failure
-    logFile.flush();
+  // Get current timestamp
+  uint32_t timestamp = wifiManager.getCurrentTimestamp();
+  if (timestamp == 0) {
+    timestamp = currentTime; // Fallback to millis() if time sync failed
+  }
+  
+  // Pack the row with session averages and gear info
+  SessionLogRecord record = makeSessionLogRecord(rpmCalculator, timestamp, elapsedTime, wheelRPM, cadenceRPM);
+  
+  // Handed to the writer task; dropped (and counted) if the card is
+  // stalled or the file could not be created
+  if (sessionLogging) {
+    logWriter.enqueue(record);
+  }
+  STAT_TIMER_STOP(HIST_LOG_DATA, logStart);
+}
+
+// Queue a telemetry sample; samples are batched into ESP-NOW frames
+void sendTelemetry(unsigned long currentTime) {
+  TelemetrySample sample;
+  sample.time = currentTime;
+  sample.wheelRPM = sessionLogFixed(rpmCalculator.getAverageWheelRPM(AVERAGE_ESPNOW), SESSION_LOG_RPM_SCALE);
+  sample.cadenceRPM = sessionLogFixed(rpmCalculator.getAverageCadenceRPM(AVERAGE_ESPNOW), SESSION_LOG_RPM_SCALE);
+  sample.chainring = rpmCalculator.getCurrentChainring();
+  sample.sprocket = rpmCalculator.getCurrentSprocket();
+  sample.gearRatio = sessionLogFixed(rpmCalculator.getCurrentGearRatio(), SESSION_LOG_RATIO_SCALE);
+  
+  wifiManager.sendSample(sample);
+  STAT_COUNT(STAT_TELEMETRY_SAMPLES);
+}
+
+// Print the current averages, drop counters and gear on one line
+void printStatusLine() {
+  // Print session averages if active
+  if (isSessionActive) {
+    Serial.print("Session Avg - Wheel RPM: ");
+    Serial.print(rpmCalculator.getSessionAvgWheelRPM(), 1);
+    Serial.print(" | Cadence: ");
+    Serial.print(rpmCalculator.getSessionAvgCadenceRPM(), 1);
+    Serial.print(" RPM | ");
+  }
+  
+  // Output current values to serial
+  Serial.print("Current - Wheel RPM: ");
+  Serial.print(rpmCalculator.getAverageWheelRPM(AVERAGE_SERIAL), 1);
+  Serial.print(" | Cadence: ");
+  Serial.print(rpmCalculator.getAverageCadenceRPM(AVERAGE_SERIAL), 1);
+  Serial.print(" RPM");
+  
+  // Report rows lost because the SD card could not keep up
+  if (logWriter.getDroppedCount() > 0) {
+    Serial.print(" | Log drops: ");
+    Serial.print(logWriter.getDroppedCount());
+  }
+  if (edgeCapture.getDroppedCount() > 0) {
+    Serial.print(" | Capture drops: ");
+    Serial.print(edgeCapture.getDroppedCount());
+  }
+  
+  // Report telemetry frames that could not be delivered in time
+  if (wifiManager.getTelemetryLink().getDroppedCount() > 0) {
+    Serial.print(" | Telemetry drops: ");
+    Serial.print(wifiManager.getTelemetryLink().getDroppedCount());
+  }
+  
+  // Print current gear if available
+  if (rpmCalculator.getCurrentChainring() > 0 && rpmCalculator.getCurrentSprocket() > 0) {
+    Serial.print(" | Chainring ");
+    Serial.print(rpmCalculator.getCurrentChainring());
+    Serial.print(" (");
+    Serial.print(CHAINRINGS[rpmCalculator.getCurrentChainring() - 1]);
+    Serial.print(") : Sprocket ");
+    Serial.print(rpmCalculator.getCurrentSprocket());
+    Serial.print(" (");
+    Serial.print(SPROCKETS[rpmCalculator.getCurrentSprocket() - 1]);
+    Serial.print(")");
+  }
+  
+  Serial.println();
+}
+
+// Send one binary sample record (SERIAL_MODE_SAMPLES / SERIAL_MODE_EDGES)
+void streamSample(unsigned long currentTime) {
+  SerialSampleRecord sample;
+  sample.time = currentTime;
+  sample.wheelMilliRPM = rpmCalculator.getDecayedWheelMilliRPM();
+  sample.cadenceMilliRPM = rpmCalculator.getFusedCadenceMilliRPM();
+  sample.smoothedWheelMilliRPM = rpmCalculator.getDecayedSmoothedWheelMilliRPM();
+  sample.smoothedCadenceMilliRPM = rpmCalculator.getDecayedSmoothedCadenceMilliRPM();
+  sample.chainring = rpmCalculator.getCurrentChainring();
+  sample.sprocket = rpmCalculator.getCurrentSprocket();
+  sample.gearRatio = rpmCalculator.getCurrentGearRatioFixed();
+  
+  serialStream.sendSample(sample);
+}
+
+// Raw edges go straight to the binary stream and the capture file as they are processed
+void onSensorEdge(uint8_t channel, uint32_t edgeTime, bool accepted, void* context) {
+  static_cast<SerialStream*>(context)->sendEdge(channel, edgeTime);
+
+  // Captures hold the primary bike's wheel and crank
+  if (channel == rpmCalculator.getWheelChannel()) {
+    edgeCapture.record(CHANNEL_WHEEL, edgeTime, accepted);
+  } else if (channel == rpmCalculator.getCadenceChannel()) {
+    edgeCapture.record(CHANNEL_CADENCE, edgeTime, accepted);
+  }
+}
+
+// Single-character commands from the serial monitor
+void handleSerialCommand() {
+  if (Serial.available() <= 0) {
+    return;
+  }
+  
+  switch (Serial.read()) {
+    case SERIAL_TEXT_COMMAND:
+      serialStream.setMode(SERIAL_MODE_TEXT);
+      break;
+    case SERIAL_SAMPLES_COMMAND:
+      serialStream.setMode(SERIAL_MODE_SAMPLES);
+      break;
+    case SERIAL_EDGES_COMMAND:
+      serialStream.setMode(SERIAL_MODE_EDGES);
+      break;
+    case SPACING_FORGET_COMMAND:
+      spacingStore.clear();
+      for (uint8_t ch = 0; ch < rpmCalculator.getEngine().getChannelCount(); ch++) {
+        rpmCalculator.getEngine().getSpacing(ch).forget();
+      }
+      if (!serialStream.isBinary()) {
+        Serial.println("Magnet spacing forgotten, relearning");
+      }
+      break;
+#ifdef ENABLE_INSTRUMENTATION
+    case STATS_COMMAND:
+      printStatsReport(Serial);
+      break;
+#endif
+    default:
+      break;
+  }
+}
+
+// Deadlines of everything loop() does on a timer; the next pass runs at
+// the earliest of them or on the next sensor interrupt
+void scheduleWakeups() {
+  rpmCalculator.scheduleDeadlines(eventLoop);
+  eventLoop.wakeAfter(lastOutputTime, OUTPUT_INTERVAL);
+  if (isSessionActive) {
+    eventLoop.wakeAfter(lastLoggingTime, LOGGING_INTERVAL);
+    eventLoop.wakeAfter(lastTelemetryTime, TELEMETRY_SAMPLE_INTERVAL);
+  }
+  if (serialStream.isBinary()) {
+    eventLoop.wakeAfter(lastStreamTime, SERIAL_STREAM_INTERVAL);
   }
+#ifdef ENABLE_INSTRUMENTATION
+  if (!serialStream.isBinary()) {
+    eventLoop.wakeAfter(lastStatsTime, STATS_INTERVAL);
+  }
+#endif
   
-  // Send data via ESP-NOW
-  SensorData data;
-  data.wheelRPM = wheelRPM;
-  data.cadenceRPM = cadenceRPM;
-  data.currentChainring = rpmCalculator.getCurrentChainring();
-  data.currentSprocket = rpmCalculator.getCurrentSprocket();
-  data.currentGearRatio = rpmCalculator.getCurrentGearRatio();
-  data.timestamp = wifiManager.getCurrentTimestamp();
+  // Wi-Fi startup, ESP-NOW retries, capture syncs and serial commands
+  eventLoop.wakeIn(EVENT_LOOP_HOUSEKEEPING_INTERVAL * 1000UL);
+}
+
+// Print the outcome of the SD card bring-up once the writer task has one
+void reportSDCard() {
+  LogWriter::StorageState state = logWriter.getStorageState();
+  if (state == LogWriter::STORAGE_STARTING) {
+    return;
+  }
+  sdCardReported = true;
   
-  wifiManager.sendData(data);
+  if (state == LogWriter::STORAGE_READY) {
+    Serial.println("SD card initialized successfully");
+    return;
+  }
+  Serial.println("SD card initialization failed!");
+  // Print more detailed diagnostics
+  Serial.print("Error code: ");
+  Serial.println(SD.sdErrorCode());
+  Serial.print("Error data: ");
+  Serial.println(SD.sdErrorData());
+  Serial.println("WARNING: SD card not available. Will function without logging.");
+  sdCardAvailable = false;
 }
 
 void setup() {
-  // Initialize serial communication
+  // Initialize serial communication; the larger TX buffer lets binary
+  // frames be queued without waiting on the UART
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER_SIZE);
   Serial.begin(SERIAL_BAUD_RATE);
+  serialStream.begin(&Serial, SERIAL_DEFAULT_MODE);
   Serial.println("Turbo Trainer - Hall Sensor Test");
-  delay(500);
   
-  // Initialize Wi-Fi and time sync
-  if (!wifiManager.begin()) {
-    Serial.println("Failed to initialize Wi-Fi and time sync");
+  // Initialize the RPM calculator with the sensor channels (and gears) from config
+#if FIXED_SENSOR_CONFIG
+  calculator.begin();  // Already checked at compile time
+#else
+  bool sensorsConfigured = calculator.begin(SENSOR_CHANNEL_CONFIG, SENSOR_CHANNEL_COUNT,
+                                            SENSOR_BIKE_CONFIG, SENSOR_BIKE_COUNT);
+  calculator.configureGears(CHAINRING_COUNT, CHAINRINGS, SPROCKET_COUNT, SPROCKETS);
+  if (!sensorsConfigured) {
+    Serial.println("Error: invalid sensor channel configuration");
   }
+#endif
+  rpmCalculator.configureAverageWindow(AVERAGE_SERIAL, SERIAL_AVERAGE_WINDOW);
+  rpmCalculator.configureAverageWindow(AVERAGE_LOG, LOG_AVERAGE_WINDOW);
+  rpmCalculator.configureAverageWindow(AVERAGE_ESPNOW, ESPNOW_AVERAGE_WINDOW);
+  rpmCalculator.setEdgeObserver(onSensorEdge, &serialStream);
   
-  // Set up Hall sensor pins as inputs with pullup resistors
-  pinMode(WHEEL_SENSOR_PIN, INPUT_PULLUP);
-  pinMode(CADENCE_SENSOR_PIN, INPUT_PULLUP);
+  // Corrections from the saved magnet spacing apply from the first revolution
+  if (SPACING_CALIBRATION) {
+    uint8_t restored = spacingStore.load(rpmCalculator.getEngine());
+    Serial.print("Magnet spacing restored for ");
+    Serial.print(restored);
+    Serial.println(" channel(s)");
+  } else {
+    for (uint8_t ch = 0; ch < rpmCalculator.getEngine().getChannelCount(); ch++) {
+      rpmCalculator.getEngine().configureSpacing(ch, false);
+    }
+  }
   
-  // Initialize the RPM calculator with magnet counts from config
-  rpmCalculator.begin(WHEEL_MAGNETS, CRANK_MAGNETS);
+  // Attach interrupts as soon as the calculator is ready so the ride is
+  // measured from boot; the ISRs only queue timestamps and wake loop(),
+  // which drains them
+  if (!eventLoop.begin()) {
+    Serial.println("Warning: light sleep not available");
+  }
+  if (!sensorInput.begin(&rpmCalculator.getEngine())) {
+    Serial.println("Error: could not start sensor acquisition");
+  }
+  sensorsAttachedTime = millis();
+  Serial.print("Sensors attached (");
+  Serial.print(SensorInput::getBackendName());
+  Serial.print(" backend) after ");
+  Serial.print(sensorsAttachedTime);
+  Serial.println(" ms");
   
-  // Configure the gears for this specific bike
-  rpmCalculator.configureGears(CHAINRING_COUNT, CHAINRINGS, SPROCKET_COUNT, SPROCKETS);
+  // Wi-Fi, NTP and ESP-NOW come up in the background, stepped from loop()
+  wifiManager.start();
   
   // Print gear configuration
   Serial.println("Gear Configuration:");
@@ -193,59 +418,54 @@ void setup() {
   lastOutputTime = millis();
   lastLoggingTime = millis();
   
-  // Try to initialize SD card
-  Serial.println("Trying to initialize SD card...");
-  delay(500);
-  
-  // Initialize SD card - separate this from critical functionality
-  Serial.print("Initializing SD card...");
-  if (!SD.begin(SD_CONFIG)) {
-    Serial.println("SD card initialization failed!");
-    // Print more detailed diagnostics
-    Serial.print("Error code: ");
-    Serial.println(SD.sdErrorCode());
-    Serial.print("Error data: ");
-    Serial.println(SD.sdErrorData());
-    sdCardAvailable = false;
-  } else {
-    Serial.println("SD card initialized successfully");
-    delay(500); // Give the card time to stabilize
-    
-    // Check SD card type - use SdFat method
-    Serial.print("SD Card present: ");
-    if (SD.card()) {
-      Serial.println("Yes");
-      sdCardAvailable = true;
-    } else {
-      Serial.println("No");
-      sdCardAvailable = false;
-    }
-  }
-  
-  // Now that other setup is done, attach interrupts last
-  // This ensures all variables are initialized before interrupts can fire
-  Serial.println("Attaching interrupt handlers...");
-  attachInterrupt(digitalPinToInterrupt(WHEEL_SENSOR_PIN), wheelPulseCounter, INTERRUPT_MODE);
-  attachInterrupt(digitalPinToInterrupt(CADENCE_SENSOR_PIN), cadencePulseCounter, INTERRUPT_MODE);
-  
-  // Disconnect from Wi-Fi after time sync
-  wifiManager.disconnectWiFi();
-  
-  Serial.println("Ready! Waiting for movement to start recording.");
+  // All SD access, the card's slow 1 MHz initialisation included, happens
+  // on the writer task, so loop() starts draining the edge rings right away.
+  // Sessions started before the card is up wait in the writer's queue.
+  Serial.println("Initializing SD card in the background...");
+  sdLogSink.begin(&SD, SD_CONFIG, LOG_PREALLOCATE_SIZE, LOG_SYNC_INTERVAL);
+  sdCardAvailable = logWriter.begin(&sdLogSink, LOG_QUEUE_LENGTH, LOG_SYNC_INTERVAL);
   if (!sdCardAvailable) {
+    Serial.println("Error: Could not start log writer task");
     Serial.println("WARNING: SD card not available. Will function without logging.");
+    sdCardReported = true;
   }
+  edgeCapture.begin(&logWriter, LOG_SYNC_INTERVAL);
+  
+  Serial.println("Ready! Waiting for movement to start recording.");
 }
 
 void loop() {
   unsigned long currentTime = millis();
+  STAT_COUNT(STAT_LOOP_PASSES);
+  STAT_INTERVAL(HIST_LOOP_PERIOD);
   
-  // Process RPM calculations 
-  rpmCalculator.calculateRPMs();
+  // Process RPM calculations (on the concrete calculator, for its rates)
+  calculator.calculateRPMs();
   
   // Check for timeouts
   rpmCalculator.checkTimeouts();
   
+  // Report how long after boot the first RPM was measured
+  if (firstSampleTime == 0 &&
+      (rpmCalculator.getInstantWheelMilliRPM() > 0 || rpmCalculator.getInstantCadenceMilliRPM() > 0)) {
+    firstSampleTime = currentTime;
+    Serial.print("Time to first sample: ");
+    Serial.print(firstSampleTime);
+    Serial.println(" ms");
+  }
+  
+  // Step Wi-Fi / NTP / ESP-NOW startup
+  wifiManager.update(currentTime);
+  
+  if (!sdCardReported) {
+    reportSDCard();
+  }
+  
+  // Date the rows logged before the clock synced
+  if (isSessionActive && !sessionClockKnown && wifiManager.isTimeValid()) {
+    sessionClockKnown = logWriter.setBootTimestamp(wifiManager.getBootTimestamp());
+  }
+  
   // Handle output interval
   if (currentTime - lastOutputTime >= OUTPUT_INTERVAL) {
     // Update session averages if session is active
@@ -253,43 +473,22 @@ void loop() {
       rpmCalculator.updateAverages();
     }
     
-    // Print session averages if active
-    if (isSessionActive) {
-      Serial.print("Session Avg - Wheel RPM: ");
-      Serial.print(rpmCalculator.getSessionAvgWheelRPM(), 1);
-      Serial.print(" | Cadence: ");
-      Serial.print(rpmCalculator.getSessionAvgCadenceRPM(), 1);
-      Serial.print(" RPM | ");
+    // Human-readable status line (binary stream modes carry the same data)
+    if (!serialStream.isBinary()) {
+      printStatusLine();
     }
     
-    // Output current values to serial
-    Serial.print("Current - Wheel RPM: ");
-    Serial.print(rpmCalculator.getCurrentWheelRPM(), 1);
-    Serial.print(" | Cadence: ");
-    Serial.print(rpmCalculator.getCurrentCadenceRPM(), 1);
-    Serial.print(" RPM");
-    
-    // Print current gear if available
-    if (rpmCalculator.getCurrentChainring() > 0 && rpmCalculator.getCurrentSprocket() > 0) {
-      Serial.print(" | Chainring ");
-      Serial.print(rpmCalculator.getCurrentChainring());
-      Serial.print(" (");
-      Serial.print(CHAINRINGS[rpmCalculator.getCurrentChainring() - 1]);
-      Serial.print(") : Sprocket ");
-      Serial.print(rpmCalculator.getCurrentSprocket());
-      Serial.print(" (");
-      Serial.print(SPROCKETS[rpmCalculator.getCurrentSprocket() - 1]);
-      Serial.print(")");
-    }
-    
-    Serial.println();
-    
     // Reset interval counters
     rpmCalculator.resetIntervalCounters();
     
     lastOutputTime = currentTime;
   }
   
+  // Save newly learned magnet spacing while stopped (flash writes stall the CPU)
+  if (SPACING_CALIBRATION && !rpmCalculator.hasActivity()) {
+    spacingStore.update(rpmCalculator.getEngine());
+  }
+  
   // Check if readings are stabilized and start session if there's activity
   if (!isSessionActive && rpmCalculator.areReadingsStabilized(currentTime) && rpmCalculator.hasActivity()) {
     startSession();
@@ -298,8 +497,36 @@ void loop() {
   // Log data at the specified interval
   if (isSessionActive && currentTime - lastLoggingTime >= LOGGING_INTERVAL) {
     // Log the data with current values
-    logData(rpmCalculator.getCurrentWheelRPM(), rpmCalculator.getCurrentCadenceRPM());
+    logData(rpmCalculator.getAverageWheelRPM(AVERAGE_LOG), rpmCalculator.getAverageCadenceRPM(AVERAGE_LOG));
     
     lastLoggingTime = currentTime;
   }
+  edgeCapture.update(currentTime);
+  
+  // Sample telemetry at a higher rate than logging; frames go out when full or stale
+  if (isSessionActive && currentTime - lastTelemetryTime >= TELEMETRY_SAMPLE_INTERVAL) {
+    sendTelemetry(currentTime);
+    lastTelemetryTime = currentTime;
+  }
+  wifiManager.updateTelemetry(currentTime);
+  
+  // High-rate binary samples for host dashboards
+  if (serialStream.isBinary() && currentTime - lastStreamTime >= SERIAL_STREAM_INTERVAL) {
+    streamSample(currentTime);
+    lastStreamTime = currentTime;
+  }
+  
+  handleSerialCommand();
+  
+#ifdef ENABLE_INSTRUMENTATION
+  // Compact stats packet periodically (text mode only)
+  if (!serialStream.isBinary() && currentTime - lastStatsTime >= STATS_INTERVAL) {
+    printStatsPacket(Serial);
+    lastStatsTime = currentTime;
+  }
+#endif
+  
+  // Idle until the next sensor edge or deadline instead of spinning
+  scheduleWakeups();
+  eventLoop.wait();
 }
\ No newline at end of file
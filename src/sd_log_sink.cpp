@@ -0,0 +1,176 @@
+#include "sd_log_sink.h"
+#include "config.h"
+#include "edge_capture_format.h"
+#include <stddef.h>
+
+// Create the global instance
+SdLogSink sdLogSink;
+
+SdLogSink::SdLogSink() :
+    sd(nullptr),
+    config(SD_CONFIG),
+    preallocateSize(0),
+    syncInterval(0)
+{
+}
+
+void SdLogSink::begin(SdFat* sd, SdSpiConfig config, uint32_t preallocateSize, unsigned long syncInterval) {
+    this->sd = sd;
+    this->config = config;
+    this->preallocateSize = preallocateSize;
+    this->syncInterval = syncInterval;
+}
+
+bool SdLogSink::mount() {
+    return sd->begin(config) && sd->card();
+}
+
+bool SdLogSink::openSession(const LogSessionInfo& info) {
+    closeSession();
+
+    // Truncate - millis() based names repeat across boots, and
+    // pre-allocation needs an empty file
+    file = sd->open(info.fileName, O_RDWR | O_CREAT | O_TRUNC);
+    if (!file) {
+        Serial.println("Error: Could not create log file!");
+        return false;
+    }
+    if (!file.preAllocate(preallocateSize)) {
+        // Still works, just with FAT allocation on the write path
+        Serial.println("Warning: Could not pre-allocate log file");
+    }
+    if (!sessionLog.begin(&file, sd->card(), info.startTimestamp, info.startMillis, info.bootTimestamp,
+                          info.wheelMagnets, info.crankMagnets, syncInterval)) {
+        Serial.println("Error: Could not write log file header!");
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool SdLogSink::appendRecord(const SessionLogRecord& record, unsigned long currentTime) {
+    return sessionLog.append(record, currentTime);
+}
+
+void SdLogSink::closeSession() {
+    if (sessionLog.isOpen()) {
+        sessionLog.end();
+        file.close();
+    }
+}
+
+bool SdLogSink::setBootTimestamp(uint32_t bootTimestamp) {
+    bool ok = !sessionLog.isOpen() || sessionLog.setBootTimestamp(bootTimestamp);
+
+    // Patch the capture header's copy in place
+    if (captureFile &&
+        !(captureFile.seekSet(offsetof(EdgeCaptureHeader, bootTimestamp)) &&
+          captureFile.write(&bootTimestamp, sizeof(uint32_t)) == sizeof(uint32_t))) {
+        ok = false;
+    }
+    return ok;
+}
+
+bool SdLogSink::flush() {
+    bool ok = !sessionLog.isOpen() || sessionLog.flush();
+    return syncCapture() && ok;
+}
+
+unsigned long SdLogSink::recoverSessions() {
+    FsFile root = sd->open("/");
+    if (!root) {
+        return 0;
+    }
+
+    unsigned long failures = 0;
+    FsFile entry;
+    char name[LOG_FILE_NAME_LENGTH];
+    char path[LOG_FILE_NAME_LENGTH + 1];
+    size_t extensionLength = strlen(LOG_FILE_EXTENSION);
+
+    while (entry.openNext(&root, O_RDONLY)) {
+        size_t nameLength = entry.getName(name, sizeof(name));
+        bool candidate = !entry.isDir() && nameLength > extensionLength &&
+                         strcmp(name + nameLength - extensionLength, LOG_FILE_EXTENSION) == 0;
+        entry.close();
+        if (!candidate) {
+            continue;
+        }
+
+        // Reopen for writing; the directory walk only needs read access
+        snprintf(path, sizeof(path), "/%s", name);
+        file = sd->open(path, O_RDWR);
+        if (!file) {
+            continue;
+        }
+
+        switch (sessionLog.recover(&file, sd->card())) {
+            case SESSION_RECOVERY_SALVAGED:
+                Serial.print("Recovered ");
+                Serial.print(name);
+                Serial.print(": ");
+                Serial.print(sessionLog.getRecordCount());
+                Serial.print(" rows (");
+                Serial.print(sessionLog.getRecordCount() - sessionLog.getCommittedCount());
+                Serial.println(" after the last commit)");
+                break;
+            case SESSION_RECOVERY_FAILED:
+                Serial.print("Error: Could not recover ");
+                Serial.println(name);
+                failures++;
+                break;
+            default:
+                break;
+        }
+        file.close();
+    }
+    root.close();
+    return failures;
+}
+
+bool SdLogSink::openCapture(const char* fileName) {
+    closeCapture();
+    // Truncate like the session log, so a reused name keeps nothing of
+    // the earlier capture
+    captureFile = sd->open(fileName, O_RDWR | O_CREAT | O_TRUNC);
+    if (!captureFile) {
+        Serial.println("Error: Could not create capture file!");
+        return false;
+    }
+    return true;
+}
+
+bool SdLogSink::writeCaptureSector(uint32_t index, const uint8_t* data) {
+    if (!captureFile) {
+        return false;
+    }
+
+    // seekSet() cannot go past the end of the file, so a sector after one
+    // the card failed to take first zero-fills the hole; capture2csv
+    // skips it by its missing sector magic
+    static const uint8_t zeros[SESSION_LOG_SECTOR_SIZE] = {0};
+    uint64_t offset = (uint64_t)index * SESSION_LOG_SECTOR_SIZE;
+    uint64_t size = captureFile.fileSize();
+    if (size < offset && !captureFile.seekSet(size)) {
+        return false;
+    }
+    while (size < offset) {
+        size_t length = offset - size < SESSION_LOG_SECTOR_SIZE ? (size_t)(offset - size) : SESSION_LOG_SECTOR_SIZE;
+        if (captureFile.write(zeros, length) != length) {
+            return false;
+        }
+        size += length;
+    }
+    return captureFile.seekSet(offset) &&
+           captureFile.write(data, SESSION_LOG_SECTOR_SIZE) == SESSION_LOG_SECTOR_SIZE;
+}
+
+bool SdLogSink::syncCapture() {
+    return !captureFile || captureFile.sync();
+}
+
+void SdLogSink::closeCapture() {
+    if (captureFile) {
+        captureFile.close();
+    }
+}
@@ -0,0 +1,250 @@
+#include "sensor_engine.h"
+
+SensorEngine::SensorEngine() :
+  channelCount(0),
+  edgeObserver(nullptr),
+  edgeObserverContext(nullptr),
+  lastActivityTime(0)
+{
+  for (uint8_t ch = 0; ch < MAX_SENSOR_CHANNELS; ch++) {
+    rpmNumerator[ch] = MILLI_RPM_MINUTE;
+    maxMilliRPM[ch] = 0;
+    magnets[ch] = 1;
+    edgeDividers[ch] = 1;
+    pins[ch] = SENSOR_PIN_NONE;
+    averages[ch].setBucketPeriod(AVERAGE_BUCKET_MS);
+    sessionWeightedMilliRPM[ch] = 0;
+    sessionTime[ch] = 0;
+    sessionAvgMilliRPM[ch] = 0;
+  }
+  reset();
+}
+
+void SensorEngine::clearChannels() {
+  channelCount = 0;
+}
+
+int8_t SensorEngine::addChannel(const SensorChannelConfig& config) {
+  if (channelCount >= MAX_SENSOR_CHANNELS || config.magnets == 0 || config.maxRPM == 0 ||
+      config.edgeDivider == 0 || config.magnets % config.edgeDivider != 0) {
+    return -1;
+  }
+
+  uint8_t ch = channelCount++;
+  pins[ch] = config.pin;
+  magnets[ch] = config.magnets;
+  edgeDividers[ch] = config.edgeDivider;
+  maxMilliRPM[ch] = (uint32_t)config.maxRPM * MILLI_RPM_PER_RPM;
+
+  // Precompute the RPM numerator so each calculation is a single divide
+  rpmNumerator[ch] = MILLI_RPM_MINUTE * config.edgeDivider / config.magnets;
+
+  configureGlitchFilter(ch, config.glitchPercent);
+  configureSpacing(ch, true);
+  sessionWeightedMilliRPM[ch] = 0;
+  sessionTime[ch] = 0;
+  sessionAvgMilliRPM[ch] = 0;
+  return (int8_t)ch;
+}
+
+void SensorEngine::configureGlitchFilter(uint8_t channel, uint8_t percent) {
+  // The absolute floor is half the edge interval at the maximum realistic
+  // RPM, leaving headroom for uneven magnet spacing
+  uint32_t maxRPM = maxMilliRPM[channel] / MILLI_RPM_PER_RPM;
+  filters[channel].configure(60000000UL * edgeDividers[channel] / (maxRPM * magnets[channel]) / 2, percent);
+}
+
+void SensorEngine::configureSpacing(uint8_t channel, bool enabled) {
+  spacing[channel].configure(enabled ? magnets[channel] / edgeDividers[channel] : 0);
+}
+
+void SensorEngine::reset() {
+  uint32_t currentTime = clockMicros();
+  for (uint8_t ch = 0; ch < MAX_SENSOR_CHANNELS; ch++) {
+    edges[ch].clear();
+    lastTriggerTime[ch] = 0;
+    batchTime[ch] = 0;
+    batchEdges[ch] = 0;
+    instantMilliRPM[ch] = 0;
+    weightedMilliRPM[ch] = 0;
+    intervalTime[ch] = 0;
+    readingCount[ch] = 0;
+    idleSince[ch] = currentTime;
+    lastInterval[ch] = 0;
+    plausibleMilliRPM[ch] = 0;
+    spacing[ch].lostPhase();
+    spikeFilters[ch].reset();
+    smoothed[ch].reset();
+    recent[ch].reset();
+    averages[ch].reset();
+  }
+  lastActivityTime = clockMillis();
+}
+
+void SensorEngine::accumulate(uint8_t channel, uint32_t milliRPM, uint32_t duration, uint32_t until) {
+  weightedMilliRPM[channel] += (uint64_t)milliRPM * duration;
+  intervalTime[channel] += duration;
+
+  // Bucketed by when the edge arrived, not by when process() got to it,
+  // so the windows do not depend on the loop period
+  averages[channel].add(milliRPM, duration, millisAt(until));
+}
+
+uint32_t SensorEngine::millisAt(uint32_t time) {
+  uint32_t currentTime = clockMicros();
+  uint32_t currentMillis = clockMillis();
+  uint32_t subMillis = currentTime - currentMillis * 1000;
+  if (subMillis >= 1000) {
+    subMillis = 0;  // The millisecond ticked between the two reads
+  }
+  uint32_t lag = currentTime - time;
+  return lag <= subMillis ? currentMillis : currentMillis - ((lag - subMillis - 1) / 1000 + 1);
+}
+
+void SensorEngine::accumulateIdle(uint8_t channel, uint32_t until) {
+  // Each bucket gets the stopped time that fell inside it, so the averages
+  // come out the same however often process() runs. Microsecond t counts
+  // towards the bucket of millisecond t / 1000.
+  uint32_t duration = until - idleSince[channel];
+  intervalTime[channel] += duration;  // Zero adds nothing to the weighted sum
+
+  // Where 'until' sits: the start (ms) of its bucket and the micros into it
+  uint32_t currentTime = clockMicros();
+  uint32_t currentMillis = clockMillis();
+  uint32_t subMillis = currentTime - currentMillis * 1000;
+  if (subMillis >= 1000) {
+    subMillis = 0;  // The millisecond ticked between the two reads
+  }
+  const uint32_t bucketMicros = AVERAGE_BUCKET_MS * 1000UL;
+  uint32_t bucketStart = currentMillis - currentMillis % AVERAGE_BUCKET_MS;
+  uint32_t intoBucket = (currentMillis % AVERAGE_BUCKET_MS) * 1000 + subMillis;
+  uint32_t lag = currentTime - until;
+  if (lag <= intoBucket) {
+    intoBucket -= lag;
+  } else {
+    uint32_t back = (lag - intoBucket - 1) / bucketMicros + 1;
+    intoBucket = back * bucketMicros + intoBucket - lag;
+    bucketStart -= back * AVERAGE_BUCKET_MS;
+  }
+
+  // Oldest part first so the window only moves forward; buckets that have
+  // already left the window are skipped
+  uint32_t inLastBucket = duration < intoBucket + 1 ? duration : intoBucket + 1;
+  uint32_t earlier = duration - inLastBucket;
+  uint32_t wholeBuckets = earlier / bucketMicros;
+  uint32_t partial = earlier % bucketMicros;
+  if (partial > 0 && wholeBuckets < AVERAGE_BUCKETS) {
+    averages[channel].add(0, partial, bucketStart - (wholeBuckets + 1) * AVERAGE_BUCKET_MS);
+  }
+  for (uint32_t i = wholeBuckets < AVERAGE_BUCKETS ? wholeBuckets : AVERAGE_BUCKETS; i > 0; i--) {
+    averages[channel].add(0, bucketMicros, bucketStart - i * AVERAGE_BUCKET_MS);
+  }
+  averages[channel].add(0, inLastBucket, bucketStart);
+}
+
+void SensorEngine::setEdgeObserver(EdgeObserver observer, void* context) {
+  edgeObserver = observer;
+  edgeObserverContext = context;
+}
+
+void SensorEngine::checkTimeouts() {
+  uint32_t currentTime = clockMicros();
+
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    if (lastTriggerTime[ch] > 0 && (currentTime - lastTriggerTime[ch]) > TIMEOUT_PERIOD) {
+      instantMilliRPM[ch] = 0;
+
+      // The unfinished interval counts as stopped. It is accounted now
+      // rather than on the next pass, which may come after the averages
+      // are next updated.
+      idleSince[ch] = lastTriggerTime[ch];
+      accumulateIdle(ch, currentTime);
+      idleSince[ch] = currentTime;
+
+      lastTriggerTime[ch] = 0; // Reset to prevent repeated zeroing
+      lastInterval[ch] = 0;
+      plausibleMilliRPM[ch] = 0;
+      spacing[ch].lostPhase();
+      filters[ch].reset();
+      spikeFilters[ch].reset();
+      smoothed[ch].reset();
+    }
+  }
+}
+
+uint32_t SensorEngine::getTimeUntilTimeout() const {
+  uint32_t currentTime = clockMicros();
+  uint32_t earliest = UINT32_MAX;
+
+  // checkTimeouts() fires on the first pass more than TIMEOUT_PERIOD after the last edge
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    if (lastTriggerTime[ch] > 0) {
+      uint32_t elapsed = currentTime - lastTriggerTime[ch];
+      uint32_t remaining = elapsed > TIMEOUT_PERIOD ? 0 : TIMEOUT_PERIOD + 1 - elapsed;
+      if (remaining < earliest) {
+        earliest = remaining;
+      }
+    }
+  }
+  return earliest;
+}
+
+void SensorEngine::updateAverages() {
+  // Update session-wide time-weighted averages. The 64-bit integer sums
+  // are exact, so multi-hour sessions accumulate no rounding drift.
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    sessionWeightedMilliRPM[ch] += weightedMilliRPM[ch];
+    sessionTime[ch] += intervalTime[ch];
+    sessionAvgMilliRPM[ch] = sessionTime[ch] > 0 ? (uint32_t)(sessionWeightedMilliRPM[ch] / sessionTime[ch]) : 0;
+  }
+}
+
+void SensorEngine::resetIntervalCounters() {
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    weightedMilliRPM[ch] = 0;
+    intervalTime[ch] = 0;
+    readingCount[ch] = 0;
+  }
+}
+
+void SensorEngine::startNewSession() {
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    sessionWeightedMilliRPM[ch] = 0;
+    sessionTime[ch] = 0;
+    sessionAvgMilliRPM[ch] = 0;
+  }
+
+  // Time before the session started must not leak into its averages
+  resetIntervalCounters();
+
+  lastActivityTime = clockMillis();
+}
+
+uint32_t SensorEngine::decay(uint8_t channel, uint32_t milliRPM) const {
+  if (milliRPM == 0 || lastTriggerTime[channel] == 0 || lastInterval[channel] == 0) {
+    return milliRPM;
+  }
+
+  uint32_t elapsed = clockMicros() - lastTriggerTime[channel];
+  if (elapsed / DECAY_STOP_PERIODS >= lastInterval[channel]) {
+    return 0;
+  }
+  if (elapsed <= lastInterval[channel]) {
+    return milliRPM;  // The next edge is not due yet
+  }
+  uint32_t bound = edgeMilliRPMFor(rpmNumerator[channel], elapsed);
+  return bound < milliRPM ? bound : milliRPM;
+}
+
+uint32_t SensorEngine::getIntervalMilliRPM(uint8_t channel) const {
+  return intervalTime[channel] > 0 ? (uint32_t)(weightedMilliRPM[channel] / intervalTime[channel]) : 0;
+}
+
+bool SensorEngine::hasActivity() const {
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    if (instantMilliRPM[ch] > 0) {
+      return true;
+    }
+  }
+  return false;
+}
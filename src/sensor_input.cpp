@@ -0,0 +1,42 @@
+#include "sensor_input.h"
+
+// Create the global instance
+SensorInput sensorInput;
+
+SensorInput::SensorInput() :
+  engine(nullptr),
+  channelCount(0)
+{
+  resetStates();
+}
+
+void SensorInput::resetStates() {
+  for (uint8_t ch = 0; ch < MAX_SENSOR_CHANNELS; ch++) {
+    states[ch] = SensorChannelState();
+    published[ch].write(states[ch]);
+  }
+}
+
+uint32_t SensorInput::getInterruptCount() const {
+  uint32_t total = 0;
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    total += getInterruptCount(ch);
+  }
+  return total;
+}
+
+uint32_t SensorInput::getEdgeCount() const {
+  uint32_t total = 0;
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    total += getEdgeCount(ch);
+  }
+  return total;
+}
+
+uint64_t SensorInput::getHandlerCycles() const {
+  uint64_t total = 0;
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    total += getState(ch).handlerCycles;
+  }
+  return total;
+}
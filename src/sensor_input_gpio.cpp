@@ -0,0 +1,66 @@
+#include "sensor_input.h"
+
+#if defined(ARDUINO) && SENSOR_BACKEND == SENSOR_BACKEND_GPIO
+
+#include <Arduino.h>
+#include "instrumentation.h"
+#include "event_loop.h"
+
+// One interrupt per edge; the argument is the channel index
+void IRAM_ATTR SensorInput::onInterrupt(void* channel) {
+#ifdef ENABLE_INSTRUMENTATION
+  uint32_t start = ESP.getCycleCount();
+#endif
+  uint8_t ch = (uint8_t)(uintptr_t)channel;
+  uint32_t timestamp = micros();
+  sensorInput.engine->recordEdge(ch, timestamp);
+  eventLoop.notifyFromISR();  // loop() processes the edge right away
+
+  SensorChannelState& state = sensorInput.states[ch];
+  state.interrupts++;
+  state.lastInterruptTime = timestamp;
+#ifdef ENABLE_INSTRUMENTATION
+  state.handlerCycles += ESP.getCycleCount() - start;
+#endif
+  sensorInput.published[ch].write(state);
+}
+
+bool SensorInput::begin(SensorEngine* engine) {
+  this->engine = engine;
+  channelCount = engine->getChannelCount();
+  resetStates();
+
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    uint8_t pin = engine->getPin(ch);
+    if (pin == SENSOR_PIN_NONE) {
+      continue;
+    }
+    // Every edge is its own interrupt here
+    if (engine->getEdgeDivider(ch) != 1) {
+      end();
+      return false;
+    }
+    pinMode(pin, INPUT_PULLUP);
+    attachInterruptArg(digitalPinToInterrupt(pin), onInterrupt, (void*)(uintptr_t)ch, INTERRUPT_MODE);
+  }
+  return true;
+}
+
+void SensorInput::end() {
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    uint8_t pin = engine->getPin(ch);
+    if (pin != SENSOR_PIN_NONE) {
+      detachInterrupt(digitalPinToInterrupt(pin));
+    }
+  }
+}
+
+uint32_t SensorInput::getEdgeCount(uint8_t channel) const {
+  return getInterruptCount(channel);
+}
+
+const char* SensorInput::getBackendName() {
+  return "gpio";
+}
+
+#endif // ARDUINO && SENSOR_BACKEND == SENSOR_BACKEND_GPIO
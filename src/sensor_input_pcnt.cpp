@@ -0,0 +1,114 @@
+#include "sensor_input.h"
+
+#if defined(ARDUINO) && SENSOR_BACKEND == SENSOR_BACKEND_PCNT
+
+#include <Arduino.h>
+#include <driver/pcnt.h>
+#include "instrumentation.h"
+#include "event_loop.h"
+
+// Each channel uses the pulse counter unit with its index. The counter
+// counts up to the channel's edge divider, then wraps to zero and raises
+// its high-limit event, so the timestamp taken here is that of the last
+// edge of the group and the engine sees one edge per edgeDivider.
+void IRAM_ATTR SensorInput::onInterrupt(void* channel) {
+#ifdef ENABLE_INSTRUMENTATION
+  uint32_t start = ESP.getCycleCount();
+#endif
+  uint8_t ch = (uint8_t)(uintptr_t)channel;
+  uint32_t timestamp = micros();
+  sensorInput.engine->recordEdge(ch, timestamp);
+  eventLoop.notifyFromISR();  // loop() processes the edge right away
+
+  SensorChannelState& state = sensorInput.states[ch];
+  state.interrupts++;
+  state.lastInterruptTime = timestamp;
+#ifdef ENABLE_INSTRUMENTATION
+  state.handlerCycles += ESP.getCycleCount() - start;
+#endif
+  sensorInput.published[ch].write(state);
+}
+
+bool SensorInput::begin(SensorEngine* engine) {
+  this->engine = engine;
+  channelCount = engine->getChannelCount();
+  resetStates();
+
+  // Already installed is fine (another driver may share the service)
+  esp_err_t err = pcnt_isr_service_install(0);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    return false;
+  }
+
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    uint8_t pin = engine->getPin(ch);
+    if (pin == SENSOR_PIN_NONE) {
+      continue;
+    }
+    if (ch >= PCNT_UNIT_MAX) {
+      end();
+      return false;
+    }
+    pcnt_unit_t unit = (pcnt_unit_t)ch;
+
+    pinMode(pin, INPUT_PULLUP);
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = pin;
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.lctrl_mode = PCNT_MODE_KEEP;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.pos_mode = INTERRUPT_MODE == FALLING ? PCNT_COUNT_DIS : PCNT_COUNT_INC;
+    config.neg_mode = INTERRUPT_MODE == RISING ? PCNT_COUNT_DIS : PCNT_COUNT_INC;
+    config.counter_h_lim = engine->getEdgeDivider(ch);
+    config.counter_l_lim = -1;
+    config.unit = unit;
+    config.channel = PCNT_CHANNEL_0;
+
+    if (pcnt_unit_config(&config) != ESP_OK ||
+        pcnt_set_filter_value(unit, PCNT_FILTER_CYCLES) != ESP_OK ||
+        pcnt_filter_enable(unit) != ESP_OK ||
+        pcnt_event_enable(unit, PCNT_EVT_H_LIM) != ESP_OK ||
+        pcnt_counter_pause(unit) != ESP_OK ||
+        pcnt_counter_clear(unit) != ESP_OK ||
+        pcnt_isr_handler_add(unit, onInterrupt, (void*)(uintptr_t)ch) != ESP_OK ||
+        pcnt_counter_resume(unit) != ESP_OK) {
+      end();
+      return false;
+    }
+  }
+  return true;
+}
+
+void SensorInput::end() {
+  for (uint8_t ch = 0; ch < channelCount && ch < PCNT_UNIT_MAX; ch++) {
+    if (engine->getPin(ch) != SENSOR_PIN_NONE) {
+      pcnt_counter_pause((pcnt_unit_t)ch);
+      pcnt_isr_handler_remove((pcnt_unit_t)ch);
+    }
+  }
+}
+
+uint32_t SensorInput::getEdgeCount(uint8_t channel) const {
+  // Whole groups plus the edges counted towards the next one. The pair is
+  // read again if an interrupt lands in between, which would otherwise
+  // count the group that just wrapped the counter twice or not at all.
+  bool counting = channel < PCNT_UNIT_MAX && engine->getPin(channel) != SENSOR_PIN_NONE;
+  SensorChannelState state;
+  int16_t pending;
+  uint32_t version;
+  do {
+    version = published[channel].readBegin();
+    state = published[channel].load();
+    pending = 0;
+    if (counting) {
+      pcnt_get_counter_value((pcnt_unit_t)channel, &pending);
+    }
+  } while (published[channel].readRetry(version));
+  return state.interrupts * engine->getEdgeDivider(channel) + (pending > 0 ? pending : 0);
+}
+
+const char* SensorInput::getBackendName() {
+  return "pcnt";
+}
+
+#endif // ARDUINO && SENSOR_BACKEND == SENSOR_BACKEND_PCNT
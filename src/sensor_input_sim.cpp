@@ -0,0 +1,44 @@
+#include "sensor_input.h"
+
+#ifndef ARDUINO
+
+// Host stand-in for the pulse counter and GPIO backends: inject() plays
+// the part of the hardware, counting edges and taking an "interrupt"
+// whenever a channel's edge divider is reached (every edge for 1).
+bool SensorInput::begin(SensorEngine* engine) {
+  this->engine = engine;
+  channelCount = engine->getChannelCount();
+  resetStates();
+  for (uint8_t ch = 0; ch < MAX_SENSOR_CHANNELS; ch++) {
+    pendingEdges[ch] = 0;
+  }
+  return true;
+}
+
+void SensorInput::end() {
+  engine = nullptr;
+}
+
+void SensorInput::inject(uint8_t channel, uint32_t timestamp) {
+  if (!engine || channel >= channelCount) {
+    return;
+  }
+  if (++pendingEdges[channel] < engine->getEdgeDivider(channel)) {
+    return;
+  }
+  pendingEdges[channel] = 0;
+  engine->recordEdge(channel, timestamp);
+  states[channel].interrupts++;
+  states[channel].lastInterruptTime = timestamp;
+  published[channel].write(states[channel]);
+}
+
+uint32_t SensorInput::getEdgeCount(uint8_t channel) const {
+  return getInterruptCount(channel) * (engine ? engine->getEdgeDivider(channel) : 1) + pendingEdges[channel];
+}
+
+const char* SensorInput::getBackendName() {
+  return "sim";
+}
+
+#endif // ARDUINO
@@ -0,0 +1,115 @@
+#include "serial_frame.h"
+#include <string.h>
+
+uint16_t serialFrameCrc(const uint8_t* data, size_t length) {
+  // CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+size_t serialFrameEncode(uint8_t type, uint8_t sequence, const void* payload, size_t length, uint8_t* out) {
+  if (length > SERIAL_FRAME_MAX_PAYLOAD) {
+    return 0;
+  }
+
+  uint8_t raw[SERIAL_FRAME_MAX_RAW];
+  raw[0] = type;
+  raw[1] = sequence;
+  memcpy(raw + 2, payload, length);
+  uint16_t crc = serialFrameCrc(raw, length + 2);
+  raw[length + 2] = (uint8_t)crc;
+  raw[length + 3] = (uint8_t)(crc >> 8);
+  size_t rawLength = length + 4;
+
+  // COBS: every zero is replaced by the distance to the next one. Frames
+  // are shorter than 254 bytes, so a single code block never overflows.
+  size_t codeIndex = 0;
+  size_t n = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < rawLength; i++) {
+    if (raw[i] == 0) {
+      out[codeIndex] = code;
+      codeIndex = n++;
+      code = 1;
+    } else {
+      out[n++] = raw[i];
+      code++;
+    }
+  }
+  out[codeIndex] = code;
+  out[n++] = 0;  // Frame delimiter
+  return n;
+}
+
+SerialFrameDecoder::SerialFrameDecoder() :
+  encodedLength(0),
+  overflow(false),
+  frameLength(0),
+  lastSequence(0),
+  hasSequence(false),
+  frameCount(0),
+  badFrames(0),
+  lostFrames(0)
+{
+}
+
+bool SerialFrameDecoder::push(uint8_t byte) {
+  if (byte != 0) {
+    if (encodedLength < sizeof(encoded)) {
+      encoded[encodedLength++] = byte;
+    } else {
+      overflow = true;
+    }
+    return false;
+  }
+
+  // Delimiter - decode whatever was collected since the last one
+  bool valid = encodedLength > 0 && !overflow && decodeFrame();
+  if (!valid && (encodedLength > 0 || overflow)) {
+    badFrames++;
+  }
+  encodedLength = 0;
+  overflow = false;
+  if (!valid) {
+    return false;
+  }
+
+  if (hasSequence && (uint8_t)(getSequence() - lastSequence) > 1) {
+    lostFrames += (uint8_t)(getSequence() - lastSequence) - 1;
+  }
+  lastSequence = getSequence();
+  hasSequence = true;
+  frameCount++;
+  return true;
+}
+
+bool SerialFrameDecoder::decodeFrame() {
+  frameLength = 0;
+  size_t i = 0;
+  while (i < encodedLength) {
+    uint8_t code = encoded[i++];
+    if (code == 0 || i + code - 1 > encodedLength) {
+      return false;
+    }
+    for (uint8_t j = 1; j < code; j++) {
+      if (frameLength >= sizeof(frame)) return false;
+      frame[frameLength++] = encoded[i++];
+    }
+    if (code < 0xFF && i < encodedLength) {
+      if (frameLength >= sizeof(frame)) return false;
+      frame[frameLength++] = 0;
+    }
+  }
+
+  if (frameLength < 4) {
+    return false;
+  }
+  uint16_t crc = frame[frameLength - 2] | (frame[frameLength - 1] << 8);
+  return serialFrameCrc(frame, frameLength - 2) == crc;
+}
@@ -0,0 +1,60 @@
+#include "serial_stream.h"
+
+// Create the global instance
+SerialStream serialStream;
+
+SerialStream::SerialStream() :
+    port(nullptr),
+    mode(SERIAL_MODE_TEXT),
+    sequence(0),
+    sentCount(0),
+    droppedCount(0)
+{
+}
+
+void SerialStream::begin(HardwareSerial* port, SerialStreamMode mode) {
+    this->port = port;
+    this->mode = mode;
+}
+
+void SerialStream::sendSample(const SerialSampleRecord& sample) {
+    if (mode == SERIAL_MODE_TEXT) {
+        return;
+    }
+    sendFrame(SERIAL_RECORD_SAMPLE, &sample, sizeof(sample));
+}
+
+void SerialStream::sendEdge(uint8_t channel, uint32_t edgeTime) {
+    if (mode != SERIAL_MODE_EDGES) {
+        return;
+    }
+    SerialEdgeRecord edge;
+    edge.channel = channel;
+    edge.time = edgeTime;
+    sendFrame(SERIAL_RECORD_EDGE, &edge, sizeof(edge));
+}
+
+bool SerialStream::sendFrame(uint8_t type, const void* payload, size_t length) {
+    if (!port) {
+        return false;
+    }
+
+    // Leading delimiter so any text printed since the last frame stays a
+    // separate (invalid) frame instead of corrupting this one
+    uint8_t encoded[SERIAL_FRAME_MAX_ENCODED + 1];
+    encoded[0] = 0;
+    size_t encodedLength = serialFrameEncode(type, sequence++, payload, length, encoded + 1);
+    if (encodedLength > 0) {
+        encodedLength++;
+    }
+
+    // Never wait on the UART - drop the frame if it would not fit
+    if (encodedLength == 0 || port->availableForWrite() < (int)encodedLength) {
+        droppedCount++;
+        return false;
+    }
+
+    port->write(encoded, encodedLength);
+    sentCount++;
+    return true;
+}
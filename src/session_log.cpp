@@ -0,0 +1,235 @@
+#include "session_log.h"
+#include "instrumentation.h"
+
+SessionLogWriter::SessionLogWriter() :
+    file(nullptr),
+    card(nullptr),
+    firstSector(0),
+    lastSector(0),
+    sectorRecords(0),
+    sectorSequence(0),
+    totalRecords(0),
+    sectorDirty(false),
+    syncInterval(0),
+    lastSyncTime(0)
+{
+    memset(sector, 0, sizeof(sector));
+}
+
+bool SessionLogWriter::begin(FsFile* file, SdCard* card, uint32_t startTimestamp, uint32_t startMillis,
+                             uint32_t bootTimestamp, uint8_t wheelMagnets, uint8_t crankMagnets,
+                             unsigned long syncInterval) {
+    this->file = file;
+    this->syncInterval = syncInterval;
+    sectorRecords = 0;
+    sectorSequence = 0;
+    totalRecords = 0;
+    sectorDirty = false;
+    lastSyncTime = millis();
+    mapExtent(card);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SESSION_LOG_MAGIC, sizeof(header.magic));
+    header.version = SESSION_LOG_VERSION;
+    header.recordSize = sizeof(SessionLogRecord);
+    header.recordsPerSector = SESSION_LOG_RECORDS_PER_SECTOR;
+    header.wheelMagnets = wheelMagnets;
+    header.crankMagnets = crankMagnets;
+    header.startTimestamp = startTimestamp;
+    header.startMillis = startMillis;
+    header.bootTimestamp = bootTimestamp;
+    header.sessionId = esp_random();
+
+    if (!writeHeader() || !file->sync()) {
+        this->file = nullptr;
+        return false;
+    }
+
+    memset(sector, 0, sizeof(sector));
+    return true;
+}
+
+SessionLogRecovery SessionLogWriter::recover(FsFile* file, SdCard* card) {
+    this->file = file;
+    mapExtent(card);
+
+    if (!readFileSector(0, sector)) {
+        this->file = nullptr;
+        return SESSION_RECOVERY_CLEAN;  // Too short to be a log
+    }
+    memcpy(&header, sector, sizeof(header));
+    if (memcmp(header.magic, SESSION_LOG_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version < 3 || header.closed) {
+        this->file = nullptr;
+        return SESSION_RECOVERY_CLEAN;
+    }
+
+    // Keep every sector of this session up to the first gap, torn write
+    // or leftover sector from an earlier file; a partial sector is always
+    // the last one written
+    totalRecords = 0;
+    sectorSequence = 0;
+    while (readFileSector(sectorSequence + 1, sector)) {
+        SessionLogSectorHeader sectorHeader;
+        memcpy(&sectorHeader, sector, sizeof(sectorHeader));
+        if (sectorHeader.magic != SESSION_LOG_SECTOR_MAGIC ||
+            sectorHeader.sequence != sectorSequence ||
+            sectorHeader.sessionId != header.sessionId ||
+            sectorHeader.recordCount == 0 ||
+            sectorHeader.recordCount > SESSION_LOG_RECORDS_PER_SECTOR) {
+            break;
+        }
+        totalRecords += sectorHeader.recordCount;
+        sectorSequence++;
+        if (sectorHeader.recordCount < SESSION_LOG_RECORDS_PER_SECTOR) {
+            break;
+        }
+    }
+
+    // committedRecords is left as it was, so the caller can report how
+    // many rows were found beyond the last commit
+    header.closed = 1;
+    bool ok = truncateSectors(sectorSequence) && writeHeader() && file->sync();
+    this->file = nullptr;
+    return ok ? SESSION_RECOVERY_SALVAGED : SESSION_RECOVERY_FAILED;
+}
+
+bool SessionLogWriter::setBootTimestamp(uint32_t bootTimestamp) {
+    if (!file) {
+        return false;
+    }
+
+    // Synced with the next flush, like the data sectors
+    header.bootTimestamp = bootTimestamp;
+    return writeHeader();
+}
+
+bool SessionLogWriter::append(const SessionLogRecord& record, unsigned long currentTime) {
+    if (!file) {
+        return false;
+    }
+
+    size_t offset = sizeof(SessionLogSectorHeader) + sectorRecords * sizeof(SessionLogRecord);
+    memcpy(sector + offset, &record, sizeof(record));
+    sectorRecords++;
+    totalRecords++;
+    sectorDirty = true;
+
+    bool ok = true;
+    if (sectorRecords == SESSION_LOG_RECORDS_PER_SECTOR) {
+        // Full sector - write it and start the next one
+        ok = writeSector();
+        sectorSequence++;
+        sectorRecords = 0;
+        memset(sector, 0, sizeof(sector));
+    }
+
+    // Only pay for a partial sector write and sync once per durability window
+    if (currentTime - lastSyncTime >= syncInterval) {
+        ok = flush() && ok;
+    }
+
+    return ok;
+}
+
+bool SessionLogWriter::flush() {
+    if (!file) {
+        return false;
+    }
+
+    STAT_TIMER_START(flushStart);
+    bool ok = true;
+    if (sectorDirty) {
+        ok = writeSector();
+    }
+    lastSyncTime = millis();
+    ok = file->sync() && ok;
+
+    // Commit only rows that are known to be on the card
+    if (ok && header.committedRecords != totalRecords) {
+        header.committedRecords = totalRecords;
+        ok = writeHeader() && file->sync();
+    }
+    STAT_TIMER_STOP(HIST_SD_FLUSH, flushStart);
+    return ok;
+}
+
+void SessionLogWriter::end() {
+    if (!file) {
+        return;
+    }
+
+    // Marked closed only after the trim, so an interrupted end() is
+    // simply recovered again on the next boot
+    if (flush() && truncateSectors(sectorSequence + (sectorRecords > 0 ? 1 : 0)) && file->sync()) {
+        header.closed = 1;
+        if (writeHeader()) {
+            file->sync();
+        }
+    }
+    file = nullptr;
+}
+
+bool SessionLogWriter::writeSector() {
+    SessionLogSectorHeader header;
+    header.magic = SESSION_LOG_SECTOR_MAGIC;
+    header.recordCount = sectorRecords;
+    header.sequence = sectorSequence;
+    header.sessionId = this->header.sessionId;
+    memcpy(sector, &header, sizeof(header));
+
+    // Data sectors follow the header sector
+    STAT_TIMER_START(writeStart);
+    bool written = writeFileSector(sectorSequence + 1, sector);
+    STAT_TIMER_STOP(HIST_SD_SECTOR, writeStart);
+    if (!written) {
+        return false;
+    }
+
+    sectorDirty = false;
+    return true;
+}
+
+bool SessionLogWriter::writeHeader() {
+    // Sector 0 holds the file header, padded to a full sector
+    uint8_t headerSector[SESSION_LOG_SECTOR_SIZE];
+    memset(headerSector, 0, sizeof(headerSector));
+    memcpy(headerSector, &header, sizeof(header));
+
+    return writeFileSector(0, headerSector);
+}
+
+bool SessionLogWriter::writeFileSector(uint32_t index, const uint8_t* data) {
+    // Past the pre-allocated extent the file simply grows as before
+    if (card && firstSector + index <= lastSector) {
+        return card->writeSector(firstSector + index, data);
+    }
+    uint64_t position = (uint64_t)index * SESSION_LOG_SECTOR_SIZE;
+    return file->seekSet(position) && file->write(data, SESSION_LOG_SECTOR_SIZE) == SESSION_LOG_SECTOR_SIZE;
+}
+
+bool SessionLogWriter::readFileSector(uint32_t index, uint8_t* data) {
+    if (card && firstSector + index <= lastSector) {
+        return card->readSector(firstSector + index, data);
+    }
+    uint64_t position = (uint64_t)index * SESSION_LOG_SECTOR_SIZE;
+    return position + SESSION_LOG_SECTOR_SIZE <= file->fileSize() &&
+           file->seekSet(position) && file->read(data, SESSION_LOG_SECTOR_SIZE) == SESSION_LOG_SECTOR_SIZE;
+}
+
+void SessionLogWriter::mapExtent(SdCard* card) {
+    this->card = nullptr;
+    if (card && file->contiguousRange(&firstSector, &lastSector)) {
+        this->card = card;
+    }
+}
+
+bool SessionLogWriter::truncateSectors(uint32_t dataSectors) {
+    uint64_t length = (uint64_t)(dataSectors + 1) * SESSION_LOG_SECTOR_SIZE;
+    if (length >= file->fileSize()) {
+        return true;
+    }
+    // The file no longer covers the whole extent
+    card = nullptr;
+    return file->truncate(length);
+}
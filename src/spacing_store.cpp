@@ -0,0 +1,104 @@
+#include "spacing_store.h"
+#include <Preferences.h>
+#include <string.h>
+#include <stdio.h>
+
+// Create the global instance
+SpacingStore spacingStore;
+
+// One key per channel: "ch0", "ch1", ...
+static void keyFor(uint8_t channel, char* key, size_t size) {
+    snprintf(key, size, "ch%u", (unsigned)channel);
+}
+
+SpacingStore::SpacingStore() {
+    for (uint8_t ch = 0; ch < MAX_SENSOR_CHANNELS; ch++) {
+        saved[ch] = false;
+        savedRevolutions[ch] = 0;
+    }
+}
+
+uint8_t SpacingStore::load(SensorEngine& engine) {
+    Preferences preferences;
+    if (!preferences.begin(SPACING_STORE_NAMESPACE, true)) {
+        return 0;  // Nothing saved yet
+    }
+
+    uint8_t restored = 0;
+    for (uint8_t ch = 0; ch < engine.getChannelCount(); ch++) {
+        SpacingCalibrator& calibrator = engine.getSpacing(ch);
+        if (!calibrator.isEnabled()) {
+            continue;
+        }
+
+        char key[8];
+        keyFor(ch, key, sizeof(key));
+        SpacingTable table;
+        if (preferences.getBytesLength(key) != sizeof(table) ||
+            preferences.getBytes(key, &table, sizeof(table)) != sizeof(table)) {
+            continue;
+        }
+        if (calibrator.loadTable(table)) {
+            saved[ch] = true;
+            savedRevolutions[ch] = calibrator.getLearnedRevolutions();
+            restored++;
+        }
+    }
+    preferences.end();
+    return restored;
+}
+
+uint8_t SpacingStore::update(const SensorEngine& engine) {
+    // Find the tables worth writing before opening the namespace
+    bool due[MAX_SENSOR_CHANNELS];
+    bool anyDue = false;
+    for (uint8_t ch = 0; ch < engine.getChannelCount(); ch++) {
+        const SpacingCalibrator& calibrator = engine.getSpacing(ch);
+        due[ch] = calibrator.isCalibrated() &&
+                  (!saved[ch] || calibrator.getLearnedRevolutions() - savedRevolutions[ch] >= SPACING_SAVE_REVOLUTIONS);
+        anyDue = anyDue || due[ch];
+    }
+    if (!anyDue) {
+        return 0;
+    }
+
+    Preferences preferences;
+    if (!preferences.begin(SPACING_STORE_NAMESPACE, false)) {
+        return 0;
+    }
+
+    uint8_t written = 0;
+    for (uint8_t ch = 0; ch < engine.getChannelCount(); ch++) {
+        if (!due[ch]) {
+            continue;
+        }
+        const SpacingCalibrator& calibrator = engine.getSpacing(ch);
+        SpacingTable table;
+        memset(&table, 0, sizeof(table));
+        calibrator.getTable(table);
+
+        char key[8];
+        keyFor(ch, key, sizeof(key));
+        // Marked saved even if the write fails, so a full or worn
+        // partition is not retried on every pass
+        if (preferences.putBytes(key, &table, sizeof(table)) == sizeof(table)) {
+            written++;
+        }
+        saved[ch] = true;
+        savedRevolutions[ch] = calibrator.getLearnedRevolutions();
+    }
+    preferences.end();
+    return written;
+}
+
+void SpacingStore::clear() {
+    Preferences preferences;
+    if (preferences.begin(SPACING_STORE_NAMESPACE, false)) {
+        preferences.clear();
+        preferences.end();
+    }
+    for (uint8_t ch = 0; ch < MAX_SENSOR_CHANNELS; ch++) {
+        saved[ch] = false;
+        savedRevolutions[ch] = 0;
+    }
+}
@@ -0,0 +1,258 @@
+#include "telemetry_codec.h"
+#include <string.h>
+
+// Header layout: magic, version, sequence (2), boot time (4), sample count
+#define OFFSET_SEQUENCE 2
+#define OFFSET_BOOT_TIME 4
+#define OFFSET_COUNT 8
+
+static size_t writeVarint(uint8_t* out, uint32_t value) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+static bool readVarint(const uint8_t* data, size_t length, size_t& pos, uint32_t& value) {
+  value = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (pos >= length) {
+      return false;
+    }
+    uint8_t byte = data[pos++];
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static void writeLE16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+}
+
+static void writeLE32(uint8_t* out, uint32_t value) {
+  writeLE16(out, (uint16_t)value);
+  writeLE16(out + 2, (uint16_t)(value >> 16));
+}
+
+static uint16_t readLE16(const uint8_t* in) {
+  return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t readLE32(const uint8_t* in) {
+  return readLE16(in) | ((uint32_t)readLE16(in + 2) << 16);
+}
+
+void telemetryStampBootTime(uint8_t* frame, size_t length, uint32_t bootTime) {
+  if (length >= TELEMETRY_HEADER_SIZE && readLE32(frame + OFFSET_BOOT_TIME) == 0) {
+    writeLE32(frame + OFFSET_BOOT_TIME, bootTime);
+  }
+}
+
+TelemetryEncoder::TelemetryEncoder() :
+  length(0),
+  firstSampleTime(0)
+{
+  memset(&previous, 0, sizeof(previous));
+  begin(0, 0);
+}
+
+void TelemetryEncoder::begin(uint16_t sequence, uint32_t bootTime) {
+  frame[0] = TELEMETRY_MAGIC;
+  frame[1] = TELEMETRY_VERSION;
+  writeLE16(frame + OFFSET_SEQUENCE, sequence);
+  writeLE32(frame + OFFSET_BOOT_TIME, bootTime);
+  frame[OFFSET_COUNT] = 0;
+  length = TELEMETRY_HEADER_SIZE;
+}
+
+bool TelemetryEncoder::add(const TelemetrySample& sample) {
+  uint8_t encoded[TELEMETRY_MAX_SAMPLE_SIZE];
+  size_t n = 0;
+
+  if (frame[OFFSET_COUNT] == 0) {
+    // Keyframe - absolute values
+    n += writeVarint(encoded + n, sample.time);
+    n += writeVarint(encoded + n, sample.wheelRPM);
+    n += writeVarint(encoded + n, sample.cadenceRPM);
+    encoded[n++] = sample.chainring;
+    encoded[n++] = sample.sprocket;
+    n += writeVarint(encoded + n, sample.gearRatio);
+  } else {
+    // Deltas against the previous sample; time only moves forward
+    n += writeVarint(encoded + n, sample.time - previous.time);
+    n += writeVarint(encoded + n, zigzag((int32_t)sample.wheelRPM - previous.wheelRPM));
+    n += writeVarint(encoded + n, zigzag((int32_t)sample.cadenceRPM - previous.cadenceRPM));
+    n += writeVarint(encoded + n, zigzag((int32_t)sample.chainring - previous.chainring));
+    n += writeVarint(encoded + n, zigzag((int32_t)sample.sprocket - previous.sprocket));
+    n += writeVarint(encoded + n, zigzag((int32_t)sample.gearRatio - previous.gearRatio));
+  }
+
+  if (length + n > TELEMETRY_MAX_FRAME_SIZE || frame[OFFSET_COUNT] == 0xFF) {
+    return false;
+  }
+
+  if (frame[OFFSET_COUNT] == 0) {
+    firstSampleTime = sample.time;
+  }
+  memcpy(frame + length, encoded, n);
+  length += n;
+  frame[OFFSET_COUNT]++;
+  previous = sample;
+  return true;
+}
+
+TelemetryDecoder::TelemetryDecoder() :
+  lastSequence(0),
+  lastBootTime(0),
+  hasSequence(false),
+  frameCount(0),
+  lostFrames(0),
+  duplicateFrames(0)
+{
+}
+
+int TelemetryDecoder::decode(const uint8_t* data, size_t length, TelemetrySample* samples, size_t maxSamples) {
+  if (length < TELEMETRY_HEADER_SIZE || data[0] != TELEMETRY_MAGIC || data[1] != TELEMETRY_VERSION) {
+    return -1;
+  }
+
+  uint16_t sequence = readLE16(data + OFFSET_SEQUENCE);
+  uint8_t count = data[OFFSET_COUNT];
+  if (count > maxSamples) {
+    return -1;
+  }
+
+  // A retried frame whose first copy did arrive (only the ack was lost)
+  if (hasSequence && sequence == lastSequence) {
+    duplicateFrames++;
+    return 0;
+  }
+
+  size_t pos = TELEMETRY_HEADER_SIZE;
+  TelemetrySample current;
+  memset(&current, 0, sizeof(current));
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t values[6];
+    if (i == 0) {
+      if (!readVarint(data, length, pos, values[0]) ||
+          !readVarint(data, length, pos, values[1]) ||
+          !readVarint(data, length, pos, values[2]) ||
+          pos + 2 > length) {
+        return -1;
+      }
+      values[3] = data[pos++];
+      values[4] = data[pos++];
+      if (!readVarint(data, length, pos, values[5])) {
+        return -1;
+      }
+      current.time = values[0];
+      current.wheelRPM = (uint16_t)values[1];
+      current.cadenceRPM = (uint16_t)values[2];
+      current.chainring = (uint8_t)values[3];
+      current.sprocket = (uint8_t)values[4];
+      current.gearRatio = (uint16_t)values[5];
+    } else {
+      for (uint8_t f = 0; f < 6; f++) {
+        if (!readVarint(data, length, pos, values[f])) {
+          return -1;
+        }
+      }
+      current.time += values[0];
+      current.wheelRPM = (uint16_t)(current.wheelRPM + unzigzag(values[1]));
+      current.cadenceRPM = (uint16_t)(current.cadenceRPM + unzigzag(values[2]));
+      current.chainring = (uint8_t)(current.chainring + unzigzag(values[3]));
+      current.sprocket = (uint8_t)(current.sprocket + unzigzag(values[4]));
+      current.gearRatio = (uint16_t)(current.gearRatio + unzigzag(values[5]));
+    }
+    samples[i] = current;
+  }
+
+  // Any gap in the sequence means frames were lost in between
+  if (hasSequence) {
+    uint16_t gap = (uint16_t)(sequence - lastSequence);
+    if (gap > 1 && gap < 0x8000) {
+      lostFrames += gap - 1;
+    }
+  }
+  lastSequence = sequence;
+  lastBootTime = readLE32(data + OFFSET_BOOT_TIME);
+  hasSequence = true;
+  frameCount++;
+
+  return count;
+}
+
+TelemetryBatcher::TelemetryBatcher() :
+  send(nullptr),
+  context(nullptr),
+  maxLatency(0),
+  sequence(0),
+  framesSent(0),
+  sendFailures(0),
+  samplesSent(0),
+  bytesSent(0)
+{
+}
+
+void TelemetryBatcher::begin(uint32_t maxLatency, TelemetrySendFn send, void* context) {
+  this->maxLatency = maxLatency;
+  this->send = send;
+  this->context = context;
+  encoder.begin(sequence, 0);
+}
+
+void TelemetryBatcher::add(const TelemetrySample& sample, uint32_t bootTime) {
+  if (encoder.isEmpty()) {
+    encoder.begin(sequence, bootTime);
+  } else {
+    encoder.stampBootTime(bootTime);  // The clock synced while the frame filled
+  }
+  if (!encoder.add(sample)) {
+    // Frame is full - ship it and start the next one with this sample
+    flush();
+    encoder.begin(sequence, bootTime);
+    encoder.add(sample);
+  }
+}
+
+void TelemetryBatcher::update(uint32_t currentTime) {
+  if (!encoder.isEmpty() && currentTime - encoder.getFirstSampleTime() >= maxLatency) {
+    flush();
+  }
+}
+
+bool TelemetryBatcher::flush() {
+  if (encoder.isEmpty()) {
+    return true;
+  }
+
+  bool sent = send && send(encoder.data(), encoder.size(), context);
+  if (sent) {
+    framesSent++;
+    samplesSent += encoder.getSampleCount();
+    bytesSent += encoder.size();
+  } else {
+    sendFailures++;
+  }
+
+  // The sequence advances either way so the receiver sees the gap
+  sequence++;
+  encoder.begin(sequence, 0);
+  return sent;
+}
@@ -0,0 +1,133 @@
+#include "telemetry_link.h"
+#include <string.h>
+
+TelemetryLink::TelemetryLink() :
+  count(0),
+  inFlight(0),
+  transport(nullptr),
+  retryDeadline(0),
+  sentCount(0),
+  ackedCount(0),
+  retriedCount(0),
+  droppedCount(0),
+  coalescedCount(0)
+{
+}
+
+void TelemetryLink::begin(TelemetryTransport* transport, uint32_t retryDeadline) {
+  this->transport = transport;
+  this->retryDeadline = retryDeadline;
+  count = 0;
+  inFlight = 0;
+  completions.clear();
+}
+
+void TelemetryLink::submit(const uint8_t* data, size_t length, uint32_t currentTime) {
+  if (length > TELEMETRY_MAX_FRAME_SIZE) {
+    droppedCount++;
+    return;
+  }
+
+  if (count == TELEMETRY_QUEUE_FRAMES) {
+    // Backlogged - newer data is worth more than the oldest waiting frame
+    for (uint8_t i = 0; i < count; i++) {
+      if (frames[order[i]].state == FRAME_WAITING) {
+        remove(i);
+        droppedCount++;
+        coalescedCount++;
+        break;
+      }
+    }
+  }
+
+  // Find a free slot (the send window guarantees one is waiting, so there is one now)
+  uint8_t slot = 0;
+  for (; slot < TELEMETRY_QUEUE_FRAMES; slot++) {
+    bool used = false;
+    for (uint8_t i = 0; i < count; i++) {
+      if (order[i] == slot) {
+        used = true;
+        break;
+      }
+    }
+    if (!used) break;
+  }
+
+  Frame& frame = frames[slot];
+  memcpy(frame.data, data, length);
+  frame.length = (uint8_t)length;
+  frame.state = FRAME_WAITING;
+  frame.attempts = 0;
+  frame.queuedAt = currentTime;
+  order[count++] = slot;
+}
+
+void TelemetryLink::restartDeadlines(uint32_t currentTime, uint32_t bootTime) {
+  for (uint8_t i = 0; i < count; i++) {
+    Frame& frame = frames[order[i]];
+    frame.queuedAt = currentTime;
+    if (frame.state == FRAME_WAITING) {
+      telemetryStampBootTime(frame.data, frame.length, bootTime);
+    }
+  }
+}
+
+void TelemetryLink::update(uint32_t currentTime) {
+  // Send results arrive in send order, so each one belongs to the oldest in-flight frame
+  uint32_t result;
+  while (inFlight > 0 && completions.pop(result)) {
+    for (uint8_t i = 0; i < count; i++) {
+      Frame& frame = frames[order[i]];
+      if (frame.state != FRAME_IN_FLIGHT) continue;
+
+      inFlight--;
+      if (result) {
+        ackedCount++;
+        remove(i);
+      } else {
+        frame.state = FRAME_WAITING;  // Retried below if there is still time
+      }
+      break;
+    }
+  }
+
+  uint8_t i = 0;
+  while (i < count) {
+    Frame& frame = frames[order[i]];
+    if (frame.state == FRAME_IN_FLIGHT) {
+      i++;
+      continue;
+    }
+
+    if (currentTime - frame.queuedAt >= retryDeadline) {
+      droppedCount++;
+      remove(i);
+      continue;
+    }
+
+    if (inFlight >= TELEMETRY_SEND_WINDOW || !transport) {
+      i++;
+      continue;
+    }
+
+    if (!transport->send(frame.data, frame.length)) {
+      break;  // Radio busy - try again next pass
+    }
+
+    if (frame.attempts > 0) {
+      retriedCount++;
+    }
+    frame.attempts++;
+    frame.state = FRAME_IN_FLIGHT;
+    inFlight++;
+    sentCount++;
+    i++;
+  }
+}
+
+void TelemetryLink::remove(uint8_t position) {
+  for (uint8_t i = position; i + 1 < count; i++) {
+    order[i] = order[i + 1];
+  }
+  count--;
+}
@@ -1,76 +1,88 @@
 #include "wifi_manager.h"
+#include "config.h"
 
 // Create the global instance
 WiFiManager wifiManager;
 
 WiFiManager::WiFiManager() :
+    state(WIFI_STATE_IDLE),
+    stateSince(0),
     timeValid(false),
+    bootTimestamp(0),
     lastSyncTime(0),
     espNowHandle(0)
 {
     // Initialize controller MAC address (replace with your controller's MAC)
     uint8_t controllerMAC[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
     memcpy(controllerAddress, controllerMAC, 6);
+    
+    espNowTransport.setPeer(controllerAddress);
+    telemetryLink.begin(&espNowTransport, TELEMETRY_RETRY_DEADLINE);
+    telemetry.begin(TELEMETRY_MAX_LATENCY, queueFrame, this);
 }
 
-bool WiFiManager::begin() {
+void WiFiManager::start() {
     // Initialize Wi-Fi in station mode
     WiFi.mode(WIFI_STA);
     
-    // Connect to Wi-Fi
-    Serial.print("Connecting to Wi-Fi...");
+    // Connect to Wi-Fi - progress is checked in update()
+    Serial.println("Connecting to Wi-Fi...");
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD); // WIFI_SSID and WIFI_PASSWORD are defined in secret.h
-    
-    // Wait for connection with timeout
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
-    }
-    
-    if (WiFi.status() != WL_CONNECTED) {
-        Serial.println("Failed to connect to Wi-Fi");
-        return false;
-    }
-    
-    Serial.println("Connected to Wi-Fi");
-    
-    // Sync time
-    if (!syncTime()) {
-        Serial.println("Failed to sync time");
-        return false;
-    }
-    
-    // Initialize ESP-NOW
-    if (!initESPNow()) {
-        Serial.println("Failed to initialize ESP-NOW");
-        return false;
-    }
-    
-    return true;
+    enterState(WIFI_STATE_CONNECTING, millis());
 }
 
-bool WiFiManager::syncTime() {
-    // Configure NTP
-    configTime(NTP_GMT_OFFSET_SEC, NTP_DAYLIGHT_OFFSET_SEC, NTP_SERVER);
-    
-    // Wait for time to be set
-    int attempts = 0;
-    while (!timeValid && attempts < 10) {
-        struct tm timeinfo;
-        if (getLocalTime(&timeinfo)) {
-            timeValid = true;
-            lastSyncTime = time(nullptr);
-            Serial.println("Time synchronized successfully");
-            return true;
+void WiFiManager::update(unsigned long currentTime) {
+    switch (state) {
+        case WIFI_STATE_CONNECTING:
+            if (WiFi.status() == WL_CONNECTED) {
+                Serial.println("Connected to Wi-Fi");
+                configTime(NTP_GMT_OFFSET_SEC, NTP_DAYLIGHT_OFFSET_SEC, NTP_SERVER);
+                enterState(WIFI_STATE_SYNCING, currentTime);
+            } else if (currentTime - stateSince >= WIFI_CONNECT_TIMEOUT) {
+                // No time sync, but ESP-NOW does not need the access point
+                Serial.println("Failed to connect to Wi-Fi");
+                enterState(initESPNow() ? WIFI_STATE_READY : WIFI_STATE_FAILED, currentTime);
+            }
+            break;
+            
+        case WIFI_STATE_SYNCING: {
+            // Zero timeout - just check whether SNTP has set the clock yet
+            struct tm timeinfo;
+            if (getLocalTime(&timeinfo, 0)) {
+                timeValid = true;
+                lastSyncTime = time(nullptr);
+                bootTimestamp = lastSyncTime - millis() / 1000;
+                Serial.print("Time synchronized after ");
+                Serial.print(currentTime);
+                Serial.println(" ms");
+            } else if (currentTime - stateSince < NTP_SYNC_TIMEOUT) {
+                break;
+            } else {
+                Serial.println("Failed to get time from NTP");
+            }
+            
+            // Leave the access point but keep the radio in station mode for ESP-NOW
+            WiFi.disconnect();
+            enterState(initESPNow() ? WIFI_STATE_READY : WIFI_STATE_FAILED, currentTime);
+            break;
         }
-        delay(1000);
-        attempts++;
+            
+        default:
+            break;
+    }
+}
+
+void WiFiManager::enterState(WiFiState newState, unsigned long currentTime) {
+    state = newState;
+    stateSince = currentTime;
+    if (newState == WIFI_STATE_READY) {
+        // Frames queued during startup get their whole deadline from now,
+        // and the boot time if NTP has synced since they were built
+        telemetryLink.restartDeadlines(currentTime, getBootTimestamp());
+    }
+    if (newState == WIFI_STATE_FAILED) {
+        Serial.println("Failed to initialize ESP-NOW");
     }
-    
-    Serial.println("Failed to get time from NTP");
-    return false;
 }
 
 bool WiFiManager::initESPNow() {
@@ -98,18 +110,29 @@ bool WiFiManager::initESPNow() {
     return true;
 }
 
-bool WiFiManager::sendData(const SensorData& data) {
-    // Send data via ESP-NOW
-    esp_err_t result = esp_now_send(controllerAddress, (uint8_t*)&data, sizeof(SensorData));
+void WiFiManager::sendSample(const TelemetrySample& sample) {
+    telemetry.add(sample, getBootTimestamp());
+}
+
+void WiFiManager::updateTelemetry(uint32_t currentTime) {
+    telemetry.update(currentTime);
     
-    if (result != ESP_OK) {
-        Serial.println("Error sending data");
-        return false;
+    // Frames wait in the link queue until ESP-NOW is up
+    if (state == WIFI_STATE_READY) {
+        telemetryLink.update(currentTime);
     }
-    
+}
+
+bool WiFiManager::queueFrame(const uint8_t* data, size_t length, void* context) {
+    WiFiManager* manager = static_cast<WiFiManager*>(context);
+    manager->telemetryLink.submit(data, length, millis());
     return true;
 }
 
+bool EspNowTransport::send(const uint8_t* data, size_t length) {
+    return esp_now_send(peerAddress, data, length) == ESP_OK;
+}
+
 uint32_t WiFiManager::getCurrentTimestamp() const {
     if (!timeValid) {
         return 0;
@@ -123,7 +146,6 @@ void WiFiManager::disconnectWiFi() {
 }
 
 void WiFiManager::onDataSent(const uint8_t* mac_addr, esp_now_send_status_t status) {
-    if (status != ESP_NOW_SEND_SUCCESS) {
-        Serial.println("Error sending data");
-    }
+    // Runs on the Wi-Fi task - the link picks the result up in updateTelemetry()
+    wifiManager.telemetryLink.onSendComplete(status == ESP_NOW_SEND_SUCCESS);
 } 
\ No newline at end of file
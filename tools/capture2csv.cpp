@@ -0,0 +1,174 @@
+// Host-side converter for raw edge captures (session_*.edg) written next
+// to the session log. Prints one row per edge with the interval to the
+// previous accepted edge on that channel, or writes the "W,<micros>" /
+// "C,<micros>" edge table that tools/replay reads.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o capture2csv capture2csv.cpp
+// Usage: capture2csv [--replay] session_123.edg [out.csv]   (writes to stdout by default)
+//   --replay          Write an edge table for tools/replay instead of the per-edge CSV
+
+#include <stdio.h>
+#include <string.h>
+#include "edge_capture_format.h"
+
+#define CAPTURE_CSV_HEADER "Channel,Time(us),Interval(us),Accepted,RPM"
+
+static const char CHANNEL_NAMES[2] = {'W', 'C'};
+
+static bool convert(FILE* in, FILE* out, bool replay) {
+  uint8_t sector[SESSION_LOG_SECTOR_SIZE];
+
+  if (fread(sector, 1, sizeof(sector), in) != sizeof(sector)) {
+    fprintf(stderr, "Error: file is shorter than the header sector\n");
+    return false;
+  }
+
+  EdgeCaptureHeader header;
+  memcpy(&header, sector, sizeof(header));
+  if (memcmp(header.magic, EDGE_CAPTURE_MAGIC, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "Error: not an edge capture\n");
+    return false;
+  }
+  if (header.version < 1 || header.version > EDGE_CAPTURE_VERSION) {
+    fprintf(stderr, "Error: unsupported capture version %u\n", header.version);
+    return false;
+  }
+  uint8_t magnets[2] = {header.wheelMagnets, header.crankMagnets};
+  size_t dataOffset = edgeCaptureDataOffset(header);
+
+  if (!replay) {
+    fprintf(out, "%s\n", CAPTURE_CSV_HEADER);
+  }
+
+  // Times are unwrapped to 64-bit micros since the capture started
+  uint64_t clock = 0;
+  uint32_t clockRaw = header.startMicros;
+  uint64_t lastAccepted[2] = {0, 0};
+  bool hasAccepted[2] = {false, false};
+  uint32_t expectedSequence = 0;
+  unsigned long edgeCount = 0;
+  unsigned long rejectedCount = 0;
+  unsigned long droppedCount = 0;
+  unsigned long lostSectors = 0;
+
+  while (fread(sector, 1, sizeof(sector), in) == sizeof(sector)) {
+    EdgeCaptureSectorHeader sectorHeader;
+    memcpy(&sectorHeader, sector, sizeof(sectorHeader));
+
+    // Zeroed holes the card failed to take, torn sectors and anything
+    // left from another capture are skipped; the sequence number of the
+    // next good sector counts them. Version 1 files were neither
+    // truncated nor tagged, so there the first bad sector ends the capture.
+    if (sectorHeader.magic != EDGE_CAPTURE_SECTOR_MAGIC ||
+        sectorHeader.sequence < expectedSequence ||
+        sectorHeader.length > SESSION_LOG_SECTOR_SIZE - dataOffset ||
+        (header.version >= 2 && sectorHeader.captureId != header.captureId)) {
+      if (header.version < 2) {
+        break;
+      }
+      continue;
+    }
+
+    // A missing sector (card write failed) or dropped edges break the
+    // chain of intervals, but the base times keep later edges exact
+    if (sectorHeader.sequence != expectedSequence || sectorHeader.droppedEdges > 0) {
+      lostSectors += sectorHeader.sequence - expectedSequence;
+      droppedCount += sectorHeader.droppedEdges;
+      hasAccepted[0] = false;
+      hasAccepted[1] = false;
+    }
+    expectedSequence = sectorHeader.sequence + 1;
+
+    uint32_t base[2] = {sectorHeader.wheelBase, sectorHeader.cadenceBase};
+    uint64_t time[2];
+    for (uint8_t c = 0; c < 2; c++) {
+      // Bases are never older than the clock by more than one wrap
+      time[c] = clock + (int32_t)(base[c] - clockRaw);
+    }
+
+    const uint8_t* data = sector + dataOffset;
+    size_t pos = 0;
+    uint32_t delta;
+    uint8_t channel;
+    bool rejected;
+    while (pos < sectorHeader.length && edgeCaptureDecode(data, sectorHeader.length, pos, delta, channel, rejected)) {
+      time[channel] += delta;
+      uint64_t edgeTime = time[channel];
+      if (edgeTime > clock) {
+        clockRaw += (uint32_t)(edgeTime - clock);
+        clock = edgeTime;
+      }
+      edgeCount++;
+
+      if (replay) {
+        fprintf(out, "%c,%llu\n", CHANNEL_NAMES[channel], (unsigned long long)edgeTime);
+        continue;
+      }
+
+      fprintf(out, "%c,%llu,", CHANNEL_NAMES[channel], (unsigned long long)edgeTime);
+      if (rejected) {
+        rejectedCount++;
+        fprintf(out, ",0,\n");
+        continue;
+      }
+      if (hasAccepted[channel] && magnets[channel] > 0) {
+        uint64_t interval = edgeTime - lastAccepted[channel];
+        fprintf(out, "%llu,1,%.2f\n", (unsigned long long)interval,
+                interval > 0 ? 60000000.0 / ((double)interval * magnets[channel]) : 0.0);
+      } else {
+        fprintf(out, ",1,\n");
+      }
+      lastAccepted[channel] = edgeTime;
+      hasAccepted[channel] = true;
+    }
+  }
+
+  fprintf(stderr, "%lu edges (%lu rejected by the filter), %lu dropped on the board, %lu sectors missing\n",
+          edgeCount, rejectedCount, droppedCount, lostSectors);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* inputName = nullptr;
+  const char* outputName = nullptr;
+  bool replay = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0) {
+      replay = true;
+    } else if (!inputName) {
+      inputName = argv[i];
+    } else {
+      outputName = argv[i];
+    }
+  }
+
+  if (!inputName) {
+    fprintf(stderr, "Usage: %s [--replay] <session.edg> [output.csv]\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(inputName, "rb");
+  if (!in) {
+    fprintf(stderr, "Error: cannot open %s\n", inputName);
+    return 1;
+  }
+
+  FILE* out = stdout;
+  if (outputName) {
+    out = fopen(outputName, "w");
+    if (!out) {
+      fprintf(stderr, "Error: cannot create %s\n", outputName);
+      fclose(in);
+      return 1;
+    }
+  }
+
+  bool ok = convert(in, out, replay);
+
+  fclose(in);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+#ifndef CSV_ROW_H
+#define CSV_ROW_H
+
+#include <stdio.h>
+#include "session_log_format.h"
+
+// Print one session log row in the CSV layout of SESSION_LOG_CSV_HEADER
+inline void printCsvRow(FILE* out, const SessionLogRecord& record) {
+  fprintf(out, "%u,%u,%.1f,%.1f,%.1f,%.1f,%u,%u,%.2f\n",
+          record.timestamp,
+          record.elapsedTime,
+          (double)record.wheelRPM / SESSION_LOG_RPM_SCALE,
+          (double)record.cadenceRPM / SESSION_LOG_RPM_SCALE,
+          (double)record.sessionAvgWheelRPM / SESSION_LOG_RPM_SCALE,
+          (double)record.sessionAvgCadenceRPM / SESSION_LOG_RPM_SCALE,
+          record.chainring,
+          record.sprocket,
+          (double)record.gearRatio / SESSION_LOG_RATIO_SCALE);
+}
+
+#endif // CSV_ROW_H
@@ -0,0 +1,239 @@
+// Latency benchmark of the live readouts when the rider stops. A reading
+// is only updated by edges, so with one crank magnet the instant cadence
+// holds its last value until checkTimeouts() zeroes it TIMEOUT_PERIOD
+// later. The decayed readouts (SensorEngine::getDecayedMilliRPM) are
+// capped by the time since the last edge instead. Synthetic stop/start
+// profiles run through SensorEngine on a virtual clock; every 10 ms each
+// readout is compared with the true speed. For each profile, channel and
+// readout the tool prints the longest time from a true stop until the
+// readout shows zero, the mean absolute error, and the samples that read
+// zero while the sensor was still turning.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o decay_bench decay_bench.cpp ../src/sensor_engine.cpp
+// Usage: decay_bench [options]
+//   --gear <ratio>        Wheel RPM per crank RPM (default 3.2)
+//   --latency-us <n>      Max interrupt latency added to each timestamp (default 5)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "sensor_engine.h"
+
+// Virtual clock - advanced by the simulation only
+static uint64_t virtualMicros = 0;
+
+uint32_t clockMillis() {
+  return (uint32_t)(virtualMicros / 1000);
+}
+
+uint32_t clockMicros() {
+  return (uint32_t)virtualMicros;
+}
+
+#define LOOP_MICROS 1000
+#define SAMPLE_MICROS 10000
+#define SETTLE_MICROS 3000000  // No scoring until the readings had time to start
+
+// A profile is a list of segments: the crank speed ramps linearly from
+// the previous segment's end speed to rpm over the given seconds
+struct Segment {
+  double seconds;
+  double rpm;
+};
+
+struct Profile {
+  const char* name;
+  double startRPM;
+  Segment segments[8];
+  uint8_t segmentCount;
+};
+
+static const Profile PROFILES[] = {
+  {"stop",      90, {{10, 90}, {0, 0}, {5, 0}}, 3},
+  {"coast",     90, {{10, 90}, {4, 0}, {4, 0}}, 3},
+  {"stopstart", 90, {{6, 90}, {0, 0}, {3, 0}, {0, 90}, {6, 90}, {0, 0}, {4, 0}}, 7},
+  {"slowdown",  90, {{6, 90}, {10, 30}, {4, 30}, {0, 0}, {4, 0}}, 5},
+  {"slow",      40, {{20, 40}}, 1},
+};
+
+enum Readout { INSTANT, DECAYED, SMOOTHED, DECAYED_SMOOTHED, READOUT_COUNT };
+static const char* READOUT_NAMES[READOUT_COUNT] = {"instant", "decayed", "smoothed", "decayed-smoothed"};
+
+struct ReadoutResult {
+  double errorSum;        // Sum of |reading - truth| in RPM
+  double maxZeroLatency;  // Longest true stop to zero reading (ms)
+  unsigned long falseZeros;
+  unsigned long stops;
+  bool waitingForZero;
+};
+
+// Deterministic pseudo-random interrupt latency
+static uint32_t latencySeed = 1;
+
+static uint32_t latency(uint32_t maxMicros) {
+  latencySeed = latencySeed * 1103515245 + 12345;
+  return maxMicros > 0 ? (latencySeed >> 16) % (maxMicros + 1) : 0;
+}
+
+// Crank speed at time t (seconds from the start of the profile)
+static double crankRPMAt(const Profile& profile, double t) {
+  double start = 0;
+  double rpm = profile.startRPM;
+  for (uint8_t i = 0; i < profile.segmentCount; i++) {
+    const Segment& segment = profile.segments[i];
+    if (t < start + segment.seconds) {
+      return rpm + (segment.rpm - rpm) * (t - start) / segment.seconds;
+    }
+    start += segment.seconds;
+    rpm = segment.rpm;
+  }
+  return rpm;
+}
+
+static double lengthOf(const Profile& profile) {
+  double length = 0;
+  for (uint8_t i = 0; i < profile.segmentCount; i++) {
+    length += profile.segments[i].seconds;
+  }
+  return length;
+}
+
+static uint32_t readout(const SensorEngine& engine, uint8_t channel, uint8_t which) {
+  switch (which) {
+    case INSTANT: return engine.getInstantMilliRPM(channel);
+    case DECAYED: return engine.getDecayedMilliRPM(channel);
+    case SMOOTHED: return engine.getSmoothedMilliRPM(channel);
+    default: return engine.getDecayedSmoothedMilliRPM(channel);
+  }
+}
+
+static void run(const Profile& profile, double gear, uint32_t maxLatency,
+                ReadoutResult results[2][READOUT_COUNT], unsigned long* samples) {
+  static SensorEngine engine;
+  const SensorChannelConfig channels[2] = {
+    {SENSOR_PIN_NONE, WHEEL_MAGNETS, 1000, WHEEL_GLITCH_PERCENT, 1},
+    {SENSOR_PIN_NONE, CRANK_MAGNETS, 200, CADENCE_GLITCH_PERCENT, 1}
+  };
+  const double scale[2] = {gear, 1.0};
+
+  virtualMicros = 1000000;
+  engine.clearChannels();
+  engine.addChannel(channels[0]);
+  engine.addChannel(channels[1]);
+  engine.reset();
+  latencySeed = 1;
+  memset(results, 0, sizeof(ReadoutResult) * 2 * READOUT_COUNT);
+  *samples = 0;
+
+  // Sensor phase in edges, integrated over the 1 ms passes; the edge time
+  // is interpolated within the pass
+  double phase[2] = {0, 0};
+  uint64_t start = virtualMicros;
+  uint64_t end = start + (uint64_t)(lengthOf(profile) * 1e6);
+  uint64_t nextSample = start + SETTLE_MICROS;
+  uint64_t stopTime = 0;  // When the crank last came to a stop (0 while turning)
+
+  while (virtualMicros < end) {
+    uint64_t passStart = virtualMicros;
+    virtualMicros += LOOP_MICROS;
+    double t = (virtualMicros - start) / 1e6;
+    double crankRPM = crankRPMAt(profile, t);
+
+    for (uint8_t ch = 0; ch < 2; ch++) {
+      double edgesPerPass = crankRPM * scale[ch] / 60.0 * channels[ch].magnets * LOOP_MICROS / 1e6;
+      double next = floor(phase[ch]) + 1;
+      if (phase[ch] + edgesPerPass >= next) {
+        // The interrupt is taken by the end of the pass at the latest
+        uint64_t edgeTime = passStart + (uint64_t)((next - phase[ch]) / edgesPerPass * LOOP_MICROS) + latency(maxLatency);
+        engine.recordEdge(ch, (uint32_t)(edgeTime < virtualMicros ? edgeTime : virtualMicros));
+      }
+      phase[ch] += edgesPerPass;
+    }
+
+    engine.process();
+    engine.checkTimeouts();
+
+    if (crankRPM == 0 && stopTime == 0) {
+      stopTime = virtualMicros;
+      for (uint8_t ch = 0; ch < 2; ch++) {
+        for (uint8_t r = 0; r < READOUT_COUNT; r++) {
+          results[ch][r].waitingForZero = true;
+          results[ch][r].stops++;
+        }
+      }
+    } else if (crankRPM > 0) {
+      stopTime = 0;
+    }
+
+    // Latency to zero is measured on every pass, errors on the samples
+    for (uint8_t ch = 0; ch < 2; ch++) {
+      for (uint8_t r = 0; r < READOUT_COUNT; r++) {
+        ReadoutResult& result = results[ch][r];
+        uint32_t reading = readout(engine, ch, r);
+        if (result.waitingForZero && reading == 0) {
+          double latencyMs = (virtualMicros - stopTime) / 1000.0;
+          if (latencyMs > result.maxZeroLatency) {
+            result.maxZeroLatency = latencyMs;
+          }
+          result.waitingForZero = false;
+        }
+        if (virtualMicros >= nextSample) {
+          double truth = crankRPM * scale[ch];
+          result.errorSum += fabs(reading / (double)MILLI_RPM_PER_RPM - truth);
+          if (reading == 0 && truth > 0) {
+            result.falseZeros++;
+          }
+        }
+      }
+    }
+    if (virtualMicros >= nextSample) {
+      (*samples)++;
+      nextSample += SAMPLE_MICROS;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  double gear = 3.2;
+  uint32_t maxLatency = 5;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--gear") == 0 && i + 1 < argc) {
+      gear = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--latency-us") == 0 && i + 1 < argc) {
+      maxLatency = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--gear <ratio>] [--latency-us <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (gear <= 0) {
+    fprintf(stderr, "Error: --gear must be positive\n");
+    return 2;
+  }
+
+  const char* channelNames[2] = {"wheel", "crank"};
+  printf("Profile,Channel,Readout,Stop to zero(ms),Mean error(rpm),False zeros\n");
+  for (size_t p = 0; p < sizeof(PROFILES) / sizeof(PROFILES[0]); p++) {
+    ReadoutResult results[2][READOUT_COUNT];
+    unsigned long samples;
+    run(PROFILES[p], gear, maxLatency, results, &samples);
+    for (uint8_t ch = 0; ch < 2; ch++) {
+      for (uint8_t r = 0; r < READOUT_COUNT; r++) {
+        const ReadoutResult& result = results[ch][r];
+        // A readout still non-zero when the profile ends never reached zero
+        if (result.stops == 0) {
+          printf("%s,%s,%s,-,", PROFILES[p].name, channelNames[ch], READOUT_NAMES[r]);
+        } else if (result.waitingForZero) {
+          printf("%s,%s,%s,never,", PROFILES[p].name, channelNames[ch], READOUT_NAMES[r]);
+        } else {
+          printf("%s,%s,%s,%.0f,", PROFILES[p].name, channelNames[ch], READOUT_NAMES[r], result.maxZeroLatency);
+        }
+        printf("%.2f,%lu\n", samples > 0 ? result.errorSum / samples : 0.0, result.falseZeros);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,217 @@
+// Stress test of EdgeBuffer, the ring the sensor ISRs queue edge
+// timestamps in (see include/edge_buffer.h). Every case runs twice:
+//   - threads: a producer thread stands in for the ISR and pushes
+//     synthetic edge trains at several kHz while the consumer drains the
+//     ring the way loop() does, once per loop period. This is the race
+//     test; how many edges the ring refuses depends on the host's
+//     scheduler, so only the accounting is checked: every refused edge is
+//     one gap in the received sequence and one counted overflow, and
+//     nothing arrives torn.
+//   - lockstep: the same trains on a virtual clock in one thread, every
+//     edge due by a loop pass pushed before the pass drains the ring.
+//     The refusals must also match a plain count of what the ring can
+//     hold, so with a 1 ms loop and no stall none are allowed.
+// Every timestamp is a multiple of the edge period, so the consumer can
+// tell which edge it got: a value that is not the next one expected is a
+// drop (the gap is counted), an old or malformed one a torn read. Some
+// cases stall the consumer long enough to fill the ring.
+//
+// Build: g++ -std=c++11 -O2 -pthread -I../include -o edge_buffer_stress edge_buffer_stress.cpp
+// Usage: edge_buffer_stress [options]
+//   --seconds <n>   Run time per case (default 2)
+//   --loop-us <n>   Consumer drain period (default 1000)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "edge_buffer.h"
+#include "sensor_engine.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Case {
+  uint32_t rate;          // Edges per second
+  uint32_t stallEvery;    // Consumer stalls every n ms (0 = never)
+  uint32_t stallMillis;
+};
+
+// 14 wheel magnets at 1000 RPM are 233 edges/s; the faster trains cover
+// bouncing sensors and the pulse rates of other setups
+static const Case CASES[] = {
+  {1000, 0, 0},
+  {2000, 0, 0},
+  {5000, 0, 0},
+  {10000, 0, 0},
+  {5000, 200, 30},
+  {10000, 100, 20},
+};
+
+struct Result {
+  unsigned long expectedRefused;  // Lockstep only: what a count of queued edges says cannot fit
+  unsigned long pushed;
+  unsigned long refused;    // push() returned false
+  unsigned long received;
+  unsigned long gaps;       // Edges missing from the received sequence
+  unsigned long torn;       // Not a timestamp the producer wrote, or out of order
+  uint32_t overflows;       // The ring's own count
+};
+
+static EdgeBuffer<SENSOR_EDGE_BUFFER_SIZE>* ring;
+static std::atomic<bool> producing(false);
+
+// Pushes edge k with timestamp k x period once its time has come; the
+// thread wakes every 50 us and catches up, like an ISR taken late
+static void produce(uint32_t period, unsigned long edges, Result* result) {
+  Clock::time_point start = Clock::now();
+  unsigned long k = 1;
+  while (k <= edges) {
+    uint64_t dueMicros = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    while (k <= edges && (uint64_t)k * period <= dueMicros) {
+      if (ring->push((uint32_t)(k * period))) {
+        result->pushed++;
+      } else {
+        result->refused++;
+      }
+      k++;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+  producing.store(false, std::memory_order_release);
+}
+
+// Pop everything queued and check it against the edges expected next;
+// previous is the edge index of the last timestamp received
+static void drain(uint32_t period, uint32_t& previous, Result* result) {
+  uint32_t timestamp;
+  while (ring->pop(timestamp)) {
+    result->received++;
+    uint32_t k = timestamp / period;
+    if (timestamp % period != 0 || k <= previous) {
+      result->torn++;
+      continue;
+    }
+    result->gaps += k - previous - 1;
+    previous = k;
+  }
+}
+
+static void consume(uint32_t period, const Case& test, uint32_t loopMicros, Result* result) {
+  uint32_t previous = 0;
+  Clock::time_point start = Clock::now();
+  Clock::time_point nextStall = start + std::chrono::milliseconds(test.stallEvery);
+  for (;;) {
+    // Read the flag before draining so nothing pushed before it is missed
+    bool last = !producing.load(std::memory_order_acquire);
+    drain(period, previous, result);
+    if (last) {
+      break;
+    }
+
+    if (test.stallEvery > 0 && Clock::now() >= nextStall) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(test.stallMillis));
+      nextStall += std::chrono::milliseconds(test.stallEvery);
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(loopMicros));
+    }
+  }
+}
+
+// The lockstep run: passes every loopMicros of virtual time, or after a
+// stall; all edges due by a pass are pushed before it drains
+static void lockstep(uint32_t period, const Case& test, uint32_t loopMicros, unsigned long edges, Result* result) {
+  uint32_t previous = 0;
+  uint32_t queued = 0;
+  unsigned long k = 1;
+  uint64_t now = 0;
+  uint64_t nextStall = (uint64_t)test.stallEvery * 1000;
+  while (k <= edges) {
+    if (test.stallEvery > 0 && now >= nextStall) {
+      now += (uint64_t)test.stallMillis * 1000;
+      nextStall += (uint64_t)test.stallEvery * 1000;
+    } else {
+      now += loopMicros;
+    }
+
+    for (; k <= edges && (uint64_t)k * period <= now; k++) {
+      if (queued < SENSOR_EDGE_BUFFER_SIZE) {
+        queued++;
+      } else {
+        result->expectedRefused++;
+      }
+      if (ring->push((uint32_t)(k * period))) {
+        result->pushed++;
+      } else {
+        result->refused++;
+      }
+    }
+    drain(period, previous, result);
+    queued = 0;
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned long seconds = 2;
+  uint32_t loopMicros = 1000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+      loopMicros = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--seconds <n>] [--loop-us <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (seconds == 0 || loopMicros == 0) {
+    fprintf(stderr, "Error: --seconds and --loop-us must be non-zero\n");
+    return 2;
+  }
+
+  bool failed = false;
+  printf("Mode,Rate(Hz),Stall,Pushed,Received,Overflows,Gaps,Torn,Result\n");
+  for (int threaded = 1; threaded >= 0; threaded--) {
+    for (size_t c = 0; c < sizeof(CASES) / sizeof(CASES[0]); c++) {
+      const Case& test = CASES[c];
+      uint32_t period = 1000000 / test.rate;
+      Result result;
+      memset(&result, 0, sizeof(result));
+
+      EdgeBuffer<SENSOR_EDGE_BUFFER_SIZE> buffer;
+      ring = &buffer;
+      if (threaded) {
+        producing.store(true);
+        std::thread consumer(consume, period, test, loopMicros, &result);
+        std::thread producer(produce, period, seconds * test.rate, &result);
+        producer.join();
+        consumer.join();
+      } else {
+        lockstep(period, test, loopMicros, seconds * test.rate, &result);
+      }
+      result.overflows = buffer.getOverflowCount();
+
+      // Every edge arrives intact unless the ring was full, and every edge
+      // the ring refused is counted once; in lockstep exactly the edges
+      // that did not fit are refused
+      bool ok = result.torn == 0 &&
+                result.received == result.pushed &&
+                result.gaps == result.refused &&
+                result.overflows == result.refused &&
+                (threaded || result.refused == result.expectedRefused);
+      failed = failed || !ok;
+
+      char stall[24];
+      if (test.stallEvery > 0) {
+        snprintf(stall, sizeof(stall), "%ums/%ums", test.stallMillis, test.stallEvery);
+      } else {
+        snprintf(stall, sizeof(stall), "none");
+      }
+      printf("%s,%u,%s,%lu,%lu,%u,%lu,%lu,%s\n", threaded ? "threads" : "lockstep", test.rate, stall,
+             result.pushed, result.received, result.overflows, result.gaps, result.torn, ok ? "ok" : "FAIL");
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+// Host benchmark of SensorEngine: runs the same simulated ride on 0..N
+// channels and reports the processing cost per loop() pass and per edge,
+// to show how the structure-of-arrays passes scale with channel count.
+// Every channel sees its own steady edge train (wheel-like and crank-like
+// channels alternate) on a virtual clock; only the engine calls are timed.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o engine_bench engine_bench.cpp ../src/sensor_engine.cpp
+// Usage: engine_bench [--seconds <n>] [--loop-us <n>]
+//   --seconds <n>     Simulated ride length per channel count (default 600)
+//   --loop-us <n>     Simulated loop() period in microseconds (default 1000)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "sensor_engine.h"
+
+// Virtual clock - advanced by the simulation only
+static uint64_t virtualMicros = 0;
+
+uint32_t clockMillis() {
+  return (uint32_t)(virtualMicros / 1000);
+}
+
+uint32_t clockMicros() {
+  return (uint32_t)virtualMicros;
+}
+
+// Wheel-like channels (14 magnets around 280 RPM) alternate with
+// crank-like ones (1 magnet around 90 RPM); each channel is slightly
+// detuned so edges do not line up across channels
+static SensorChannelConfig channelFor(uint8_t channel) {
+  SensorChannelConfig config;
+  config.pin = SENSOR_PIN_NONE;
+  config.magnets = (channel % 2 == 0) ? 14 : 1;
+  config.maxRPM = (channel % 2 == 0) ? 1000 : 200;
+  config.glitchPercent = (channel % 2 == 0) ? 30 : 50;
+  config.edgeDivider = 1;
+  return config;
+}
+
+static uint32_t periodFor(uint8_t channel) {
+  uint32_t rpm = (channel % 2 == 0) ? 280 : 90;
+  uint8_t magnets = (channel % 2 == 0) ? 14 : 1;
+  return 60000000UL / (rpm * magnets) + channel * 7;
+}
+
+struct BenchResult {
+  unsigned long passes;
+  unsigned long edges;
+  double nanoseconds;
+};
+
+static BenchResult run(uint8_t channelCount, uint32_t seconds, uint32_t loopMicros) {
+  static SensorEngine engine;
+  virtualMicros = 1000000;
+  engine.clearChannels();
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    engine.addChannel(channelFor(ch));
+  }
+  engine.reset();
+  engine.startNewSession();
+
+  uint64_t nextEdge[MAX_SENSOR_CHANNELS];
+  uint32_t period[MAX_SENSOR_CHANNELS];
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    period[ch] = periodFor(ch);
+    nextEdge[ch] = virtualMicros + period[ch] / (ch + 2);
+  }
+
+  BenchResult result = {0, 0, 0.0};
+  uint64_t end = virtualMicros + (uint64_t)seconds * 1000000;
+  std::chrono::steady_clock::duration elapsed(0);
+  while (virtualMicros < end) {
+    virtualMicros += loopMicros;
+
+    // Queue what the ISRs would have seen since the last pass (not timed)
+    for (uint8_t ch = 0; ch < channelCount; ch++) {
+      while (nextEdge[ch] <= virtualMicros) {
+        engine.recordEdge(ch, (uint32_t)nextEdge[ch]);
+        nextEdge[ch] += period[ch];
+        result.edges++;
+      }
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    engine.process();
+    engine.checkTimeouts();
+    elapsed += std::chrono::steady_clock::now() - start;
+    result.passes++;
+  }
+
+  // Keep the results observable so nothing is optimized away
+  uint32_t checksum = 0;
+  for (uint8_t ch = 0; ch < channelCount; ch++) {
+    checksum += engine.getInstantMilliRPM(ch);
+  }
+  if (channelCount > 0 && checksum == 0) {
+    fprintf(stderr, "Warning: no channel reported RPM\n");
+  }
+
+  result.nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  return result;
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds = 600;
+  uint32_t loopMicros = 1000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+      loopMicros = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--seconds <n>] [--loop-us <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (seconds == 0 || loopMicros == 0) {
+    fprintf(stderr, "Error: --seconds and --loop-us must be non-zero\n");
+    return 2;
+  }
+
+  // The zero-channel row is the fixed cost of a pass plus the timer itself
+  printf("Channels,Edges,Passes,ns/pass,ns/edge,ns/pass/channel\n");
+  for (uint8_t channels = 0; channels <= MAX_SENSOR_CHANNELS; channels++) {
+    BenchResult result = run(channels, seconds, loopMicros);
+    double perPass = result.nanoseconds / result.passes;
+    printf("%u,%lu,%lu,%.1f,%.1f,%.1f\n", channels, result.edges, result.passes, perPass,
+           result.edges > 0 ? result.nanoseconds / result.edges : 0.0,
+           channels > 0 ? perPass / channels : 0.0);
+  }
+  return 0;
+}
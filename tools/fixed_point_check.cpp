@@ -0,0 +1,269 @@
+// Bit-accuracy check and cycle benchmark of the fixed-point RPM maths
+// (edgeMilliRPMFor() and batchMilliRPMFor() in include/sensor_engine.h)
+// against the float formula they replaced, 60e6 / (interval x magnets).
+// For every magnet count and edge divider the engine accepts, a
+// repeatable sweep of edge intervals plus seeded random ones and random
+// batches is converted both ways and compared with the exact result,
+// computed in integers. The fixed-point per-edge value must equal the
+// exact one rounded down and the batch value may be at most 1 milli-RPM
+// below it; the float path is reported for comparison. A steady train is
+// also run through SensorEngine itself, whose readings must match. Exits
+// 1 if the fixed-point path is ever off.
+//
+// --bench instead times each conversion (ns per call, and TSC cycles on
+// x86). Host CPUs divide 64-bit integers and floats in hardware, so the
+// ratios only hint at the ESP32, which does neither.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o fixed_point_check fixed_point_check.cpp ../src/sensor_engine.cpp
+// Usage: fixed_point_check [--bench] [--seed <n>]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "sensor_engine.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+// Virtual clock - advanced by the engine check only
+static uint64_t virtualMicros = 0;
+
+uint32_t clockMillis() {
+  return (uint32_t)(virtualMicros / 1000);
+}
+
+uint32_t clockMicros() {
+  return (uint32_t)virtualMicros;
+}
+
+#define MIN_INTERVAL 100           // 600 000 RPM with one magnet - past any plausible reading
+#define MAX_INTERVAL 60000000      // SensorEngine restarts past 60 s
+#define SWEEP_STEPS 4000           // Geometric sweep between the two
+#define RANDOM_INTERVALS 20000
+#define RANDOM_BATCHES 20000
+#define MAX_BATCH_EDGES 16
+
+struct Layout {
+  uint8_t magnets;
+  uint8_t edgeDivider;
+};
+
+static std::vector<Layout> layouts() {
+  std::vector<Layout> result;
+  for (uint8_t magnets = 1; magnets <= 32; magnets++) {
+    for (uint8_t divider = 1; divider <= magnets; divider++) {
+      if (magnets % divider == 0) {
+        Layout layout = {magnets, divider};
+        result.push_back(layout);
+      }
+    }
+  }
+  return result;
+}
+
+static uint64_t numeratorFor(const Layout& layout) {
+  return MILLI_RPM_MINUTE * layout.edgeDivider / layout.magnets;
+}
+
+// Exact milli-RPM rounded down
+static uint64_t exactEdge(const Layout& layout, uint32_t interval) {
+  return (MILLI_RPM_MINUTE * layout.edgeDivider) / ((uint64_t)layout.magnets * interval);
+}
+
+static uint64_t exactBatch(const Layout& layout, uint32_t edges, uint64_t time) {
+  return (MILLI_RPM_MINUTE * layout.edgeDivider * edges) / ((uint64_t)layout.magnets * time);
+}
+
+// Exact milli-RPM, for judging the float path
+static long double realBatch(const Layout& layout, uint32_t edges, uint64_t time) {
+  return (long double)(MILLI_RPM_MINUTE * layout.edgeDivider * edges) / ((long double)layout.magnets * time);
+}
+
+// The float path as the firmware had it, in milli-RPM
+static float floatEdge(const Layout& layout, uint32_t interval) {
+  return 60000000.0f / ((float)interval * layout.magnets / layout.edgeDivider) * 1000.0f;
+}
+
+static float floatBatch(const Layout& layout, uint32_t edges, uint64_t time) {
+  return (float)edges * 60000000.0f / ((float)time * layout.magnets / layout.edgeDivider) * 1000.0f;
+}
+
+struct Accuracy {
+  unsigned long values;
+  unsigned long fixedMismatches;
+  uint64_t fixedMaxError;       // milli-RPM
+  unsigned long floatMismatches;  // More than 1 milli-RPM from the exact value
+  double floatMaxError;
+  double floatMaxRelative;
+};
+
+static void compare(Accuracy& accuracy, uint64_t exact, long double real, uint32_t fixed, float approximate,
+                    uint64_t allowed) {
+  accuracy.values++;
+  uint64_t fixedError = fixed > exact ? fixed - exact : exact - fixed;
+  if (fixed > exact || fixedError > allowed) {
+    accuracy.fixedMismatches++;
+  }
+  if (fixedError > accuracy.fixedMaxError) {
+    accuracy.fixedMaxError = fixedError;
+  }
+
+  double floatError = (double)((long double)approximate - real);
+  floatError = floatError < 0 ? -floatError : floatError;
+  if (floatError > 1.0) {
+    accuracy.floatMismatches++;
+  }
+  if (floatError > accuracy.floatMaxError) {
+    accuracy.floatMaxError = floatError;
+  }
+  if (floatError / (double)real > accuracy.floatMaxRelative) {
+    accuracy.floatMaxRelative = floatError / (double)real;
+  }
+}
+
+// Readings a steady train leaves in the engine must be the exact ones
+static bool checkEngine(const Layout& layout, uint32_t interval) {
+  static SensorEngine engine;
+  SensorChannelConfig config = {SENSOR_PIN_NONE, layout.magnets, 60000, 0, layout.edgeDivider};
+  engine.clearChannels();
+  if (engine.addChannel(config) < 0) {
+    return false;
+  }
+  engine.reset();
+
+  virtualMicros = 1000000;
+  for (uint8_t i = 0; i <= 4; i++) {
+    engine.processEdge(0, (uint32_t)virtualMicros);
+    virtualMicros += interval;
+  }
+  virtualMicros -= interval;
+  engine.process();
+
+  uint64_t edge = exactEdge(layout, interval);
+  uint64_t batch = exactBatch(layout, 4, (uint64_t)interval * 4);
+  uint32_t instant = engine.getInstantMilliRPM(0);
+  return engine.getEdgeStats(0).max() == edge &&
+         (instant == batch || instant + 1 == batch || batch > 60000ULL * MILLI_RPM_PER_RPM);
+}
+
+static int runAccuracy(uint32_t seed) {
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<uint32_t> anyInterval(MIN_INTERVAL, MAX_INTERVAL - 1);
+  std::uniform_int_distribution<uint32_t> batchSize(1, MAX_BATCH_EDGES);
+  bool failed = false;
+
+  printf("Magnets,EdgeDivider,Values,FixedMismatches,FixedMaxError(mRPM),FloatOver1mRPM,FloatMaxError(mRPM),FloatMaxRelative,Engine,Result\n");
+  std::vector<Layout> all = layouts();
+  for (size_t l = 0; l < all.size(); l++) {
+    const Layout& layout = all[l];
+    uint64_t numerator = numeratorFor(layout);
+    Accuracy edges;
+    memset(&edges, 0, sizeof(edges));
+
+    // Per edge: a geometric sweep, then random intervals
+    for (uint32_t step = 0; step <= SWEEP_STEPS; step++) {
+      double fraction = (double)step / SWEEP_STEPS;
+      uint32_t interval = (uint32_t)(MIN_INTERVAL * pow((double)MAX_INTERVAL / MIN_INTERVAL, fraction));
+      interval = interval >= MAX_INTERVAL ? MAX_INTERVAL - 1 : interval;
+      compare(edges, exactEdge(layout, interval), realBatch(layout, 1, interval), edgeMilliRPMFor(numerator, interval),
+              floatEdge(layout, interval), 0);
+    }
+    for (uint32_t i = 0; i < RANDOM_INTERVALS; i++) {
+      uint32_t interval = anyInterval(random);
+      compare(edges, exactEdge(layout, interval), realBatch(layout, 1, interval), edgeMilliRPMFor(numerator, interval),
+              floatEdge(layout, interval), 0);
+    }
+
+    // Batches of random intervals; the truncated numerator may cost one
+    for (uint32_t i = 0; i < RANDOM_BATCHES; i++) {
+      uint32_t count = batchSize(random);
+      uint64_t time = 0;
+      for (uint32_t e = 0; e < count; e++) {
+        time += anyInterval(random) / count;
+      }
+      compare(edges, exactBatch(layout, count, time), realBatch(layout, count, time),
+              batchMilliRPMFor(numerator, count, time), floatBatch(layout, count, time), 1);
+    }
+
+    bool engineOk = checkEngine(layout, 15306) && checkEngine(layout, 666667) && checkEngine(layout, 1234);
+    bool ok = edges.fixedMismatches == 0 && engineOk;
+    failed = failed || !ok;
+    printf("%u,%u,%lu,%lu,%llu,%lu,%.1f,%.2e,%s,%s\n", layout.magnets, layout.edgeDivider, edges.values,
+           edges.fixedMismatches, (unsigned long long)edges.fixedMaxError, edges.floatMismatches,
+           edges.floatMaxError, edges.floatMaxRelative, engineOk ? "ok" : "FAIL", ok ? "ok" : "FAIL");
+  }
+  return failed ? 1 : 0;
+}
+
+// Times one conversion over a fixed table of intervals
+template <typename Convert>
+static void bench(const char* name, const std::vector<uint32_t>& intervals, unsigned long passes, Convert convert) {
+  volatile double sink = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#ifdef HAVE_TSC
+  uint64_t startCycles = __rdtsc();
+#endif
+  for (unsigned long pass = 0; pass < passes; pass++) {
+    double total = 0;
+    for (size_t i = 0; i < intervals.size(); i++) {
+      total += convert(intervals[i]);
+    }
+    sink = sink + total;
+  }
+#ifdef HAVE_TSC
+  double cycles = (double)(__rdtsc() - startCycles);
+#else
+  double cycles = 0;
+#endif
+  double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  double calls = (double)passes * intervals.size();
+  printf("%s,%.0f,%.2f,%.1f\n", name, calls, nanoseconds / calls, cycles / calls);
+}
+
+static int runBench(uint32_t seed) {
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<uint32_t> interval(2000, 2000000);
+  std::vector<uint32_t> intervals(4096);
+  for (size_t i = 0; i < intervals.size(); i++) {
+    intervals[i] = interval(random);
+  }
+
+  const Layout wheel = {14, 1};  // Numerator fits 32 bits
+  const Layout crank = {1, 1};   // 64-bit numerator
+  const uint64_t wheelNumerator = numeratorFor(wheel);
+  const uint64_t crankNumerator = numeratorFor(crank);
+  const unsigned long passes = 2000;
+
+  // Cycles are TSC ticks (0 where there is no TSC)
+  printf("Conversion,Calls,ns/call,cycles/call\n");
+  bench("edge-fixed-32bit", intervals, passes, [&](uint32_t i) { return (double)edgeMilliRPMFor(wheelNumerator, i); });
+  bench("edge-fixed-64bit", intervals, passes, [&](uint32_t i) { return (double)edgeMilliRPMFor(crankNumerator, i); });
+  bench("edge-float", intervals, passes, [&](uint32_t i) { return (double)floatEdge(wheel, i); });
+  bench("batch-fixed", intervals, passes, [&](uint32_t i) { return (double)batchMilliRPMFor(wheelNumerator, 4, (uint64_t)i * 4); });
+  bench("batch-float", intervals, passes, [&](uint32_t i) { return (double)floatBatch(wheel, 4, (uint64_t)i * 4); });
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  bool benchmark = false;
+  uint32_t seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--bench") == 0) {
+      benchmark = true;
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--bench] [--seed <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  return benchmark ? runBench(seed) : runAccuracy(seed);
+}
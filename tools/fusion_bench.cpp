@@ -0,0 +1,350 @@
+// Accuracy check of the wheel-derived cadence (CadenceFusion). Synthetic
+// rides - steady riding, cadence intervals, shifts and freewheeling - are
+// turned into wheel and crank edges and replayed through RPMCalculator on
+// a virtual clock, the way tools/replay runs a ride. Every 10 ms the live
+// cadence the firmware streams is compared with the true cadence, once
+// from the crank alone (the decayed crank reading) and once fused. For
+// each ride the tool prints the mean and 95th percentile error, how often
+// the reading changes, and the share of time the fused value was locked.
+//
+// With --edges the tool replays a captured edge table instead (the format
+// replay reads); there is no true cadence then, so it prints how far the
+// fused cadence was from each crank edge's own reading just before that
+// edge arrived. --write-edges saves a synthetic ride as such a table.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o fusion_bench fusion_bench.cpp ../src/rpm_calculator.cpp ../src/sensor_engine.cpp ../src/gear_estimator.cpp ../src/cadence_fusion.cpp ../src/event_loop.cpp
+// Usage: fusion_bench [options]
+//   --edges <file>         Check a captured edge table ("W,<micros>" / "C,<micros>")
+//   --write-edges <ride>   Print the named synthetic ride as an edge table
+//   --latency-us <n>       Max interrupt latency added to each timestamp (default 5)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "config.h"
+#include "rpm_calculator.h"
+
+// Virtual clock - advanced by the simulation only
+static uint64_t virtualMicros = 0;
+
+uint32_t clockMillis() {
+  return (uint32_t)(virtualMicros / 1000);
+}
+
+uint32_t clockMicros() {
+  return (uint32_t)virtualMicros;
+}
+
+#define LOOP_MICROS 1000
+#define SAMPLE_MICROS 10000
+#define SETTLE_MICROS 5000000  // No scoring until a gear had time to lock
+
+// The firmware's default gears (RPMCalculator::begin)
+static const uint8_t CHAINRINGS[2] = {50, 34};
+static const uint8_t SPROCKETS[9] = {11, 12, 13, 15, 17, 19, 21, 24, 28};
+
+// A ride is a list of segments: the wheel speed ramps linearly to
+// wheelRPM over the given seconds in one gear, with the rider pedalling
+// (cadence = wheel / gear ratio) or freewheeling (crank stopped)
+struct Segment {
+  double seconds;
+  double wheelRPM;
+  uint8_t chainring;  // Teeth
+  uint8_t sprocket;   // Teeth
+  bool pedalling;
+};
+
+struct Ride {
+  const char* name;
+  double startWheelRPM;
+  Segment segments[10];
+  uint8_t segmentCount;
+};
+
+static const Ride RIDES[] = {
+  {"steady", 265, {{60, 265, 50, 17, true}}, 1},
+  {"intervals", 206, {{10, 206, 50, 17, true}, {4, 324, 50, 17, true}, {6, 324, 50, 17, true},
+                      {4, 206, 50, 17, true}, {6, 206, 50, 17, true}, {4, 324, 50, 17, true},
+                      {6, 324, 50, 17, true}, {4, 206, 50, 17, true}, {6, 206, 50, 17, true}}, 9},
+  {"shifts", 265, {{10, 265, 50, 17, true}, {8, 300, 50, 15, true}, {8, 330, 50, 13, true},
+                   {8, 300, 50, 15, true}, {8, 240, 50, 19, true}, {8, 180, 34, 15, true}}, 6},
+  {"freewheel", 265, {{10, 265, 50, 17, true}, {4, 200, 50, 17, false}, {10, 265, 50, 17, true},
+                      {2, 240, 50, 17, false}, {10, 265, 50, 17, true}}, 5},
+};
+
+enum Readout { CRANK_ONLY, FUSED, READOUT_COUNT };
+static const char* READOUT_NAMES[READOUT_COUNT] = {"crank", "fused"};
+
+struct Edge {
+  uint64_t time;  // micros since start of the ride
+  bool wheel;
+};
+
+static bool edgeEarlier(const Edge& a, const Edge& b) {
+  return a.time < b.time;
+}
+
+// Deterministic pseudo-random interrupt latency
+static uint32_t latencySeed = 1;
+
+static uint32_t latency(uint32_t maxMicros) {
+  latencySeed = latencySeed * 1103515245 + 12345;
+  return maxMicros > 0 ? (latencySeed >> 16) % (maxMicros + 1) : 0;
+}
+
+// Wheel speed and the segment in force at time t (seconds)
+static double wheelRPMAt(const Ride& ride, double t, const Segment** current) {
+  double start = 0;
+  double rpm = ride.startWheelRPM;
+  for (uint8_t i = 0; i < ride.segmentCount; i++) {
+    const Segment& segment = ride.segments[i];
+    if (t < start + segment.seconds || i == ride.segmentCount - 1) {
+      *current = &segment;
+      double progress = (t - start) / segment.seconds;
+      return rpm + (segment.wheelRPM - rpm) * (progress < 1 ? progress : 1);
+    }
+    start += segment.seconds;
+    rpm = segment.wheelRPM;
+  }
+  return rpm;
+}
+
+static double cadenceAt(const Ride& ride, double t) {
+  const Segment* segment;
+  double wheelRPM = wheelRPMAt(ride, t, &segment);
+  return segment->pedalling ? wheelRPM * segment->sprocket / segment->chainring : 0;
+}
+
+static double lengthOf(const Ride& ride) {
+  double length = 0;
+  for (uint8_t i = 0; i < ride.segmentCount; i++) {
+    length += ride.segments[i].seconds;
+  }
+  return length;
+}
+
+// Edges of a synthetic ride; the crank phase is kept while freewheeling
+static void synthesize(const Ride& ride, uint32_t maxLatency, std::vector<Edge>& edges) {
+  double phase[2] = {0, 0};
+  const double magnets[2] = {WHEEL_MAGNETS, CRANK_MAGNETS};
+  uint64_t end = (uint64_t)(lengthOf(ride) * 1e6);
+  latencySeed = 1;
+
+  for (uint64_t passStart = 0; passStart < end; passStart += LOOP_MICROS) {
+    double t = (passStart + LOOP_MICROS) / 1e6;
+    const Segment* segment;
+    double rpm[2] = {wheelRPMAt(ride, t, &segment), cadenceAt(ride, t)};
+    for (uint8_t ch = 0; ch < 2; ch++) {
+      double edgesPerPass = rpm[ch] / 60.0 * magnets[ch] * LOOP_MICROS / 1e6;
+      double next = floor(phase[ch]) + 1;
+      if (edgesPerPass > 0 && phase[ch] + edgesPerPass >= next) {
+        // The interrupt is taken by the end of the pass at the latest
+        uint64_t edgeTime = passStart + (uint64_t)((next - phase[ch]) / edgesPerPass * LOOP_MICROS) + latency(maxLatency);
+        Edge edge;
+        edge.time = edgeTime < passStart + LOOP_MICROS ? edgeTime : passStart + LOOP_MICROS;
+        edge.wheel = ch == 0;
+        edges.push_back(edge);
+      }
+      phase[ch] += edgesPerPass;
+    }
+  }
+  std::stable_sort(edges.begin(), edges.end(), edgeEarlier);
+}
+
+static bool readEdges(FILE* in, std::vector<Edge>& edges) {
+  char line[128];
+  while (fgets(line, sizeof(line), in)) {
+    char channel = line[0];
+    if ((channel != 'W' && channel != 'C') || line[1] != ',') {
+      continue;  // Header or comment
+    }
+    Edge edge;
+    edge.time = strtoull(line + 2, nullptr, 10);
+    edge.wheel = channel == 'W';
+    edges.push_back(edge);
+  }
+  std::stable_sort(edges.begin(), edges.end(), edgeEarlier);
+  return !edges.empty();
+}
+
+// Same setup sequence as the firmware
+static void setUp(RPMCalculator& calculator) {
+  calculator.begin(WHEEL_MAGNETS, CRANK_MAGNETS);
+  calculator.configureGlitchFilters(WHEEL_GLITCH_PERCENT, CADENCE_GLITCH_PERCENT);
+  calculator.configureGears(2, CHAINRINGS, 9, SPROCKETS);
+}
+
+static uint32_t readout(const RPMCalculator& calculator, uint8_t which) {
+  return which == FUSED ? calculator.getFusedCadenceMilliRPM() : calculator.getDecayedCadenceMilliRPM();
+}
+
+// One pass of loop(): queue the edges taken by now, then process them
+static void runPass(RPMCalculator& calculator, const std::vector<Edge>& edges, size_t& nextEdge) {
+  virtualMicros += LOOP_MICROS;
+  while (nextEdge < edges.size() && edges[nextEdge].time <= virtualMicros) {
+    if (edges[nextEdge].wheel) {
+      calculator.recordWheelEdge((uint32_t)edges[nextEdge].time);
+    } else {
+      calculator.recordCadenceEdge((uint32_t)edges[nextEdge].time);
+    }
+    nextEdge++;
+  }
+  calculator.calculateRPMs();
+  calculator.checkTimeouts();
+}
+
+static double percentile(std::vector<double>& values, double fraction) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(fraction * (values.size() - 1))];
+}
+
+static void benchRide(const Ride& ride, uint32_t maxLatency) {
+  std::vector<Edge> edges;
+  synthesize(ride, maxLatency, edges);
+
+  static RPMCalculator calculator;
+  setUp(calculator);
+  virtualMicros = 0;
+  size_t nextEdge = 0;
+  uint64_t end = (uint64_t)(lengthOf(ride) * 1e6);
+
+  std::vector<double> errors[READOUT_COUNT];
+  unsigned long changes[READOUT_COUNT] = {0, 0};
+  uint32_t previous[READOUT_COUNT] = {0, 0};
+  unsigned long fusedSamples = 0;
+
+  while (virtualMicros < end) {
+    runPass(calculator, edges, nextEdge);
+    if (virtualMicros < SETTLE_MICROS || virtualMicros % SAMPLE_MICROS != 0) {
+      continue;
+    }
+
+    double truth = cadenceAt(ride, virtualMicros / 1e6);
+    for (uint8_t r = 0; r < READOUT_COUNT; r++) {
+      uint32_t reading = readout(calculator, r);
+      errors[r].push_back(fabs(reading / (double)MILLI_RPM_PER_RPM - truth));
+      if (reading != previous[r]) {
+        changes[r]++;
+        previous[r] = reading;
+      }
+    }
+    if (calculator.isCadenceFused()) {
+      fusedSamples++;
+    }
+  }
+
+  double seconds = (end - SETTLE_MICROS) / 1e6;
+  for (uint8_t r = 0; r < READOUT_COUNT; r++) {
+    double sum = 0;
+    for (size_t i = 0; i < errors[r].size(); i++) {
+      sum += errors[r][i];
+    }
+    size_t samples = errors[r].size();
+    printf("%s,%s,%.2f,%.2f,%.1f,%.1f\n", ride.name, READOUT_NAMES[r],
+           samples > 0 ? sum / samples : 0.0, percentile(errors[r], 0.95),
+           changes[r] / seconds, r == FUSED && samples > 0 ? fusedSamples * 100.0 / samples : 0.0);
+  }
+}
+
+// A captured ride has no true cadence: score the fused value held just
+// before each crank edge against that edge's own reading
+static int checkEdges(const char* inputName) {
+  FILE* in = fopen(inputName, "r");
+  if (!in) {
+    fprintf(stderr, "Error: cannot open %s\n", inputName);
+    return 1;
+  }
+  std::vector<Edge> edges;
+  bool loaded = readEdges(in, edges);
+  fclose(in);
+  if (!loaded) {
+    fprintf(stderr, "Error: no edges in %s\n", inputName);
+    return 1;
+  }
+
+  static RPMCalculator calculator;
+  setUp(calculator);
+  virtualMicros = 0;
+  size_t nextEdge = 0;
+  uint64_t end = edges.back().time + LOOP_MICROS;
+  const SensorEngine& engine = calculator.getEngine();
+  uint8_t crank = calculator.getCadenceChannel();
+
+  std::vector<double> residuals;
+  unsigned long crankEdges = 0;
+  while (virtualMicros < end) {
+    uint32_t lastEdge = engine.getLastEdgeTime(crank);
+    uint32_t fused = calculator.isCadenceFused() ? calculator.getFusedCadenceMilliRPM() : 0;
+    runPass(calculator, edges, nextEdge);
+    if (engine.getLastEdgeTime(crank) == lastEdge || engine.getLastInterval(crank) == 0) {
+      continue;
+    }
+    crankEdges++;
+    uint32_t measured = engine.getInstantMilliRPM(crank);
+    if (fused > 0 && measured > 0) {
+      residuals.push_back(fabs((double)fused - measured) * 100.0 / measured);
+    }
+  }
+
+  double sum = 0;
+  for (size_t i = 0; i < residuals.size(); i++) {
+    sum += residuals[i];
+  }
+  const CadenceFusion& fusion = calculator.getCadenceFusion(0);
+  printf("Crank edges,Checked while fused,Mean residual(%%),P95 residual(%%),Disagreeing edges\n");
+  printf("%lu,%lu,%.2f,%.2f,%lu\n", crankEdges, (unsigned long)residuals.size(),
+         residuals.empty() ? 0.0 : sum / residuals.size(), percentile(residuals, 0.95),
+         fusion.getDisagreeingEdges());
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  const char* edgesName = nullptr;
+  const char* writeRide = nullptr;
+  uint32_t maxLatency = 5;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--edges") == 0 && i + 1 < argc) {
+      edgesName = argv[++i];
+    } else if (strcmp(argv[i], "--write-edges") == 0 && i + 1 < argc) {
+      writeRide = argv[++i];
+    } else if (strcmp(argv[i], "--latency-us") == 0 && i + 1 < argc) {
+      maxLatency = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--edges <file>] [--write-edges <ride>] [--latency-us <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (edgesName) {
+    return checkEdges(edgesName);
+  }
+
+  const size_t rideCount = sizeof(RIDES) / sizeof(RIDES[0]);
+  if (writeRide) {
+    for (size_t r = 0; r < rideCount; r++) {
+      if (strcmp(RIDES[r].name, writeRide) == 0) {
+        std::vector<Edge> edges;
+        synthesize(RIDES[r], maxLatency, edges);
+        for (size_t i = 0; i < edges.size(); i++) {
+          printf("%c,%llu\n", edges[i].wheel ? 'W' : 'C', (unsigned long long)edges[i].time);
+        }
+        return 0;
+      }
+    }
+    fprintf(stderr, "Error: no ride named %s\n", writeRide);
+    return 2;
+  }
+
+  printf("Ride,Cadence,Mean error(rpm),P95 error(rpm),Updates/s,Fused(%%)\n");
+  for (size_t r = 0; r < rideCount; r++) {
+    benchRide(RIDES[r], maxLatency);
+  }
+  return 0;
+}
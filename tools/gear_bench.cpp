@@ -0,0 +1,184 @@
+// Host micro-benchmark of gear matching. Compares the original lookup,
+// which divided out every chainring/sprocket pair in float on each pass
+// and kept the closest, with GearEstimator's binary search over its
+// sorted, precomputed ratio table (see include/gear_estimator.h). Both
+// run over the same seeded set of measured wheel/crank speeds for a few
+// drivetrains; the estimator is cleared before each call so the
+// hysteresis and dwell never hold back a gear and both always pick the
+// closest one. The two picks must agree to within the table's merge
+// tolerance, else the tool exits 1.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o gear_bench gear_bench.cpp ../src/gear_estimator.cpp
+// Usage: gear_bench [--passes <n>] [--seed <n>]
+//   --passes <n>   Times each lookup runs over the sample set (default 200)
+//   --seed <n>     Sample set seed (default 1)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "gear_estimator.h"
+
+// No dwell is ever waited out, so the clock can stand still
+uint32_t clockMillis() {
+  return 0;
+}
+
+uint32_t clockMicros() {
+  return 0;
+}
+
+#define SAMPLE_COUNT 4096
+
+struct Drivetrain {
+  const char* name;
+  uint8_t chainringCount;
+  uint8_t chainringTeeth[MAX_CHAINRINGS];
+  uint8_t sprocketCount;
+  uint8_t sprocketTeeth[MAX_SPROCKETS];
+};
+
+static const Drivetrain DRIVETRAINS[] = {
+  {"1x12", 1, {32}, 12, {10, 12, 14, 16, 18, 21, 24, 28, 32, 36, 42, 50}},
+  {"2x11", 2, {50, 34}, 11, {11, 12, 13, 14, 15, 17, 19, 21, 23, 25, 28}},
+  {"3x13", 3, {48, 36, 26}, 13, {10, 11, 12, 13, 14, 15, 17, 19, 21, 24, 28, 32, 36}},
+};
+
+struct Sample {
+  uint32_t wheelMilliRPM;
+  uint32_t cadenceMilliRPM;
+};
+
+// The lookup before the table: every pair divided out in float, the
+// closest kept (returns the ratio, 0 if nothing is within 20%)
+static float linearScan(const Drivetrain& drivetrain, float wheelRPM, float cadenceRPM) {
+  float measuredRatio = wheelRPM / cadenceRPM;
+  float bestMatch = 99999.0f;
+  float bestRatio = 0.0f;
+  for (uint8_t c = 0; c < drivetrain.chainringCount; c++) {
+    for (uint8_t s = 0; s < drivetrain.sprocketCount; s++) {
+      float theoreticalRatio = (float)drivetrain.chainringTeeth[c] / drivetrain.sprocketTeeth[s];
+      float diff = fabsf(theoreticalRatio - measuredRatio);
+      if (diff < bestMatch) {
+        bestMatch = diff;
+        bestRatio = theoreticalRatio;
+      }
+    }
+  }
+  return bestMatch / measuredRatio < 0.2f ? bestRatio : 0.0f;
+}
+
+// Crank speeds from 60 to 110 RPM; ratios from 10% below the lowest gear
+// to 10% above the highest, so some fall outside the match tolerance
+static std::vector<Sample> makeSamples(const Drivetrain& drivetrain, uint32_t seed) {
+  float lowest = 99999.0f;
+  float highest = 0.0f;
+  for (uint8_t c = 0; c < drivetrain.chainringCount; c++) {
+    for (uint8_t s = 0; s < drivetrain.sprocketCount; s++) {
+      float ratio = (float)drivetrain.chainringTeeth[c] / drivetrain.sprocketTeeth[s];
+      lowest = ratio < lowest ? ratio : lowest;
+      highest = ratio > highest ? ratio : highest;
+    }
+  }
+
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> cadence(60.0f, 110.0f);
+  std::uniform_real_distribution<float> ratio(lowest * 0.9f, highest * 1.1f);
+  std::vector<Sample> samples(SAMPLE_COUNT);
+  for (size_t i = 0; i < samples.size(); i++) {
+    float cadenceRPM = cadence(random);
+    samples[i].cadenceMilliRPM = (uint32_t)(cadenceRPM * 1000.0f);
+    samples[i].wheelMilliRPM = (uint32_t)(cadenceRPM * ratio(random) * 1000.0f);
+  }
+  return samples;
+}
+
+int main(int argc, char** argv) {
+  unsigned long passes = 200;
+  uint32_t seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+      passes = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--passes <n>] [--seed <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (passes == 0) {
+    fprintf(stderr, "Error: --passes must be non-zero\n");
+    return 2;
+  }
+
+  bool failed = false;
+  printf("Drivetrain,Pairs,TableEntries,Calls,Linear(ns/call),Table(ns/call),Speedup,Mismatches\n");
+  for (size_t d = 0; d < sizeof(DRIVETRAINS) / sizeof(DRIVETRAINS[0]); d++) {
+    const Drivetrain& drivetrain = DRIVETRAINS[d];
+    std::vector<Sample> samples = makeSamples(drivetrain, seed + (uint32_t)d);
+
+    GearEstimator estimator;
+    estimator.configure(drivetrain.chainringCount, drivetrain.chainringTeeth,
+                        drivetrain.sprocketCount, drivetrain.sprocketTeeth);
+    GearEntry table[MAX_GEARS];
+    uint8_t entries = buildGearTable(drivetrain.chainringTeeth, drivetrain.chainringCount,
+                                     drivetrain.sprocketTeeth, drivetrain.sprocketCount, table);
+
+    // The table pick must be as close to the measured ratio as the
+    // linear one, up to the merging of ratios within GEAR_RATIO_TOLERANCE
+    // and the fixed-point rounding (which may break a tie the other way)
+    unsigned long mismatches = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+      float measured = (float)samples[i].wheelMilliRPM / samples[i].cadenceMilliRPM;
+      float linear = linearScan(drivetrain, samples[i].wheelMilliRPM / 1000.0f, samples[i].cadenceMilliRPM / 1000.0f);
+      estimator.clear();
+      estimator.estimate(samples[i].wheelMilliRPM, samples[i].cadenceMilliRPM);
+      float fixed = (float)estimator.getCurrentGearRatioFixed() / GEAR_RATIO_SCALE;
+      float slack = measured * (GEAR_RATIO_TOLERANCE + 1) / 1000.0f;
+      if ((linear > 0.0f) != (fixed > 0.0f)) {
+        // Only a sample right at the 20% boundary may land on either side
+        float nearest = linear > 0.0f ? linear : fixed;
+        if (fabsf(fabsf(nearest - measured) - measured * GEAR_MATCH_TOLERANCE / 100.0f) > slack) {
+          mismatches++;
+        }
+      } else if (linear > 0.0f && fabsf(fixed - measured) > fabsf(linear - measured) + slack) {
+        mismatches++;
+      }
+    }
+
+    volatile float linearSink = 0.0f;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned long pass = 0; pass < passes; pass++) {
+      float total = 0.0f;
+      for (size_t i = 0; i < samples.size(); i++) {
+        total += linearScan(drivetrain, samples[i].wheelMilliRPM / 1000.0f, samples[i].cadenceMilliRPM / 1000.0f);
+      }
+      linearSink = linearSink + total;
+    }
+    double linearNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    volatile uint32_t tableSink = 0;
+    start = std::chrono::steady_clock::now();
+    for (unsigned long pass = 0; pass < passes; pass++) {
+      uint32_t total = 0;
+      for (size_t i = 0; i < samples.size(); i++) {
+        estimator.clear();
+        estimator.estimate(samples[i].wheelMilliRPM, samples[i].cadenceMilliRPM);
+        total += estimator.getCurrentGearRatioFixed();
+      }
+      tableSink = tableSink + total;
+    }
+    double tableNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    unsigned long calls = passes * samples.size();
+    failed = failed || mismatches > 0;
+    printf("%s,%u,%u,%lu,%.1f,%.1f,%.2f,%lu\n", drivetrain.name,
+           drivetrain.chainringCount * drivetrain.sprocketCount, entries, calls,
+           linearNs / calls, tableNs / calls, linearNs / tableNs, mismatches);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,302 @@
+// Replayable corpus for the period-relative debounce (GlitchFilter). Each
+// corpus case is a seeded edge sequence with every edge labelled as a real
+// magnet pass or as sensor bounce: clean rides up to sprint speeds, and
+// the same rides with bursts of chatter after the real edges. The edges run
+// through GlitchFilter as SensorEngine drives it, with the interval taken
+// from the last accepted edge and the floor set from the channel's max RPM.
+// For comparison they also run through the fixed 10 ms debounce it
+// replaced. For each case and filter the tool prints the share of real
+// edges accepted, the share of bounce rejected, and the mean error of the
+// RPM measured from the accepted intervals. The process exits non-zero if
+// GlitchFilter misses a case's limits.
+//
+// --write <case> prints a case as "<W|C>,<micros>,<1 real|0 bounce>"
+// lines, and --edges <file> runs such a file instead of the built-in
+// corpus. A captured edge table without the label column is accepted as
+// well; only the share of edges rejected is printed for it.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o glitch_corpus glitch_corpus.cpp
+// Usage: glitch_corpus [options]
+//   --edges <file>    Run an edge file through the filter
+//   --write <case>    Print the named corpus case as an edge file
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "config.h"
+#include "glitch_filter.h"
+#include "rpm_calculator.h"
+
+#define FIXED_DEBOUNCE_MICROS 10000  // The debounce GlitchFilter replaced
+
+struct Segment {
+  double seconds;
+  double rpm;
+};
+
+struct CorpusCase {
+  const char* name;
+  char channel;               // 'W' wheel or 'C' crank
+  double startRPM;
+  Segment segments[4];
+  uint8_t segmentCount;
+  uint8_t bouncePercent;      // Real edges followed by a burst of bounce
+  uint8_t maxBounces;         // Edges per burst
+  uint32_t bounceMicros;      // Burst length after the real edge
+  double minRealAccepted;     // Limits for GlitchFilter (%)
+  double minBounceRejected;
+  double maxError;            // Mean RPM error (%)
+};
+
+static const CorpusCase CORPUS[] = {
+  {"wheel-clean",        'W', 250, {{30, 250}}, 1, 0, 0, 0, 100.0, 0.0, 0.1},
+  {"wheel-sprint",       'W', 200, {{10, 1000}, {10, 1000}, {10, 200}}, 3, 0, 0, 0, 100.0, 0.0, 0.1},
+  {"wheel-bouncy",       'W', 250, {{30, 250}}, 1, 50, 3, 800, 99.9, 99.0, 0.5},
+  {"wheel-sprint-bouncy",'W', 200, {{10, 1000}, {10, 1000}, {10, 200}}, 3, 50, 3, 400, 99.9, 99.0, 0.5},
+  {"wheel-slow-chatter", 'W', 40, {{30, 40}, {10, 60}}, 2, 50, 3, 15000, 99.9, 99.0, 0.5},
+  {"crank-clean",        'C', 90, {{30, 60}, {30, 120}, {30, 90}}, 3, 0, 0, 0, 100.0, 0.0, 0.1},
+  {"crank-bouncy",       'C', 90, {{30, 60}, {30, 120}, {30, 90}}, 3, 80, 4, 5000, 99.5, 99.0, 0.5},
+  {"crank-chatter",      'C', 90, {{30, 60}, {30, 120}, {30, 90}}, 3, 50, 3, 200000, 99.5, 99.0, 0.5},
+  {"crank-surge",        'C', 40, {{2, 160}, {30, 160}}, 2, 50, 4, 3000, 99.5, 99.0, 0.5},
+};
+
+struct Edge {
+  char channel;
+  uint32_t micros;
+  int8_t real;     // 1 real, 0 bounce, -1 unknown
+  double trueRPM;  // Speed over the interval a real edge ends
+};
+
+struct Result {
+  unsigned long real;
+  unsigned long bounce;
+  unsigned long realAccepted;
+  unsigned long bounceRejected;
+  unsigned long accepted;
+  double errorSum;           // |measured / true - 1| over scored intervals
+  unsigned long scored;
+};
+
+// Deterministic pseudo-random numbers, reseeded per case
+static uint32_t randomSeed = 1;
+
+static uint32_t nextRandom() {
+  randomSeed = randomSeed * 1103515245 + 12345;
+  return randomSeed >> 16;
+}
+
+static double rpmAt(const CorpusCase& test, double t) {
+  double start = 0;
+  double rpm = test.startRPM;
+  for (uint8_t i = 0; i < test.segmentCount; i++) {
+    const Segment& segment = test.segments[i];
+    if (t < start + segment.seconds) {
+      return rpm + (segment.rpm - rpm) * (t - start) / segment.seconds;
+    }
+    start += segment.seconds;
+    rpm = segment.rpm;
+  }
+  return rpm;
+}
+
+static uint8_t magnetsFor(char channel) {
+  return channel == 'W' ? WHEEL_MAGNETS : CRANK_MAGNETS;
+}
+
+static std::vector<Edge> generate(const CorpusCase& test, uint32_t seed) {
+  std::vector<Edge> edges;
+  randomSeed = seed;
+  uint8_t magnets = magnetsFor(test.channel);
+  double length = 0;
+  for (uint8_t i = 0; i < test.segmentCount; i++) {
+    length += test.segments[i].seconds;
+  }
+
+  // Step edge by edge at the speed of the moment, so each interval is
+  // ridden at exactly the speed of the edge that starts it
+  double t = 0.5;
+  double previousRPM = 0;
+  while (t < length) {
+    double rpm = rpmAt(test, t);
+    Edge edge = {test.channel, (uint32_t)(t * 1e6), 1, previousRPM};
+    previousRPM = rpm;
+    edges.push_back(edge);
+    if (nextRandom() % 100 < test.bouncePercent) {
+      uint8_t bounces = (uint8_t)(1 + nextRandom() % test.maxBounces);
+      for (uint8_t b = 0; b < bounces; b++) {
+        Edge bounce = {test.channel, edge.micros + 1 + nextRandom() % test.bounceMicros, 0, 0};
+        edges.push_back(bounce);
+      }
+    }
+    t += 60.0 / (rpm * magnets);
+  }
+  std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.micros < b.micros; });
+  return edges;
+}
+
+// Run one channel's edges; fixed selects the old 10 ms debounce
+static Result run(const std::vector<Edge>& edges, char channel, bool fixed) {
+  Result result;
+  memset(&result, 0, sizeof(result));
+  uint8_t magnets = magnetsFor(channel);
+  uint16_t maxRPM = channel == 'W' ? MAX_WHEEL_RPM : MAX_CADENCE_RPM;
+  GlitchFilter filter;
+  filter.configure(60000000UL / ((uint32_t)maxRPM * magnets) / 2,
+                   channel == 'W' ? WHEEL_GLITCH_PERCENT : CADENCE_GLITCH_PERCENT);
+
+  bool started = false;
+  uint32_t lastAccepted = 0;
+  int8_t lastAcceptedReal = 0;
+  for (size_t i = 0; i < edges.size(); i++) {
+    const Edge& edge = edges[i];
+    if (edge.channel != channel) {
+      continue;
+    }
+    if (edge.real == 1) {
+      result.real++;
+    } else if (edge.real == 0) {
+      result.bounce++;
+    }
+
+    bool accepted;
+    uint32_t interval = edge.micros - lastAccepted;
+    if (!started) {
+      accepted = true;
+      started = true;
+    } else {
+      accepted = fixed ? interval >= FIXED_DEBOUNCE_MICROS : filter.accept(interval);
+    }
+
+    if (accepted) {
+      result.accepted++;
+      // An interval between two real edges is a speed reading
+      if (edge.real == 1 && lastAcceptedReal == 1 && edge.trueRPM > 0) {
+        double measured = 60e6 / ((double)interval * magnets);
+        result.errorSum += fabs(measured / edge.trueRPM - 1);
+        result.scored++;
+      }
+      lastAccepted = edge.micros;
+      lastAcceptedReal = edge.real;
+    }
+    if (edge.real == 1 && accepted) {
+      result.realAccepted++;
+    } else if (edge.real == 0 && !accepted) {
+      result.bounceRejected++;
+    }
+  }
+  return result;
+}
+
+static double percent(unsigned long part, unsigned long whole) {
+  return whole > 0 ? 100.0 * part / whole : 100.0;
+}
+
+static void print(const char* name, char channel, const char* filter, const Result& result) {
+  printf("%s,%s,%s,%lu,%lu,%.2f,%.2f,%.3f\n", name, channel == 'W' ? "wheel" : "crank", filter,
+         result.real, result.bounce, percent(result.realAccepted, result.real),
+         percent(result.bounceRejected, result.bounce),
+         result.scored > 0 ? 100.0 * result.errorSum / result.scored : 0.0);
+}
+
+static bool readEdges(const char* path, std::vector<Edge>& edges) {
+  FILE* file = fopen(path, "r");
+  if (file == nullptr) {
+    fprintf(stderr, "Error: cannot open %s\n", path);
+    return false;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    char channel;
+    unsigned long micros;
+    int real = -1;
+    if (sscanf(line, "%c,%lu,%d", &channel, &micros, &real) < 2 || (channel != 'W' && channel != 'C')) {
+      continue;  // Header or blank line
+    }
+    Edge edge = {channel, (uint32_t)micros, (int8_t)(real == 0 || real == 1 ? real : -1), 0};
+    edges.push_back(edge);
+  }
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* edgeFile = nullptr;
+  const char* writeCase = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--edges") == 0 && i + 1 < argc) {
+      edgeFile = argv[++i];
+    } else if (strcmp(argv[i], "--write") == 0 && i + 1 < argc) {
+      writeCase = argv[++i];
+    } else {
+      fprintf(stderr, "Usage: %s [--edges <file>] [--write <case>]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  const size_t caseCount = sizeof(CORPUS) / sizeof(CORPUS[0]);
+  if (writeCase != nullptr) {
+    for (size_t c = 0; c < caseCount; c++) {
+      if (strcmp(CORPUS[c].name, writeCase) == 0) {
+        std::vector<Edge> edges = generate(CORPUS[c], (uint32_t)c + 1);
+        for (size_t i = 0; i < edges.size(); i++) {
+          printf("%c,%u,%d\n", edges[i].channel, edges[i].micros, edges[i].real);
+        }
+        return 0;
+      }
+    }
+    fprintf(stderr, "Error: no corpus case named %s\n", writeCase);
+    return 2;
+  }
+
+  if (edgeFile != nullptr) {
+    std::vector<Edge> edges;
+    if (!readEdges(edgeFile, edges)) {
+      return 2;
+    }
+    // A file carries no true speed, so only the accept/reject shares are
+    // printed; without labels, the share of edges rejected
+    bool labelled = std::any_of(edges.begin(), edges.end(), [](const Edge& e) { return e.real >= 0; });
+    printf(labelled ? "File,Channel,Real edges,Bounce edges,Real accepted(%%),Bounce rejected(%%)\n"
+                    : "File,Channel,Edges,Rejected(%%)\n");
+    for (char channel : {'W', 'C'}) {
+      Result result = run(edges, channel, false);
+      unsigned long total = (unsigned long)std::count_if(edges.begin(), edges.end(),
+                                                         [channel](const Edge& e) { return e.channel == channel; });
+      if (total == 0) {
+        continue;
+      }
+      const char* name = channel == 'W' ? "wheel" : "crank";
+      if (labelled) {
+        printf("%s,%s,%lu,%lu,%.2f,%.2f\n", edgeFile, name, result.real, result.bounce,
+               percent(result.realAccepted, result.real), percent(result.bounceRejected, result.bounce));
+      } else {
+        printf("%s,%s,%lu,%.2f\n", edgeFile, name, total, percent(total - result.accepted, total));
+      }
+    }
+    return 0;
+  }
+
+  printf("Case,Channel,Filter,Real edges,Bounce edges,Real accepted(%%),Bounce rejected(%%),Mean error(%%)\n");
+  bool failed = false;
+  for (size_t c = 0; c < caseCount; c++) {
+    const CorpusCase& test = CORPUS[c];
+    std::vector<Edge> edges = generate(test, (uint32_t)c + 1);
+    Result glitch = run(edges, test.channel, false);
+    Result fixed = run(edges, test.channel, true);
+    print(test.name, test.channel, "glitch", glitch);
+    print(test.name, test.channel, "fixed-10ms", fixed);
+
+    double error = glitch.scored > 0 ? 100.0 * glitch.errorSum / glitch.scored : 0.0;
+    if (percent(glitch.realAccepted, glitch.real) < test.minRealAccepted ||
+        percent(glitch.bounceRejected, glitch.bounce) < test.minBounceRejected ||
+        error > test.maxError) {
+      fprintf(stderr, "FAIL: %s outside its limits\n", test.name);
+      failed = true;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+// Host-side converter from binary session logs (session_*.bin) to the
+// CSV column layout the firmware used to write directly.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o log2csv log2csv.cpp
+// Usage: log2csv session_123.bin [out.csv]   (writes to stdout by default)
+
+#include <stdio.h>
+#include <string.h>
+#include "session_log_format.h"
+#include "csv_row.h"
+
+static bool convert(FILE* in, FILE* out) {
+  uint8_t sector[SESSION_LOG_SECTOR_SIZE];
+
+  if (fread(sector, 1, sizeof(sector), in) != sizeof(sector)) {
+    fprintf(stderr, "Error: file is shorter than the header sector\n");
+    return false;
+  }
+
+  SessionLogHeader header;
+  memcpy(&header, sector, sizeof(header));
+  if (memcmp(header.magic, SESSION_LOG_MAGIC, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "Error: not a session log\n");
+    return false;
+  }
+  if (header.version < 1 || header.version > SESSION_LOG_VERSION || header.recordSize != sizeof(SessionLogRecord)) {
+    fprintf(stderr, "Error: unsupported log version %u (record size %u)\n",
+            header.version, header.recordSize);
+    return false;
+  }
+
+  if (header.version >= 3 && !header.closed) {
+    fprintf(stderr, "Warning: session was not closed (%u rows committed) - reading every valid sector\n",
+            header.committedRecords);
+  }
+
+  fprintf(out, "%s\n", SESSION_LOG_CSV_HEADER);
+
+  size_t rowOffset = sessionLogRowOffset(header);
+  uint32_t expectedSequence = 0;
+  while (fread(sector, 1, sizeof(sector), in) == sizeof(sector)) {
+    SessionLogSectorHeader sectorHeader;
+    memcpy(&sectorHeader, sector, sizeof(sectorHeader));
+
+    // Unwritten or torn sectors (or another session's leftovers in the
+    // pre-allocated space) end the readable part of the log
+    if (sectorHeader.magic != SESSION_LOG_SECTOR_MAGIC ||
+        sectorHeader.sequence != expectedSequence ||
+        sectorHeader.recordCount > header.recordsPerSector ||
+        (header.version >= 3 && sectorHeader.sessionId != header.sessionId)) {
+      break;
+    }
+
+    for (uint16_t i = 0; i < sectorHeader.recordCount; i++) {
+      SessionLogRecord record;
+      memcpy(&record, sector + rowOffset + i * sizeof(record), sizeof(record));
+      record.timestamp = sessionLogRowTime(header, record);
+      printCsvRow(out, record);
+    }
+    expectedSequence++;
+  }
+
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s <session.bin> [output.csv]\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "Error: cannot open %s\n", argv[1]);
+    return 1;
+  }
+
+  FILE* out = argc == 3 ? fopen(argv[2], "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Error: cannot create %s\n", argv[2]);
+    fclose(in);
+    return 1;
+  }
+
+  bool ok = convert(in, out);
+
+  fclose(in);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return ok ? 0 : 1;
+}
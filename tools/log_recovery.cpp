@@ -0,0 +1,188 @@
+// Host test of the boot-time recovery of interrupted session logs
+// (SdLogSink::recoverSessions() and SessionLogWriter::recover()), against
+// the simulated SD card in native/. Each case writes a session through
+// SdLogSink, cuts the power at a chosen card write (or closes the session
+// normally), then boots again and runs recovery. A case passes when
+//   - recovery reports no failures,
+//   - the file is marked closed and trimmed right after its last row,
+//   - it holds exactly the rows whose sectors reached the card, in order,
+//     none from an earlier session, with the committed count of the last
+//     sync,
+//   - a second recovery leaves it byte for byte as it is, and a file that
+//     is not a session log is never touched.
+// Exits 1 if any case fails.
+//
+// Build: g++ -std=gnu++17 -O2 -DARDUINO_SHIM -I../native -I../include -o log_recovery log_recovery.cpp ../src/sd_log_sink.cpp ../src/session_log.cpp ../native/arduino_shim.cpp ../native/sdfat_shim.cpp
+// Usage: log_recovery
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "config.h"
+#include "sd_log_sink.h"
+
+#define LOG_NAME "session_1000.bin"
+#define OTHER_NAME "session_1000.edg"
+#define EARLIER_ROWS 200  // Rows of the closed session that stale-sectors leaves behind
+
+struct Case {
+  const char* name;
+  bool earlierSession;       // First write and close a longer session under the same name
+  uint32_t rows;             // Rows appended
+  uint32_t commitAfter;      // flush() after this many rows (0: never)
+  unsigned long cutAtWrite;  // Power cut on this card write after the open, 0: after the last row,
+                             // SHIM_SD_NEVER: close normally
+  uint32_t expectedRows;
+  uint32_t expectedCommitted;
+};
+
+// Rows go out a whole sector at a time (25 rows); nothing is synced
+// unless the case commits, so a cut loses every row of the partial sector
+static const Case CASES[] = {
+  {"closed-normally", false, 60, 0, SHIM_SD_NEVER, 60, 60},
+  {"crash-after-commit", false, 70, 30, 0, 50, 30},
+  {"torn-sector", false, 100, 0, 3, 50, 0},
+  {"stale-sectors", true, 60, 0, 0, 50, 0},
+};
+
+// What the recovered file holds
+struct LogContents {
+  bool valid;
+  bool closed;
+  uint32_t rows;
+  uint32_t committed;
+  bool inOrder;        // Every row is the next one this session wrote
+  uint32_t sectors;    // File length in sectors
+};
+
+static LogContents readLog(const std::string& data, uint32_t firstRow) {
+  LogContents contents = {false, false, 0, 0, true, (uint32_t)(data.size() / SESSION_LOG_SECTOR_SIZE)};
+  if (data.size() < SESSION_LOG_SECTOR_SIZE) {
+    return contents;
+  }
+
+  SessionLogHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  contents.valid = memcmp(header.magic, SESSION_LOG_MAGIC, sizeof(header.magic)) == 0 &&
+                   header.version == SESSION_LOG_VERSION;
+  contents.closed = header.closed != 0;
+  contents.committed = header.committedRecords;
+
+  // The same walk as tools/log2csv
+  for (uint32_t sequence = 0; (sequence + 2) * SESSION_LOG_SECTOR_SIZE <= data.size(); sequence++) {
+    const char* sector = data.data() + (sequence + 1) * SESSION_LOG_SECTOR_SIZE;
+    SessionLogSectorHeader sectorHeader;
+    memcpy(&sectorHeader, sector, sizeof(sectorHeader));
+    if (sectorHeader.magic != SESSION_LOG_SECTOR_MAGIC || sectorHeader.sequence != sequence ||
+        sectorHeader.recordCount > SESSION_LOG_RECORDS_PER_SECTOR || sectorHeader.sessionId != header.sessionId) {
+      break;
+    }
+    for (uint16_t i = 0; i < sectorHeader.recordCount; i++) {
+      SessionLogRecord record;
+      memcpy(&record, sector + sizeof(sectorHeader) + i * sizeof(record), sizeof(record));
+      contents.inOrder = contents.inOrder && record.elapsedTime == firstRow + contents.rows;
+      contents.rows++;
+    }
+  }
+  return contents;
+}
+
+// Write a session of numbered rows, starting at firstRow
+static void writeSession(uint32_t rows, uint32_t firstRow, uint32_t commitAfter, unsigned long cutAtWrite) {
+  SdFat sd;
+  SdLogSink sink;
+  sink.begin(&sd, SD_CONFIG, LOG_PREALLOCATE_SIZE, LOG_SYNC_INTERVAL);
+  sink.mount();
+  sink.recoverSessions();
+
+  LogSessionInfo info = {LOG_NAME, 1700000000, 0, 0, WHEEL_MAGNETS, CRANK_MAGNETS};
+  if (!sink.openSession(info)) {
+    return;
+  }
+  if (cutAtWrite != SHIM_SD_NEVER && cutAtWrite > 0) {
+    shimSdPowerCutAfter(cutAtWrite);
+  }
+
+  // The clock stands still, so only full sectors and commitAfter write
+  for (uint32_t i = 0; i < rows; i++) {
+    SessionLogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp = 1700000000 + (firstRow + i) / 10;
+    record.elapsedTime = firstRow + i;
+    record.wheelRPM = (uint16_t)(2800 + i % 50);
+    record.cadenceRPM = 900;
+    sink.appendRecord(record, 0);
+    if (i + 1 == commitAfter) {
+      sink.flush();
+    }
+  }
+
+  if (cutAtWrite == SHIM_SD_NEVER) {
+    sink.closeSession();
+  } else {
+    shimSdPowerCutAfter(0);  // The rest of the session never reaches the card
+  }
+}
+
+// Boot: recover, and return the number of failures
+static unsigned long boot() {
+  shimSdPowerCutAfter(SHIM_SD_NEVER);
+  SdFat sd;
+  SdLogSink sink;
+  sink.begin(&sd, SD_CONFIG, LOG_PREALLOCATE_SIZE, LOG_SYNC_INTERVAL);
+  sink.mount();
+  return sink.recoverSessions();
+}
+
+int main(int argc, char** argv) {
+  (void)argv;
+  if (argc != 1) {
+    fprintf(stderr, "Usage: log_recovery\n");
+    return 2;
+  }
+
+  Serial.setEcho(false);  // Recovery reports
+  bool failed = false;
+
+  printf("Case,Rows,Recovered,Expected,Committed,FileSectors,Result\n");
+  for (size_t c = 0; c < sizeof(CASES) / sizeof(CASES[0]); c++) {
+    const Case& test = CASES[c];
+    shimSdFormat();
+    shimSeedRandom((uint32_t)c + 1);
+
+    // A file recovery must leave alone, with bytes that look like a log
+    SdFat sd;
+    FsFile other = sd.open(OTHER_NAME, O_RDWR | O_CREAT);
+    uint8_t pattern[SESSION_LOG_SECTOR_SIZE];
+    memset(pattern, 0, sizeof(pattern));
+    memcpy(pattern, SESSION_LOG_MAGIC, 4);
+    other.write(pattern, sizeof(pattern));
+    other.close();
+    std::string otherBefore = shimSdFileContents(OTHER_NAME);
+
+    uint32_t firstRow = 0;
+    if (test.earlierSession) {
+      writeSession(EARLIER_ROWS, 100000, 0, SHIM_SD_NEVER);
+      boot();
+    }
+    writeSession(test.rows, firstRow, test.commitAfter, test.cutAtWrite);
+
+    unsigned long failures = boot();
+    std::string recovered = shimSdFileContents(LOG_NAME);
+    LogContents contents = readLog(recovered, firstRow);
+    uint32_t dataSectors = (test.expectedRows + SESSION_LOG_RECORDS_PER_SECTOR - 1) / SESSION_LOG_RECORDS_PER_SECTOR;
+
+    failures += boot();
+    bool ok = failures == 0 && contents.valid && contents.closed && contents.inOrder &&
+              contents.rows == test.expectedRows && contents.committed == test.expectedCommitted &&
+              contents.sectors == dataSectors + 1 && recovered.size() % SESSION_LOG_SECTOR_SIZE == 0 &&
+              shimSdFileContents(LOG_NAME) == recovered && shimSdFileContents(OTHER_NAME) == otherBefore;
+    failed = failed || !ok;
+
+    printf("%s,%u,%u,%u,%u,%u,%s\n", test.name, test.rows, contents.rows, test.expectedRows, contents.committed,
+           contents.sectors, ok ? "ok" : "FAIL");
+  }
+  return failed ? 1 : 0;
+}
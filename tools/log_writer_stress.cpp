@@ -0,0 +1,278 @@
+// Host harness for LogWriter (see include/log_writer.h), built on the
+// std::thread queue backend. The producer stands in for loop(): it
+// enqueues a numbered row every loop period and now and then hands over
+// a capture sector from a small buffer pool, the way EdgeCapture does. A
+// fake sink in place of the SD card stalls for 200-500 ms at random, like
+// a card doing wear levelling. Each case checks that the measurement side
+// never waits on the sink (the slowest enqueue stays far below one
+// stall), that every row is either written once and in order or counted
+// as dropped, and that every capture buffer is handed back. In one case
+// the sink cannot open the session file, so every row must be counted
+// as dropped.
+//
+// Build: g++ -std=c++11 -O2 -pthread -I../include -o log_writer_stress log_writer_stress.cpp ../src/log_writer.cpp ../src/log_queue_thread.cpp
+// Usage: log_writer_stress [options]
+//   --seconds <n>   Run time per case (default 3)
+//   --loop-us <n>   Producer loop period (default 1000)
+//   --seed <n>      Stall schedule seed (default 1)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "log_writer.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define QUEUE_LENGTH 32            // LOG_QUEUE_LENGTH
+#define SYNC_INTERVAL 100          // Short, so idle flushes happen during the run
+#define CAPTURE_BUFFERS 4          // EDGE_CAPTURE_BUFFERS
+#define CAPTURE_EVERY 8            // Loop iterations per capture sector
+#define MAX_ENQUEUE_MICROS 20000   // A tenth of the shortest stall; leaves room for host scheduling
+
+static Clock::time_point epoch = Clock::now();
+
+uint32_t clockMillis() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - epoch).count();
+}
+
+uint32_t clockMicros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - epoch).count();
+}
+
+struct Case {
+  const char* name;
+  uint32_t stallEvery;    // Mean sink calls between stalls (0 = never)
+  bool failOpen;          // The session file cannot be created
+};
+
+static const Case CASES[] = {
+  {"steady", 0, false},
+  {"stalls", 1000, false},
+  {"frequent-stalls", 200, false},
+  {"failed-open", 200, true},
+};
+
+// Stands in for the SD card: keeps what it is given and sleeps 200-500 ms
+// on random calls
+class StallingSink : public LogSink {
+public:
+  StallingSink(uint32_t stallEvery, bool failOpen, uint32_t seed) :
+    stallEvery(stallEvery), failOpen(failOpen), random(seed), open(false), stalls(0), outOfOrder(0),
+    captureOpen(false) {}
+
+  bool mount() override { return true; }
+  unsigned long recoverSessions() override { stall(); return 0; }
+
+  bool openSession(const LogSessionInfo& info) override {
+    (void)info;
+    stall();
+    open = !failOpen;
+    return open;
+  }
+
+  bool isSessionOpen() const override { return open; }
+
+  bool appendRecord(const SessionLogRecord& record, unsigned long currentTime) override {
+    (void)currentTime;
+    stall();
+    if (!rows.empty() && record.elapsedTime <= rows.back()) {
+      outOfOrder++;
+    }
+    rows.push_back(record.elapsedTime);
+    return true;
+  }
+
+  void closeSession() override { open = false; }
+  bool setBootTimestamp(uint32_t bootTimestamp) override { (void)bootTimestamp; return true; }
+  bool flush() override { stall(); return true; }
+
+  bool openCapture(const char* fileName) override {
+    (void)fileName;
+    captureOpen = true;
+    return true;
+  }
+
+  bool writeCaptureSector(uint32_t index, const uint8_t* data) override {
+    stall();
+    // The producer fills each sector with its index; a torn one means the
+    // buffer was reused before it was handed back
+    uint8_t expected = (uint8_t)index;
+    for (size_t i = 0; i < SESSION_LOG_SECTOR_SIZE; i++) {
+      if (data[i] != expected) {
+        return false;
+      }
+    }
+    if (!sectors.empty() && index <= sectors.back()) {
+      outOfOrder++;
+    }
+    sectors.push_back(index);
+    return captureOpen;
+  }
+
+  bool syncCapture() override { return true; }
+  void closeCapture() override { captureOpen = false; }
+
+  std::vector<uint32_t> rows;
+  std::vector<uint32_t> sectors;
+  unsigned long getStalls() const { return stalls; }
+  unsigned long getOutOfOrder() const { return outOfOrder; }
+
+private:
+  uint32_t stallEvery;
+  bool failOpen;
+  std::mt19937 random;
+  bool open;
+  unsigned long stalls;
+  unsigned long outOfOrder;
+  bool captureOpen;
+
+  void stall() {
+    if (stallEvery == 0 || random() % stallEvery != 0) {
+      return;
+    }
+    std::uniform_int_distribution<uint32_t> length(200, 500);
+    std::this_thread::sleep_for(std::chrono::milliseconds(length(random)));
+    stalls++;
+  }
+};
+
+struct Result {
+  unsigned long enqueued;
+  unsigned long sectorsQueued;
+  unsigned long sectorsKept;    // No free buffer, or refused by the queue
+  unsigned long buffersLost;    // Still marked busy after the writer stopped
+  double p99Micros;
+  double maxMicros;
+};
+
+static void produce(LogWriter& writer, unsigned long seconds, uint32_t loopMicros, Result* result) {
+  static uint8_t buffers[CAPTURE_BUFFERS][SESSION_LOG_SECTOR_SIZE];
+  static std::atomic<bool> busy[CAPTURE_BUFFERS];
+  for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+    busy[i].store(false);
+  }
+
+  std::vector<double> latencies;
+  SessionLogRecord record;
+  memset(&record, 0, sizeof(record));
+  uint32_t sector = 0;
+  unsigned long iterations = seconds * 1000000UL / loopMicros;
+  Clock::time_point next = Clock::now();
+
+  writer.openSession("stress.bin", 0, clockMillis(), 0, 1, 1);
+  writer.openCapture("stress.cap");
+  for (unsigned long k = 1; k <= iterations; k++) {
+    record.elapsedTime = (uint32_t)k;
+
+    Clock::time_point before = Clock::now();
+    writer.enqueue(record);
+    Clock::time_point after = Clock::now();
+    latencies.push_back(std::chrono::duration<double, std::micro>(after - before).count());
+    result->enqueued++;
+
+    if (k % CAPTURE_EVERY == 0) {
+      int index = -1;
+      for (int i = 0; i < CAPTURE_BUFFERS && index < 0; i++) {
+        if (!busy[i].load(std::memory_order_acquire)) {
+          index = i;
+        }
+      }
+      if (index < 0) {
+        result->sectorsKept++;
+      } else {
+        memset(buffers[index], (uint8_t)sector, SESSION_LOG_SECTOR_SIZE);
+        busy[index].store(true, std::memory_order_relaxed);
+        if (writer.writeCaptureSector(buffers[index], sector, &busy[index])) {
+          result->sectorsQueued++;
+          sector++;
+        } else {
+          busy[index].store(false, std::memory_order_relaxed);
+          result->sectorsKept++;
+        }
+      }
+    }
+
+    next += std::chrono::microseconds(loopMicros);
+    std::this_thread::sleep_until(next);
+  }
+  writer.closeCapture();
+  writer.closeSession();
+  writer.end();
+
+  for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+    if (busy[i].load()) {
+      result->buffersLost++;
+    }
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  result->p99Micros = latencies[latencies.size() * 99 / 100];
+  result->maxMicros = latencies.back();
+}
+
+int main(int argc, char** argv) {
+  unsigned long seconds = 3;
+  uint32_t loopMicros = 1000;
+  uint32_t seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+      loopMicros = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--seconds <n>] [--loop-us <n>] [--seed <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (seconds == 0 || loopMicros == 0) {
+    fprintf(stderr, "Error: --seconds and --loop-us must be non-zero\n");
+    return 2;
+  }
+
+  bool failed = false;
+  printf("Case,Stalls,Enqueued,Written,Dropped,Errors,Sectors,SectorsKept,P99Enqueue(us),MaxEnqueue(us),Result\n");
+  for (size_t c = 0; c < sizeof(CASES) / sizeof(CASES[0]); c++) {
+    const Case& test = CASES[c];
+    Result result;
+    memset(&result, 0, sizeof(result));
+
+    StallingSink sink(test.stallEvery, test.failOpen, seed + (uint32_t)c);
+    LogWriter* writer = new LogWriter();
+    if (!writer->begin(&sink, QUEUE_LENGTH, SYNC_INTERVAL)) {
+      fprintf(stderr, "Error: Could not start the log writer\n");
+      return 1;
+    }
+    produce(*writer, seconds, loopMicros, &result);
+
+    // Written rows are exactly the ones not dropped, each once and in
+    // order; queued sectors all reached the sink; nothing waited on a
+    // stall. Without a session file nothing is written, and the failed
+    // open is the only error.
+    bool ok = writer->getWrittenCount() + writer->getDroppedCount() == result.enqueued &&
+              sink.rows.size() == writer->getWrittenCount() &&
+              sink.sectors.size() == result.sectorsQueued &&
+              sink.getOutOfOrder() == 0 &&
+              writer->getWriteErrorCount() == (test.failOpen ? 1UL : 0UL) &&
+              (!test.failOpen || writer->getWrittenCount() == 0) &&
+              result.buffersLost == 0 &&
+              result.maxMicros < MAX_ENQUEUE_MICROS &&
+              (test.stallEvery > 0 || writer->getDroppedCount() == 0);
+    failed = failed || !ok;
+
+    printf("%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.1f,%.1f,%s\n", test.name, sink.getStalls(), result.enqueued,
+           writer->getWrittenCount(), writer->getDroppedCount(), writer->getWriteErrorCount(),
+           result.sectorsQueued, result.sectorsKept, result.p99Micros, result.maxMicros, ok ? "ok" : "FAIL");
+    delete writer;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+// Checks that the averages do not depend on how often loop() runs. The
+// same seeded ride - steady riding with jitter, surges, coasting stops long
+// enough to time out, the crank stopping while the wheel turns, contact
+// bounce the debounce filter must reject, and bursts of 1 to 3 s above the
+// channel's maximum RPM (electrical noise) that get past the debounce
+// filter - is replayed through RPMCalculator on a virtual clock with
+// loop() passes every 1, 10, 100, 1000 and 10000 us. At every
+// OUTPUT_INTERVAL boundary (which each of those periods lands on exactly)
+// the interval average, the session average after updateAverages() and
+// the serial, log and ESP-NOW window averages of both channels are
+// recorded. Every period must record the same values as the 1 us run, and
+// none of them, nor the smoothed reading or the recent-edge maximum, may
+// exceed the channel's maximum RPM; else the tool exits 1.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o loop_invariance loop_invariance.cpp ../src/rpm_calculator.cpp ../src/sensor_engine.cpp ../src/gear_estimator.cpp ../src/cadence_fusion.cpp ../src/event_loop.cpp
+// Usage: loop_invariance [--seconds <n>] [--seed <n>]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "config.h"
+#include "clock.h"
+#include "rpm_calculator.h"
+
+// Virtual clock - advanced by the simulation only
+static uint64_t virtualMicros = 0;
+
+uint32_t clockMillis() {
+  return (uint32_t)(virtualMicros / 1000);
+}
+
+uint32_t clockMicros() {
+  return (uint32_t)virtualMicros;
+}
+
+static const uint32_t LOOP_PERIODS[] = {1, 10, 100, 1000, 10000};  // Each divides a millisecond
+static const uint64_t TIMEOUT_LEAD = 3005000;  // Edge to OUTPUT_INTERVAL boundary: the 3 s timeout plus 5 ms
+
+struct Edge {
+  uint64_t time;
+  bool wheel;
+};
+
+static bool edgeEarlier(const Edge& a, const Edge& b) {
+  return a.time < b.time;
+}
+
+// One channel's edges: riding spells at a random speed with per-edge
+// jitter, an occasional surge and, in some spells, a burst at 1.2 to 1.9
+// times limitRPM, separated by stops of 0.5 to 8 s, with bounce edges
+// sprinkled in. Every other spell ends with a last, slow edge
+// placed so the timeout falls a few milliseconds before an OUTPUT_INTERVAL
+// boundary, where a coarse loop only notices it on the boundary pass, and
+// a stop long enough to reach it.
+static void synthesizeChannel(std::vector<Edge>& edges, bool wheel, uint8_t magnets, double minRPM, double maxRPM,
+                              double limitRPM, uint64_t end, std::mt19937& random) {
+  std::uniform_real_distribution<double> speed(minRPM, maxRPM);
+  std::uniform_real_distribution<double> burstSpeed(1.2 * limitRPM, 1.9 * limitRPM);
+  std::uniform_int_distribution<uint32_t> burstLength(1000000, 3000000);
+  std::uniform_real_distribution<double> jitter(0.97, 1.03);
+  std::uniform_int_distribution<uint32_t> spell(5000000, 40000000);
+  std::uniform_int_distribution<uint32_t> stop(500000, 8000000);
+  std::uniform_int_distribution<uint32_t> chance(0, 999);
+
+  uint64_t time = 1000000;
+  while (time < end) {
+    uint64_t spellEnd = time + spell(random);
+    double rpm = speed(random);
+    uint64_t burstStart = spellEnd;
+    uint64_t burstEnd = spellEnd;
+    double burstRPM = burstSpeed(random);
+    if (chance(random) < 300) {
+      burstStart = time + (spellEnd - time) * chance(random) / 1000;
+      burstEnd = burstStart + burstLength(random);
+    }
+    while (time < spellEnd && time < end) {
+      Edge edge = {time, wheel};
+      edges.push_back(edge);
+      if (chance(random) < 5) {
+        Edge bounce = {time + 50 + chance(random), wheel};  // Well inside the debounce window
+        edges.push_back(bounce);
+      }
+      if (chance(random) < 2) {
+        rpm = speed(random);  // Surge or sudden easing off
+      }
+      double edgeRPM = time >= burstStart && time < burstEnd ? burstRPM : rpm;
+      time += (uint64_t)(60000000.0 / (edgeRPM * magnets) * jitter(random));
+    }
+    if (chance(random) < 500 && !edges.empty()) {
+      const uint64_t outputMicros = (uint64_t)OUTPUT_INTERVAL * 1000;
+      uint64_t boundary = (edges.back().time + TIMEOUT_LEAD + outputMicros) / outputMicros * outputMicros;
+      Edge last = {boundary - TIMEOUT_LEAD, wheel};
+      edges.push_back(last);
+      time = last.time + TIMEOUT_LEAD;
+    }
+    time += stop(random);
+  }
+}
+
+// Values recorded at each OUTPUT_INTERVAL boundary
+struct Boundary {
+  uint32_t values[2][5];  // Per channel: interval, session, serial, log, ESP-NOW window
+};
+
+// Records the boundaries of one loop period; implausible counts those
+// where a channel reads above its maximum RPM
+static std::vector<Boundary> run(const std::vector<Edge>& edges, uint64_t end, uint32_t loopPeriod,
+                                 unsigned long& implausible) {
+  static RPMCalculator calculator;
+  virtualMicros = 0;
+  calculator.begin(WHEEL_MAGNETS, CRANK_MAGNETS);
+  calculator.configureGlitchFilters(WHEEL_GLITCH_PERCENT, CADENCE_GLITCH_PERCENT);
+  calculator.configureAverageWindow(AVERAGE_SERIAL, SERIAL_AVERAGE_WINDOW);
+  calculator.configureAverageWindow(AVERAGE_LOG, LOG_AVERAGE_WINDOW);
+  calculator.configureAverageWindow(AVERAGE_ESPNOW, ESPNOW_AVERAGE_WINDOW);
+  calculator.startNewSession();
+
+  const SensorEngine& engine = calculator.getEngine();
+  const uint8_t channels[2] = {calculator.getWheelChannel(), calculator.getCadenceChannel()};
+  const uint32_t limits[2] = {(uint32_t)MAX_WHEEL_RPM * MILLI_RPM_PER_RPM, (uint32_t)MAX_CADENCE_RPM * MILLI_RPM_PER_RPM};
+  const uint64_t outputMicros = (uint64_t)OUTPUT_INTERVAL * 1000;
+  std::vector<Boundary> boundaries;
+  size_t nextEdge = 0;
+  implausible = 0;
+
+  // The same order of calls as loop() in main.cpp
+  for (virtualMicros = loopPeriod; virtualMicros <= end; virtualMicros += loopPeriod) {
+    while (nextEdge < edges.size() && edges[nextEdge].time <= virtualMicros) {
+      if (edges[nextEdge].wheel) {
+        calculator.recordWheelEdge((uint32_t)edges[nextEdge].time);
+      } else {
+        calculator.recordCadenceEdge((uint32_t)edges[nextEdge].time);
+      }
+      nextEdge++;
+    }
+
+    calculator.calculateRPMs();
+    calculator.checkTimeouts();
+
+    if (virtualMicros % outputMicros == 0) {
+      Boundary boundary;
+      for (uint8_t i = 0; i < 2; i++) {
+        boundary.values[i][0] = engine.getIntervalMilliRPM(channels[i]);
+      }
+      calculator.updateAverages();
+      for (uint8_t i = 0; i < 2; i++) {
+        boundary.values[i][1] = engine.getSessionAvgMilliRPM(channels[i]);
+        boundary.values[i][2] = engine.getAverageMilliRPM(channels[i], SERIAL_AVERAGE_WINDOW);
+        boundary.values[i][3] = engine.getAverageMilliRPM(channels[i], LOG_AVERAGE_WINDOW);
+        boundary.values[i][4] = engine.getAverageMilliRPM(channels[i], ESPNOW_AVERAGE_WINDOW);
+      }
+      calculator.resetIntervalCounters();
+      boundaries.push_back(boundary);
+
+      bool above = false;
+      for (uint8_t i = 0; i < 2; i++) {
+        above = above || engine.getSmoothedMilliRPM(channels[i]) > limits[i] ||
+                engine.getEdgeStats(channels[i]).max() > limits[i];
+        for (uint8_t v = 0; v < 5; v++) {
+          above = above || boundary.values[i][v] > limits[i];
+        }
+      }
+      if (above) {
+        implausible++;
+      }
+    }
+  }
+  return boundaries;
+}
+
+static const char* VALUE_NAMES[5] = {"interval", "session", "serial window", "log window", "ESP-NOW window"};
+
+// Number of boundaries that differ from the reference; the first is described on stderr
+static unsigned long compare(const std::vector<Boundary>& reference, const std::vector<Boundary>& boundaries,
+                             uint32_t loopPeriod) {
+  if (boundaries.size() != reference.size()) {
+    fprintf(stderr, "--loop-us %u: %zu boundaries, expected %zu\n", loopPeriod, boundaries.size(), reference.size());
+    return reference.size();
+  }
+
+  unsigned long mismatches = 0;
+  for (size_t b = 0; b < reference.size(); b++) {
+    if (memcmp(&reference[b], &boundaries[b], sizeof(Boundary)) == 0) {
+      continue;
+    }
+    if (mismatches == 0) {
+      for (uint8_t i = 0; i < 2; i++) {
+        for (uint8_t v = 0; v < 5; v++) {
+          if (reference[b].values[i][v] != boundaries[b].values[i][v]) {
+            fprintf(stderr, "--loop-us %u at %llu ms: %s %s %u mRPM, expected %u\n", loopPeriod,
+                    (unsigned long long)(b + 1) * OUTPUT_INTERVAL, i == 0 ? "wheel" : "cadence", VALUE_NAMES[v],
+                    boundaries[b].values[i][v], reference[b].values[i][v]);
+          }
+        }
+      }
+    }
+    mismatches++;
+  }
+  return mismatches;
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds = 300;
+  uint32_t seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--seconds <n>] [--seed <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (seconds == 0) {
+    fprintf(stderr, "Error: --seconds must be non-zero\n");
+    return 2;
+  }
+
+  uint64_t end = (uint64_t)seconds * 1000000;
+  std::mt19937 random(seed);
+  std::vector<Edge> edges;
+  synthesizeChannel(edges, true, WHEEL_MAGNETS, 80.0, 400.0, MAX_WHEEL_RPM, end, random);
+  synthesizeChannel(edges, false, CRANK_MAGNETS, 50.0, 120.0, MAX_CADENCE_RPM, end, random);
+  std::stable_sort(edges.begin(), edges.end(), edgeEarlier);
+
+  const size_t periods = sizeof(LOOP_PERIODS) / sizeof(LOOP_PERIODS[0]);
+  unsigned long implausible;
+  std::vector<Boundary> reference = run(edges, end, LOOP_PERIODS[0], implausible);
+  bool failed = false;
+
+  printf("LoopUs,Edges,Boundaries,Mismatches,Implausible,Result\n");
+  for (size_t p = 0; p < periods; p++) {
+    unsigned long mismatches = 0;
+    if (p > 0) {
+      mismatches = compare(reference, run(edges, end, LOOP_PERIODS[p], implausible), LOOP_PERIODS[p]);
+    }
+    bool ok = mismatches == 0 && implausible == 0;
+    failed = failed || !ok;
+    printf("%u,%zu,%zu,%lu,%lu,%s\n", LOOP_PERIODS[p], edges.size(), reference.size(), mismatches, implausible,
+           ok ? "ok" : "FAIL");
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,253 @@
+// Faster-than-real-time replay of recorded or synthesized sensor edges
+// through RPMCalculator. A virtual clock stands in for the board clock and
+// loop() is simulated pass by pass, so the output is the same CSV rows the
+// firmware would have logged for that ride.
+//
+// By default loop() polls every --loop-us. With --event it runs the way the
+// firmware's event loop does: a pass on every edge and at every deadline
+// registered with EventLoop, nothing in between. Its rows must match a
+// loop polling every microsecond (--loop-us 1) byte for byte.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o replay replay.cpp ../src/rpm_calculator.cpp ../src/sensor_engine.cpp ../src/gear_estimator.cpp ../src/cadence_fusion.cpp ../src/event_loop.cpp
+// Usage: replay [options] <input>
+//   input             Edge table, one "W,<micros>" or "C,<micros>" per line
+//   --synth           Input is a session CSV; edges are synthesized from its rows
+//   --loop-us <n>     Simulated loop() period in microseconds (default 1000)
+//   --event           Event-driven passes instead of polling
+//   --start <unix>    Wall-clock start time for the Timestamp column (default: millis)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include "config.h"
+#include "clock.h"
+#include "rpm_calculator.h"
+#include "event_loop.h"
+#include "session_record.h"
+#include "csv_row.h"
+
+// Virtual clock - advanced by the simulation only
+static uint64_t virtualMicros = 0;
+
+uint32_t clockMillis() {
+  return (uint32_t)(virtualMicros / 1000);
+}
+
+uint32_t clockMicros() {
+  return (uint32_t)virtualMicros;
+}
+
+struct Edge {
+  uint64_t time;  // micros since start of the recording
+  bool wheel;
+};
+
+static bool edgeEarlier(const Edge& a, const Edge& b) {
+  return a.time < b.time;
+}
+
+// Read an edge table of "W,<micros>" / "C,<micros>" lines
+static bool readEdges(FILE* in, std::vector<Edge>& edges) {
+  char line[128];
+  while (fgets(line, sizeof(line), in)) {
+    char channel = line[0];
+    if ((channel != 'W' && channel != 'C') || line[1] != ',') {
+      continue;  // Header or comment
+    }
+    Edge edge;
+    edge.time = strtoull(line + 2, nullptr, 10);
+    edge.wheel = channel == 'W';
+    edges.push_back(edge);
+  }
+
+  // Captured tables list each channel's edges in the order loop() drained them
+  std::stable_sort(edges.begin(), edges.end(), edgeEarlier);
+  return !edges.empty();
+}
+
+// Generate evenly spaced edges matching the RPM of each session CSV row
+static void synthesizeChannel(std::vector<Edge>& edges, bool wheel, double rpm, uint8_t magnets,
+                              uint64_t rowStart, uint64_t rowEnd, double& nextEdge) {
+  if (rpm <= 0) {
+    nextEdge = 0;
+    return;
+  }
+  double period = 60000000.0 / (rpm * magnets);
+  if (nextEdge < rowStart) {
+    nextEdge = rowStart;
+  }
+  while (nextEdge < rowEnd) {
+    Edge edge;
+    edge.time = (uint64_t)nextEdge;
+    edge.wheel = wheel;
+    edges.push_back(edge);
+    nextEdge += period;
+  }
+}
+
+static bool synthesizeEdges(FILE* in, std::vector<Edge>& edges) {
+  char line[256];
+  uint64_t previousElapsed = 0;
+  double nextWheelEdge = 0;
+  double nextCadenceEdge = 0;
+  bool first = true;
+
+  while (fgets(line, sizeof(line), in)) {
+    unsigned long timestamp, elapsed;
+    double wheelRPM, cadenceRPM;
+    if (sscanf(line, "%lu,%lu,%lf,%lf", &timestamp, &elapsed, &wheelRPM, &cadenceRPM) != 4) {
+      continue;  // Header
+    }
+
+    // Each row covers the logging interval that ended at its elapsed time
+    uint64_t rowEnd = (uint64_t)elapsed * 1000;
+    uint64_t rowStart = first ? (rowEnd > LOGGING_INTERVAL * 1000ULL ? rowEnd - LOGGING_INTERVAL * 1000ULL : 0)
+                              : previousElapsed * 1000;
+    synthesizeChannel(edges, true, wheelRPM, WHEEL_MAGNETS, rowStart, rowEnd, nextWheelEdge);
+    synthesizeChannel(edges, false, cadenceRPM, CRANK_MAGNETS, rowStart, rowEnd, nextCadenceEdge);
+    previousElapsed = elapsed;
+    first = false;
+  }
+
+  std::sort(edges.begin(), edges.end(), edgeEarlier);
+  return !edges.empty();
+}
+
+int main(int argc, char** argv) {
+  const char* inputName = nullptr;
+  bool synth = false;
+  bool eventDriven = false;
+  uint64_t loopPeriod = 1000;
+  uint32_t startTimestamp = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--synth") == 0) {
+      synth = true;
+    } else if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+      loopPeriod = strtoull(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--event") == 0) {
+      eventDriven = true;
+    } else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) {
+      startTimestamp = strtoul(argv[++i], nullptr, 10);
+    } else {
+      inputName = argv[i];
+    }
+  }
+
+  if (!inputName || loopPeriod == 0) {
+    fprintf(stderr, "Usage: %s [--synth] [--loop-us <n>] [--event] [--start <unix>] <input>\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(inputName, "r");
+  if (!in) {
+    fprintf(stderr, "Error: cannot open %s\n", inputName);
+    return 1;
+  }
+
+  std::vector<Edge> edges;
+  bool loaded = synth ? synthesizeEdges(in, edges) : readEdges(in, edges);
+  fclose(in);
+  if (!loaded) {
+    fprintf(stderr, "Error: no edges in %s\n", inputName);
+    return 1;
+  }
+
+  clock_t wallStart = clock();
+
+  // Same setup sequence as the firmware
+  RPMCalculator calculator;
+  calculator.begin(WHEEL_MAGNETS, CRANK_MAGNETS);
+  calculator.configureGlitchFilters(WHEEL_GLITCH_PERCENT, CADENCE_GLITCH_PERCENT);
+  calculator.configureAverageWindow(AVERAGE_SERIAL, SERIAL_AVERAGE_WINDOW);
+  calculator.configureAverageWindow(AVERAGE_LOG, LOG_AVERAGE_WINDOW);
+  calculator.configureAverageWindow(AVERAGE_ESPNOW, ESPNOW_AVERAGE_WINDOW);
+
+  unsigned long lastOutputTime = 0;
+  unsigned long lastLoggingTime = 0;
+  unsigned long sessionStartTime = 0;
+  bool isSessionActive = false;
+  unsigned long rows = 0;
+  unsigned long passes = 0;
+  EventLoop events;
+
+  // Run a little past the last edge so timeouts and the final rows appear
+  uint64_t endTime = edges.back().time + (uint64_t)OUTPUT_INTERVAL * 1000 * 2;
+  size_t nextEdge = 0;
+
+  printf("%s\n", SESSION_LOG_CSV_HEADER);
+
+  // Mirrors loop() in main.cpp, one simulated pass per loopPeriod or per event
+  virtualMicros = 0;
+  while (virtualMicros <= endTime) {
+    // Deliver every edge the ISRs would have queued since the last pass
+    while (nextEdge < edges.size() && edges[nextEdge].time <= virtualMicros) {
+      uint32_t edgeTime = (uint32_t)edges[nextEdge].time;
+      if (edges[nextEdge].wheel) {
+        calculator.recordWheelEdge(edgeTime);
+      } else {
+        calculator.recordCadenceEdge(edgeTime);
+      }
+      nextEdge++;
+    }
+
+    unsigned long currentTime = clockMillis();
+
+    calculator.calculateRPMs();
+    calculator.checkTimeouts();
+
+    if (currentTime - lastOutputTime >= OUTPUT_INTERVAL) {
+      if (isSessionActive) {
+        calculator.updateAverages();
+      }
+      calculator.resetIntervalCounters();
+      lastOutputTime = currentTime;
+    }
+
+    if (!isSessionActive && calculator.areReadingsStabilized(currentTime) && calculator.hasActivity()) {
+      calculator.startNewSession();
+      isSessionActive = true;
+      sessionStartTime = currentTime;
+    }
+
+    if (isSessionActive && currentTime - lastLoggingTime >= LOGGING_INTERVAL) {
+      uint32_t timestamp = startTimestamp ? startTimestamp + currentTime / 1000 : currentTime;
+      SessionLogRecord record = makeSessionLogRecord(calculator, timestamp, currentTime - sessionStartTime,
+                                                     calculator.getAverageWheelRPM(AVERAGE_LOG),
+                                                     calculator.getAverageCadenceRPM(AVERAGE_LOG));
+      printCsvRow(stdout, record);
+      rows++;
+      lastLoggingTime = currentTime;
+    }
+    passes++;
+
+    if (!eventDriven) {
+      virtualMicros += loopPeriod;
+      continue;
+    }
+
+    // Same deadlines as scheduleWakeups() in main.cpp; the next pass is
+    // at the earliest of them or at the next edge's interrupt
+    calculator.scheduleDeadlines(events);
+    events.wakeAfter(lastOutputTime, OUTPUT_INTERVAL);
+    if (isSessionActive) {
+      events.wakeAfter(lastLoggingTime, LOGGING_INTERVAL);
+    }
+    uint64_t wakeTime = events.getDelay() == UINT32_MAX ? endTime + 1 : virtualMicros + events.getDelay();
+    if (nextEdge < edges.size() && edges[nextEdge].time < wakeTime) {
+      wakeTime = edges[nextEdge].time;
+    }
+    events.clearDeadlines();
+    virtualMicros = wakeTime > virtualMicros ? wakeTime : virtualMicros + 1;
+  }
+
+  double wallSeconds = (double)(clock() - wallStart) / CLOCKS_PER_SEC;
+  double simSeconds = endTime / 1000000.0;
+  fprintf(stderr, "Replayed %zu edges, %lu rows, %lu passes, %.1f s simulated in %.3f s (%.0fx real time)\n",
+          edges.size(), rows, passes, simSeconds, wallSeconds,
+          wallSeconds > 0 ? simSeconds / wallSeconds : 0.0);
+  return 0;
+}
@@ -0,0 +1,177 @@
+// Compares the GPIO and pulse counter (PCNT) sensor backends at equal
+// pulse rates. The same edge trains go through the simulated SensorInput
+// backend twice - once with every edge an interrupt (GPIO), once with the
+// wheel's edges grouped per revolution as the pulse counter does - and
+// through SensorEngine on a virtual clock. For each wheel speed the tool
+// prints pulse and interrupt rates, the estimated CPU load of the
+// interrupts, the host time spent draining the queues, and how far the
+// wheel reading strays from the true speed.
+//
+// Interrupt cost is an input (--isr-us): take it from the "sensor_input"
+// line of an instrumented build's stats dump plus the entry/exit overhead.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o sensor_load sensor_load.cpp ../src/sensor_input.cpp ../src/sensor_input_sim.cpp ../src/sensor_engine.cpp
+// Usage: sensor_load [options]
+//   --seconds <n>          Simulated time per speed (default 120)
+//   --isr-us <x>           CPU time per interrupt in microseconds (default 2.5)
+//   --spacing-error <pct>  Peak magnet placement error in % of the spacing (default 2)
+//   --cadence <rpm>        Crank speed for every run (default 90)
+//   --latency-us <n>       Max interrupt latency added to each timestamp (default 5)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include "config.h"
+#include "sensor_input.h"
+
+// Virtual clock - advanced by the simulation only
+static uint64_t virtualMicros = 0;
+
+uint32_t clockMillis() {
+  return (uint32_t)(virtualMicros / 1000);
+}
+
+uint32_t clockMicros() {
+  return (uint32_t)virtualMicros;
+}
+
+#define LOOP_MICROS 1000
+#define SAMPLE_MICROS 100000  // Reading compared with the true speed every 100 ms
+
+static const uint16_t WHEEL_SPEEDS[] = {100, 250, 400, 600, 800, 1000};
+
+struct LoadResult {
+  unsigned long pulses;
+  unsigned long interrupts;
+  double processNanoseconds;
+  double errorSum;     // Sum of |reading - truth| / truth over the samples
+  unsigned long samples;
+};
+
+// Deterministic pseudo-random interrupt latency
+static uint32_t latencySeed = 1;
+
+static uint32_t latency(uint32_t maxMicros) {
+  latencySeed = latencySeed * 1103515245 + 12345;
+  return maxMicros > 0 ? (latencySeed >> 16) % (maxMicros + 1) : 0;
+}
+
+static LoadResult run(uint8_t wheelDivider, uint16_t wheelRPM, uint16_t cadenceRPM,
+                      uint32_t seconds, double spacingError, uint32_t maxLatency) {
+  static SensorEngine engine;
+  static SensorInput input;
+  const SensorChannelConfig channels[2] = {
+    {SENSOR_PIN_NONE, WHEEL_MAGNETS, 1000, WHEEL_GLITCH_PERCENT, wheelDivider},
+    {SENSOR_PIN_NONE, CRANK_MAGNETS, 200, CADENCE_GLITCH_PERCENT, 1}
+  };
+
+  virtualMicros = 1000000;
+  engine.clearChannels();
+  engine.addChannel(channels[0]);
+  engine.addChannel(channels[1]);
+  engine.reset();
+  input.begin(&engine);
+  latencySeed = 1;
+
+  // Fixed magnet placement error: magnet i sits spacingError * sin(...)
+  // of a spacing away from its nominal position
+  double wheelPeriod = 60e6 / wheelRPM;
+  double magnetOffset[WHEEL_MAGNETS];
+  for (uint8_t i = 0; i < WHEEL_MAGNETS; i++) {
+    magnetOffset[i] = spacingError / 100.0 * sin(2 * M_PI * i / WHEEL_MAGNETS * 3) * wheelPeriod / WHEEL_MAGNETS;
+  }
+  double cadencePeriod = 60e6 / cadenceRPM;
+
+  LoadResult result = {0, 0, 0.0, 0.0, 0};
+  uint64_t start = virtualMicros;
+  uint64_t end = start + (uint64_t)seconds * 1000000;
+  uint64_t nextSample = start + 2000000;  // Let the readings settle first
+  unsigned long wheelEdge = 1;
+  unsigned long cadenceEdge = 1;
+  uint64_t nextWheelTime = start + (uint64_t)(wheelPeriod / WHEEL_MAGNETS + magnetOffset[1]) + latency(maxLatency);
+  uint64_t nextCadenceTime = start + (uint64_t)cadencePeriod + latency(maxLatency);
+  std::chrono::steady_clock::duration elapsed(0);
+
+  while (virtualMicros < end) {
+    virtualMicros += LOOP_MICROS;
+
+    // Sensor edges whose interrupt has been taken by now, through the
+    // simulated hardware
+    while (nextWheelTime <= virtualMicros) {
+      input.inject(0, (uint32_t)nextWheelTime);
+      wheelEdge++;
+      result.pulses++;
+      nextWheelTime = start + (uint64_t)(wheelEdge * wheelPeriod / WHEEL_MAGNETS +
+                                         magnetOffset[wheelEdge % WHEEL_MAGNETS]) + latency(maxLatency);
+    }
+    while (nextCadenceTime <= virtualMicros) {
+      input.inject(1, (uint32_t)nextCadenceTime);
+      cadenceEdge++;
+      result.pulses++;
+      nextCadenceTime = start + (uint64_t)(cadenceEdge * cadencePeriod) + latency(maxLatency);
+    }
+
+    std::chrono::steady_clock::time_point passStart = std::chrono::steady_clock::now();
+    engine.process();
+    engine.checkTimeouts();
+    elapsed += std::chrono::steady_clock::now() - passStart;
+
+    if (virtualMicros >= nextSample) {
+      double reading = engine.getInstantMilliRPM(0) / (double)MILLI_RPM_PER_RPM;
+      result.errorSum += fabs(reading - wheelRPM) / wheelRPM;
+      result.samples++;
+      nextSample += SAMPLE_MICROS;
+    }
+  }
+
+  result.interrupts = input.getInterruptCount();
+  result.processNanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  input.end();
+  return result;
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds = 120;
+  double isrMicros = 2.5;
+  double spacingError = 2.0;
+  uint16_t cadenceRPM = 90;
+  uint32_t maxLatency = 5;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--isr-us") == 0 && i + 1 < argc) {
+      isrMicros = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--spacing-error") == 0 && i + 1 < argc) {
+      spacingError = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--cadence") == 0 && i + 1 < argc) {
+      cadenceRPM = (uint16_t)strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--latency-us") == 0 && i + 1 < argc) {
+      maxLatency = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--seconds <n>] [--isr-us <x>] [--spacing-error <pct>] [--cadence <rpm>] [--latency-us <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (seconds < 3 || cadenceRPM == 0) {
+    fprintf(stderr, "Error: --seconds must be at least 3 and --cadence non-zero\n");
+    return 2;
+  }
+
+  printf("Backend,WheelRPM,Pulses/s,Interrupts/s,ISR load(%%),Process(us/s host),Wheel error(%%)\n");
+  for (size_t s = 0; s < sizeof(WHEEL_SPEEDS) / sizeof(WHEEL_SPEEDS[0]); s++) {
+    const uint8_t dividers[2] = {1, WHEEL_MAGNETS};
+    const char* names[2] = {"gpio", "pcnt"};
+    for (uint8_t b = 0; b < 2; b++) {
+      LoadResult result = run(dividers[b], WHEEL_SPEEDS[s], cadenceRPM, seconds, spacingError, maxLatency);
+      double interruptRate = (double)result.interrupts / seconds;
+      printf("%s,%u,%.1f,%.1f,%.3f,%.2f,%.3f\n", names[b], WHEEL_SPEEDS[s],
+             (double)result.pulses / seconds, interruptRate, interruptRate * isrMicros / 1e4,
+             result.processNanoseconds / 1000.0 / seconds,
+             result.samples > 0 ? result.errorSum * 100 / result.samples : 0.0);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,145 @@
+// Stress test of SeqLock, the snapshot the sensor ISRs publish through
+// (see include/sensor_input.h). One producer thread writes as fast as it
+// can while reader threads on other cores copy the value and check that
+// every copy is a single write: all words are derived from one sequence
+// number, so a copy mixing two writes is caught. With --unguarded the
+// readers copy without the sequence protocol, which shows the check does
+// find torn reads on this machine.
+//
+// Build: g++ -std=c++11 -O2 -pthread -I../include -o seqlock_stress seqlock_stress.cpp
+// Usage: seqlock_stress [options]
+//   --seconds <n>   Run time (default 5)
+//   --readers <n>   Reader threads (default 3)
+//   --unguarded     Copy without the sequence protocol (expect torn reads)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "seqlock.h"
+
+// Twice the size of SensorChannelState, so a copy spans more time
+struct Payload {
+  uint32_t sequence;
+  uint32_t words[7];
+};
+
+static Payload makePayload(uint32_t n) {
+  Payload payload;
+  payload.sequence = n;
+  for (uint32_t i = 0; i < 7; i++) {
+    payload.words[i] = n * 2654435761u + i;
+  }
+  return payload;
+}
+
+static bool isConsistent(const Payload& payload) {
+  for (uint32_t i = 0; i < 7; i++) {
+    if (payload.words[i] != payload.sequence * 2654435761u + i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct ReaderResult {
+  unsigned long reads;
+  unsigned long retries;
+  unsigned long torn;
+  unsigned long backwards;  // Copies older than one already seen
+};
+
+static SeqLock<Payload> shared;
+static std::atomic<bool> running(true);
+
+static void produce(unsigned long* writes) {
+  uint32_t n = 0;
+  while (running.load(std::memory_order_relaxed)) {
+    shared.write(makePayload(++n));
+  }
+  *writes = n;
+}
+
+static void consume(bool guarded, ReaderResult* result) {
+  ReaderResult local = {0, 0, 0, 0};
+  uint32_t newest = 0;
+  while (running.load(std::memory_order_relaxed)) {
+    Payload payload;
+    if (guarded) {
+      uint32_t version;
+      for (;;) {
+        version = shared.readBegin();
+        payload = shared.load();
+        if (!shared.readRetry(version)) break;
+        local.retries++;
+      }
+    } else {
+      payload = shared.load();
+    }
+
+    local.reads++;
+    if (!isConsistent(payload)) {
+      local.torn++;
+    } else if (payload.sequence < newest) {
+      local.backwards++;
+    } else {
+      newest = payload.sequence;
+    }
+  }
+  *result = local;
+}
+
+int main(int argc, char** argv) {
+  unsigned long seconds = 5;
+  unsigned long readerCount = 3;
+  bool guarded = true;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) {
+      readerCount = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--unguarded") == 0) {
+      guarded = false;
+    } else {
+      fprintf(stderr, "Usage: %s [--seconds <n>] [--readers <n>] [--unguarded]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (seconds == 0 || readerCount == 0) {
+    fprintf(stderr, "Error: --seconds and --readers must be non-zero\n");
+    return 2;
+  }
+
+  unsigned long writes = 0;
+  shared.write(makePayload(0));  // Readers may start before the producer
+  std::vector<ReaderResult> results(readerCount);
+  std::vector<std::thread> readers;
+  std::thread producer(produce, &writes);
+  for (unsigned long r = 0; r < readerCount; r++) {
+    readers.push_back(std::thread(consume, guarded, &results[r]));
+  }
+
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  running.store(false);
+  producer.join();
+  ReaderResult total = {0, 0, 0, 0};
+  for (unsigned long r = 0; r < readerCount; r++) {
+    readers[r].join();
+    total.reads += results[r].reads;
+    total.retries += results[r].retries;
+    total.torn += results[r].torn;
+    total.backwards += results[r].backwards;
+  }
+
+  printf("Mode,Writes/s,Reads/s,Retries/s,Torn,Backwards\n");
+  printf("%s,%.0f,%.0f,%.0f,%lu,%lu\n", guarded ? "seqlock" : "unguarded",
+         (double)writes / seconds, (double)total.reads / seconds, (double)total.retries / seconds,
+         total.torn, total.backwards);
+
+  // Any torn or out-of-order copy through the seqlock is a failure
+  return guarded && (total.torn > 0 || total.backwards > 0) ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+// Host-side reader for the framed binary serial stream (serial_frame.h).
+// Reads from a capture file, a pty or the board's serial device, prints
+// sample records as CSV and optionally writes raw edges in the
+// "W,<micros>" / "C,<micros>" format that tools/replay reads.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o serial_reader serial_reader.cpp ../src/serial_frame.cpp
+// Usage: serial_reader [--edges <file>] <input>
+//   input             File, pty or serial device (e.g. /dev/ttyUSB0), or - for stdin
+//   --edges <file>    Write raw edge records to this file
+//
+// Send 'b' (samples) or 'e' (samples + edges) to the board to start the
+// binary stream and 't' to return to text. A serial device is switched to
+// raw mode at SERIAL_BAUD_RATE.
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "config.h"
+#include "serial_frame.h"
+
+#define SAMPLE_CSV_HEADER "Time(ms),WheelRPM,CadenceRPM,SmoothedWheelRPM,SmoothedCadenceRPM,Chainring,Sprocket,GearRatio"
+
+static speed_t ttySpeed(unsigned long baud) {
+  switch (baud) {
+    case 57600: return B57600;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+    default: return B115200;
+  }
+}
+
+// Put a tty into raw mode so no bytes are translated or buffered per line
+static void configureTty(int fd, unsigned long baud) {
+  struct termios tty;
+  if (tcgetattr(fd, &tty) != 0) {
+    return;
+  }
+  cfmakeraw(&tty);
+  cfsetispeed(&tty, ttySpeed(baud));
+  cfsetospeed(&tty, ttySpeed(baud));
+  tcsetattr(fd, TCSANOW, &tty);
+}
+
+int main(int argc, char** argv) {
+  const char* inputName = nullptr;
+  const char* edgesName = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--edges") == 0 && i + 1 < argc) {
+      edgesName = argv[++i];
+    } else {
+      inputName = argv[i];
+    }
+  }
+
+  if (!inputName) {
+    fprintf(stderr, "Usage: %s [--edges <file>] <input|->\n", argv[0]);
+    return 2;
+  }
+
+  int fd = strcmp(inputName, "-") == 0 ? STDIN_FILENO : open(inputName, O_RDONLY | O_NOCTTY);
+  if (fd < 0) {
+    fprintf(stderr, "Error: cannot open %s\n", inputName);
+    return 1;
+  }
+  bool live = isatty(fd);
+  if (live) {
+    configureTty(fd, SERIAL_BAUD_RATE);
+  }
+
+  FILE* edges = nullptr;
+  if (edgesName) {
+    edges = fopen(edgesName, "w");
+    if (!edges) {
+      fprintf(stderr, "Error: cannot create %s\n", edgesName);
+      return 1;
+    }
+  }
+
+  printf("%s\n", SAMPLE_CSV_HEADER);
+
+  SerialFrameDecoder decoder;
+  unsigned long samples = 0;
+  unsigned long edgeCount = 0;
+  uint8_t buffer[4096];
+  ssize_t length;
+
+  while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t i = 0; i < length; i++) {
+      if (!decoder.push(buffer[i])) {
+        continue;
+      }
+
+      if (decoder.getType() == SERIAL_RECORD_SAMPLE && decoder.getPayloadLength() == sizeof(SerialSampleRecord)) {
+        SerialSampleRecord sample;
+        memcpy(&sample, decoder.getPayload(), sizeof(sample));
+        printf("%u,%.3f,%.3f,%.3f,%.3f,%u,%u,%.3f\n", sample.time,
+               sample.wheelMilliRPM / 1000.0, sample.cadenceMilliRPM / 1000.0,
+               sample.smoothedWheelMilliRPM / 1000.0, sample.smoothedCadenceMilliRPM / 1000.0,
+               sample.chainring, sample.sprocket, sample.gearRatio / 1000.0);
+        samples++;
+      } else if (decoder.getType() == SERIAL_RECORD_EDGE && decoder.getPayloadLength() == sizeof(SerialEdgeRecord)) {
+        SerialEdgeRecord edge;
+        memcpy(&edge, decoder.getPayload(), sizeof(edge));
+        if (edges) {
+          fprintf(edges, "%c,%u\n", edge.channel == 0 ? 'W' : 'C', edge.time);
+        }
+        edgeCount++;
+      }
+    }
+
+    // Keep a live dashboard fed line by line
+    if (live) {
+      fflush(stdout);
+    }
+  }
+
+  if (fd != STDIN_FILENO) {
+    close(fd);
+  }
+  if (edges) {
+    fclose(edges);
+  }
+
+  fprintf(stderr, "%lu samples, %lu edges, %lu frames lost, %lu bad frames\n",
+          samples, edgeCount, decoder.getLostFrames(), decoder.getBadFrames());
+  return 0;
+}
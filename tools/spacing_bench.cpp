@@ -0,0 +1,310 @@
+// Accuracy check of the magnet spacing calibration (SpacingCalibrator).
+// A wheel whose magnets sit slightly off their nominal angles (seeded
+// random errors, so every run sees the same ring) is turned by synthetic
+// rides - steady, speed ramps, a stop and restart, missed edges - and the
+// edges run through SensorEngine on a virtual clock. After every pass
+// with an edge the instant wheel RPM is compared with the true mean speed
+// over that edge's interval. Each ride runs three times: calibration off,
+// learning from scratch, and restored from the table the scratch run
+// learned (as the firmware does from NVS after a reboot). For each run
+// the tool prints the mean and worst per-edge error, when corrections
+// started, how far the learned table is from the real spacing, and how
+// often the phase was found again.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o spacing_bench spacing_bench.cpp ../src/sensor_engine.cpp
+// Usage: spacing_bench [options]
+//   --error-deg <n>       Standard deviation of the magnet placement error (default 2)
+//   --magnets <n>         Magnets on the wheel (default WHEEL_MAGNETS)
+//   --seed <n>            Seed of the placement errors (default 1)
+//   --latency-us <n>      Max interrupt latency added to each timestamp (default 5)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "sensor_engine.h"
+
+// Virtual clock - advanced by the simulation only
+static uint64_t virtualMicros = 0;
+
+uint32_t clockMillis() {
+  return (uint32_t)(virtualMicros / 1000);
+}
+
+uint32_t clockMicros() {
+  return (uint32_t)virtualMicros;
+}
+
+#define LOOP_MICROS 1000
+#define SETTLE_MICROS 1000000  // No scoring until the first readings are in
+
+// A ride is a list of segments: the wheel speed ramps linearly from the
+// previous segment's end speed to rpm over the given seconds
+struct Segment {
+  double seconds;
+  double rpm;
+};
+
+struct Ride {
+  const char* name;
+  double startRPM;
+  Segment segments[8];
+  uint8_t segmentCount;
+  uint32_t missEvery;  // Drop every n-th edge (0 = none)
+};
+
+static const Ride RIDES[] = {
+  {"steady",    250, {{60, 250}}, 1, 0},
+  {"ramps",     200, {{15, 200}, {15, 400}, {15, 400}, {15, 200}}, 4, 0},
+  {"stopstart", 250, {{30, 250}, {0, 0}, {5, 0}, {3, 250}, {22, 250}}, 5, 0},
+  {"missed",    250, {{60, 250}}, 1, 400},
+};
+
+enum Mode { MODE_OFF, MODE_LEARN, MODE_RESTORED, MODE_COUNT };
+static const char* MODE_NAMES[MODE_COUNT] = {"off", "learn", "restored"};
+
+struct RunResult {
+  double errorSum;           // Sum of |reading - truth| in RPM
+  double maxError;
+  unsigned long edges;       // Scored edges
+  double calibratedAfter;    // Seconds into the ride, < 0 if never
+  double tableError;         // Worst learned slot vs the real spacing (% of even)
+  unsigned long resyncs;
+};
+
+// Deterministic pseudo-random numbers for latency and placement errors
+static uint32_t randomSeed = 1;
+
+static uint32_t nextRandom() {
+  randomSeed = randomSeed * 1103515245 + 12345;
+  return randomSeed >> 16;
+}
+
+static uint32_t latency(uint32_t maxMicros) {
+  return maxMicros > 0 ? nextRandom() % (maxMicros + 1) : 0;
+}
+
+// Approximately normal, from the sum of uniforms
+static double gaussian() {
+  double sum = 0;
+  for (int i = 0; i < 12; i++) {
+    sum += (nextRandom() & 0x7FFF) / 32768.0;
+  }
+  return sum - 6.0;
+}
+
+// Wheel speed at time t (seconds from the start of the ride)
+static double wheelRPMAt(const Ride& ride, double t) {
+  double start = 0;
+  double rpm = ride.startRPM;
+  for (uint8_t i = 0; i < ride.segmentCount; i++) {
+    const Segment& segment = ride.segments[i];
+    if (t < start + segment.seconds) {
+      return rpm + (segment.rpm - rpm) * (t - start) / segment.seconds;
+    }
+    start += segment.seconds;
+    rpm = segment.rpm;
+  }
+  return rpm;
+}
+
+static double lengthOf(const Ride& ride) {
+  double length = 0;
+  for (uint8_t i = 0; i < ride.segmentCount; i++) {
+    length += ride.segments[i].seconds;
+  }
+  return length;
+}
+
+// Worst slot difference between a learned table and the real shares, at
+// the best rotation (the table's slot 0 is whichever magnet came first)
+static double tableError(const SpacingCalibrator& calibrator, const double* shares, uint8_t magnets) {
+  double best = 1e9;
+  for (uint8_t shift = 0; shift < magnets; shift++) {
+    double worst = 0;
+    for (uint8_t i = 0; i < magnets; i++) {
+      double learned = calibrator.getSpacing((uint8_t)((i + shift) % magnets)) / (double)SPACING_ONE;
+      double difference = fabs(learned - shares[i]) * 100;
+      if (difference > worst) {
+        worst = difference;
+      }
+    }
+    if (worst < best) {
+      best = worst;
+    }
+  }
+  return best;
+}
+
+// Ride once; shares[i] is the real angle from magnet i-1 to magnet i as a
+// fraction of the even spacing
+static void run(const Ride& ride, const double* shares, uint8_t magnets, uint32_t maxLatency,
+                Mode mode, SpacingTable& table, RunResult& result) {
+  static SensorEngine engine;
+  SensorChannelConfig channel = {SENSOR_PIN_NONE, magnets, 1000, WHEEL_GLITCH_PERCENT, 1};
+
+  virtualMicros = 1000000;
+  engine.clearChannels();
+  engine.addChannel(channel);
+  engine.configureSpacing(0, mode != MODE_OFF);
+  if (mode == MODE_RESTORED) {
+    engine.getSpacing(0).loadTable(table);
+  }
+  engine.reset();
+  randomSeed = 7;
+  memset(&result, 0, sizeof(result));
+  result.calibratedAfter = -1;
+
+  // Magnet positions in revolutions; the wheel angle is integrated over
+  // the 1 ms passes and the edge time interpolated within the pass
+  double positions[SPACING_MAX_SLOTS + 1];
+  positions[0] = 0;
+  for (uint8_t i = 1; i <= magnets; i++) {
+    positions[i] = positions[i - 1] + shares[i % magnets] / magnets;
+  }
+  positions[magnets] = 1.0;  // Exactly, so the wheel angle's whole turns line up
+  double angle = 0;
+  uint8_t nextMagnet = 1;
+  uint32_t edgeCount = 0;
+  double lastTrueEdge = -1;  // Seconds, of the last edge the sensor saw (< 0 after a stop)
+  double lastShare = 0;
+
+  uint64_t start = virtualMicros;
+  uint64_t end = start + (uint64_t)(lengthOf(ride) * 1e6);
+  while (virtualMicros < end) {
+    uint64_t passStart = virtualMicros;
+    virtualMicros += LOOP_MICROS;
+    double t = (virtualMicros - start) / 1e6;
+    double rpm = wheelRPMAt(ride, t);
+    double turn = rpm / 60.0 * LOOP_MICROS / 1e6;
+
+    bool scored = false;
+    double truth = 0;
+    double revolutionStart = floor(angle);
+    double target = revolutionStart + positions[nextMagnet];
+    if (turn > 0 && angle + turn >= target) {
+      double edgeOffset = (target - angle) / turn * LOOP_MICROS;
+      double edgeSeconds = (passStart - start + edgeOffset) / 1e6;
+      edgeCount++;
+      bool missed = ride.missEvery > 0 && edgeCount % ride.missEvery == 0;
+      if (!missed) {
+        uint64_t edgeTime = passStart + (uint64_t)edgeOffset + latency(maxLatency);
+        engine.recordEdge(0, (uint32_t)(edgeTime < virtualMicros ? edgeTime : virtualMicros));
+
+        // True mean speed over the interval this edge closes (the missed
+        // edge's interval included)
+        double share = lastShare + shares[nextMagnet % magnets];
+        if (lastTrueEdge >= 0) {
+          truth = share / magnets * 60.0 / (edgeSeconds - lastTrueEdge);
+          scored = t * 1e6 >= SETTLE_MICROS;
+        }
+        lastTrueEdge = edgeSeconds;
+        lastShare = 0;
+      } else {
+        lastShare += shares[nextMagnet % magnets];
+      }
+      nextMagnet = (uint8_t)(nextMagnet % magnets + 1);
+    }
+    angle += turn;
+    if (rpm == 0) {
+      lastTrueEdge = -1;
+      lastShare = 0;
+    }
+
+    engine.process();
+    engine.checkTimeouts();
+
+    const SpacingCalibrator& calibrator = engine.getSpacing(0);
+    if (result.calibratedAfter < 0 && calibrator.isCalibrated() && calibrator.isSynced()) {
+      result.calibratedAfter = t;
+    }
+
+    // The instant value is the interval of the one edge in this pass
+    uint32_t reading = engine.getInstantMilliRPM(0);
+    if (scored && reading > 0) {
+      double error = fabs(reading / (double)MILLI_RPM_PER_RPM - truth);
+      result.errorSum += error;
+      if (error > result.maxError) {
+        result.maxError = error;
+      }
+      result.edges++;
+    }
+  }
+
+  const SpacingCalibrator& calibrator = engine.getSpacing(0);
+  result.tableError = mode == MODE_OFF ? -1 : tableError(calibrator, shares, magnets);
+  result.resyncs = calibrator.getResyncCount();
+  if (mode == MODE_LEARN) {
+    calibrator.getTable(table);
+  }
+}
+
+int main(int argc, char** argv) {
+  double errorDegrees = 2;
+  int magnets = WHEEL_MAGNETS;
+  uint32_t seed = 1;
+  uint32_t maxLatency = 5;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--error-deg") == 0 && i + 1 < argc) {
+      errorDegrees = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--magnets") == 0 && i + 1 < argc) {
+      magnets = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--latency-us") == 0 && i + 1 < argc) {
+      maxLatency = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--error-deg <n>] [--magnets <n>] [--seed <n>] [--latency-us <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (magnets < 2 || magnets > SPACING_MAX_SLOTS) {
+    fprintf(stderr, "Error: --magnets must be 2 to %d\n", SPACING_MAX_SLOTS);
+    return 2;
+  }
+  if (errorDegrees < 0 || errorDegrees * 3 >= 360.0 / magnets / 2) {
+    fprintf(stderr, "Error: --error-deg is too large for %d magnets\n", magnets);
+    return 2;
+  }
+
+  // Place the magnets: nominal angle plus a random error, then express
+  // each gap as a fraction of the even gap
+  randomSeed = seed;
+  double placed[SPACING_MAX_SLOTS];
+  for (int i = 0; i < magnets; i++) {
+    placed[i] = i * 360.0 / magnets + gaussian() * errorDegrees;
+  }
+  double shares[SPACING_MAX_SLOTS];
+  double worstShare = 0;
+  for (int i = 0; i < magnets; i++) {
+    double gap = i > 0 ? placed[i] - placed[i - 1] : placed[0] + 360.0 - placed[magnets - 1];
+    shares[i] = gap / (360.0 / magnets);
+    worstShare = fmax(worstShare, fabs(shares[i] - 1) * 100);
+  }
+  printf("# %d magnets, %.1f deg placement error, largest gap error %.1f%%\n", magnets, errorDegrees, worstShare);
+
+  printf("Ride,Calibration,Mean error(rpm),Max error(rpm),Calibrated after(s),Table error(%%),Resyncs\n");
+  for (size_t r = 0; r < sizeof(RIDES) / sizeof(RIDES[0]); r++) {
+    SpacingTable table;
+    memset(&table, 0, sizeof(table));
+    for (int mode = 0; mode < MODE_COUNT; mode++) {
+      RunResult result;
+      run(RIDES[r], shares, (uint8_t)magnets, maxLatency, (Mode)mode, table, result);
+      printf("%s,%s,%.3f,%.2f,", RIDES[r].name, MODE_NAMES[mode],
+             result.edges > 0 ? result.errorSum / result.edges : 0.0, result.maxError);
+      if (mode == MODE_OFF) {
+        printf("-,-,-\n");
+        continue;
+      }
+      if (result.calibratedAfter < 0) {
+        printf("never,");
+      } else {
+        printf("%.1f,", result.calibratedAfter);
+      }
+      printf("%.2f,%lu\n", result.tableError, result.resyncs);
+    }
+  }
+  return 0;
+}
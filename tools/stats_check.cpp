@@ -0,0 +1,183 @@
+// Brute-force check of the streaming statistics in
+// include/streaming_stats.h. Seeded sample sequences (random, monotonic,
+// constant, sawtooth, spiky, and values near the 2^26 the window's sums
+// are sized for) are fed to SlidingWindow and MedianFilter of several
+// sizes. After every sample the structure's answers are compared with a
+// plain recomputation over a copy of the recent samples: mean, min and
+// max exactly, the variance to within the 1 unit its integer rounding may
+// lose, the median exactly. Each structure is also reset part way through
+// a sequence. Exits 1 on any mismatch.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o stats_check stats_check.cpp
+// Usage: stats_check [--samples <n>] [--seed <n>]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+#include "streaming_stats.h"
+
+enum Pattern {
+  PATTERN_RANDOM,
+  PATTERN_RISING,
+  PATTERN_FALLING,
+  PATTERN_CONSTANT,
+  PATTERN_SAWTOOTH,
+  PATTERN_SPIKES,
+  PATTERN_LARGE,
+  PATTERN_COUNT
+};
+
+static const char* PATTERN_NAMES[PATTERN_COUNT] = {
+  "random", "rising", "falling", "constant", "sawtooth", "spikes", "large"
+};
+
+static std::vector<uint32_t> makeSequence(Pattern pattern, size_t length, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::vector<uint32_t> samples(length);
+  for (size_t i = 0; i < length; i++) {
+    switch (pattern) {
+      case PATTERN_RANDOM:   samples[i] = random() % 1000000; break;
+      case PATTERN_RISING:   samples[i] = (uint32_t)(i * 7); break;
+      case PATTERN_FALLING:  samples[i] = (uint32_t)((length - i) * 7); break;
+      case PATTERN_CONSTANT: samples[i] = 280000; break;
+      case PATTERN_SAWTOOTH: samples[i] = (uint32_t)(i % 23) * 1000; break;
+      case PATTERN_SPIKES:   samples[i] = random() % 50 == 0 ? 900000 : 280000 + random() % 200; break;
+      case PATTERN_LARGE:    samples[i] = (1u << 26) - 1 - random() % 1000; break;
+      default:               samples[i] = 0; break;
+    }
+  }
+  return samples;
+}
+
+// Exact population variance, rounded down
+static uint64_t bruteVariance(const std::deque<uint32_t>& window) {
+  unsigned __int128 sum = 0;
+  unsigned __int128 sumSquares = 0;
+  for (size_t i = 0; i < window.size(); i++) {
+    sum += window[i];
+    sumSquares += (unsigned __int128)window[i] * window[i];
+  }
+  unsigned __int128 n = window.size();
+  return (uint64_t)((n * sumSquares - sum * sum) / (n * n));
+}
+
+template <uint16_t N>
+static unsigned long checkWindow(const std::vector<uint32_t>& samples) {
+  SlidingWindow<uint32_t, N> window;
+  std::deque<uint32_t> recent;
+  unsigned long mismatches = 0;
+
+  for (size_t i = 0; i < samples.size(); i++) {
+    // Start over once, part way through
+    if (i == samples.size() / 3) {
+      window.reset();
+      recent.clear();
+    }
+
+    window.add(samples[i]);
+    recent.push_back(samples[i]);
+    if (recent.size() > N) {
+      recent.pop_front();
+    }
+
+    uint64_t sum = 0;
+    for (size_t j = 0; j < recent.size(); j++) {
+      sum += recent[j];
+    }
+    uint32_t mean = (uint32_t)(sum / recent.size());
+    uint32_t low = *std::min_element(recent.begin(), recent.end());
+    uint32_t high = *std::max_element(recent.begin(), recent.end());
+    uint64_t variance = bruteVariance(recent);
+    uint64_t reported = window.variance();
+    uint64_t varianceError = reported > variance ? reported - variance : variance - reported;
+
+    if (window.size() != recent.size() || window.mean() != mean || window.min() != low ||
+        window.max() != high || varianceError > 1) {
+      if (mismatches == 0) {
+        fprintf(stderr, "SlidingWindow<%u> sample %zu: size %u/%zu mean %u/%u min %u/%u max %u/%u variance %llu/%llu\n",
+                N, i, window.size(), recent.size(), window.mean(), mean, window.min(), low, window.max(), high,
+                (unsigned long long)reported, (unsigned long long)variance);
+      }
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+template <uint8_t N>
+static unsigned long checkMedian(const std::vector<uint32_t>& samples) {
+  MedianFilter<uint32_t, N> filter;
+  std::deque<uint32_t> recent;
+  unsigned long mismatches = 0;
+
+  for (size_t i = 0; i < samples.size(); i++) {
+    if (i == samples.size() / 3) {
+      filter.reset();
+      recent.clear();
+    }
+
+    uint32_t median = filter.add(samples[i]);
+    recent.push_back(samples[i]);
+    if (recent.size() > N) {
+      recent.pop_front();
+    }
+
+    std::vector<uint32_t> sorted(recent.begin(), recent.end());
+    std::sort(sorted.begin(), sorted.end());
+    if (median != sorted[sorted.size() / 2]) {
+      if (mismatches == 0) {
+        fprintf(stderr, "MedianFilter<%u> sample %zu: %u, expected %u\n", N, i, median, sorted[sorted.size() / 2]);
+      }
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+static bool failed = false;
+
+static void report(const char* structure, unsigned size, Pattern pattern, size_t samples, unsigned long mismatches) {
+  failed = failed || mismatches > 0;
+  printf("%s,%u,%s,%zu,%lu,%s\n", structure, size, PATTERN_NAMES[pattern], samples, mismatches,
+         mismatches == 0 ? "ok" : "FAIL");
+}
+
+int main(int argc, char** argv) {
+  size_t length = 20000;
+  uint32_t seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+      length = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--samples <n>] [--seed <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (length == 0) {
+    fprintf(stderr, "Error: --samples must be non-zero\n");
+    return 2;
+  }
+
+  // RECENT_EDGE_WINDOW is 16 and SPIKE_MEDIAN_SIZE 3; the other sizes
+  // cover the edges of the index arithmetic
+  printf("Structure,Size,Sequence,Samples,Mismatches,Result\n");
+  for (int p = 0; p < PATTERN_COUNT; p++) {
+    Pattern pattern = (Pattern)p;
+    std::vector<uint32_t> samples = makeSequence(pattern, length, seed + p);
+    report("SlidingWindow", 1, pattern, length, checkWindow<1>(samples));
+    report("SlidingWindow", 5, pattern, length, checkWindow<5>(samples));
+    report("SlidingWindow", 16, pattern, length, checkWindow<16>(samples));
+    report("SlidingWindow", 100, pattern, length, checkWindow<100>(samples));
+    report("MedianFilter", 3, pattern, length, checkMedian<3>(samples));
+    report("MedianFilter", 5, pattern, length, checkMedian<5>(samples));
+    report("MedianFilter", 9, pattern, length, checkMedian<9>(samples));
+  }
+  return failed ? 1 : 0;
+}
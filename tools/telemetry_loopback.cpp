@@ -0,0 +1,241 @@
+// Runs a logged session through the ESP-NOW telemetry batcher and send
+// window with a simulated lossy radio in place of esp_now_send(). Every
+// frame that arrives is decoded and checked against the samples that went
+// in, then delivery counters, bytes per sample and latency are reported.
+//
+// Build: g++ -std=c++11 -O2 -I../include -o telemetry_loopback telemetry_loopback.cpp ../src/telemetry_codec.cpp ../src/telemetry_link.cpp
+// Usage: telemetry_loopback [options] <session.csv>
+//   --interval <ms>   Telemetry sample interval (default TELEMETRY_SAMPLE_INTERVAL)
+//   --latency <ms>    Max time a sample waits in a partly filled frame (default TELEMETRY_MAX_LATENCY)
+//   --retry <ms>      Max time a frame is retried (default TELEMETRY_RETRY_DEADLINE)
+//   --airtime <ms>    Time from send to send callback (default 2)
+//   --loss <pct>      Chance a frame never reaches the receiver
+//   --ack-loss <pct>  Chance a delivered frame is still reported as failed
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <map>
+#include "config.h"
+#include "session_log_format.h"
+#include "telemetry_codec.h"
+#include "telemetry_link.h"
+
+// Simulated radio: each accepted frame is "on the air" for airtime ms,
+// then either reaches the receiver or is lost, and the send callback
+// fires. A lost ack delivers the frame but still reports a failure.
+class LossyTransport : public TelemetryTransport {
+public:
+  LossyTransport() : link(nullptr), currentTime(0), airtime(2), lossPercent(0), ackLossPercent(0),
+                     busy(false), mismatches(0), totalLatency(0), maxLatency(0) {}
+
+  bool send(const uint8_t* data, size_t length) override {
+    if (busy) {
+      return false;
+    }
+    memcpy(frame, data, length);
+    frameLength = length;
+    doneAt = currentTime + airtime;
+    busy = true;
+    return true;
+  }
+
+  // Advance the simulated radio to the given time
+  void step(uint32_t time) {
+    currentTime = time;
+    if (!busy || time < doneAt) {
+      return;
+    }
+    busy = false;
+
+    bool delivered = rand() % 100 >= (int)lossPercent;
+    bool acked = delivered && rand() % 100 >= (int)ackLossPercent;
+    if (delivered) {
+      receive();
+    }
+    link->onSendComplete(acked);
+  }
+
+  TelemetryLink* link;
+  TelemetryDecoder decoder;
+  std::map<uint32_t, TelemetrySample> expected;  // Sent samples by time, removed on arrival
+  uint32_t currentTime;
+  uint32_t airtime;
+  unsigned lossPercent;
+  unsigned ackLossPercent;
+  bool busy;
+  unsigned long mismatches;
+  uint64_t totalLatency;
+  uint32_t maxLatency;
+
+private:
+  uint8_t frame[TELEMETRY_MAX_FRAME_SIZE];
+  size_t frameLength;
+  uint32_t doneAt;
+
+  void receive() {
+    TelemetrySample samples[TELEMETRY_MAX_FRAME_SIZE];
+    int count = decoder.decode(frame, frameLength, samples, TELEMETRY_MAX_FRAME_SIZE);
+    if (count < 0) {
+      mismatches++;
+      return;
+    }
+    for (int i = 0; i < count; i++) {
+      std::map<uint32_t, TelemetrySample>::iterator it = expected.find(samples[i].time);
+      if (it == expected.end() || memcmp(&it->second, &samples[i], sizeof(TelemetrySample)) != 0) {
+        mismatches++;
+        continue;
+      }
+      // Latency from sampling to arrival at the receiver
+      uint32_t latency = currentTime - samples[i].time;
+      totalLatency += latency;
+      if (latency > maxLatency) {
+        maxLatency = latency;
+      }
+      expected.erase(it);
+    }
+  }
+};
+
+// Simulated millisecond clock, read when the batcher queues a frame
+static uint32_t now = 0;
+
+// Batcher send function - queues the frame on the link
+static bool queueFrame(const uint8_t* data, size_t length, void* context) {
+  static_cast<TelemetryLink*>(context)->submit(data, length, now);
+  return true;
+}
+
+struct Row {
+  uint32_t elapsed;
+  double wheelRPM;
+  double cadenceRPM;
+  unsigned chainring;
+  unsigned sprocket;
+  double gearRatio;
+};
+
+static bool readRows(FILE* in, std::vector<Row>& rows) {
+  char line[256];
+  while (fgets(line, sizeof(line), in)) {
+    unsigned long timestamp;
+    Row row;
+    double sessionWheel, sessionCadence;
+    if (sscanf(line, "%lu,%u,%lf,%lf,%lf,%lf,%u,%u,%lf", &timestamp, &row.elapsed, &row.wheelRPM,
+               &row.cadenceRPM, &sessionWheel, &sessionCadence, &row.chainring, &row.sprocket,
+               &row.gearRatio) != 9) {
+      continue;  // Header
+    }
+    rows.push_back(row);
+  }
+  return rows.size() >= 2;
+}
+
+int main(int argc, char** argv) {
+  const char* inputName = nullptr;
+  uint32_t interval = TELEMETRY_SAMPLE_INTERVAL;
+  uint32_t latency = TELEMETRY_MAX_LATENCY;
+  uint32_t retry = TELEMETRY_RETRY_DEADLINE;
+  LossyTransport radio;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+      interval = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+      latency = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--retry") == 0 && i + 1 < argc) {
+      retry = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--airtime") == 0 && i + 1 < argc) {
+      radio.airtime = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+      radio.lossPercent = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--ack-loss") == 0 && i + 1 < argc) {
+      radio.ackLossPercent = strtoul(argv[++i], nullptr, 10);
+    } else {
+      inputName = argv[i];
+    }
+  }
+
+  if (!inputName || interval == 0) {
+    fprintf(stderr, "Usage: %s [--interval <ms>] [--latency <ms>] [--retry <ms>]\n"
+                    "       [--airtime <ms>] [--loss <pct>] [--ack-loss <pct>] <session.csv>\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(inputName, "r");
+  if (!in) {
+    fprintf(stderr, "Error: cannot open %s\n", inputName);
+    return 1;
+  }
+  std::vector<Row> rows;
+  bool loaded = readRows(in, rows);
+  fclose(in);
+  if (!loaded) {
+    fprintf(stderr, "Error: need at least two rows in %s\n", inputName);
+    return 1;
+  }
+
+  srand(1);  // Same losses on every run
+
+  TelemetryLink link;
+  link.begin(&radio, retry);
+  radio.link = &link;
+
+  TelemetryBatcher batcher;
+  batcher.begin(latency, queueFrame, &link);
+
+  // Step a millisecond clock, sampling the logged rows with linear
+  // interpolation so the deltas look like a live 10 Hz stream
+  unsigned long samples = 0;
+  size_t row = 0;
+  uint32_t endTime = rows.back().elapsed;
+  for (uint32_t t = rows.front().elapsed; t <= endTime; t++) {
+    now = t;
+    radio.step(t);
+    if ((t - rows.front().elapsed) % interval == 0) {
+      while (row + 2 < rows.size() && rows[row + 1].elapsed <= t) row++;
+      const Row& a = rows[row];
+      const Row& b = rows[row + 1];
+      double f = b.elapsed > a.elapsed ? (double)(t - a.elapsed) / (b.elapsed - a.elapsed) : 0;
+      if (f > 1) f = 1;
+
+      TelemetrySample sample;
+      sample.time = t;
+      sample.wheelRPM = sessionLogFixed((float)(a.wheelRPM + (b.wheelRPM - a.wheelRPM) * f), SESSION_LOG_RPM_SCALE);
+      sample.cadenceRPM = sessionLogFixed((float)(a.cadenceRPM + (b.cadenceRPM - a.cadenceRPM) * f), SESSION_LOG_RPM_SCALE);
+      sample.chainring = (uint8_t)a.chainring;
+      sample.sprocket = (uint8_t)a.sprocket;
+      sample.gearRatio = sessionLogFixed((float)a.gearRatio, SESSION_LOG_RATIO_SCALE);
+
+      radio.expected[sample.time] = sample;
+      batcher.add(sample, 0);
+      samples++;
+    }
+    batcher.update(t);
+    link.update(t);
+  }
+
+  // Let the link drain whatever is still queued
+  batcher.flush();
+  for (uint32_t t = endTime + 1; t <= endTime + retry + radio.airtime + 1; t++) {
+    now = t;
+    radio.step(t);
+    link.update(t);
+  }
+
+  unsigned long delivered = samples - radio.expected.size();
+
+  printf("Samples:          %lu (every %u ms), delivered %lu, mismatches %lu\n",
+         samples, interval, delivered, radio.mismatches);
+  printf("Frames:           %lu built, %lu sends, %lu acked, %lu retried, %lu dropped (%lu coalesced)\n",
+         batcher.getFramesSent(), link.getSentCount(), link.getAckedCount(), link.getRetriedCount(),
+         link.getDroppedCount(), link.getCoalescedCount());
+  printf("Receiver:         %lu frames, %lu lost, %lu duplicates\n",
+         radio.decoder.getFrameCount(), radio.decoder.getLostFrames(), radio.decoder.getDuplicateFrames());
+  printf("Bytes per sample: %.2f (one SensorData per sample: %u)\n",
+         samples > 0 ? (double)batcher.getBytesSent() / samples : 0.0, 20u);
+  printf("Latency:          mean %.0f ms, max %u ms\n",
+         delivered > 0 ? (double)radio.totalLatency / delivered : 0.0, radio.maxLatency);
+  return radio.mismatches == 0 ? 0 : 1;
+}
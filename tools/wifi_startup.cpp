@@ -0,0 +1,159 @@
+// Host test of WiFiManager's background startup and of the telemetry
+// queued while it runs, against the Wi-Fi, NTP and ESP-NOW stand-ins in
+// native/. Each case scripts when the access point and the time server
+// answer (or that they never do, or that ESP-NOW will not start), then
+// steps loop() a millisecond at a time on the shim clock: update(), a
+// telemetry sample every TELEMETRY_SAMPLE_INTERVAL from boot, then
+// updateTelemetry(). The simulated radio acks every frame on the next
+// pass and the receiver decodes it. A case passes when
+//   - the link is ready (or has failed) at the time the timeouts give,
+//   - no frame expires on the retry deadline: the only frames missing at
+//     the receiver are those the full startup queue coalesced,
+//   - once the clock has synced, every frame carries the boot time, also
+//     those built before the sync; without a sync every frame carries 0.
+// Exits 1 if any case fails.
+//
+// Build: g++ -std=gnu++17 -O2 -DARDUINO_SHIM -I../native -I../include -o wifi_startup wifi_startup.cpp ../src/wifi_manager.cpp ../src/telemetry_codec.cpp ../src/telemetry_link.cpp ../native/arduino_shim.cpp ../native/wifi_shim.cpp
+// Usage: wifi_startup [--seconds <n>]
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_now.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "config.h"
+#include "wifi_manager.h"
+
+struct Case {
+  const char* name;
+  unsigned long connectAfter;  // ms from WiFi.begin(), SHIM_NEVER if never
+  unsigned long syncAfter;     // ms from configTime(), SHIM_NEVER if never
+  bool espNowFails;
+  WiFiState expectedState;
+  unsigned long expectedReadyAt;
+};
+
+static const Case CASES[] = {
+  {"connect-and-sync", 2000, 1500, false, WIFI_STATE_READY, 3500},
+  {"slow-sync", 4000, 8000, false, WIFI_STATE_READY, 12000},
+  {"no-ntp", 2000, SHIM_NEVER, false, WIFI_STATE_READY, 2000 + NTP_SYNC_TIMEOUT},
+  {"no-access-point", SHIM_NEVER, SHIM_NEVER, false, WIFI_STATE_READY, WIFI_CONNECT_TIMEOUT},
+  {"esp-now-fails", 2000, 1500, true, WIFI_STATE_FAILED, 3500},
+};
+
+struct Result {
+  unsigned long readyAt;
+  unsigned long syncAt;
+  unsigned long received;
+  unsigned long frameErrors;  // Malformed, or with the wrong boot time
+  unsigned long sequences;  // Frames the batcher numbered
+};
+
+static Result runCase(const Case& test, uint32_t runMillis) {
+  // A fresh manager for each case - onDataSent() reaches it by name
+  wifiManager.~WiFiManager();
+  new (&wifiManager) WiFiManager();
+  shimScriptWiFi(test.connectAfter, test.syncAfter);
+  if (test.espNowFails) {
+    shimFailEspNowInit();
+  }
+  shimSetMicros(0);
+
+  Result result = {0, 0, 0, 0, 0};
+  TelemetryDecoder decoder;
+  bool ready = false;
+  bool synced = false;
+  wifiManager.start();
+
+  // Samples stop after runMillis; the rest lets the last frame drain
+  uint32_t endMillis = runMillis + TELEMETRY_MAX_LATENCY + TELEMETRY_RETRY_DEADLINE;
+  for (uint32_t t = 0; t <= endMillis; t++) {
+    shimSetMicros((uint64_t)t * 1000);
+
+    // Frames sent on the previous pass reach the receiver
+    uint8_t frame[ESP_NOW_MAX_DATA_LEN];
+    size_t length;
+    while (shimEspNowDeliver(true, frame, &length)) {
+      TelemetrySample samples[TELEMETRY_MAX_FRAME_SIZE];
+      int count = decoder.decode(frame, length, samples, TELEMETRY_MAX_FRAME_SIZE);
+      if (count <= 0) {
+        result.frameErrors++;
+        continue;
+      }
+      result.received++;
+      result.sequences = decoder.getLastSequence() + 1;
+      uint32_t expected = synced ? wifiManager.getBootTimestamp() : 0;
+      if (decoder.getLastBootTime() != expected) {
+        result.frameErrors++;
+      }
+    }
+
+    wifiManager.update(t);
+    if (!ready && wifiManager.getState() >= WIFI_STATE_READY) {
+      ready = true;
+      result.readyAt = t;
+    }
+    if (!synced && wifiManager.isTimeValid()) {
+      synced = true;
+      result.syncAt = t;
+    }
+
+    if (t <= runMillis && t % TELEMETRY_SAMPLE_INTERVAL == 0) {
+      TelemetrySample sample;
+      memset(&sample, 0, sizeof(sample));
+      sample.time = t;
+      sample.wheelRPM = (uint16_t)(2800 + t / 100 % 50);
+      sample.cadenceRPM = 900;
+      wifiManager.sendSample(sample);
+    }
+    wifiManager.updateTelemetry(t);
+  }
+  return result;
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds = 30;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--seconds <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (seconds * 1000UL <= WIFI_CONNECT_TIMEOUT + NTP_SYNC_TIMEOUT) {
+    fprintf(stderr, "Error: --seconds must outlast the startup timeouts (%u s)\n",
+            (WIFI_CONNECT_TIMEOUT + NTP_SYNC_TIMEOUT) / 1000);
+    return 2;
+  }
+
+  Serial.setEcho(false);  // WiFiManager's progress messages
+  bool failed = false;
+
+  printf("Case,State,ReadyAt(ms),SyncAt(ms),Frames,Received,Coalesced,DeadlineDrops,FrameErrors,Result\n");
+  for (size_t c = 0; c < sizeof(CASES) / sizeof(CASES[0]); c++) {
+    const Case& test = CASES[c];
+    Result result = runCase(test, seconds * 1000);
+    const TelemetryLink& link = wifiManager.getTelemetryLink();
+    unsigned long coalesced = link.getCoalescedCount();
+    unsigned long deadlineDrops = link.getDroppedCount() - coalesced;
+
+    bool ok = wifiManager.getState() == test.expectedState && result.readyAt == test.expectedReadyAt &&
+              result.frameErrors == 0;
+    if (test.expectedState == WIFI_STATE_READY) {
+      ok = ok && deadlineDrops == 0 && result.received > 0 && result.received + coalesced == result.sequences;
+    } else {
+      ok = ok && result.received == 0 && link.getSentCount() == 0;
+    }
+    failed = failed || !ok;
+
+    printf("%s,%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%s\n", test.name,
+           wifiManager.getState() == WIFI_STATE_READY ? "ready" : "failed", result.readyAt,
+           wifiManager.isTimeValid() ? result.syncAt : 0, result.sequences, result.received, coalesced,
+           deadlineDrops, result.frameErrors, ok ? "ok" : "FAIL");
+  }
+  return failed ? 1 : 0;
+}